@@ -36,6 +36,7 @@
 #include "SDL_thread.h"
 
 typedef uint32_t Uint32;
+typedef int32_t Sint32;
 
 __BEGIN_DECLS
 
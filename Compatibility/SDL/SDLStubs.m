@@ -27,6 +27,7 @@
 #include "SDL.h"
 #include "SDL_thread.h"
 #import <OpenEmuBase/OETimingUtils.h>
+#include <errno.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <sys/time.h>
@@ -91,11 +92,37 @@ int SDL_CondWait(SDL_cond *cond, SDL_mutex *mut)
     return pthread_cond_wait((pthread_cond_t*)cond, (pthread_mutex_t*)mut);
 }
 
+int SDL_CondWaitTimeout(SDL_cond *cond, SDL_mutex *mut, uint32_t ms)
+{
+    struct timeval now;
+    struct timespec abstime;
+    int retval;
+    
+    gettimeofday(&now, NULL);
+    abstime.tv_sec = now.tv_sec + ms / 1000;
+    abstime.tv_nsec = (now.tv_usec + (ms % 1000) * 1000) * 1000;
+    if (abstime.tv_nsec >= 1000000000) {
+        abstime.tv_sec += 1;
+        abstime.tv_nsec -= 1000000000;
+    }
+    
+    retval = pthread_cond_timedwait((pthread_cond_t*)cond, (pthread_mutex_t*)mut, &abstime);
+    if (retval == ETIMEDOUT) {
+        return SDL_MUTEX_TIMEDOUT;
+    }
+    return retval;
+}
+
 int SDL_CondSignal(SDL_cond *cond)
 {
     return pthread_cond_signal((pthread_cond_t*)cond);
 }
 
+int SDL_CondBroadcast(SDL_cond *cond)
+{
+    return pthread_cond_broadcast((pthread_cond_t*)cond);
+}
+
 void SDL_DestroyCond(SDL_cond *cond)
 {
     pthread_cond_destroy((pthread_cond_t*)cond);
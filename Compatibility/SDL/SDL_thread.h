@@ -27,7 +27,10 @@
 #ifndef SDL_THREAD_H
 #define SDL_THREAD_H
 
+#include <stdint.h>
+
 #define SDL_VERSION_ATLEAST(x,y,z) 1
+#define SDL_MUTEX_TIMEDOUT 1
 
 typedef void SDL_mutex;
 typedef void SDL_cond;
@@ -43,7 +46,9 @@ void SDL_DestroyMutex(SDL_mutex *m);
 
 SDL_cond *SDL_CreateCond(void);
 int SDL_CondWait(SDL_cond *cond, SDL_mutex *mut);
+int SDL_CondWaitTimeout(SDL_cond *cond, SDL_mutex *mut, uint32_t ms);
 int SDL_CondSignal(SDL_cond *cond);
+int SDL_CondBroadcast(SDL_cond *cond);
 void SDL_DestroyCond(SDL_cond *cond);
 
 SDL_Thread *SDL_CreateThread(int (*fn)(void *), const char *name, void *context);
@@ -33,5 +33,14 @@
 #define STRICTINLINE inline
 #endif
 
+// SIMD, only baseline instruction sets that need no runtime detection
+#if !defined(NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SIMD_SSE2
+#include <emmintrin.h>
+#elif !defined(NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 // misc
 #define UNUSED(x) (void)(x)
@@ -169,6 +169,7 @@ static void n64video_init_parallel(uint32_t worker_id)
     wstate->stride = parallel_num_workers();
     wstate->offset = worker_id;
     wstate->rseed = wstate->vi_rseed = 3 + worker_id * 13;
+    tmem_cache_init(wstate, worker_id);
 }
 
 void n64video_init(struct n64video_config* _config)
@@ -229,6 +230,7 @@ void n64video_init(struct n64video_config* _config)
         wstate->stride = 1;
         wstate->offset = 0;
         wstate->rseed = 3;
+        tmem_cache_init(wstate, 0);
     }
 }
 
@@ -318,4 +320,5 @@ void n64video_close(void)
 {
     vi_close();
     parallel_close();
+    tmem_cache_close();
 }
@@ -101,9 +101,11 @@ struct n64video_config
         bool vsync;                 // enable vsync if true
         bool exclusive;             // run in exclusive mode when in fullscreen if true
         bool integer_scaling;       // one native pixel is displayed as a multiple of a screen pixel if true
+        bool async;                 // run VI filters in the background, overlapped with the next frame, if true
     } vi;
     struct {
         enum dp_compat_profile compat;  // multithreading compatibility mode
+        bool tmem_cache;                // sample textures from a pre-decoded copy of TMEM if true
     } dp;
     bool parallel;                  // use multithreaded renderer if true
     bool busyloop;                  // use a busyloop while waiting for work
@@ -335,6 +335,7 @@ struct rdp_state
 
     // tmem
     uint8_t tmem[0x1000];
+    struct tmem_cache* tmem_cache;
 
     // zbuffer
     uint32_t zb_address;
@@ -727,6 +727,8 @@ static void loading_pipeline(struct rdp_state* wstate, int start, int end, int t
             break;
             }
 
+            if (wstate->tmem_cache)
+                tmem_cache_invalidate(wstate->tmem_cache, tmemidx0, tmemidx1, tmemidx2, tmemidx3);
 
             s = (s + dsinc) & ~0x1f;
             t = (t + dtinc) & ~0x1f;
@@ -10,6 +10,254 @@ static uint8_t replicated_rgba[32];
 #define GET_MED_RGBA16_TMEM(x)  (replicated_rgba[((x) >> 6) & 0x1f])
 #define GET_HI_RGBA16_TMEM(x)   (replicated_rgba[(x) >> 11])
 
+// decoded TMEM cache: texels of the non-TLUT formats are a function of their
+// TMEM address, the format and, for CI4, the palette. Each slot holds the
+// decoded texels of one such format, filled lazily per 64-bit TMEM word and
+// invalidated by the loading pipeline whenever a word is written.
+#define TMEM_CACHE_SLOTS    2
+#define TMEM_CACHE_WORDS    0x200
+#define TMEM_CACHE_UNUSED   0xffffffff
+
+struct tmem_cache_slot
+{
+    uint32_t key;
+    uint64_t valid[TMEM_CACHE_WORDS / 64];
+    struct color texels[TMEM_CACHE_WORDS << 4];
+};
+
+struct tmem_cache
+{
+    struct tmem_cache_slot slot[TMEM_CACHE_SLOTS];
+    uint32_t last;
+};
+
+static struct tmem_cache* tmem_caches[PARALLEL_MAX_WORKERS];
+
+static void tmem_cache_init(struct rdp_state* wstate, uint32_t worker_id)
+{
+    wstate->tmem_cache = NULL;
+
+    if (!config.dp.tmem_cache) {
+        return;
+    }
+
+    if (!tmem_caches[worker_id]) {
+        tmem_caches[worker_id] = malloc(sizeof(struct tmem_cache));
+        if (!tmem_caches[worker_id]) {
+            return;
+        }
+    }
+
+    struct tmem_cache* cache = tmem_caches[worker_id];
+    for (uint32_t i = 0; i < TMEM_CACHE_SLOTS; i++) {
+        cache->slot[i].key = TMEM_CACHE_UNUSED;
+    }
+    cache->last = 0;
+
+    wstate->tmem_cache = cache;
+}
+
+static void tmem_cache_close(void)
+{
+    for (uint32_t i = 0; i < PARALLEL_MAX_WORKERS; i++) {
+        state[i].tmem_cache = NULL;
+        free(tmem_caches[i]);
+        tmem_caches[i] = NULL;
+    }
+}
+
+static void tmem_cache_invalidate(struct tmem_cache* cache, uint32_t idx0, uint32_t idx1, uint32_t idx2, uint32_t idx3)
+{
+    // RGBA32 texels also depend on the word in the upper half, so always
+    // drop both halves
+    uint64_t mask[TMEM_CACHE_WORDS / 64] = { 0 };
+    uint32_t idx[] = { idx0, idx1, idx2, idx3 };
+    for (int i = 0; i < 4; i++) {
+        uint32_t word = (idx[i] >> 2) & 0xff;
+        mask[word >> 6] |= 1ULL << (word & 63);
+        mask[(word | 0x100) >> 6] |= 1ULL << (word & 63);
+    }
+
+    for (int i = 0; i < TMEM_CACHE_SLOTS; i++) {
+        for (int j = 0; j < TMEM_CACHE_WORDS / 64; j++) {
+            cache->slot[i].valid[j] &= ~mask[j];
+        }
+    }
+}
+
+static void tmem_cache_decode(struct rdp_state* wstate, struct color* color, uint32_t kind, uint32_t tpal, uint32_t idx)
+{
+    uint32_t p, i;
+    uint16_t c;
+
+    switch (kind)
+    {
+    case TEXEL_RGBA4:
+    case TEXEL_I4:
+        p = wstate->tmem[idx >> 1];
+        p = (idx & 1) ? (p & 0xf) : (p >> 4);
+        p |= (p << 4);
+        color->r = color->g = color->b = color->a = p;
+        break;
+    case TEXEL_CI4:
+        p = wstate->tmem[idx >> 1];
+        p = (idx & 1) ? (p & 0xf) : (p >> 4);
+        p = (uint8_t)(tpal << 4) | p;
+        color->r = color->g = color->b = color->a = p;
+        break;
+    case TEXEL_IA4:
+        p = wstate->tmem[idx >> 1];
+        p = (idx & 1) ? (p & 0xf) : (p >> 4);
+        i = p & 0xe;
+        i = (i << 4) | (i << 1) | (i >> 2);
+        color->r = color->g = color->b = i;
+        color->a = (p & 0x1) ? 0xff : 0;
+        break;
+    case TEXEL_RGBA8:
+    case TEXEL_CI8:
+    case TEXEL_I8:
+        p = wstate->tmem[idx];
+        color->r = color->g = color->b = color->a = p;
+        break;
+    case TEXEL_IA8:
+        p = wstate->tmem[idx];
+        i = p & 0xf0;
+        i |= (i >> 4);
+        color->r = color->g = color->b = i;
+        color->a = ((p & 0xf) << 4) | (p & 0xf);
+        break;
+    case TEXEL_RGBA16:
+        c = tc16[idx];
+        color->r = GET_HI_RGBA16_TMEM(c);
+        color->g = GET_MED_RGBA16_TMEM(c);
+        color->b = GET_LOW_RGBA16_TMEM(c);
+        color->a = (c & 1) ? 0xff : 0;
+        break;
+    case TEXEL_RGBA32:
+        c = tc16[idx];
+        color->r = c >> 8;
+        color->g = c & 0xff;
+        c = tc16[idx | 0x400];
+        color->b = c >> 8;
+        color->a = c & 0xff;
+        break;
+    case TEXEL_IA16:
+        c = tc16[idx];
+        color->r = color->g = color->b = c >> 8;
+        color->a = c & 0xff;
+        break;
+    default:
+        c = tc16[idx];
+        color->r = color->b = c >> 8;
+        color->g = color->a = c & 0xff;
+        break;
+    }
+}
+
+static STRICTINLINE struct tmem_cache_slot* tmem_cache_lookup(struct rdp_state* wstate, uint32_t tilenum)
+{
+    struct tmem_cache* cache = wstate->tmem_cache;
+    uint32_t kind = wstate->tile[tilenum].f.notlutswitch;
+    uint32_t key = kind;
+
+    if (kind == TEXEL_CI4) {
+        key |= wstate->tile[tilenum].palette << 8;
+    }
+
+    struct tmem_cache_slot* slot = &cache->slot[cache->last];
+    if (slot->key == key) {
+        return slot;
+    }
+
+    // the other slot is either a hit or gets replaced
+    cache->last ^= 1;
+    slot = &cache->slot[cache->last];
+    if (slot->key != key) {
+        slot->key = key;
+        memset(slot->valid, 0, sizeof(slot->valid));
+    }
+
+    return slot;
+}
+
+static STRICTINLINE uint32_t tmem_cache_shift(uint32_t kind)
+{
+    switch (kind & 3)
+    {
+    case PIXEL_SIZE_4BIT:
+        return 4;
+    case PIXEL_SIZE_8BIT:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+static STRICTINLINE uint32_t tmem_cache_idx(uint32_t kind, uint32_t tbase, int s, int t)
+{
+    switch (kind & 3)
+    {
+    case PIXEL_SIZE_4BIT:
+        return (((((tbase << 4) + s) >> 1) ^ ((t & 1) ? BYTE_XOR_DWORD_SWAP : BYTE_ADDR_XOR)) & 0xfff) << 1 | (s & 1);
+    case PIXEL_SIZE_8BIT:
+        return (((tbase << 3) + s) ^ ((t & 1) ? BYTE_XOR_DWORD_SWAP : BYTE_ADDR_XOR)) & 0xfff;
+    default:
+        return (((tbase << 2) + s) ^ ((t & 1) ? WORD_XOR_DWORD_SWAP : WORD_ADDR_XOR)) & (kind == TEXEL_RGBA32 ? 0x3ff : 0x7ff);
+    }
+}
+
+static STRICTINLINE const struct color* tmem_cache_texel(struct rdp_state* wstate, struct tmem_cache_slot* slot, uint32_t shift, uint32_t idx)
+{
+    uint32_t word = idx >> shift;
+
+    if (!((slot->valid[word >> 6] >> (word & 63)) & 1)) {
+        uint32_t kind = slot->key & 0xff;
+        uint32_t tpal = slot->key >> 8;
+        for (uint32_t i = word << shift; i < (word + 1) << shift; i++) {
+            tmem_cache_decode(wstate, &slot->texels[i], kind, tpal, i);
+        }
+        slot->valid[word >> 6] |= 1ULL << (word & 63);
+    }
+
+    return &slot->texels[idx];
+}
+
+static STRICTINLINE bool tmem_cache_fetch(struct rdp_state* wstate, struct color* color, int s, int t, uint32_t tilenum)
+{
+    uint32_t kind = wstate->tile[tilenum].f.notlutswitch;
+    if (kind >= TEXEL_YUV4 && kind <= TEXEL_YUV32) {
+        return false;
+    }
+
+    struct tmem_cache_slot* slot = tmem_cache_lookup(wstate, tilenum);
+    uint32_t shift = tmem_cache_shift(kind);
+    uint32_t tbase = wstate->tile[tilenum].line * (t & 0xff) + wstate->tile[tilenum].tmem;
+
+    *color = *tmem_cache_texel(wstate, slot, shift, tmem_cache_idx(kind, tbase, s, t));
+    return true;
+}
+
+static STRICTINLINE bool tmem_cache_fetch_quadro(struct rdp_state* wstate, struct color* color0, struct color* color1, struct color* color2, struct color* color3, int s0, int sdiff, int t0, int tdiff, uint32_t tilenum)
+{
+    uint32_t kind = wstate->tile[tilenum].f.notlutswitch;
+    if (kind >= TEXEL_YUV4 && kind <= TEXEL_YUV32) {
+        return false;
+    }
+
+    struct tmem_cache_slot* slot = tmem_cache_lookup(wstate, tilenum);
+    uint32_t shift = tmem_cache_shift(kind);
+    int t1 = (t0 & 0xff) + tdiff;
+    int s1 = s0 + sdiff;
+    uint32_t tbase0 = wstate->tile[tilenum].line * (t0 & 0xff) + wstate->tile[tilenum].tmem;
+    uint32_t tbase2 = wstate->tile[tilenum].line * t1 + wstate->tile[tilenum].tmem;
+
+    *color0 = *tmem_cache_texel(wstate, slot, shift, tmem_cache_idx(kind, tbase0, s0, t0));
+    *color1 = *tmem_cache_texel(wstate, slot, shift, tmem_cache_idx(kind, tbase0, s1, t0));
+    *color2 = *tmem_cache_texel(wstate, slot, shift, tmem_cache_idx(kind, tbase2, s0, t1));
+    *color3 = *tmem_cache_texel(wstate, slot, shift, tmem_cache_idx(kind, tbase2, s1, t1));
+    return true;
+}
+
 static void sort_tmem_idx(uint32_t *idx, uint32_t idxa, uint32_t idxb, uint32_t idxc, uint32_t idxd, uint32_t bankno)
 {
     if ((idxa & 3) == bankno)
@@ -62,6 +310,9 @@ static void compute_color_index(struct rdp_state* wstate, uint32_t* cidx, uint32
 
 static INLINE void fetch_texel(struct rdp_state* wstate, struct color *color, int s, int t, uint32_t tilenum)
 {
+    if (wstate->tmem_cache && tmem_cache_fetch(wstate, color, s, t, tilenum))
+        return;
+
     uint32_t tbase = wstate->tile[tilenum].line * (t & 0xff) + wstate->tile[tilenum].tmem;
 
 
@@ -416,6 +667,8 @@ static INLINE void fetch_texel(struct rdp_state* wstate, struct color *color, in
 
 static INLINE void fetch_texel_quadro(struct rdp_state* wstate, struct color *color0, struct color *color1, struct color *color2, struct color *color3, int s0, int sdiff, int t0, int tdiff, uint32_t tilenum, int unequaluppers)
 {
+    if (wstate->tmem_cache && tmem_cache_fetch_quadro(wstate, color0, color1, color2, color3, s0, sdiff, t0, tdiff, tilenum))
+        return;
 
     uint32_t tbase0 = wstate->tile[tilenum].line * (t0 & 0xff) + wstate->tile[tilenum].tmem;
 
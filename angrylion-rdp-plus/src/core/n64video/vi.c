@@ -49,6 +49,48 @@ struct vi_reg_ctrl
 
 typedef void(*vi_fetch_filter_func)(struct n64video_pixel*, uint32_t, uint32_t, struct vi_reg_ctrl, uint32_t, uint32_t);
 
+// RDRAM as seen by the VI filters, either the live RDRAM or a snapshot of the
+// frame buffer area if the filters run asynchronously
+static uint32_t* vi_rdram32;
+static uint16_t* vi_rdram16;
+static uint8_t* vi_rdram_hidden;
+
+static STRICTINLINE uint16_t vi_read_idx16(uint32_t in)
+{
+    in &= RDRAM_MASK >> 1;
+    return rdram_valid_idx16(in) ? vi_rdram16[in ^ WORD_ADDR_XOR] : 0;
+}
+
+static STRICTINLINE uint16_t vi_read_idx16_fast(uint32_t in)
+{
+    return vi_rdram16[in ^ WORD_ADDR_XOR];
+}
+
+static STRICTINLINE uint32_t vi_read_idx32(uint32_t in)
+{
+    in &= RDRAM_MASK >> 2;
+    return rdram_valid_idx32(in) ? vi_rdram32[in] : 0;
+}
+
+static STRICTINLINE uint32_t vi_read_idx32_fast(uint32_t in)
+{
+    return vi_rdram32[in];
+}
+
+static STRICTINLINE void vi_read_pair16(uint16_t* rdst, uint8_t* hdst, uint32_t in)
+{
+    in &= RDRAM_MASK >> 1;
+    if (rdram_valid_idx16(in)) {
+        *rdst = vi_rdram16[in ^ WORD_ADDR_XOR];
+        *hdst = vi_rdram_hidden[in];
+        if (*hdst & HB_CLEAN) {
+            *hdst = (*rdst & 1) ? 3 : 0;
+        }
+    } else {
+        *rdst = *hdst = 0;
+    }
+}
+
 #include "vi/gamma.c"
 #include "vi/lerp.c"
 #include "vi/divot.c"
@@ -78,8 +120,9 @@ static uint32_t tvfadeoutstate[PRESCALE_HEIGHT];
 static uint32_t zb_address;
 static int32_t vinnglitch;
 
-// prescale buffer
-static struct n64video_pixel prescale[PRESCALE_WIDTH * PRESCALE_HEIGHT];
+// prescale buffer, double-buffered for asynchronous VI filtering
+static struct n64video_pixel prescale_buffers[2][PRESCALE_WIDTH * PRESCALE_HEIGHT];
+static struct n64video_pixel* prescale = prescale_buffers[0];
 static uint32_t prescale_ptr;
 static int32_t linecount;
 
@@ -92,12 +135,59 @@ static int32_t v_start;
 static int32_t h_start;
 static int32_t v_current_line;
 
+// asynchronous filtering: frame buffer snapshot, private line caches and the
+// frame that is currently being filtered in the background
+static uint8_t* vi_async_rdram;
+static uint8_t* vi_async_rdram_hidden;
+static struct n64video_pixel vi_async_viaa_array[0xa10 << 1];
+static struct n64video_pixel vi_async_divot_array[0xa10 << 1];
+static uint32_t vi_async_rseed;
+static struct n64video_frame_buffer vi_async_fb;
+static bool vi_async_pending;
+
+static bool vi_async_enabled(void)
+{
+    return config.vi.async && config.vi.mode == VI_MODE_NORMAL && vi_async_rdram != NULL;
+}
+
+static void vi_async_free(void)
+{
+    free(vi_async_rdram);
+    free(vi_async_rdram_hidden);
+    vi_async_rdram = NULL;
+    vi_async_rdram_hidden = NULL;
+}
+
 static void vi_init(void)
 {
     vi_gamma_init();
     vi_restore_init();
 
-    memset(prescale, 0, sizeof(prescale));
+    memset(prescale_buffers, 0, sizeof(prescale_buffers));
+    prescale = prescale_buffers[0];
+
+    vi_rdram32 = rdram32;
+    vi_rdram16 = rdram16;
+    vi_rdram_hidden = rdram_hidden;
+
+    // the background task may still use the snapshot
+    parallel_async_wait();
+    vi_async_free();
+    memset(&vi_async_fb, 0, sizeof(vi_async_fb));
+    vi_async_pending = false;
+
+    if (config.vi.async) {
+        vi_async_rdram = calloc(1, config.gfx.rdram_size);
+        vi_async_rdram_hidden = calloc(1, config.gfx.rdram_size / 2);
+
+        if (vi_async_rdram && vi_async_rdram_hidden) {
+            vi_async_rseed = 3;
+        } else {
+            msg_warning("Not enough memory for asynchronous VI, disabling it");
+            vi_async_free();
+            config.vi.async = false;
+        }
+    }
 
     prevvicurrent = 0;
     emucontrolsvicurrent = -1;
@@ -107,11 +197,10 @@ static void vi_init(void)
     zb_address = 0;
 }
 
-static void vi_process_full_parallel(uint32_t worker_id)
+static void vi_process_full_rows(struct n64video_pixel* viaa_array, struct n64video_pixel* divot_array,
+                                 uint32_t* rseed, int32_t y_begin, int32_t y_inc)
 {
     int32_t y;
-    struct n64video_pixel *viaa_array = state[worker_id].viaa_array;
-    struct n64video_pixel *divot_array = state[worker_id].divot_array;
 
     int32_t cache_marker = 0, cache_next_marker = 0, divot_cache_marker = 0, divot_cache_next_marker = 0;
     int32_t cache_marker_init = (x_start >> 10) - 1;
@@ -136,14 +225,7 @@ static void vi_process_full_parallel(uint32_t worker_id)
 
     pixels = 0;
 
-    int32_t y_begin = 0;
     int32_t y_end = vres;
-    int32_t y_inc = 1;
-
-    if (config.parallel) {
-        y_begin = worker_id;
-        y_inc = parallel_num_workers();
-    }
 
     for (y = y_begin; y < y_end; y += y_inc) {
         int32_t x;
@@ -292,7 +374,7 @@ static void vi_process_full_parallel(uint32_t worker_id)
 
             if (x >= minhpass && x < maxhpass) {
                 *pixel = color;
-                gamma_filters(pixel, ctrl.gamma_enable, ctrl.gamma_dither_enable, &state[worker_id].vi_rseed);
+                gamma_filters(pixel, ctrl.gamma_enable, ctrl.gamma_dither_enable, rseed);
             } else {
                 pixel->r = pixel->g = pixel->b = 0;
             }
@@ -318,6 +400,73 @@ static void vi_process_full_parallel(uint32_t worker_id)
     }
 }
 
+static void vi_process_full_parallel(uint32_t worker_id)
+{
+    struct rdp_state* wstate = &state[worker_id];
+    int32_t y_begin = 0;
+    int32_t y_inc = 1;
+
+    if (config.parallel) {
+        y_begin = worker_id;
+        y_inc = parallel_num_workers();
+    }
+
+    vi_process_full_rows(wstate->viaa_array, wstate->divot_array, &wstate->vi_rseed, y_begin, y_inc);
+}
+
+static void vi_process_full_async(void)
+{
+    // the worker pool is busy with RDP commands, so use a single thread
+    vi_process_full_rows(vi_async_viaa_array, vi_async_divot_array, &vi_async_rseed, 0, 1);
+}
+
+static void vi_select_rdram(bool snapshot)
+{
+    // the snapshot is only refreshed for asynchronous frames, synchronous
+    // ones must read the live RDRAM
+    if (snapshot) {
+        vi_rdram32 = (uint32_t*)vi_async_rdram;
+        vi_rdram16 = (uint16_t*)vi_async_rdram;
+        vi_rdram_hidden = vi_async_rdram_hidden;
+    } else {
+        vi_rdram32 = rdram32;
+        vi_rdram16 = rdram16;
+        vi_rdram_hidden = rdram_hidden;
+    }
+}
+
+static void vi_async_swap_buffers(void)
+{
+    // the last buffer may still be presented, so switch to the other one and
+    // bring it up to date, since borders and faded lines persist across frames
+    struct n64video_pixel* prev = prescale;
+    prescale = prescale == prescale_buffers[0] ? prescale_buffers[1] : prescale_buffers[0];
+    memcpy(prescale, prev, sizeof(prescale_buffers[0]));
+}
+
+static void vi_async_snapshot(void)
+{
+    // copy the part of the frame buffer the filters may read, including the
+    // neighbours of the first and last line and some slack for the restore
+    // and divot filters reaching past the line ends
+    int64_t bpp = (ctrl.type & 1) ? 4 : 2;
+    int64_t width = vi_width_low;
+    int64_t margin = (MAX(width, vres) + 8) * bpp;
+    int64_t line_begin = (int64_t)(y_start >> 10) - 1;
+    int64_t line_end = (int64_t)((y_start + (uint32_t)vres * y_add) >> 10) + 2;
+    int64_t x_end = (int64_t)((x_start + (uint32_t)hres * x_add) >> 10) + 3;
+    int64_t begin = frame_buffer + line_begin * width * bpp - margin;
+    int64_t end = frame_buffer + (line_end * width + x_end) * bpp + margin;
+
+    begin = CLAMP(begin, 0, (int64_t)config.gfx.rdram_size) & ~7;
+    end = (CLAMP(end, 0, (int64_t)config.gfx.rdram_size) + 7) & ~7;
+
+    if (end > begin) {
+        memcpy(vi_async_rdram + begin, rdram8 + begin, (size_t)(end - begin));
+        memcpy(vi_async_rdram_hidden + (begin >> 1), rdram_hidden + (begin >> 1), (size_t)((end - begin) >> 1));
+    }
+}
+
 static bool vi_process_full(struct n64video_frame_buffer* fb)
 {
     bool isblank = (ctrl.type & 2) == 0;
@@ -354,6 +503,10 @@ static bool vi_process_full(struct n64video_frame_buffer* fb)
 
     prevwasblank = isblank;
 
+    if (vi_async_enabled()) {
+        vi_async_swap_buffers();
+    }
+
     linecount = PRESCALE_WIDTH << ctrl.serrate;
     prescale_ptr = v_start * linecount + h_start + (lowerfield ? PRESCALE_WIDTH : 0);
 
@@ -361,7 +514,7 @@ static bool vi_process_full(struct n64video_frame_buffer* fb)
     if (isblank) {
         // blank signal, clear entire screen buffer
         memset(tvfadeoutstate, 0, PRESCALE_HEIGHT * sizeof(uint32_t));
-        memset(prescale, 0, sizeof(prescale));
+        memset(prescale, 0, sizeof(prescale_buffers[0]));
     } else {
         // clear left border
         int32_t j;
@@ -450,8 +603,13 @@ static bool vi_process_full(struct n64video_frame_buffer* fb)
         return false;
     }
 
-    // run filter update in parallel if enabled
-    if (config.parallel) {
+    // run filter update in the background or in parallel if enabled
+    vi_select_rdram(vi_async_enabled());
+
+    if (vi_async_enabled()) {
+        vi_async_snapshot();
+        parallel_async_run(vi_process_full_async);
+    } else if (config.parallel) {
         parallel_run(vi_process_full_parallel);
     } else {
         vi_process_full_parallel(0);
@@ -617,7 +775,7 @@ void vi_set_zbuffer_address(uint32_t address)
     zb_address = address;
 }
 
-void n64video_update_screen(struct n64video_frame_buffer* fb)
+static void vi_update_screen(struct n64video_frame_buffer* fb)
 {
     // check for configuration errors
     if (config.vi.mode >= VI_MODE_NUM) {
@@ -746,8 +904,36 @@ void n64video_update_screen(struct n64video_frame_buffer* fb)
     }
 }
 
+void n64video_update_screen(struct n64video_frame_buffer* fb)
+{
+    if (!vi_async_enabled()) {
+        if (vi_async_pending) {
+            // asynchronous VI has just been turned off, so finish and present
+            // the frame still being filtered in the background before the
+            // synchronous path touches the same state
+            parallel_async_wait();
+            vi_async_pending = false;
+            *fb = vi_async_fb;
+            return;
+        }
+
+        vi_update_screen(fb);
+        return;
+    }
+
+    // present the frame that has been filtered in the background while the
+    // RDP was busy and start filtering the current one, which adds one frame
+    // of latency but takes the VI off the critical path
+    parallel_async_wait();
+    *fb = vi_async_fb;
+    vi_update_screen(&vi_async_fb);
+    vi_async_pending = true;
+}
+
 static void vi_close(void)
 {
+    parallel_async_wait();
+    vi_async_free();
 }
 
 #endif // N64VIDEO_C
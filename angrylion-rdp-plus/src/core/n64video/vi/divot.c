@@ -1,5 +1,40 @@
 #ifdef N64VIDEO_C
 
+// the divot filter picks the median of the three pixels for each color
+// component, which maps to a min/max network on packed bytes
+#if defined(SIMD_SSE2) || defined(SIMD_NEON)
+static STRICTINLINE void divot_filter(struct n64video_pixel* final, struct n64video_pixel center, struct n64video_pixel left, struct n64video_pixel right)
+{
+    *final = center;
+
+    if ((center.a & left.a & right.a) == 7)
+    {
+        return;
+    }
+
+    uint32_t c, l, r, m;
+    memcpy(&c, &center, sizeof(c));
+    memcpy(&l, &left, sizeof(l));
+    memcpy(&r, &right, sizeof(r));
+
+#ifdef SIMD_SSE2
+    __m128i vc = _mm_cvtsi32_si128((int)c);
+    __m128i vl = _mm_cvtsi32_si128((int)l);
+    __m128i vr = _mm_cvtsi32_si128((int)r);
+    __m128i vm = _mm_max_epu8(_mm_min_epu8(vl, vc), _mm_min_epu8(_mm_max_epu8(vl, vc), vr));
+    m = (uint32_t)_mm_cvtsi128_si32(vm);
+#else
+    uint8x8_t vc = vreinterpret_u8_u32(vdup_n_u32(c));
+    uint8x8_t vl = vreinterpret_u8_u32(vdup_n_u32(l));
+    uint8x8_t vr = vreinterpret_u8_u32(vdup_n_u32(r));
+    uint8x8_t vm = vmax_u8(vmin_u8(vl, vc), vmin_u8(vmax_u8(vl, vc), vr));
+    m = vget_lane_u32(vreinterpret_u32_u8(vm), 0);
+#endif
+
+    memcpy(final, &m, sizeof(m));
+    final->a = center.a;
+}
+#else
 static STRICTINLINE void divot_filter(struct n64video_pixel* final, struct n64video_pixel center, struct n64video_pixel left, struct n64video_pixel right)
 {
     *final = center;
@@ -24,6 +59,6 @@ static STRICTINLINE void divot_filter(struct n64video_pixel* final, struct n64vi
     else if ((right.b >= center.b && left.b >= right.b) || (right.b >= left.b && center.b >= right.b))
         final->b = right.b;
 }
+#endif
 
 #endif // N64VIDEO_C
-
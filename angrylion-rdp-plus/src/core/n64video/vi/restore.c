@@ -44,7 +44,7 @@ static STRICTINLINE void restore_filter16(int* r, int* g, int* b, uint32_t fboff
     {
         for (i = 0; i < 8; i++)
         {
-            pix = rdram_read_idx16_fast(dirs[i]);
+            pix = vi_read_idx16_fast(dirs[i]);
             tempr = (pix >> 11) & 0x1f;
             tempg = (pix >> 6) & 0x1f;
             tempb = (pix >> 1) & 0x1f;
@@ -57,7 +57,7 @@ static STRICTINLINE void restore_filter16(int* r, int* g, int* b, uint32_t fboff
     {
         for (i = 0; i < 8; i++)
         {
-            pix = rdram_read_idx16(dirs[i]);
+            pix = vi_read_idx16(dirs[i]);
             tempr = (pix >> 11) & 0x1f;
             tempg = (pix >> 6) & 0x1f;
             tempb = (pix >> 1) & 0x1f;
@@ -115,7 +115,7 @@ static STRICTINLINE void restore_filter32(int* r, int* g, int* b, uint32_t fboff
     {
         for (i = 0; i < 8; i++)
         {
-            pix = rdram_read_idx32_fast(dirs[i]);
+            pix = vi_read_idx32_fast(dirs[i]);
             tempr = (pix >> 27) & 0x1f;
             tempg = (pix >> 19) & 0x1f;
             tempb = (pix >> 11) & 0x1f;
@@ -128,7 +128,7 @@ static STRICTINLINE void restore_filter32(int* r, int* g, int* b, uint32_t fboff
     {
         for (i = 0; i < 8; i++)
         {
-            pix = rdram_read_idx32(dirs[i]);
+            pix = vi_read_idx32(dirs[i]);
             tempr = (pix >> 27) & 0x1f;
             tempg = (pix >> 19) & 0x1f;
             tempb = (pix >> 11) & 0x1f;
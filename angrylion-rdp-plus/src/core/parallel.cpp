@@ -200,8 +200,87 @@ public:
     }
 };
 
+// runs a single task on a background thread while the main thread continues
+class ParallelAsync
+{
+public:
+    ParallelAsync() : m_thread(&ParallelAsync::do_work, this)
+    {
+    }
+
+    ~ParallelAsync()
+    {
+        // finish the current task, then exit the worker loop
+        wait();
+
+        {
+            std::unique_lock<std::mutex> ul(m_signal_mutex);
+            m_exit = true;
+        }
+
+        m_signal_work.notify_one();
+        m_thread.join();
+    }
+
+    void run(void task(void))
+    {
+        // only one task at a time
+        wait();
+
+        std::unique_lock<std::mutex> ul(m_signal_mutex);
+        m_task = task;
+        m_signal_work.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> ul(m_signal_mutex);
+        m_signal_done.wait(ul, [this] {
+            return m_task == nullptr;
+        });
+    }
+
+private:
+    std::mutex m_signal_mutex;
+    std::condition_variable m_signal_work;
+    std::condition_variable m_signal_done;
+    void (*m_task)(void) = nullptr;
+    bool m_exit = false;
+
+    // must be initialized last, it starts running immediately
+    std::thread m_thread;
+
+    void do_work()
+    {
+        std::unique_lock<std::mutex> ul(m_signal_mutex);
+
+        while (true) {
+            m_signal_work.wait(ul, [this] {
+                return m_task != nullptr || m_exit;
+            });
+
+            if (m_task == nullptr) {
+                break;
+            }
+
+            // run task outside of the lock
+            void (*task)(void) = m_task;
+            ul.unlock();
+            task();
+            ul.lock();
+
+            m_task = nullptr;
+            m_signal_done.notify_all();
+        }
+    }
+
+    void operator=(const ParallelAsync&) = delete;
+    ParallelAsync(const ParallelAsync&) = delete;
+};
+
 // C interface for the Parallel class
 static std::shared_ptr<Parallel> parallel;
+static std::unique_ptr<ParallelAsync> parallel_async;
 
 void parallel_init(uint32_t num, bool busy)
 {
@@ -227,4 +306,22 @@ uint32_t parallel_num_workers()
 void parallel_close()
 {
     parallel.reset();
+    parallel_async.reset();
+}
+
+void parallel_async_run(void task(void))
+{
+    // background thread is created on first use
+    if (!parallel_async) {
+        parallel_async = std::make_unique<ParallelAsync>();
+    }
+
+    parallel_async->run(task);
+}
+
+void parallel_async_wait()
+{
+    if (parallel_async) {
+        parallel_async->wait();
+    }
 }
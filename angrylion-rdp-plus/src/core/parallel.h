@@ -14,6 +14,9 @@ void parallel_run(void task(uint32_t));
 uint32_t parallel_num_workers(void);
 void parallel_close(void);
 
+void parallel_async_run(void task(void));
+void parallel_async_wait(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,8 +35,10 @@
 #define KEY_VI_WIDESCREEN "ViWidescreen"
 #define KEY_VI_HIDE_OVERSCAN "ViHideOverscan"
 #define KEY_VI_INTEGER_SCALING "ViIntegerScaling"
+#define KEY_VI_ASYNC "ViAsync"
 
 #define KEY_DP_COMPAT "DpCompat"
+#define KEY_DP_TMEM_CACHE "DpTmemCache"
 
 #include <stdlib.h>
 #include <string.h>
@@ -121,7 +123,9 @@ EXPORT m64p_error CALL PluginStartup(m64p_dynlib_handle _CoreLibHandle, void *Co
     ConfigSetDefaultBool(configVideoAngrylionPlus, KEY_VI_WIDESCREEN, config.vi.widescreen, "Use anamorphic 16:9 output mode if True");
     ConfigSetDefaultBool(configVideoAngrylionPlus, KEY_VI_HIDE_OVERSCAN, config.vi.hide_overscan, "Hide overscan area in filteded mode if True");
     ConfigSetDefaultBool(configVideoAngrylionPlus, KEY_VI_INTEGER_SCALING, config.vi.integer_scaling, "Display upscaled pixels as groups of 1x1, 2x2, 3x3, etc. if True");
+    ConfigSetDefaultBool(configVideoAngrylionPlus, KEY_VI_ASYNC, config.vi.async, "Run VI filters in the background while the next frame is rendered if True (adds one frame of latency)");
     ConfigSetDefaultInt(configVideoAngrylionPlus, KEY_DP_COMPAT, config.dp.compat, "Compatibility mode (0=Fast 1=Moderate 2=Slow");
+    ConfigSetDefaultBool(configVideoAngrylionPlus, KEY_DP_TMEM_CACHE, config.dp.tmem_cache, "Sample textures from a pre-decoded copy of the texture memory if True");
 
     ConfigSaveSection("Video-General");
     ConfigSaveSection("Video-AngrylionPlus");
@@ -210,8 +214,10 @@ EXPORT int CALL RomOpen (void)
     config.vi.widescreen = ConfigGetParamBool(configVideoAngrylionPlus, KEY_VI_WIDESCREEN);
     config.vi.hide_overscan = ConfigGetParamBool(configVideoAngrylionPlus, KEY_VI_HIDE_OVERSCAN);
     config.vi.integer_scaling = ConfigGetParamBool(configVideoAngrylionPlus, KEY_VI_INTEGER_SCALING);
+    config.vi.async = ConfigGetParamBool(configVideoAngrylionPlus, KEY_VI_ASYNC);
 
     config.dp.compat = ConfigGetParamInt(configVideoAngrylionPlus, KEY_DP_COMPAT);
+    config.dp.tmem_cache = ConfigGetParamBool(configVideoAngrylionPlus, KEY_DP_TMEM_CACHE);
 
     config.gfx.rdram = gfx.RDRAM;
 
@@ -28,9 +28,11 @@
 #define KEY_VI_EXCLUSIVE "exclusive"
 #define KEY_VI_VSYNC "vsync"
 #define KEY_VI_INT_SCALING "integer_scaling"
+#define KEY_VI_ASYNC "async"
 #define KEY_BUSYLOOP "busyloop"
 
 #define KEY_DP_COMPAT "compat"
+#define KEY_DP_TMEM_CACHE "tmem_cache"
 
 #define CONFIG_FILE_NAME CORE_SIMPLE_NAME "-config.ini"
 
@@ -213,12 +215,16 @@ static void config_handle(const char* key, const char* value, const char* sectio
             config.vi.vsync = strtol(value, NULL, 0) != 0;
         } else if (!_strcmpi(key, KEY_VI_INT_SCALING)) {
             config.vi.integer_scaling = strtol(value, NULL, 0) != 0;
+        } else if (!_strcmpi(key, KEY_VI_ASYNC)) {
+            config.vi.async = strtol(value, NULL, 0) != 0;
         } else if (!_strcmpi(key, KEY_BUSYLOOP)) {
             config.busyloop = strtol(value, NULL, 0) != 0;
         }
     } else if (!_strcmpi(section, SECTION_DISPLAY_PROCESSOR)) {
         if (!_strcmpi(key, KEY_DP_COMPAT)) {
             config.dp.compat = strtol(value, NULL, 0);
+        } else if (!_strcmpi(key, KEY_DP_TMEM_CACHE)) {
+            config.dp.tmem_cache = strtol(value, NULL, 0) != 0;
         }
     }
 }
@@ -325,11 +331,13 @@ bool config_save(void)
     config_write_int32(fp, KEY_VI_EXCLUSIVE, config.vi.exclusive);
     config_write_int32(fp, KEY_VI_VSYNC, config.vi.vsync);
     config_write_int32(fp, KEY_VI_INT_SCALING, config.vi.integer_scaling);
+    config_write_int32(fp, KEY_VI_ASYNC, config.vi.async);
     config_write_int32(fp, KEY_BUSYLOOP, config.busyloop);
     fputs("\n", fp);
 
     config_write_section(fp, SECTION_DISPLAY_PROCESSOR);
     config_write_int32(fp, KEY_DP_COMPAT, config.dp.compat);
+    config_write_int32(fp, KEY_DP_TMEM_CACHE, config.dp.tmem_cache);
 
     fclose(fp);
 
@@ -0,0 +1,243 @@
+// Checks and times the VI filters (restore, divot, lerp, AA) through the
+// public n64video interface.
+//
+// Every test frame buffer is run through the full VI and a checksum of the
+// output is printed, so two builds can be compared line by line. The SIMD
+// filters must produce exactly the same output as the scalar ones:
+//
+//   cc -O2 -std=c11 -I../src/core -c ../src/core/n64video.c -o n64video.o
+//   cc -O2 -std=c11 -I../src/core -DNO_SIMD -c ../src/core/n64video.c -o n64video_scalar.o
+//   c++ -O2 -std=c++14 -c ../src/core/parallel.cpp -o parallel.o
+//   cc -O2 -std=c11 -I../src/core vi_filter_check.c n64video.o parallel.o -lstdc++ -lpthread -o vi_filter_check
+//   cc -O2 -std=c11 -I../src/core vi_filter_check.c n64video_scalar.o parallel.o -lstdc++ -lpthread -o vi_filter_check_scalar
+//   ./vi_filter_check_scalar > scalar.txt && ./vi_filter_check > simd.txt && diff scalar.txt simd.txt
+//
+// With -b, each test is also timed on a single thread and the average time
+// per VI frame is printed next to the checksum.
+
+#include "n64video.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FB_ADDRESS 0x100000
+#define FB_WIDTH 320
+#define FB_HEIGHT 240
+
+// VI_STATUS bits
+#define CTRL_TYPE_16 2
+#define CTRL_TYPE_32 3
+#define CTRL_DIVOT (1 << 4)
+#define CTRL_AA(mode) ((mode) << 8)
+#define CTRL_DITHER_FILTER (1 << 16)
+
+enum pattern
+{
+    PATTERN_NOISE,  // every bit random, including coverage
+    PATTERN_SMOOTH  // gradients with some noise, mostly full coverage
+};
+
+struct test
+{
+    const char* name;
+    uint32_t status;
+    uint32_t x_scale;
+    uint32_t y_scale;
+    enum pattern pattern;
+};
+
+static const struct test tests[] = {
+    {"16 noise aa divot filter",        CTRL_TYPE_16 | CTRL_AA(0) | CTRL_DIVOT | CTRL_DITHER_FILTER, 0x200, 0x400, PATTERN_NOISE},
+    {"16 noise aa divot filter scaled", CTRL_TYPE_16 | CTRL_AA(1) | CTRL_DIVOT | CTRL_DITHER_FILTER, 0x1cc, 0x3a0, PATTERN_NOISE},
+    {"16 noise resample filter",        CTRL_TYPE_16 | CTRL_AA(2) | CTRL_DITHER_FILTER,              0x200, 0x400, PATTERN_NOISE},
+    {"16 noise replicate",              CTRL_TYPE_16 | CTRL_AA(3),                                   0x200, 0x400, PATTERN_NOISE},
+    {"32 noise aa divot filter",        CTRL_TYPE_32 | CTRL_AA(0) | CTRL_DIVOT | CTRL_DITHER_FILTER, 0x200, 0x400, PATTERN_NOISE},
+    {"32 noise resample divot scaled",  CTRL_TYPE_32 | CTRL_AA(2) | CTRL_DIVOT | CTRL_DITHER_FILTER, 0x1cc, 0x3a0, PATTERN_NOISE},
+    {"16 smooth aa divot filter",       CTRL_TYPE_16 | CTRL_AA(0) | CTRL_DIVOT | CTRL_DITHER_FILTER, 0x200, 0x400, PATTERN_SMOOTH},
+    {"16 smooth resample filter",       CTRL_TYPE_16 | CTRL_AA(2) | CTRL_DITHER_FILTER,              0x200, 0x400, PATTERN_SMOOTH},
+    {"32 smooth aa divot filter",       CTRL_TYPE_32 | CTRL_AA(0) | CTRL_DIVOT | CTRL_DITHER_FILTER, 0x200, 0x400, PATTERN_SMOOTH},
+};
+
+static uint8_t rdram[RDRAM_MAX_SIZE];
+static uint32_t vi_regs[VI_NUM_REG];
+static uint32_t* vi_reg_ptrs[VI_NUM_REG];
+static uint32_t dp_regs[DP_NUM_REG];
+static uint32_t* dp_reg_ptrs[DP_NUM_REG];
+static uint32_t mi_intr;
+
+void msg_error(const char* err, ...)
+{
+    va_list arg;
+    va_start(arg, err);
+    vfprintf(stderr, err, arg);
+    va_end(arg);
+    fputc('\n', stderr);
+    exit(EXIT_FAILURE);
+}
+
+void msg_warning(const char* err, ...)
+{
+    va_list arg;
+    va_start(arg, err);
+    vfprintf(stderr, err, arg);
+    va_end(arg);
+    fputc('\n', stderr);
+}
+
+void msg_debug(const char* err, ...)
+{
+    (void)err;
+}
+
+static void mi_intr_cb(void)
+{
+}
+
+static uint32_t xorshift32(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static uint32_t smooth_channel(uint32_t x, uint32_t y, uint32_t shift, uint32_t max, uint32_t* seed)
+{
+    int32_t v = (int32_t)(((x << shift) + y * 3) % (max * 2));
+    if (v > (int32_t)max) {
+        v = (int32_t)max * 2 - v;
+    }
+    v += (int32_t)(xorshift32(seed) % 3) - 1;
+    return v < 0 ? 0 : v > (int32_t)max ? max : (uint32_t)v;
+}
+
+static void fill_frame_buffer(const struct test* t, uint32_t seed)
+{
+    uint32_t* words = (uint32_t*)(rdram + FB_ADDRESS);
+    bool is32 = (t->status & 3) == CTRL_TYPE_32;
+    // one extra line, the filters read past the last one
+    uint32_t num_pixels = FB_WIDTH * (FB_HEIGHT + 1);
+    uint32_t i;
+
+    if (t->pattern == PATTERN_NOISE) {
+        for (i = 0; i < (is32 ? num_pixels : num_pixels / 2); i++) {
+            words[i] = xorshift32(&seed);
+        }
+        return;
+    }
+
+    for (i = 0; i < num_pixels; i++) {
+        uint32_t x = i % FB_WIDTH;
+        uint32_t y = i / FB_WIDTH;
+        // one in 16 pixels is an edge with partial coverage
+        bool edge = (xorshift32(&seed) & 15) == 0;
+
+        if (is32) {
+            uint32_t r = smooth_channel(x, y, 1, 255, &seed);
+            uint32_t g = smooth_channel(y, x, 1, 255, &seed);
+            uint32_t b = smooth_channel(x + y, x, 0, 255, &seed);
+            uint32_t a = edge ? (xorshift32(&seed) & 0xe0) : 0xe0;
+            words[i] = (r << 24) | (g << 16) | (b << 8) | a;
+        } else {
+            uint32_t r = smooth_channel(x, y, 0, 31, &seed);
+            uint32_t g = smooth_channel(y, x, 0, 31, &seed);
+            uint32_t b = smooth_channel(x + y, x, 0, 31, &seed);
+            uint32_t pix = (r << 11) | (g << 6) | (b << 1) | (edge ? 0 : 1);
+            if (i & 1) {
+                words[i >> 1] |= pix;
+            } else {
+                words[i >> 1] = pix << 16;
+            }
+        }
+    }
+}
+
+static uint32_t frame_checksum(const struct n64video_frame_buffer* fb)
+{
+    // FNV-1a over the visible pixels
+    uint32_t hash = 2166136261u;
+    for (uint32_t y = 0; y < fb->height; y++) {
+        const uint8_t* line = (const uint8_t*)(fb->pixels + y * fb->pitch);
+        for (uint32_t x = 0; x < fb->width * sizeof(struct n64video_pixel); x++) {
+            hash = (hash ^ line[x]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+    bool bench = argc > 1 && !strcmp(argv[1], "-b");
+    struct n64video_config config;
+    uint32_t i;
+
+    for (i = 0; i < VI_NUM_REG; i++) {
+        vi_reg_ptrs[i] = &vi_regs[i];
+    }
+
+    for (i = 0; i < DP_NUM_REG; i++) {
+        dp_reg_ptrs[i] = &dp_regs[i];
+    }
+
+    n64video_config_init(&config);
+    config.gfx.rdram = rdram;
+    config.gfx.rdram_size = sizeof(rdram);
+    config.gfx.vi_reg = vi_reg_ptrs;
+    config.gfx.dp_reg = dp_reg_ptrs;
+    config.gfx.mi_intr_reg = &mi_intr;
+    config.gfx.mi_intr_cb = mi_intr_cb;
+    config.vi.mode = VI_MODE_NORMAL;
+    config.parallel = false;
+    n64video_init(&config);
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        const struct test* t = &tests[i];
+        struct n64video_frame_buffer fb;
+        uint32_t checksum = 0;
+
+        // 320x240 NTSC timing, as set up by libultra
+        vi_regs[VI_STATUS] = t->status;
+        vi_regs[VI_ORIGIN] = FB_ADDRESS;
+        vi_regs[VI_WIDTH] = FB_WIDTH;
+        vi_regs[VI_V_SYNC] = 525;
+        vi_regs[VI_H_START] = (108 << 16) | 748;
+        vi_regs[VI_V_START] = (37 << 16) | 511;
+        vi_regs[VI_X_SCALE] = t->x_scale;
+        vi_regs[VI_Y_SCALE] = t->y_scale;
+
+        // several frames with different contents per test
+        for (uint32_t frame = 0; frame < 4; frame++) {
+            fill_frame_buffer(t, 0x9e3779b9u * (i * 4 + frame + 1));
+            n64video_update_screen(&fb);
+            checksum = checksum * 31 + (fb.valid ? frame_checksum(&fb) : 0);
+        }
+
+        printf("%-32s %08x", t->name, (unsigned)checksum);
+
+        if (bench) {
+            uint32_t frames = 200;
+            double start = now_seconds();
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                n64video_update_screen(&fb);
+            }
+            printf(" %8.3f ms/frame", (now_seconds() - start) * 1000.0 / frames);
+        }
+
+        printf("\n");
+    }
+
+    n64video_close();
+
+    return EXIT_SUCCESS;
+}
@@ -23,7 +23,9 @@
  * outside of the core library.
  */
 
+#include <ctype.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,6 +44,10 @@
 #define MUPEN64PLUS_CFG_NAME "mupen64plus.cfg"
 
 #define SECTION_MAGIC 0xDBDC0580
+#define PARAM_MAGIC   0xDBDC0581
+
+/* minimum number of buckets of a section's variable index */
+enum { MIN_VAR_BUCKETS = 16 };
 
 struct external_config {
   char *file;
@@ -57,18 +63,49 @@ typedef struct _config_var {
     char *string;
   } val;
   char                 *comment;
+  uint32_t              hash;
   struct _config_var   *next;
+  struct _config_var   *next_in_bucket;
   } config_var;
 
 typedef struct _config_section {
   unsigned int            magic;
   char                   *name;
+  uint32_t                hash;
   struct _config_var     *first_var;
+  struct _config_var     *last_var;
+  /* variables indexed by the hash of their case-folded name */
+  struct _config_var    **var_buckets;
+  unsigned int            var_bucket_count;
+  unsigned int            var_count;
   struct _config_section *next;
   } config_section;
 
 typedef config_section *config_list;
 
+typedef struct {
+  void (*callback)(void *context, m64p_param_handle ParamHandle);
+  void *context;
+  } config_param_callback;
+
+/* Parameter handles are never freed before ConfigShutdown, so they remain
+ * valid when their section is deleted or reverted. The variable they point
+ * to is looked up again whenever the layout of the config lists changed. */
+typedef struct _config_param {
+  unsigned int            magic;
+  char                   *section_name;
+  char                   *name;
+  uint32_t                section_hash;
+  uint32_t                hash;
+  config_var             *var;
+  unsigned int            generation;
+  config_param_callback  *callbacks;
+  unsigned int            callback_count;
+  unsigned int            notifying;      /* nesting depth of notify_params on this parameter */
+  unsigned int            dead_callbacks; /* callbacks removed while notifying, not compacted yet */
+  struct _config_param   *next;
+  } config_param;
+
 /* local variables */
 static int         l_ConfigInit = 0;
 static char       *l_DataDirOverride = NULL;
@@ -77,6 +114,9 @@ static char       *l_UserCacheDirOverride = NULL;
 static char       *l_UserDataDirOverride = NULL;
 static config_list l_ConfigListActive = NULL;
 static config_list l_ConfigListSaved = NULL;
+static config_param *l_ConfigParams = NULL;
+/* incremented whenever variables are created or deleted */
+static unsigned int l_ConfigGeneration = 1;
 
 /* --------------- */
 /* local functions */
@@ -93,6 +133,21 @@ static int is_numeric(const char *string)
     return (rval == 1);
 }
 
+/* FNV-1a hash of the lowercase name, so that names differing only by case,
+ * which osal_insensitive_strcmp considers equal, have the same hash */
+static uint32_t config_hash(const char *name)
+{
+    uint32_t hash = UINT32_C(2166136261);
+
+    while (*name != '\0')
+    {
+        hash ^= (uint32_t) tolower((unsigned char) *name++);
+        hash *= UINT32_C(16777619);
+    }
+
+    return hash;
+}
+
 /* This function returns a pointer to the pointer of the requested section
  * (i.e. a pointer the next field of the previous element, or to the first node).
  *
@@ -104,9 +159,10 @@ static int is_numeric(const char *string)
 static config_section **find_section_link(config_list *list, const char *ParamName)
 {
     config_section **curr_sec_link;
+    uint32_t hash = config_hash(ParamName);
     for (curr_sec_link = list; *curr_sec_link != NULL; curr_sec_link = &(*curr_sec_link)->next)
     {
-        if (osal_insensitive_strcmp(ParamName, (*curr_sec_link)->name) == 0)
+        if ((*curr_sec_link)->hash == hash && osal_insensitive_strcmp(ParamName, (*curr_sec_link)->name) == 0)
             break;
     }
 
@@ -155,6 +211,7 @@ static config_var *config_var_create(const char *ParamName, const char *ParamHel
         free(var);
         return NULL;
     }
+    var->hash = config_hash(ParamName);
 
     var->type = M64TYPE_INT;
     var->val.integer = 0;
@@ -178,11 +235,24 @@ static config_var *config_var_create(const char *ParamName, const char *ParamHel
 
 static config_var *find_section_var(config_section *section, const char *ParamName)
 {
-    /* walk through the linked list of variables in the section */
+    /* walk through the variables of the section with the same hash */
     config_var *curr_var;
-    for (curr_var = section->first_var; curr_var != NULL; curr_var = curr_var->next)
+    uint32_t hash = config_hash(ParamName);
+
+    /* no index if it couldn't be allocated */
+    if (section->var_buckets == NULL)
     {
-        if (osal_insensitive_strcmp(ParamName, curr_var->name) == 0)
+        for (curr_var = section->first_var; curr_var != NULL; curr_var = curr_var->next)
+        {
+            if (curr_var->hash == hash && osal_insensitive_strcmp(ParamName, curr_var->name) == 0)
+                return curr_var;
+        }
+        return NULL;
+    }
+
+    for (curr_var = section->var_buckets[hash & (section->var_bucket_count - 1)]; curr_var != NULL; curr_var = curr_var->next_in_bucket)
+    {
+        if (curr_var->hash == hash && osal_insensitive_strcmp(ParamName, curr_var->name) == 0)
             return curr_var;
     }
 
@@ -190,24 +260,62 @@ static config_var *find_section_var(config_section *section, const char *ParamNa
     return NULL;
 }
 
+static int index_section_vars(config_section *section, unsigned int bucket_count)
+{
+    config_var **buckets;
+    config_var *curr_var;
+
+    buckets = (config_var **) calloc(bucket_count, sizeof(config_var *));
+    if (buckets == NULL)
+        return 0;
+
+    free(section->var_buckets);
+    section->var_buckets = buckets;
+    section->var_bucket_count = bucket_count;
+
+    /* buckets keep the order of the list, so that the first variable of a given name wins */
+    for (curr_var = section->first_var; curr_var != NULL; curr_var = curr_var->next)
+    {
+        config_var **bucket = &buckets[curr_var->hash & (bucket_count - 1)];
+        curr_var->next_in_bucket = NULL;
+        while (*bucket != NULL)
+            bucket = &(*bucket)->next_in_bucket;
+        *bucket = curr_var;
+    }
+
+    return 1;
+}
+
 static void append_var_to_section(config_section *section, config_var *var)
 {
-    config_var *last_var;
+    config_var **bucket;
 
     if (section == NULL || var == NULL || section->magic != SECTION_MAGIC)
         return;
 
     if (section->first_var == NULL)
-    {
         section->first_var = var;
-        return;
-    }
-
-    last_var = section->first_var;
-    while (last_var->next != NULL)
-        last_var = last_var->next;
-
-    last_var->next = var;
+    else
+        section->last_var->next = var;
+    section->last_var = var;
+    section->var_count++;
+    l_ConfigGeneration++;
+
+    /* keep at most one variable per bucket on average */
+    if (section->var_count > section->var_bucket_count)
+    {
+        unsigned int bucket_count = (section->var_bucket_count > 0) ? 2 * section->var_bucket_count : MIN_VAR_BUCKETS;
+        if (index_section_vars(section, bucket_count))
+            return;
+        if (section->var_buckets == NULL)
+            return;
+    }
+
+    var->next_in_bucket = NULL;
+    bucket = &section->var_buckets[var->hash & (section->var_bucket_count - 1)];
+    while (*bucket != NULL)
+        bucket = &(*bucket)->next_in_bucket;
+    *bucket = var;
 }
 
 static void delete_var(config_var *var)
@@ -234,8 +342,10 @@ static void delete_section(config_section *pSection)
         curr_var = next_var;
     }
 
+    free(pSection->var_buckets);
     free(pSection->name);
     free(pSection);
+    l_ConfigGeneration++;
 }
 
 static void delete_list(config_list *pConfigList)
@@ -271,7 +381,12 @@ static config_section *config_section_create(const char *ParamName)
         free(sec);
         return NULL;
     }
+    sec->hash = config_hash(ParamName);
     sec->first_var = NULL;
+    sec->last_var = NULL;
+    sec->var_buckets = NULL;
+    sec->var_bucket_count = 0;
+    sec->var_count = 0;
     sec->next = NULL;
     return sec;
 }
@@ -279,7 +394,7 @@ static config_section *config_section_create(const char *ParamName)
 static config_section * section_deepcopy(config_section *orig_section)
 {
     config_section *new_section;
-    config_var *orig_var, *last_new_var;
+    config_var *orig_var;
 
     /* Input validation */
     if (orig_section == NULL)
@@ -292,7 +407,6 @@ static config_section * section_deepcopy(config_section *orig_section)
 
     /* create and copy all section variables */
     orig_var = orig_section->first_var;
-    last_new_var = NULL;
     while (orig_var != NULL)
     {
         config_var *new_var = config_var_create(orig_var->name, orig_var->comment);
@@ -332,11 +446,7 @@ static config_section * section_deepcopy(config_section *orig_section)
         }
 
         /* add the new variable to the new section */
-        if (last_new_var == NULL)
-            new_section->first_var = new_var;
-        else
-            last_new_var->next = new_var;
-        last_new_var = new_var;
+        append_var_to_section(new_section, new_var);
         /* advance variable pointer in original section variable list */
         orig_var = orig_var->next;
     }
@@ -366,6 +476,198 @@ static void copy_configlist_active_to_saved(void)
     }
 }
 
+static config_var *find_param_var(config_param *param)
+{
+    config_section *section;
+
+    if (param->generation != l_ConfigGeneration)
+    {
+        section = find_section(l_ConfigListActive, param->section_name);
+        param->var = (section != NULL) ? find_section_var(section, param->name) : NULL;
+        param->generation = l_ConfigGeneration;
+    }
+
+    return param->var;
+}
+
+static config_param *find_param(const char *SectionName, const char *ParamName)
+{
+    config_param *param;
+    uint32_t section_hash = config_hash(SectionName);
+    uint32_t hash = config_hash(ParamName);
+
+    for (param = l_ConfigParams; param != NULL; param = param->next)
+    {
+        if (param->section_hash == section_hash && param->hash == hash &&
+            osal_insensitive_strcmp(SectionName, param->section_name) == 0 &&
+            osal_insensitive_strcmp(ParamName, param->name) == 0)
+            return param;
+    }
+
+    return NULL;
+}
+
+static void delete_params(void)
+{
+    while (l_ConfigParams != NULL)
+    {
+        config_param *next_param = l_ConfigParams->next;
+        free(l_ConfigParams->section_name);
+        free(l_ConfigParams->name);
+        free(l_ConfigParams->callbacks);
+        free(l_ConfigParams);
+        l_ConfigParams = next_param;
+    }
+}
+
+static void compact_param_callbacks(config_param *param)
+{
+    unsigned int i, j = 0;
+
+    for (i = 0; i < param->callback_count; ++i)
+    {
+        if (param->callbacks[i].callback != NULL)
+            param->callbacks[j++] = param->callbacks[i];
+    }
+
+    param->callback_count = j;
+    param->dead_callbacks = 0;
+}
+
+/* Call the callbacks registered on parameter ParamName of section SectionName,
+ * or on all the parameters of the section if ParamName is NULL */
+static void notify_params(const char *SectionName, const char *ParamName)
+{
+    config_param *param;
+    uint32_t section_hash = config_hash(SectionName);
+    uint32_t hash = (ParamName != NULL) ? config_hash(ParamName) : 0;
+    unsigned int i, count;
+
+    for (param = l_ConfigParams; param != NULL; param = param->next)
+    {
+        if (param->callback_count == 0 || param->section_hash != section_hash ||
+            osal_insensitive_strcmp(SectionName, param->section_name) != 0)
+            continue;
+        if (ParamName != NULL && (param->hash != hash || osal_insensitive_strcmp(ParamName, param->name) != 0))
+            continue;
+
+        /* callbacks may register or remove callbacks: removed ones are only
+         * marked dead until the outermost notification is over, and the ones
+         * registered meanwhile get called from the next change on */
+        count = param->callback_count;
+        param->notifying++;
+        for (i = 0; i < count; ++i)
+        {
+            if (param->callbacks[i].callback != NULL)
+                param->callbacks[i].callback(param->callbacks[i].context, (m64p_param_handle) param);
+        }
+        if (--param->notifying == 0 && param->dead_callbacks != 0)
+            compact_param_callbacks(param);
+    }
+}
+
+static int var_value_equals(const config_var *var, m64p_type ParamType, const void *ParamValue)
+{
+    if (var->type != ParamType)
+        return 0;
+
+    switch (ParamType)
+    {
+        case M64TYPE_INT:
+            return var->val.integer == *((int *) ParamValue);
+        case M64TYPE_FLOAT:
+            return var->val.number == *((float *) ParamValue);
+        case M64TYPE_BOOL:
+            return var->val.integer == (*((int *) ParamValue) != 0);
+        case M64TYPE_STRING:
+            return var->val.string != NULL && strcmp(var->val.string, (char *) ParamValue) == 0;
+        default:
+            return 0;
+    }
+}
+
+static int var_get_int(const config_var *var, const char *caller)
+{
+    /* translate the actual variable type to an int */
+    switch(var->type)
+    {
+        case M64TYPE_INT:
+            return var->val.integer;
+        case M64TYPE_FLOAT:
+            return (int) var->val.number;
+        case M64TYPE_BOOL:
+            return (var->val.integer != 0);
+        case M64TYPE_STRING:
+            return atoi(var->val.string);
+        default:
+            DebugMessage(M64MSG_ERROR, "%s(): invalid internal parameter type for '%s'", caller, var->name);
+            return 0;
+    }
+}
+
+static float var_get_float(const config_var *var, const char *caller)
+{
+    /* translate the actual variable type to a float */
+    switch(var->type)
+    {
+        case M64TYPE_INT:
+            return (float) var->val.integer;
+        case M64TYPE_FLOAT:
+            return var->val.number;
+        case M64TYPE_BOOL:
+            return (var->val.integer != 0) ? 1.0f : 0.0f;
+        case M64TYPE_STRING:
+            return (float) atof(var->val.string);
+        default:
+            DebugMessage(M64MSG_ERROR, "%s(): invalid internal parameter type for '%s'", caller, var->name);
+            return 0.0;
+    }
+}
+
+static int var_get_bool(const config_var *var, const char *caller)
+{
+    /* translate the actual variable type to an int (0 or 1) */
+    switch(var->type)
+    {
+        case M64TYPE_INT:
+            return (var->val.integer != 0);
+        case M64TYPE_FLOAT:
+            return (var->val.number != 0.0);
+        case M64TYPE_BOOL:
+            return var->val.integer;
+        case M64TYPE_STRING:
+            return (osal_insensitive_strcmp(var->val.string, "true") == 0);
+        default:
+            DebugMessage(M64MSG_ERROR, "%s(): invalid internal parameter type for '%s'", caller, var->name);
+            return 0;
+    }
+}
+
+static const char *var_get_string(const config_var *var, const char *caller)
+{
+    static char outstr[64];  /* warning: not thread safe */
+
+    /* translate the actual variable type to a string */
+    switch(var->type)
+    {
+        case M64TYPE_INT:
+            snprintf(outstr, 63, "%i", var->val.integer);
+            outstr[63] = 0;
+            return outstr;
+        case M64TYPE_FLOAT:
+            snprintf(outstr, 63, "%f", var->val.number);
+            outstr[63] = 0;
+            return outstr;
+        case M64TYPE_BOOL:
+            return (var->val.integer ? "True" : "False");
+        case M64TYPE_STRING:
+            return var->val.string;
+        default:
+            DebugMessage(M64MSG_ERROR, "%s(): invalid internal parameter type for '%s'", caller, var->name);
+            return "";
+    }
+}
+
 static m64p_error write_configlist_file(void)
 {
     config_section *curr_section;
@@ -621,6 +923,7 @@ m64p_error ConfigShutdown(void)
     /* free all of the memory in the 2 lists */
     delete_list(&l_ConfigListActive);
     delete_list(&l_ConfigListSaved);
+    delete_params();
 
     return M64ERR_SUCCESS;
 }
@@ -929,7 +1232,7 @@ EXPORT int CALL ConfigHasUnsavedChanges(const char *SectionName)
 EXPORT m64p_error CALL ConfigDeleteSection(const char *SectionName)
 {
     config_section **curr_section_link;
-    config_section *next_section;
+    config_section *section;
 
     if (!l_ConfigInit)
         return M64ERR_NOT_INIT;
@@ -941,13 +1244,17 @@ EXPORT m64p_error CALL ConfigDeleteSection(const char *SectionName)
     if (*curr_section_link == NULL)
         return M64ERR_INPUT_NOT_FOUND;
 
-    next_section = (*curr_section_link)->next;
-
-    /* delete the named section */
-    delete_section(*curr_section_link);
+    section = *curr_section_link;
 
     /* fix the pointer to point to the next section after the deleted one */
-    *curr_section_link = next_section;
+    *curr_section_link = section->next;
+
+    /* the listeners must not find the section anymore, but SectionName may be its name */
+    l_ConfigGeneration++;
+    notify_params(section->name, NULL);
+
+    /* delete the named section */
+    delete_section(section);
 
     return M64ERR_SUCCESS;
 }
@@ -1040,6 +1347,8 @@ EXPORT m64p_error CALL ConfigRevertChanges(const char *SectionName)
     /* release memory associated with active_section */
     delete_section(active_section);
 
+    notify_params(new_section->name, NULL);
+
     return M64ERR_SUCCESS;
 }
 
@@ -1072,6 +1381,11 @@ EXPORT m64p_error CALL ConfigSetParameter(m64p_handle ConfigSectionHandle, const
             return M64ERR_NO_MEMORY;
         append_var_to_section(section, var);
     }
+    else if (var_value_equals(var, ParamType, ParamValue))
+    {
+        /* nothing changed, don't wake up the listeners */
+        return M64ERR_SUCCESS;
+    }
 
     /* cleanup old values */
     switch (var->type)
@@ -1106,6 +1420,8 @@ EXPORT m64p_error CALL ConfigSetParameter(m64p_handle ConfigSectionHandle, const
             break;
     }
 
+    notify_params(section->name, var->name);
+
     return M64ERR_SUCCESS;
 }
 
@@ -1272,6 +1588,8 @@ EXPORT m64p_error CALL ConfigSetDefaultInt(m64p_handle ConfigSectionHandle, cons
     var->val.integer = ParamValue;
     append_var_to_section(section, var);
 
+    notify_params(section->name, var->name);
+
     return M64ERR_SUCCESS;
 }
 
@@ -1307,6 +1625,8 @@ EXPORT m64p_error CALL ConfigSetDefaultFloat(m64p_handle ConfigSectionHandle, co
     var->val.number = ParamValue;
     append_var_to_section(section, var);
 
+    notify_params(section->name, var->name);
+
     return M64ERR_SUCCESS;
 }
 
@@ -1342,6 +1662,8 @@ EXPORT m64p_error CALL ConfigSetDefaultBool(m64p_handle ConfigSectionHandle, con
     var->val.integer = ParamValue ? 1 : 0;
     append_var_to_section(section, var);
 
+    notify_params(section->name, var->name);
+
     return M64ERR_SUCCESS;
 }
 
@@ -1382,6 +1704,8 @@ EXPORT m64p_error CALL ConfigSetDefaultString(m64p_handle ConfigSectionHandle, c
     }
     append_var_to_section(section, var);
 
+    notify_params(section->name, var->name);
+
     return M64ERR_SUCCESS;
 }
 
@@ -1412,21 +1736,7 @@ EXPORT int CALL ConfigGetParamInt(m64p_handle ConfigSectionHandle, const char *P
         return 0;
     }
 
-    /* translate the actual variable type to an int */
-    switch(var->type)
-    {
-        case M64TYPE_INT:
-            return var->val.integer;
-        case M64TYPE_FLOAT:
-            return (int) var->val.number;
-        case M64TYPE_BOOL:
-            return (var->val.integer != 0);
-        case M64TYPE_STRING:
-            return atoi(var->val.string);
-        default:
-            DebugMessage(M64MSG_ERROR, "ConfigGetParamInt(): invalid internal parameter type for '%s'", ParamName);
-            return 0;
-    }
+    return var_get_int(var, "ConfigGetParamInt");
 }
 
 EXPORT float CALL ConfigGetParamFloat(m64p_handle ConfigSectionHandle, const char *ParamName)
@@ -1456,21 +1766,7 @@ EXPORT float CALL ConfigGetParamFloat(m64p_handle ConfigSectionHandle, const cha
         return 0.0;
     }
 
-    /* translate the actual variable type to a float */
-    switch(var->type)
-    {
-        case M64TYPE_INT:
-            return (float) var->val.integer;
-        case M64TYPE_FLOAT:
-            return var->val.number;
-        case M64TYPE_BOOL:
-            return (var->val.integer != 0) ? 1.0f : 0.0f;
-        case M64TYPE_STRING:
-            return (float) atof(var->val.string);
-        default:
-            DebugMessage(M64MSG_ERROR, "ConfigGetParamFloat(): invalid internal parameter type for '%s'", ParamName);
-            return 0.0;
-    }
+    return var_get_float(var, "ConfigGetParamFloat");
 }
 
 EXPORT int CALL ConfigGetParamBool(m64p_handle ConfigSectionHandle, const char *ParamName)
@@ -1500,26 +1796,11 @@ EXPORT int CALL ConfigGetParamBool(m64p_handle ConfigSectionHandle, const char *
         return 0;
     }
 
-    /* translate the actual variable type to an int (0 or 1) */
-    switch(var->type)
-    {
-        case M64TYPE_INT:
-            return (var->val.integer != 0);
-        case M64TYPE_FLOAT:
-            return (var->val.number != 0.0);
-        case M64TYPE_BOOL:
-            return var->val.integer;
-        case M64TYPE_STRING:
-            return (osal_insensitive_strcmp(var->val.string, "true") == 0);
-        default:
-            DebugMessage(M64MSG_ERROR, "ConfigGetParamBool(): invalid internal parameter type for '%s'", ParamName);
-            return 0;
-    }
+    return var_get_bool(var, "ConfigGetParamBool");
 }
 
 EXPORT const char * CALL ConfigGetParamString(m64p_handle ConfigSectionHandle, const char *ParamName)
 {
-    static char outstr[64];  /* warning: not thread safe */
     config_section *section;
     config_var *var;
 
@@ -1545,25 +1826,212 @@ EXPORT const char * CALL ConfigGetParamString(m64p_handle ConfigSectionHandle, c
         return "";
     }
 
-    /* translate the actual variable type to a string */
-    switch(var->type)
+    return var_get_string(var, "ConfigGetParamString");
+}
+
+/* ------------------------------------------------------ */
+/* Parameter handle functions, exported outside the Core  */
+/* ------------------------------------------------------ */
+
+static config_param *get_param(m64p_param_handle ParamHandle, const char *caller)
+{
+    config_param *param = (config_param *) ParamHandle;
+
+    if (!l_ConfigInit || param == NULL)
     {
-        case M64TYPE_INT:
-            snprintf(outstr, 63, "%i", var->val.integer);
-            outstr[63] = 0;
-            return outstr;
-        case M64TYPE_FLOAT:
-            snprintf(outstr, 63, "%f", var->val.number);
-            outstr[63] = 0;
-            return outstr;
-        case M64TYPE_BOOL:
-            return (var->val.integer ? "True" : "False");
-        case M64TYPE_STRING:
-            return var->val.string;
-        default:
-            DebugMessage(M64MSG_ERROR, "ConfigGetParamString(): invalid internal parameter type for '%s'", ParamName);
-            return "";
+        DebugMessage(M64MSG_ERROR, "%s(): Input assertion!", caller);
+        return NULL;
+    }
+    if (param->magic != PARAM_MAGIC)
+    {
+        DebugMessage(M64MSG_ERROR, "%s(): ParamHandle invalid!", caller);
+        return NULL;
+    }
+
+    return param;
+}
+
+EXPORT m64p_error CALL ConfigGetParameterHandle(m64p_handle ConfigSectionHandle, const char *ParamName, m64p_param_handle *ParamHandle)
+{
+    config_section *section;
+    config_param *param;
+
+    /* check input conditions */
+    if (!l_ConfigInit)
+        return M64ERR_NOT_INIT;
+    if (ConfigSectionHandle == NULL || ParamName == NULL || ParamHandle == NULL)
+        return M64ERR_INPUT_ASSERT;
+
+    section = (config_section *) ConfigSectionHandle;
+    if (section->magic != SECTION_MAGIC)
+        return M64ERR_INPUT_INVALID;
+
+    /* return the existing handle if this parameter was already asked for */
+    param = find_param(section->name, ParamName);
+    if (param != NULL)
+    {
+        *ParamHandle = (m64p_param_handle) param;
+        return M64ERR_SUCCESS;
     }
+
+    param = (config_param *) calloc(1, sizeof(config_param));
+    if (param == NULL)
+        return M64ERR_NO_MEMORY;
+
+    param->section_name = strdup(section->name);
+    param->name = strdup(ParamName);
+    if (param->section_name == NULL || param->name == NULL)
+    {
+        free(param->section_name);
+        free(param->name);
+        free(param);
+        return M64ERR_NO_MEMORY;
+    }
+
+    param->magic = PARAM_MAGIC;
+    param->section_hash = section->hash;
+    param->hash = config_hash(ParamName);
+    /* the parameter may not exist yet, it is looked up on first use */
+    param->generation = l_ConfigGeneration - 1;
+    param->next = l_ConfigParams;
+    l_ConfigParams = param;
+
+    *ParamHandle = (m64p_param_handle) param;
+    return M64ERR_SUCCESS;
+}
+
+EXPORT int CALL ConfigGetParamIntByHandle(m64p_param_handle ParamHandle)
+{
+    config_param *param;
+    config_var *var;
+
+    param = get_param(ParamHandle, "ConfigGetParamIntByHandle");
+    if (param == NULL)
+        return 0;
+
+    var = find_param_var(param);
+    if (var == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "ConfigGetParamIntByHandle(): Parameter '%s' not found!", param->name);
+        return 0;
+    }
+
+    return var_get_int(var, "ConfigGetParamIntByHandle");
+}
+
+EXPORT float CALL ConfigGetParamFloatByHandle(m64p_param_handle ParamHandle)
+{
+    config_param *param;
+    config_var *var;
+
+    param = get_param(ParamHandle, "ConfigGetParamFloatByHandle");
+    if (param == NULL)
+        return 0.0;
+
+    var = find_param_var(param);
+    if (var == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "ConfigGetParamFloatByHandle(): Parameter '%s' not found!", param->name);
+        return 0.0;
+    }
+
+    return var_get_float(var, "ConfigGetParamFloatByHandle");
+}
+
+EXPORT int CALL ConfigGetParamBoolByHandle(m64p_param_handle ParamHandle)
+{
+    config_param *param;
+    config_var *var;
+
+    param = get_param(ParamHandle, "ConfigGetParamBoolByHandle");
+    if (param == NULL)
+        return 0;
+
+    var = find_param_var(param);
+    if (var == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "ConfigGetParamBoolByHandle(): Parameter '%s' not found!", param->name);
+        return 0;
+    }
+
+    return var_get_bool(var, "ConfigGetParamBoolByHandle");
+}
+
+EXPORT const char * CALL ConfigGetParamStringByHandle(m64p_param_handle ParamHandle)
+{
+    config_param *param;
+    config_var *var;
+
+    param = get_param(ParamHandle, "ConfigGetParamStringByHandle");
+    if (param == NULL)
+        return "";
+
+    var = find_param_var(param);
+    if (var == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "ConfigGetParamStringByHandle(): Parameter '%s' not found!", param->name);
+        return "";
+    }
+
+    return var_get_string(var, "ConfigGetParamStringByHandle");
+}
+
+EXPORT m64p_error CALL ConfigAddParameterCallback(m64p_param_handle ParamHandle, void (*ParamCallback)(void *context, m64p_param_handle ParamHandle), void *context)
+{
+    config_param *param = (config_param *) ParamHandle;
+    config_param_callback *callbacks;
+
+    /* check input conditions */
+    if (!l_ConfigInit)
+        return M64ERR_NOT_INIT;
+    if (param == NULL || ParamCallback == NULL)
+        return M64ERR_INPUT_ASSERT;
+    if (param->magic != PARAM_MAGIC)
+        return M64ERR_INPUT_INVALID;
+
+    callbacks = (config_param_callback *) realloc(param->callbacks, (param->callback_count + 1) * sizeof(config_param_callback));
+    if (callbacks == NULL)
+        return M64ERR_NO_MEMORY;
+
+    callbacks[param->callback_count].callback = ParamCallback;
+    callbacks[param->callback_count].context = context;
+    param->callbacks = callbacks;
+    param->callback_count++;
+
+    return M64ERR_SUCCESS;
+}
+
+EXPORT m64p_error CALL ConfigRemoveParameterCallback(m64p_param_handle ParamHandle, void (*ParamCallback)(void *context, m64p_param_handle ParamHandle), void *context)
+{
+    config_param *param = (config_param *) ParamHandle;
+    unsigned int i;
+
+    /* check input conditions */
+    if (!l_ConfigInit)
+        return M64ERR_NOT_INIT;
+    if (param == NULL || ParamCallback == NULL)
+        return M64ERR_INPUT_ASSERT;
+    if (param->magic != PARAM_MAGIC)
+        return M64ERR_INPUT_INVALID;
+
+    for (i = 0; i < param->callback_count; ++i)
+    {
+        if (param->callbacks[i].callback == ParamCallback && param->callbacks[i].context == context)
+        {
+            /* notify_params may be walking the array */
+            if (param->notifying != 0)
+            {
+                param->callbacks[i].callback = NULL;
+                param->dead_callbacks++;
+                return M64ERR_SUCCESS;
+            }
+            memmove(&param->callbacks[i], &param->callbacks[i + 1], (param->callback_count - i - 1) * sizeof(config_param_callback));
+            param->callback_count--;
+            return M64ERR_SUCCESS;
+        }
+    }
+
+    return M64ERR_INPUT_NOT_FOUND;
 }
 
 EXPORT m64p_error CALL ConfigOverrideUserPaths(const char *DataPath, const char *CachePath)
@@ -38,6 +38,7 @@
 #include "m64p_types.h"
 #include "main/cheat.h"
 #include "main/eventloop.h"
+#include "main/frame_pacer.h"
 #include "main/main.h"
 #include "main/rom.h"
 #include "main/savestates.h"
@@ -456,4 +457,16 @@ EXPORT m64p_error CALL CoreGetRomSettings(m64p_rom_settings *RomSettings, int Ro
     return M64ERR_SUCCESS;
 }
 
+EXPORT m64p_error CALL CoreGetFramePacerStats(m64p_frame_pacer_stats *Stats, int StatsLength)
+{
+    if (!l_CoreInit)
+        return M64ERR_NOT_INIT;
+    if (Stats == NULL)
+        return M64ERR_INPUT_ASSERT;
+    if (StatsLength < (int)sizeof(m64p_frame_pacer_stats))
+        return M64ERR_INPUT_INVALID;
+
+    frame_pacer_get_stats(Stats);
 
+    return M64ERR_SUCCESS;
+}
@@ -198,6 +198,50 @@ EXPORT int          CALL ConfigGetParamBool(m64p_handle, const char *);
 EXPORT const char * CALL ConfigGetParamString(m64p_handle, const char *);
 #endif
 
+/* ConfigGetParameterHandle()
+ *
+ * This function returns a handle to the parameter ParamName of the given
+ * section. The parameter does not need to exist yet. Handles stay valid until
+ * the Core library is shut down, even if the section is deleted or reverted,
+ * and asking twice for the same parameter returns the same handle.
+ */
+typedef m64p_error (*ptr_ConfigGetParameterHandle)(m64p_handle, const char *, m64p_param_handle *);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL ConfigGetParameterHandle(m64p_handle, const char *, m64p_param_handle *);
+#endif
+
+/* ConfigGetParam***ByHandle()
+ *
+ * These functions behave like the ConfigGetParam***() functions, but take a
+ * handle given by ConfigGetParameterHandle() and don't need to search for the
+ * parameter by name, so they can be called in performance sensitive code.
+ */
+typedef int          (*ptr_ConfigGetParamIntByHandle)(m64p_param_handle);
+typedef float        (*ptr_ConfigGetParamFloatByHandle)(m64p_param_handle);
+typedef int          (*ptr_ConfigGetParamBoolByHandle)(m64p_param_handle);
+typedef const char * (*ptr_ConfigGetParamStringByHandle)(m64p_param_handle);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT int          CALL ConfigGetParamIntByHandle(m64p_param_handle);
+EXPORT float        CALL ConfigGetParamFloatByHandle(m64p_param_handle);
+EXPORT int          CALL ConfigGetParamBoolByHandle(m64p_param_handle);
+EXPORT const char * CALL ConfigGetParamStringByHandle(m64p_param_handle);
+#endif
+
+/* ConfigAddParameterCallback()
+ * ConfigRemoveParameterCallback()
+ *
+ * These functions register or unregister a function which will be called
+ * whenever the value of the given parameter may have changed: when it is set
+ * with ConfigSetParameter() or created with ConfigSetDefault***(), or when its
+ * section is reverted or deleted.
+ */
+typedef m64p_error (*ptr_ConfigAddParameterCallback)(m64p_param_handle, void (*)(void *, m64p_param_handle), void *);
+typedef m64p_error (*ptr_ConfigRemoveParameterCallback)(m64p_param_handle, void (*)(void *, m64p_param_handle), void *);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL ConfigAddParameterCallback(m64p_param_handle, void (*)(void *, m64p_param_handle), void *);
+EXPORT m64p_error CALL ConfigRemoveParameterCallback(m64p_param_handle, void (*)(void *, m64p_param_handle), void *);
+#endif
+
 /* ConfigGetSharedDataFilepath()
  *
  * This function is provided to allow a plugin to retrieve a full pathname to a
@@ -133,6 +133,16 @@ typedef m64p_error (*ptr_CoreGetRomSettings)(m64p_rom_settings *, int, int, int)
 EXPORT m64p_error CALL CoreGetRomSettings(m64p_rom_settings *, int, int, int);
 #endif
 
+/* CoreGetFramePacerStats()
+ *
+ * This function will retrieve the frame pacing histograms collected since the
+ * emulation was started.
+ */
+typedef m64p_error (*ptr_CoreGetFramePacerStats)(m64p_frame_pacer_stats *, int);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL CoreGetFramePacerStats(m64p_frame_pacer_stats *, int);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -225,10 +225,13 @@ typedef struct
 typedef void (*ptr_FBRead)(unsigned int addr);
 typedef void (*ptr_FBWrite)(unsigned int addr, unsigned int size);
 typedef void (*ptr_FBGetFrameBufferInfo)(void *p);
+/* optional: notifies a whole written range at once instead of one FBWrite per unit */
+typedef void (*ptr_FBWriteRange)(unsigned int addr, unsigned int length);
 #if defined(M64P_PLUGIN_PROTOTYPES)
 EXPORT void CALL FBRead(unsigned int addr);
 EXPORT void CALL FBWrite(unsigned int addr, unsigned int size);
 EXPORT void CALL FBGetFrameBufferInfo(void *p);
+EXPORT void CALL FBWriteRange(unsigned int addr, unsigned int length);
 #endif
 
 /* audio plugin function pointers */
@@ -51,6 +51,7 @@
 /* ----------------------------------------- */
 
 typedef void * m64p_handle;
+typedef void * m64p_param_handle;
 
 /* Generic function pointer returned from osal_dynlib_getproc (and the like)
  * Don't use it directly, cast to proper type before using it.
@@ -289,6 +290,21 @@ typedef struct
    unsigned int aidmamodifier; /* Percentage modifier for AI DMA duration */
 } m64p_rom_settings;
 
+/* Frame pacing histograms: bucket 0 counts durations below 2 microseconds,
+ * bucket i counts durations in [2^i, 2^(i+1)) microseconds
+ * and the last bucket everything above. */
+#define M64P_FRAME_PACER_BUCKETS 24
+
+typedef struct
+{
+   unsigned int frames;     /* Number of frames paced since emulation started */
+   unsigned int resyncs;    /* Number of times the schedule was dropped after falling too far behind or ahead */
+   unsigned int sleep_margin_us; /* Current margin kept for spinning before a frame deadline */
+   unsigned int emulation[M64P_FRAME_PACER_BUCKETS]; /* Time spent emulating a frame */
+   unsigned int idle[M64P_FRAME_PACER_BUCKETS];      /* Time spent waiting for the frame deadline */
+   unsigned int overshoot[M64P_FRAME_PACER_BUCKETS]; /* Time by which the frame deadline was missed */
+} m64p_frame_pacer_stats;
+
 /* ----------------------------------------- */
 /* Structures and Types for the Debugger     */
 /* ----------------------------------------- */
@@ -22,6 +22,7 @@
 #ifndef M64P_BACKENDS_API_CLOCK_BACKEND_H
 #define M64P_BACKENDS_API_CLOCK_BACKEND_H
 
+#include <stdint.h>
 #include <time.h>
 
 struct clock_backend_interface
@@ -31,4 +32,12 @@ struct clock_backend_interface
     time_t (*get_time)(void* clock);
 };
 
+struct monotonic_clock_backend_interface
+{
+    /* Returns the current time in nanoseconds from an unspecified origin.
+     * Never goes backward, unaffected by wall clock adjustments.
+     */
+    uint64_t (*get_time_ns)(void* clock);
+};
+
 #endif
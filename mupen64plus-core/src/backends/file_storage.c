@@ -21,7 +21,11 @@
 
 #include "file_storage.h"
 
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
@@ -29,6 +33,40 @@
 #include "device/dd/dd_controller.h"
 #include "main/util.h"
 #include "main/netplay.h"
+#include "osal/files.h"
+
+#define WRITEBACK_ENTRIES_COUNT 16
+
+/* Larger storages (64DD disks) are written synchronously
+ * rather than being duplicated in a writeback image */
+#define WRITEBACK_MAX_STORAGE_SIZE 0x100000
+
+struct writeback_entry
+{
+    struct file_storage* fstorage;  /* NULL if the entry is free */
+    uint8_t* image;                 /* copy of storage content as of the last save */
+    size_t begin;                   /* dirty range is [begin, end) */
+    size_t end;
+    int full;                       /* write the whole file instead of a chunk */
+    int busy;                       /* image is being written to disk */
+    Uint32 deadline;
+};
+
+struct writeback_service
+{
+    int running;
+    int quit;
+    unsigned int delay;
+    SDL_mutex* lock;
+    SDL_cond* cond;
+    SDL_Thread* thread;
+    struct writeback_entry entries[WRITEBACK_ENTRIES_COUNT];
+
+    unsigned int saves;
+    unsigned int writes;
+};
+
+static struct writeback_service l_writeback;
 
 int open_file_storage(struct file_storage* fstorage, size_t size, const char* filename)
 {
@@ -36,6 +74,7 @@ int open_file_storage(struct file_storage* fstorage, size_t size, const char* fi
     fstorage->filename = filename;
     fstorage->size = size;
     fstorage->first_access = 1;
+    fstorage->mapped = 0;
 
     /* allocate memory for holding data */
     fstorage->data = malloc(fstorage->size);
@@ -60,6 +99,7 @@ int open_rom_file_storage(struct file_storage* fstorage, const char* filename)
     fstorage->size = 0;
     fstorage->filename = NULL;
     fstorage->first_access = 1;
+    fstorage->mapped = 0;
 
     file_status_t err = load_file(filename, (void**)&fstorage->data, &fstorage->size);
 
@@ -71,9 +111,37 @@ int open_rom_file_storage(struct file_storage* fstorage, const char* filename)
     return err;
 }
 
+int open_mapped_file_storage(struct file_storage* fstorage, const char* filename)
+{
+    fstorage->size = 0;
+    fstorage->filename = NULL;
+    fstorage->first_access = 1;
+    fstorage->mapped = 1;
+
+    fstorage->data = osal_file_map(filename, &fstorage->size);
+    if (fstorage->data == NULL) {
+        fstorage->mapped = 0;
+        return file_open_error;
+    }
+
+    /* ! take ownsership of filename ! */
+    fstorage->filename = filename;
+
+    return file_ok;
+}
+
+static void writeback_release(struct file_storage* fstorage);
+
 void close_file_storage(struct file_storage* fstorage)
 {
-    free((void*)fstorage->data);
+    writeback_release(fstorage);
+
+    if (fstorage->mapped) {
+        osal_file_unmap(fstorage->data, fstorage->size);
+    }
+    else {
+        free((void*)fstorage->data);
+    }
     free((void*)fstorage->filename);
 }
 
@@ -90,6 +158,286 @@ static size_t file_storage_size(const void* storage)
     return fstorage->size;
 }
 
+static void report_file_storage_error(const char* filename, file_status_t err)
+{
+    switch(err)
+    {
+    case file_open_error:
+        DebugMessage(M64MSG_WARNING, "couldn't open storage file '%s' for writing", filename);
+        break;
+    case file_write_error:
+        DebugMessage(M64MSG_WARNING, "failed to write storage file '%s'", filename);
+        break;
+    default:
+        break;
+    }
+}
+
+static int writeback_is_dirty(const struct writeback_entry* entry)
+{
+    return entry->full || entry->begin < entry->end;
+}
+
+/* Must be called with the service lock held.
+ * The lock is released while writing to disk. */
+static void writeback_flush_locked(struct writeback_entry* entry)
+{
+    while (entry->busy) {
+        SDL_CondWait(l_writeback.cond, l_writeback.lock);
+    }
+
+    if (entry->fstorage == NULL || !writeback_is_dirty(entry)) {
+        return;
+    }
+
+    const char* filename = entry->fstorage->filename;
+    size_t start = entry->full ? 0 : entry->begin;
+    size_t size = entry->full ? entry->fstorage->size : entry->end - entry->begin;
+    int full = entry->full;
+
+    uint8_t* chunk = malloc(size);
+    if (chunk == NULL) {
+        DebugMessage(M64MSG_WARNING, "couldn't allocate writeback buffer for storage file '%s'", filename);
+        return;
+    }
+    memcpy(chunk, entry->image + start, size);
+
+    entry->full = 0;
+    entry->begin = entry->end = 0;
+    entry->busy = 1;
+    ++l_writeback.writes;
+    SDL_UnlockMutex(l_writeback.lock);
+
+    file_status_t err = (full)
+        ? write_to_file(filename, chunk, size)
+        : write_chunk_to_file(filename, chunk, size, start);
+    report_file_storage_error(filename, err);
+    free(chunk);
+
+    SDL_LockMutex(l_writeback.lock);
+    entry->busy = 0;
+    SDL_CondBroadcast(l_writeback.cond);
+}
+
+static int writeback_thread(void* opaque)
+{
+    SDL_LockMutex(l_writeback.lock);
+
+    while (!l_writeback.quit) {
+        struct writeback_entry* due = NULL;
+        Sint32 wait = -1;
+        Uint32 now = SDL_GetTicks();
+        size_t i;
+
+        for (i = 0; i < WRITEBACK_ENTRIES_COUNT; ++i) {
+            struct writeback_entry* entry = &l_writeback.entries[i];
+            if (entry->fstorage == NULL || entry->busy || !writeback_is_dirty(entry)) {
+                continue;
+            }
+
+            Sint32 left = (Sint32)(entry->deadline - now);
+            if (left <= 0) {
+                due = entry;
+                break;
+            }
+            if (wait < 0 || left < wait) {
+                wait = left;
+            }
+        }
+
+        if (due != NULL) {
+            writeback_flush_locked(due);
+        }
+        else if (wait < 0) {
+            SDL_CondWait(l_writeback.cond, l_writeback.lock);
+        }
+        else {
+            SDL_CondWaitTimeout(l_writeback.cond, l_writeback.lock, (Uint32)wait);
+        }
+    }
+
+    SDL_UnlockMutex(l_writeback.lock);
+    return 0;
+}
+
+static struct writeback_entry* writeback_get_entry(struct file_storage* fstorage)
+{
+    struct writeback_entry* free_entry = NULL;
+    size_t i;
+
+    for (i = 0; i < WRITEBACK_ENTRIES_COUNT; ++i) {
+        struct writeback_entry* entry = &l_writeback.entries[i];
+        if (entry->fstorage == fstorage) {
+            return entry;
+        }
+        if (entry->fstorage == NULL && free_entry == NULL) {
+            free_entry = entry;
+        }
+    }
+
+    if (free_entry == NULL) {
+        return NULL;
+    }
+
+    free_entry->image = malloc(fstorage->size);
+    if (free_entry->image == NULL) {
+        return NULL;
+    }
+
+    free_entry->fstorage = fstorage;
+    free_entry->begin = free_entry->end = 0;
+    free_entry->full = 0;
+    free_entry->busy = 0;
+
+    return free_entry;
+}
+
+/* Returns 0 if the save has to be written synchronously */
+static int writeback_queue(struct file_storage* fstorage, size_t start, size_t size)
+{
+    if (!l_writeback.running || fstorage->size > WRITEBACK_MAX_STORAGE_SIZE) {
+        return 0;
+    }
+
+    SDL_LockMutex(l_writeback.lock);
+
+    struct writeback_entry* entry = writeback_get_entry(fstorage);
+    if (entry == NULL) {
+        SDL_UnlockMutex(l_writeback.lock);
+        return 0;
+    }
+
+    int was_dirty = writeback_is_dirty(entry);
+
+    /* On first save access ignore start/size and write full storage content */
+    if (fstorage->first_access) {
+        fstorage->first_access = 0;
+        entry->full = 1;
+        start = 0;
+        size = fstorage->size;
+    }
+
+    memcpy(entry->image + start, fstorage->data + start, size);
+
+    if (entry->begin < entry->end) {
+        if (start < entry->begin) { entry->begin = start; }
+        if (start + size > entry->end) { entry->end = start + size; }
+    }
+    else {
+        entry->begin = start;
+        entry->end = start + size;
+    }
+
+    if (!was_dirty) {
+        entry->deadline = SDL_GetTicks() + l_writeback.delay;
+        SDL_CondBroadcast(l_writeback.cond);
+    }
+    ++l_writeback.saves;
+
+    SDL_UnlockMutex(l_writeback.lock);
+    return 1;
+}
+
+static void writeback_release(struct file_storage* fstorage)
+{
+    size_t i;
+
+    if (!l_writeback.running) {
+        return;
+    }
+
+    SDL_LockMutex(l_writeback.lock);
+    for (i = 0; i < WRITEBACK_ENTRIES_COUNT; ++i) {
+        struct writeback_entry* entry = &l_writeback.entries[i];
+        if (entry->fstorage != fstorage) {
+            continue;
+        }
+
+        writeback_flush_locked(entry);
+        free(entry->image);
+        memset(entry, 0, sizeof(*entry));
+    }
+    SDL_UnlockMutex(l_writeback.lock);
+}
+
+void file_storage_writeback_start(unsigned int delay_ms)
+{
+    memset(&l_writeback, 0, sizeof(l_writeback));
+
+    if (delay_ms == 0) {
+        return;
+    }
+
+    l_writeback.delay = delay_ms;
+    l_writeback.lock = SDL_CreateMutex();
+    l_writeback.cond = SDL_CreateCond();
+    if (l_writeback.lock == NULL || l_writeback.cond == NULL) {
+        goto fail;
+    }
+
+#if SDL_VERSION_ATLEAST(2,0,0)
+    l_writeback.thread = SDL_CreateThread(writeback_thread, "m64pwriteback", NULL);
+#else
+    l_writeback.thread = SDL_CreateThread(writeback_thread, NULL);
+#endif
+    if (l_writeback.thread == NULL) {
+        goto fail;
+    }
+
+    l_writeback.running = 1;
+    return;
+
+fail:
+    DebugMessage(M64MSG_WARNING, "Could not start storage writeback thread, saves will be written synchronously");
+    if (l_writeback.cond != NULL) { SDL_DestroyCond(l_writeback.cond); }
+    if (l_writeback.lock != NULL) { SDL_DestroyMutex(l_writeback.lock); }
+    memset(&l_writeback, 0, sizeof(l_writeback));
+}
+
+void file_storage_writeback_sync(void)
+{
+    size_t i;
+
+    if (!l_writeback.running) {
+        return;
+    }
+
+    SDL_LockMutex(l_writeback.lock);
+    for (i = 0; i < WRITEBACK_ENTRIES_COUNT; ++i) {
+        writeback_flush_locked(&l_writeback.entries[i]);
+    }
+    SDL_UnlockMutex(l_writeback.lock);
+}
+
+void file_storage_writeback_stop(void)
+{
+    size_t i;
+    int status;
+
+    if (!l_writeback.running) {
+        return;
+    }
+
+    SDL_LockMutex(l_writeback.lock);
+    l_writeback.quit = 1;
+    SDL_CondBroadcast(l_writeback.cond);
+    SDL_UnlockMutex(l_writeback.lock);
+    SDL_WaitThread(l_writeback.thread, &status);
+
+    file_storage_writeback_sync();
+
+    for (i = 0; i < WRITEBACK_ENTRIES_COUNT; ++i) {
+        free(l_writeback.entries[i].image);
+    }
+
+    DebugMessage(M64MSG_VERBOSE, "Storage writeback: %u saves written in %u file accesses",
+        l_writeback.saves, l_writeback.writes);
+
+    SDL_DestroyCond(l_writeback.cond);
+    SDL_DestroyMutex(l_writeback.lock);
+    memset(&l_writeback, 0, sizeof(l_writeback));
+}
+
 static void file_storage_save(void* storage, size_t start, size_t size)
 {
     if (netplay_is_init() && netplay_get_controller(0) == -1)
@@ -97,6 +445,9 @@ static void file_storage_save(void* storage, size_t start, size_t size)
 
     struct file_storage* fstorage = (struct file_storage*)storage;
 
+    if (writeback_queue(fstorage, start, size))
+        return;
+
     file_status_t err;
 
     /* On first save access ignore start/size and write full storage content,
@@ -109,17 +460,7 @@ static void file_storage_save(void* storage, size_t start, size_t size)
         err = write_chunk_to_file(fstorage->filename, fstorage->data + start, size, start);
     }
 
-    switch(err)
-    {
-    case file_open_error:
-        DebugMessage(M64MSG_WARNING, "couldn't open storage file '%s' for writing", fstorage->filename);
-        break;
-    case file_write_error:
-        DebugMessage(M64MSG_WARNING, "failed to write storage file '%s'", fstorage->filename);
-        break;
-    default:
-        break;
-    }
+    report_file_storage_error(fstorage->filename, err);
 }
 
 static void file_storage_parent_save(void* storage, size_t start, size_t size)
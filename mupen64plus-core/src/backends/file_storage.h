@@ -31,13 +31,27 @@ struct file_storage
     size_t size;
     const char* filename;
     int first_access;
+    int mapped;
 };
 
 
 int open_file_storage(struct file_storage* storage, size_t size, const char* filename);
 int open_rom_file_storage(struct file_storage* storage, const char* filename);
+/* Same as open_rom_file_storage, but the file is mapped copy-on-write
+ * instead of being read upfront. Modifications only reach the file through save. */
+int open_mapped_file_storage(struct file_storage* storage, const char* filename);
 void close_file_storage(struct file_storage* storage);
 
+/* Background writeback of g_ifile_storage saves.
+ * While started, saves are copied to a per-storage image and their dirty
+ * ranges coalesced, then written to disk by a worker thread delay_ms after the
+ * first unwritten change. When not started, saves are written synchronously.
+ */
+void file_storage_writeback_start(unsigned int delay_ms);
+void file_storage_writeback_stop(void);
+/* Write all pending saves to disk before returning */
+void file_storage_writeback_sync(void);
+
 extern const struct storage_backend_interface g_ifile_storage;
 extern const struct storage_backend_interface g_ifile_storage_ro;
 extern const struct storage_backend_interface g_isubfile_storage;
@@ -26,6 +26,7 @@
 #include "device/rcp/ri/ri_controller.h"
 #include "device/rcp/vi/vi_controller.h"
 #include "device/rdram/rdram.h"
+#include "main/frame_pacer.h"
 #include "main/rom.h"
 #include "plugin/plugin.h"
 
@@ -56,6 +57,8 @@ static void audio_plugin_push_samples(void* aout, const void* buffer, size_t siz
 
     ai->regs[AI_LEN_REG] = saved_ai_length;
     ai->regs[AI_DRAM_ADDR_REG] = saved_ai_dram;
+
+    frame_pacer_push_audio(size, ai->vi->clock / (1 + ai->regs[AI_DACRATE_REG]));
 }
 
 const struct audio_out_backend_interface g_iaudio_out_backend_plugin_compat =
@@ -25,6 +25,7 @@
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
 
+#include "device/memory/dma_copy.h"
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rcp/pi/pi_controller.h"
@@ -93,7 +94,20 @@ unsigned int cart_rom_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_
 
 unsigned int cart_rom_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
-    size_t i;
+    cart_rom_dma_write_data(opaque, dram, dram_addr, cart_addr, length);
+
+    return cart_rom_dma_write_cycles(opaque, dram_addr, cart_addr, length);
+}
+
+unsigned int cart_rom_dma_write_cycles(void* opaque, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
+{
+    struct cart_rom* cart_rom = (struct cart_rom*)opaque;
+
+    return (length / 8) + add_random_interrupt_time(cart_rom->r4300);
+}
+
+void cart_rom_dma_write_data(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
+{
     struct cart_rom* cart_rom = (struct cart_rom*)opaque;
     const uint8_t* mem = cart_rom->rom;
 
@@ -101,9 +115,7 @@ unsigned int cart_rom_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
 
     if (cart_addr + length < cart_rom->rom_size)
     {
-        for(i = 0; i < length; ++i) {
-            dram[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
-        }
+        dma_copy(dram, dram_addr, mem, cart_addr, length);
     }
     else
     {
@@ -111,18 +123,11 @@ unsigned int cart_rom_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
             ? 0
             : cart_rom->rom_size - cart_addr;
 
-        for (i = 0; i < diff; ++i) {
-            dram[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
-        }
-        for (; i < length; ++i) {
-            dram[(dram_addr+i)^S8] = 0;
-        }
+        dma_copy(dram, dram_addr, mem, cart_addr, diff);
+        dma_zero(dram, dram_addr + diff, length - diff);
     }
 
     /* invalidate cached code */
-    invalidate_r4300_cached_code(cart_rom->r4300, 0x80000000 + dram_addr, length);
-    invalidate_r4300_cached_code(cart_rom->r4300, 0xa0000000 + dram_addr, length);
-
-    return (length / 8) + add_random_interrupt_time(cart_rom->r4300);
+    invalidate_r4300_cached_code_physical(cart_rom->r4300, dram_addr, length, CODE_WRITE_PI);
 }
 
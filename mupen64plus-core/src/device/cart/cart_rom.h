@@ -58,5 +58,7 @@ void write_cart_rom(void* opaque, uint32_t address, uint32_t value, uint32_t mas
 
 unsigned int cart_rom_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
 unsigned int cart_rom_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
+unsigned int cart_rom_dma_write_cycles(void* opaque, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
+void cart_rom_dma_write_data(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
 
 #endif
@@ -27,6 +27,7 @@
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
 #include "backends/api/storage_backend.h"
+#include "device/memory/dma_copy.h"
 #include "device/memory/memory.h"
 
 #define __STDC_FORMAT_MACROS
@@ -35,7 +36,6 @@
 
 static void flashram_command(struct flashram* flashram, uint32_t command)
 {
-    unsigned int i;
     unsigned int offset;
     uint8_t* mem = flashram->istorage->data(flashram->storage);
 
@@ -82,9 +82,7 @@ static void flashram_command(struct flashram* flashram, uint32_t command)
 
         /* program selected page */
         offset = (command & 0xffff) * 128;
-        for (i = 0; i < 128; ++i) {
-            mem[(offset+i)^S8] = flashram->page_buf[i];
-        }
+        dma_copy_from_bytes(mem, offset, flashram->page_buf, 128);
         flashram->istorage->save(flashram->storage, offset, 128);
 
         /* clear program busy flag, set program success flag, transition to status mode */
@@ -183,7 +181,6 @@ void write_flashram(void* opaque, uint32_t address, uint32_t value, uint32_t mas
 
 unsigned int flashram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
-    size_t i;
     struct flashram* flashram = (struct flashram*)opaque;
     const uint8_t* mem = flashram->istorage->data(flashram->storage);
 
@@ -207,9 +204,7 @@ unsigned int flashram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
         }
 
         /* do actual DMA */
-        for(i = 0; i < length; ++i) {
-            dram[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
-        }
+        dma_copy(dram, dram_addr, mem, cart_addr, length);
     }
     else {
         /* other accesses are not implemented */
@@ -223,13 +218,10 @@ unsigned int flashram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
 unsigned int flashram_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
     struct flashram* flashram = (struct flashram*)opaque;
-    unsigned int i;
 
     if ((cart_addr & 0x1ffff) == 0x00000 && length == 128 && flashram->mode == FLASHRAM_MODE_PAGE_PROGRAM) {
         /* load page buf using DMA */
-        for(i = 0; i < length; ++i) {
-            flashram->page_buf[i] = dram[(dram_addr+i)^S8];
-        }
+        dma_copy_to_bytes(flashram->page_buf, dram, dram_addr, length);
     }
     else {
         /* other accesses are not implemented */
@@ -89,23 +89,41 @@ void change_pak(struct game_controller* cont,
     cont->ipak = ipak;
 }
 
+/* CRC-8 (poly 0x85) of a crc register shifted by 8 zero bits */
+static const uint8_t l_pak_crc_table[256] =
+{
+    0x00, 0x85, 0x8f, 0x0a, 0x9b, 0x1e, 0x14, 0x91, 0xb3, 0x36, 0x3c, 0xb9, 0x28, 0xad, 0xa7, 0x22,
+    0xe3, 0x66, 0x6c, 0xe9, 0x78, 0xfd, 0xf7, 0x72, 0x50, 0xd5, 0xdf, 0x5a, 0xcb, 0x4e, 0x44, 0xc1,
+    0x43, 0xc6, 0xcc, 0x49, 0xd8, 0x5d, 0x57, 0xd2, 0xf0, 0x75, 0x7f, 0xfa, 0x6b, 0xee, 0xe4, 0x61,
+    0xa0, 0x25, 0x2f, 0xaa, 0x3b, 0xbe, 0xb4, 0x31, 0x13, 0x96, 0x9c, 0x19, 0x88, 0x0d, 0x07, 0x82,
+    0x86, 0x03, 0x09, 0x8c, 0x1d, 0x98, 0x92, 0x17, 0x35, 0xb0, 0xba, 0x3f, 0xae, 0x2b, 0x21, 0xa4,
+    0x65, 0xe0, 0xea, 0x6f, 0xfe, 0x7b, 0x71, 0xf4, 0xd6, 0x53, 0x59, 0xdc, 0x4d, 0xc8, 0xc2, 0x47,
+    0xc5, 0x40, 0x4a, 0xcf, 0x5e, 0xdb, 0xd1, 0x54, 0x76, 0xf3, 0xf9, 0x7c, 0xed, 0x68, 0x62, 0xe7,
+    0x26, 0xa3, 0xa9, 0x2c, 0xbd, 0x38, 0x32, 0xb7, 0x95, 0x10, 0x1a, 0x9f, 0x0e, 0x8b, 0x81, 0x04,
+    0x89, 0x0c, 0x06, 0x83, 0x12, 0x97, 0x9d, 0x18, 0x3a, 0xbf, 0xb5, 0x30, 0xa1, 0x24, 0x2e, 0xab,
+    0x6a, 0xef, 0xe5, 0x60, 0xf1, 0x74, 0x7e, 0xfb, 0xd9, 0x5c, 0x56, 0xd3, 0x42, 0xc7, 0xcd, 0x48,
+    0xca, 0x4f, 0x45, 0xc0, 0x51, 0xd4, 0xde, 0x5b, 0x79, 0xfc, 0xf6, 0x73, 0xe2, 0x67, 0x6d, 0xe8,
+    0x29, 0xac, 0xa6, 0x23, 0xb2, 0x37, 0x3d, 0xb8, 0x9a, 0x1f, 0x15, 0x90, 0x01, 0x84, 0x8e, 0x0b,
+    0x0f, 0x8a, 0x80, 0x05, 0x94, 0x11, 0x1b, 0x9e, 0xbc, 0x39, 0x33, 0xb6, 0x27, 0xa2, 0xa8, 0x2d,
+    0xec, 0x69, 0x63, 0xe6, 0x77, 0xf2, 0xf8, 0x7d, 0x5f, 0xda, 0xd0, 0x55, 0xc4, 0x41, 0x4b, 0xce,
+    0x4c, 0xc9, 0xc3, 0x46, 0xd7, 0x52, 0x58, 0xdd, 0xff, 0x7a, 0x70, 0xf5, 0x64, 0xe1, 0xeb, 0x6e,
+    0xaf, 0x2a, 0x20, 0xa5, 0x34, 0xb1, 0xbb, 0x3e, 0x1c, 0x99, 0x93, 0x16, 0x87, 0x02, 0x08, 0x8d,
+};
+
 static uint8_t pak_data_crc(const uint8_t* data, size_t size)
 {
     size_t i;
     uint8_t crc = 0;
 
-    for(i = 0; i <= size; ++i)
+    /* data bits enter at the bottom of the register, so they never reach
+     * the feedback tap within their own byte */
+    for(i = 0; i < size; ++i)
     {
-        int mask;
-        for (mask = 0x80; mask >= 1; mask >>= 1)
-        {
-            uint8_t xor_tap = (crc & 0x80) ? 0x85 : 0x00;
-            crc <<= 1;
-            if (i != size && (data[i] & mask)) crc |= 1;
-            crc ^= xor_tap;
-        }
+        crc = l_pak_crc_table[crc] ^ data[i];
     }
-    return crc;
+
+    /* flush with an extra zero byte */
+    return l_pak_crc_table[crc];
 }
 
 static void pak_read_block(struct game_controller* cont,
@@ -124,8 +124,6 @@ static void read_transferpak(void* pak, uint16_t address, uint8_t* data, size_t
         /* read gb cart */
         if (tpk->enabled)
         {
-            DebugMessage(M64MSG_VERBOSE, "tpak read cart: %04x", address);
-
             if (tpk->gb_cart != NULL) {
                 read_gb_cart(tpk->gb_cart, gb_cart_address(tpk->bank, address), data, size);
             }
@@ -198,8 +196,6 @@ static void write_transferpak(void* pak, uint16_t address, const uint8_t* data,
         /* write gb cart */
 //        if (tpk->enabled)
         {
-            DebugMessage(M64MSG_VERBOSE, "tpak write gb: %04x <- %02x", address, value);
-
             if (tpk->gb_cart != NULL) {
                 write_gb_cart(tpk->gb_cart, gb_cart_address(tpk->bank, address), data, size);
             }
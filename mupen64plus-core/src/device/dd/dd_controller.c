@@ -33,6 +33,7 @@
 #include "backends/api/storage_backend.h"
 #include "device/dd/disk.h"
 #include "device/device.h"
+#include "device/memory/dma_copy.h"
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 
@@ -197,8 +198,6 @@ void dd_dv_int_handler(void* opaque)
 
 static void read_C2(struct dd_controller* dd)
 {
-    size_t i;
-
     size_t length = zone_sec_size[dd->bm_zone];
     unsigned int sector = (dd->regs[DD_ASIC_CUR_SECTOR] >> 16) & 0xff;
     sector %= 90;
@@ -207,9 +206,7 @@ static void read_C2(struct dd_controller* dd)
     DebugMessage(M64MSG_VERBOSE, "read C2: length=%08x, offset=%08x",
             (uint32_t)length, (uint32_t)offset);
 
-    for (i = 0; i < length; ++i) {
-        dd->c2s_buf[(offset + i) ^ 3] = 0;
-    }
+    dma_zero(dd->c2s_buf, (uint32_t)offset, length);
 }
 
 static uint8_t* seek_sector(struct dd_controller* dd)
@@ -231,7 +228,6 @@ static uint8_t* seek_sector(struct dd_controller* dd)
 
 static void read_sector(struct dd_controller* dd)
 {
-    size_t i;
     const uint8_t* disk_sec = seek_sector(dd);
     if (disk_sec == NULL) {
         return;
@@ -239,14 +235,11 @@ static void read_sector(struct dd_controller* dd)
 
     size_t length = dd->regs[DD_ASIC_HOST_SECBYTE] + 1;
 
-    for (i = 0; i < length; ++i) {
-        dd->ds_buf[i ^ 3] = disk_sec[i];
-    }
+    dma_copy_from_bytes(dd->ds_buf, 0, disk_sec, length);
 }
 
 static void write_sector(struct dd_controller* dd)
 {
-    size_t i;
     uint8_t* disk_sec = seek_sector(dd);
     if (disk_sec == NULL) {
         return;
@@ -254,9 +247,7 @@ static void write_sector(struct dd_controller* dd)
 
     size_t length = dd->regs[DD_ASIC_HOST_SECBYTE] + 1;
 
-	for (i = 0; i < length; ++i) {
-		disk_sec[i] = dd->ds_buf[i ^ 3];
-    }
+    dma_copy_to_bytes(disk_sec, dd->ds_buf, 0, length);
 
     dd->idisk->save(dd->disk, disk_sec - dd->idisk->data(dd->disk), length);
 }
@@ -798,7 +789,6 @@ unsigned int dd_dom_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_ad
 {
     struct dd_controller* dd = (struct dd_controller*)opaque;
     uint8_t* mem;
-    size_t i;
 
     DebugMessage(M64MSG_VERBOSE, "DD DMA read dram=%08x  cart=%08x length=%08x",
             dram_addr, cart_addr, length);
@@ -820,9 +810,7 @@ unsigned int dd_dom_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_ad
         return (length * 63) / 25;
     }
 
-    for (i = 0; i < length; ++i) {
-        mem[(cart_addr + i) ^ S8] = dram[(dram_addr + i) ^ S8];
-    }
+    dma_copy(mem, cart_addr, dram, dram_addr, length);
 
     /* Recommended Count Per Op = 1, this seems to break very easily */
     return (length * 63) / 25;
@@ -833,7 +821,6 @@ unsigned int dd_dom_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, u
     struct dd_controller* dd = (struct dd_controller*)opaque;
     unsigned int cycles;
     const uint8_t* mem;
-    size_t i;
 
     DebugMessage(M64MSG_VERBOSE, "DD DMA write dram=%08x  cart=%08x length=%08x",
             dram_addr, cart_addr, length);
@@ -869,12 +856,9 @@ unsigned int dd_dom_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, u
         cycles = (length * 63) / 25;
     }
 
-    for (i = 0; i < length; ++i) {
-        dram[(dram_addr + i) ^ S8] = mem[(cart_addr + i) ^ S8];
-    }
+    dma_copy(dram, dram_addr, mem, cart_addr, length);
 
-    invalidate_r4300_cached_code(dd->r4300, R4300_KSEG0 + dram_addr, length);
-    invalidate_r4300_cached_code(dd->r4300, R4300_KSEG1 + dram_addr, length);
+    invalidate_r4300_cached_code_physical(dd->r4300, dram_addr, length, CODE_WRITE_PI);
 
     return cycles;
 }
@@ -96,12 +96,33 @@ void GenerateLBAToPhysTable(struct dd_disk* disk)
         return;
 
     const struct dd_sys_data* sys_data = (void*)(disk->istorage->data(disk->storage) + disk->offset_sys);
+    uint8_t disktype = sys_data->type & 0x0F;
+
+    for (uint32_t i = 0; i < PHYS_LBA_TABLE_SIZE; i++)
+    {
+        disk->phys_lba_table[i] = 0xFFFF;
+    }
+
+    disk->lba_byte_table[0] = 0;
     for (uint32_t lba = 0; lba < SIZE_LBA; lba++)
     {
-        disk->lba_phys_table[lba] = LBAToPhys(sys_data, lba);
+        uint16_t phys = LBAToPhys(sys_data, lba);
+        disk->lba_phys_table[lba] = phys;
+
+        /* keep the lowest LBA for a given location, like a linear search would */
+        if (phys < PHYS_LBA_TABLE_SIZE && disk->phys_lba_table[phys] == 0xFFFF)
+            disk->phys_lba_table[phys] = lba;
+
+        disk->lba_byte_table[lba + 1] = disk->lba_byte_table[lba] + LBAToByteA(disktype, lba, 1);
     }
 }
 
+/* Same as LBAToByte for lba + nlbas <= SIZE_LBA, using the precomputed table */
+static uint32_t LBAToByteDisk(const struct dd_disk* disk, uint32_t lba, uint32_t nlbas)
+{
+    return disk->lba_byte_table[lba + nlbas] - disk->lba_byte_table[lba];
+}
+
 uint32_t LBAToVZone(const struct dd_sys_data* sys_data, uint32_t lba)
 {
     return LBAToVZoneA(sys_data->type, lba);
@@ -224,27 +245,37 @@ uint32_t PhysToLBA(const struct dd_disk* disk, uint16_t head, uint16_t track, ui
 {
     uint16_t expectedvalue = track | (head * 0x1000) | (block * 0x2000);
 
-    for (uint16_t lba = 0; lba < SIZE_LBA; lba++)
-    {
-        if (disk->lba_phys_table[lba] == expectedvalue)
-        {
-            return lba;
-        }
-    }
-    return 0xFFFF;
+    return (expectedvalue < PHYS_LBA_TABLE_SIZE)
+        ? disk->phys_lba_table[expectedvalue]
+        : 0xFFFF;
 }
 
 
 
+/* zone of each head 0 track, tracks above the last zone start are in zone 7 */
+static uint8_t l_track_zone_table[0x425];
+static int l_track_zone_table_ready = 0;
+
 unsigned int get_zone_from_head_track(unsigned int head, unsigned int track)
 {
     unsigned int zone;
-    for (zone = 7; zone > 0; --zone) {
-        if (track >= TrackZoneTable[0][zone]) {
-            break;
+
+    if (!l_track_zone_table_ready) {
+        for (unsigned int t = 0; t < sizeof(l_track_zone_table); ++t) {
+            for (zone = 7; zone > 0; --zone) {
+                if (t >= TrackZoneTable[0][zone]) {
+                    break;
+                }
+            }
+            l_track_zone_table[t] = zone;
         }
+        l_track_zone_table_ready = 1;
     }
 
+    zone = (track < sizeof(l_track_zone_table))
+        ? l_track_zone_table[track]
+        : 7;
+
     return zone + head;
 }
 
@@ -314,8 +345,7 @@ static uint8_t* get_sector_base_sdk(const struct dd_disk* disk,
     unsigned int sector_size = (disk->development && head == 0 && track < 6)
         ? 0xC0
         : zone_sec_size_phys[get_zone_from_head_track(head, track)];
-    const struct dd_sys_data* sys_data = (void*)(disk->istorage->data(disk->storage) + disk->offset_sys);
-    unsigned int offset = LBAToByte(sys_data, 0, lba) + sector * sector_size;
+    unsigned int offset = LBAToByteDisk(disk, 0, lba) + sector * sector_size;
 
     /* Handle Errors for wrong System Data */
     if (sector == 0 && lba < SYSTEM_LBAS)
@@ -344,12 +374,17 @@ static uint8_t* get_sector_base_d64(const struct dd_disk* disk,
     uint16_t rom_lba_end = big16(sys_data->rom_lba_end);
     uint16_t ram_lba_start = big16(sys_data->ram_lba_start);
     uint16_t ram_lba_end = big16(sys_data->ram_lba_end);
-    uint8_t disk_type = sys_data->type & 0x0F;
     unsigned int sector_size = zone_sec_size_phys[get_zone_from_head_track(head, track)];
     uint16_t lba = PhysToLBA(disk, head, track, block);
     unsigned int offset = 0;
 
-    if (lba < DISKID_LBA)
+    if (lba > MAX_LBA)
+    {
+        //Invalid
+        DebugMessage(M64MSG_ERROR, "Invalid LBA (Head:%d - Track:%04x - Block:%d)", head, track, block);
+        return NULL;
+    }
+    else if (lba < DISKID_LBA)
     {
         //System Data
         offset = disk->offset_sys;
@@ -362,12 +397,12 @@ static uint8_t* get_sector_base_d64(const struct dd_disk* disk,
     else if (lba <= (rom_lba_end + SYSTEM_LBAS))
     {
         //ROM Area
-        offset = D64_OFFSET_DATA + LBAToByteA(disk_type, SYSTEM_LBAS, lba - SYSTEM_LBAS) + (sector * sector_size);
+        offset = D64_OFFSET_DATA + LBAToByteDisk(disk, SYSTEM_LBAS, lba - SYSTEM_LBAS) + (sector * sector_size);
     }
     else if (((lba - SYSTEM_LBAS) >= ram_lba_start) && ((lba - SYSTEM_LBAS) <= ram_lba_end))
     {
         //RAM Area
-        offset = disk->offset_ram + LBAToByteA(disk_type, ram_lba_start + SYSTEM_LBAS, lba - SYSTEM_LBAS - ram_lba_start) + (sector * sector_size);
+        offset = disk->offset_ram + LBAToByteDisk(disk, ram_lba_start + SYSTEM_LBAS, lba - SYSTEM_LBAS - ram_lba_start) + (sector * sector_size);
     }
     else
     {
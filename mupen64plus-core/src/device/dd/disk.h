@@ -133,6 +133,9 @@ static const uint16_t TrackZoneTable[2][8] = {
 #define DISKID_LBA          14
 #define PROTECT_LBA         12
 
+/* physical locations are track | (head * 0x1000) | (block * 0x2000) */
+#define PHYS_LBA_TABLE_SIZE 0x4000
+
 #define SECTORSIZE_SYS SECTORSIZE(0)
 #define SECTORSIZE_SYS_DEV SECTORSIZE(3)
 
@@ -147,6 +150,11 @@ struct dd_disk
     const struct storage_backend_interface* isave_storage;
 
     uint16_t lba_phys_table[0x10DC];
+
+    /* Flat address translation tables (SDK and D64 formats),
+     * see GenerateLBAToPhysTable */
+    uint16_t phys_lba_table[PHYS_LBA_TABLE_SIZE];   /* physical location -> LBA (0xFFFF if none) */
+    uint32_t lba_byte_table[SIZE_LBA + 1];          /* LBA -> byte offset from LBA 0 */
     uint8_t format;
     uint8_t development;
     uint8_t region;
@@ -50,7 +50,14 @@ static void get_pi_dma_handler(struct cart* cart, struct dd_controller* dd, uint
 {
 #define RW(o, x) \
     do { \
-    static const struct pi_dma_handler h = { x ## _dma_read, x ## _dma_write }; \
+    static const struct pi_dma_handler h = { x ## _dma_read, x ## _dma_write, NULL, NULL }; \
+    *opaque = (o); \
+    *handler = &h; \
+    } while(0)
+/* same as RW, but also allows deferred writes */
+#define RWD(o, x) \
+    do { \
+    static const struct pi_dma_handler h = { x ## _dma_read, x ## _dma_write, x ## _dma_write_cycles, x ## _dma_write_data }; \
     *opaque = (o); \
     *handler = &h; \
     } while(0)
@@ -62,7 +69,7 @@ static void get_pi_dma_handler(struct cart* cart, struct dd_controller* dd, uint
         }
         else {
             /* 0x10000000 - 0x1fbfffff : dom1 addr2, cart rom */
-            RW(&cart->cart_rom, cart_rom);
+            RWD(&cart->cart_rom, cart_rom);
         }
     }
     else if (address >= MM_DOM2_ADDR2) {
@@ -74,6 +81,7 @@ static void get_pi_dma_handler(struct cart* cart, struct dd_controller* dd, uint
         /* 0x06000000 - 0x07ffffff : dom1 addr1, dd rom */
         RW(dd, dd_dom);
     }
+#undef RWD
 #undef RW
 }
 
@@ -89,6 +97,8 @@ void init_device(struct device* dev,
     uint32_t start_address,
     /* ai */
     void* aout, const struct audio_out_backend_interface* iaout, float dma_modifier,
+    /* pi */
+    int lazy_pi_dma,
     /* si */
     unsigned int si_dma_duration,
     /* rdram */
@@ -190,7 +200,8 @@ void init_device(struct device* dev,
     init_pi(&dev->pi,
             get_pi_dma_handler,
             &dev->cart, &dev->dd,
-            &dev->mi, &dev->ri, &dev->dp);
+            &dev->mi, &dev->ri, &dev->dp,
+            &dev->mem, lazy_pi_dma);
     init_ri(&dev->ri, &dev->rdram);
     init_si(&dev->si, si_dma_duration, &dev->mi, &dev->pif, &dev->ri);
     init_vi(&dev->vi, vi_clock, expected_refresh_rate, &dev->mi, &dev->dp);
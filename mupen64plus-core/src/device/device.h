@@ -127,6 +127,8 @@ void init_device(struct device* dev,
     uint32_t start_address,
     /* ai */
     void* aout, const struct audio_out_backend_interface* iaout, float dma_modifier,
+    /* pi */
+    int lazy_pi_dma,
     /* si */
     unsigned int si_dma_duration,
     /* rdram */
@@ -37,6 +37,7 @@ void cv_imshow(const char* name, unsigned int width, unsigned int height, int ch
 #endif
 
 #include <assert.h>
+#include <limits.h>
 #include <string.h>
 
 
@@ -54,13 +55,13 @@ enum gbcart_extra_devices
 /* various helper functions for ram, rom, or MBC uses */
 
 
-static void read_rom(const void* rom_storage, const struct storage_backend_interface* irom_storage, uint16_t address, uint8_t* data, size_t size)
+static void read_rom(const void* rom_storage, const struct storage_backend_interface* irom_storage, size_t address, uint8_t* data, size_t size)
 {
     assert(size > 0);
 
     if (address + size > irom_storage->size(rom_storage))
     {
-        DebugMessage(M64MSG_WARNING, "Out of bound read from GB ROM %04x", address);
+        DebugMessage(M64MSG_WARNING, "Out of bound read from GB ROM %04zx", address);
         return;
     }
 
@@ -68,28 +69,28 @@ static void read_rom(const void* rom_storage, const struct storage_backend_inter
 }
 
 
-static void read_ram(const void* ram_storage, const struct storage_backend_interface* iram_storage, unsigned int enabled, uint16_t address, uint8_t* data, size_t size, uint8_t mask)
+static void read_ram(const void* ram_storage, const struct storage_backend_interface* iram_storage, unsigned int enabled, size_t address, uint8_t* data, size_t size, uint8_t mask)
 {
     size_t i;
     assert(size > 0);
 
     /* RAM has to be enabled before use */
     if (!enabled) {
-        DebugMessage(M64MSG_WARNING, "Trying to read from non enabled GB RAM %04x", address);
+        DebugMessage(M64MSG_WARNING, "Trying to read from non enabled GB RAM %04zx", address);
         memset(data, 0xff, size);
         return;
     }
 
     /* RAM must be present */
     if (iram_storage->data(ram_storage) == NULL) {
-        DebugMessage(M64MSG_WARNING, "Trying to read from absent GB RAM %04x", address);
+        DebugMessage(M64MSG_WARNING, "Trying to read from absent GB RAM %04zx", address);
         memset(data, 0xff, size);
         return;
     }
 
     if (address + size > iram_storage->size(ram_storage))
     {
-        DebugMessage(M64MSG_WARNING, "Out of bound read from GB RAM %04x", address);
+        DebugMessage(M64MSG_WARNING, "Out of bound read from GB RAM %04zx", address);
         return;
     }
 
@@ -102,7 +103,7 @@ static void read_ram(const void* ram_storage, const struct storage_backend_inter
     }
 }
 
-static void write_ram(void* ram_storage, const struct storage_backend_interface* iram_storage, unsigned int enabled, uint16_t address, const uint8_t* data, size_t size, uint8_t mask)
+static void write_ram(void* ram_storage, const struct storage_backend_interface* iram_storage, unsigned int enabled, size_t address, const uint8_t* data, size_t size, uint8_t mask)
 {
     size_t i;
     uint8_t* dst;
@@ -111,19 +112,19 @@ static void write_ram(void* ram_storage, const struct storage_backend_interface*
 
     /* RAM has to be enabled before use */
     if (!enabled) {
-        DebugMessage(M64MSG_WARNING, "Trying to write to non enabled GB RAM %04x", address);
+        DebugMessage(M64MSG_WARNING, "Trying to write to non enabled GB RAM %04zx", address);
         return;
     }
 
     /* RAM must be present */
     if (iram_storage->data(ram_storage) == NULL) {
-        DebugMessage(M64MSG_WARNING, "Trying to write to absent GB RAM %04x", address);
+        DebugMessage(M64MSG_WARNING, "Trying to write to absent GB RAM %04zx", address);
         return;
     }
 
     if (address + size > iram_storage->size(ram_storage))
     {
-        DebugMessage(M64MSG_WARNING, "Out of bound write to GB RAM %04x", address);
+        DebugMessage(M64MSG_WARNING, "Out of bound write to GB RAM %04zx", address);
         return;
     }
 
@@ -139,6 +140,115 @@ static void write_ram(void* ram_storage, const struct storage_backend_interface*
 }
 
 
+static void map_gb_cart_bank(struct gb_cart_bank* map, uint8_t* mem, size_t mem_size, unsigned int bank, size_t bank_size)
+{
+    size_t offset = (size_t)bank * bank_size;
+
+    map->bank = bank;
+
+    if (mem == NULL || offset >= mem_size) {
+        map->data = NULL;
+        map->size = 0;
+    }
+    else {
+        map->data = mem + offset;
+        map->size = (mem_size - offset < bank_size) ? mem_size - offset : bank_size;
+    }
+}
+
+static void reset_gb_cart_banks(struct gb_cart* gb_cart)
+{
+    /* force remapping on next access */
+    gb_cart->rom_map[0].bank = UINT_MAX;
+    gb_cart->rom_map[1].bank = UINT_MAX;
+    gb_cart->ram_map.bank = UINT_MAX;
+}
+
+static struct gb_cart_bank* get_ram_bank(struct gb_cart* gb_cart, unsigned int bank)
+{
+    struct gb_cart_bank* map = &gb_cart->ram_map;
+
+    if (map->bank != bank) {
+        if (gb_cart->iram_storage == NULL) {
+            map_gb_cart_bank(map, NULL, 0, bank, 0x2000);
+        }
+        else {
+            map_gb_cart_bank(map,
+                gb_cart->iram_storage->data(gb_cart->ram_storage),
+                gb_cart->iram_storage->size(gb_cart->ram_storage),
+                bank, 0x2000);
+        }
+    }
+
+    return map;
+}
+
+/* read from ROM bank mapped in the window of address (0x0000-0x7fff) */
+static void read_rom_bank(struct gb_cart* gb_cart, unsigned int bank, uint16_t address, uint8_t* data, size_t size)
+{
+    struct gb_cart_bank* map = &gb_cart->rom_map[(address >> 14) & 1];
+    size_t offset = address & 0x3fff;
+
+    if (map->bank != bank) {
+        map_gb_cart_bank(map,
+            gb_cart->irom_storage->data(gb_cart->rom_storage),
+            gb_cart->irom_storage->size(gb_cart->rom_storage),
+            bank, 0x4000);
+    }
+
+    if (offset + size <= map->size) {
+        memcpy(data, map->data + offset, size);
+        return;
+    }
+
+    read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (size_t)bank * 0x4000 + offset, data, size);
+}
+
+/* read from RAM bank mapped at 0xa000-0xbfff (offset is relative to 0xa000) */
+static void read_ram_bank(struct gb_cart* gb_cart, unsigned int enabled, unsigned int bank, uint16_t offset, uint8_t* data, size_t size, uint8_t mask)
+{
+    size_t i;
+    const struct gb_cart_bank* map = get_ram_bank(gb_cart, bank);
+
+    if (enabled && offset + size <= map->size) {
+        memcpy(data, map->data + offset, size);
+
+        if (mask != UINT8_C(0xff)) {
+            for (i = 0; i < size; ++i) {
+                data[i] &= mask;
+            }
+        }
+        return;
+    }
+
+    read_ram(gb_cart->ram_storage, gb_cart->iram_storage, enabled, (size_t)bank * 0x2000 + offset, data, size, mask);
+}
+
+/* write to RAM bank mapped at 0xa000-0xbfff (offset is relative to 0xa000) */
+static void write_ram_bank(struct gb_cart* gb_cart, unsigned int enabled, unsigned int bank, uint16_t offset, const uint8_t* data, size_t size, uint8_t mask)
+{
+    size_t i;
+    const struct gb_cart_bank* map = get_ram_bank(gb_cart, bank);
+    size_t address = (size_t)bank * 0x2000 + offset;
+
+    if (enabled && offset + size <= map->size) {
+        uint8_t* dst = map->data + offset;
+        memcpy(dst, data, size);
+
+        if (mask != UINT8_C(0xff)) {
+            for (i = 0; i < size; ++i) {
+                dst[i] &= mask;
+            }
+        }
+
+        gb_cart->iram_storage->save(gb_cart->ram_storage, address, size);
+        return;
+    }
+
+    write_ram(gb_cart->ram_storage, gb_cart->iram_storage, enabled, address, data, size, mask);
+}
+
+
 static void set_ram_enable(struct gb_cart* gb_cart, uint8_t value)
 {
     gb_cart->ram_enable = ((value & 0x0f) == 0x0a) ? 1 : 0;
@@ -157,12 +267,12 @@ static int read_gb_cart_nombc(struct gb_cart* gb_cart, uint16_t address, uint8_t
     case (0x2000 >> 13):
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        read_rom_bank(gb_cart, address >> 14, address, data, size);
         break;
 
     /* 0xa000-0xbfff: RAM */
     case (0xa000 >> 13):
-        read_ram(gb_cart->ram_storage, gb_cart->iram_storage, 1, address - 0xa000, data, size, UINT8_C(0xff));
+        read_ram_bank(gb_cart, 1, 0, address - 0xa000, data, size, UINT8_C(0xff));
         break;
 
     default:
@@ -186,7 +296,7 @@ static int write_gb_cart_nombc(struct gb_cart* gb_cart, uint16_t address, const
 
     /* 0xa000-0xbfff: RAM */
     case (0xa000 >> 13):
-        write_ram(gb_cart->ram_storage, gb_cart->iram_storage, 1, address - 0xa000, data, size, UINT8_C(0xff));
+        write_ram_bank(gb_cart, 1, 0, address - 0xa000, data, size, UINT8_C(0xff));
         break;
 
     default:
@@ -204,18 +314,18 @@ static int read_gb_cart_mbc1(struct gb_cart* gb_cart, uint16_t address, uint8_t*
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        read_rom_bank(gb_cart, 0, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 01-7f */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        read_rom_bank(gb_cart, gb_cart->rom_bank, address, data, size);
         break;
 
     /* 0xa000-0xbfff: RAM bank 00-03 */
     case (0xa000 >> 13):
-        read_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+        read_ram_bank(gb_cart, gb_cart->ram_enable, gb_cart->ram_bank, address - 0xa000, data, size, UINT8_C(0xff));
         break;
 
     default:
@@ -272,7 +382,7 @@ static int write_gb_cart_mbc1(struct gb_cart* gb_cart, uint16_t address, const u
 
     /* 0xa000-0xbfff: RAM bank 00-03 */
     case (0xa000 >> 13):
-        write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+        write_ram_bank(gb_cart, gb_cart->ram_enable, gb_cart->ram_bank, address - 0xa000, data, size, UINT8_C(0xff));
         break;
 
     default:
@@ -289,18 +399,18 @@ static int read_gb_cart_mbc2(struct gb_cart* gb_cart, uint16_t address, uint8_t*
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        read_rom_bank(gb_cart, 0, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 01-0f */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        read_rom_bank(gb_cart, gb_cart->rom_bank, address, data, size);
         break;
 
     /* 0xa000-0xa1ff: internal 512x4bit RAM */
     case (0xa000 >> 13):
-        read_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000), data, size, UINT8_C(0x0f));
+        read_ram_bank(gb_cart, gb_cart->ram_enable, 0, address - 0xa000, data, size, UINT8_C(0x0f));
         break;
 
     default:
@@ -335,7 +445,7 @@ static int write_gb_cart_mbc2(struct gb_cart* gb_cart, uint16_t address, const u
 
     /* 0xa000-0xa1ff: internal 512x4bit RAM */
     case (0xa000 >> 13):
-        write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000), data, size, UINT8_C(0x0f));
+        write_ram_bank(gb_cart, gb_cart->ram_enable, 0, address - 0xa000, data, size, UINT8_C(0x0f));
         break;
 
     default:
@@ -353,13 +463,13 @@ static int read_gb_cart_mbc3(struct gb_cart* gb_cart, uint16_t address, uint8_t*
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        read_rom_bank(gb_cart, 0, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 01-7f */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        read_rom_bank(gb_cart, gb_cart->rom_bank, address, data, size);
         break;
 
     /* 0xa000-0xbfff: RAM bank 00-07 or RTC register 08-0c */
@@ -375,7 +485,7 @@ static int read_gb_cart_mbc3(struct gb_cart* gb_cart, uint16_t address, uint8_t*
         case 0x05:
         case 0x06:
         case 0x07:
-            read_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+            read_ram_bank(gb_cart, gb_cart->ram_enable, gb_cart->ram_bank, address - 0xa000, data, size, UINT8_C(0xff));
             break;
 
         /* RTC registers */
@@ -460,7 +570,7 @@ static int write_gb_cart_mbc3(struct gb_cart* gb_cart, uint16_t address, const u
         case 0x05:
         case 0x06:
         case 0x07:
-            write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+            write_ram_bank(gb_cart, gb_cart->ram_enable, gb_cart->ram_bank, address - 0xa000, data, size, UINT8_C(0xff));
             break;
 
         /* RTC registers */
@@ -502,18 +612,18 @@ static int read_gb_cart_mbc5(struct gb_cart* gb_cart, uint16_t address, uint8_t*
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        read_rom_bank(gb_cart, 0, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 00-ff (???) */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        read_rom_bank(gb_cart, gb_cart->rom_bank, address, data, size);
         break;
 
     /* 0xa000-0xbfff: RAM bank 00-07 */
     case (0xa000 >> 13):
-        read_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + ((gb_cart->ram_bank & 0x7) * 0x2000), data, size, UINT8_C(0xff));
+        read_ram_bank(gb_cart, gb_cart->ram_enable, gb_cart->ram_bank & 0x7, address - 0xa000, data, size, UINT8_C(0xff));
         break;
 
     default:
@@ -560,7 +670,7 @@ static int write_gb_cart_mbc5(struct gb_cart* gb_cart, uint16_t address, const u
 
     /* 0xa000-0xbfff: RAM bank 00-0f */
     case (0xa000 >> 13):
-        write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + ((gb_cart->ram_bank & 0x07)* 0x2000), data, size, UINT8_C(0xff));
+        write_ram_bank(gb_cart, gb_cart->ram_enable, gb_cart->ram_bank & 0x07, address - 0xa000, data, size, UINT8_C(0xff));
         break;
 
     default:
@@ -760,13 +870,13 @@ static int read_gb_cart_pocket_cam(struct gb_cart* gb_cart, uint16_t address, ui
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        read_rom_bank(gb_cart, 0, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 00-3f */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        read_rom_bank(gb_cart, gb_cart->rom_bank, address, data, size);
         break;
 
     /* 0xa000-0xbfff: RAM bank 00-0f, Camera registers & 0x10 */
@@ -778,7 +888,7 @@ static int read_gb_cart_pocket_cam(struct gb_cart* gb_cart, uint16_t address, ui
             }
         }
         else {
-            read_ram(gb_cart->ram_storage, gb_cart->iram_storage, 1, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+            read_ram_bank(gb_cart, 1, gb_cart->ram_bank, address - 0xa000, data, size, UINT8_C(0xff));
         }
         break;
 
@@ -827,7 +937,7 @@ static int write_gb_cart_pocket_cam(struct gb_cart* gb_cart, uint16_t address, c
             }
         }
         else {
-            write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+            write_ram_bank(gb_cart, gb_cart->ram_enable, gb_cart->ram_bank, address - 0xa000, data, size, UINT8_C(0xff));
         }
         break;
 
@@ -1077,6 +1187,8 @@ void init_gb_cart(struct gb_cart* gb_cart,
     gb_cart->read_gb_cart = type->read_gb_cart;
     gb_cart->write_gb_cart = type->write_gb_cart;
 
+    reset_gb_cart_banks(gb_cart);
+
     return;
 
 error_release_ram:
@@ -1094,6 +1206,8 @@ void poweron_gb_cart(struct gb_cart* gb_cart)
     gb_cart->ram_enable = 0;
     gb_cart->mbc1_mode = 0;
 
+    reset_gb_cart_banks(gb_cart);
+
     if (gb_cart->extra_devices & GED_RTC) {
         poweron_mbc3_rtc(&gb_cart->rtc);
     }
@@ -48,6 +48,14 @@ struct pocket_cam
     uint8_t* ram;
 };
 
+/* Cached host pointer to a mapped ROM or RAM bank */
+struct gb_cart_bank
+{
+    uint8_t* data;      /* NULL if the bank is outside of the storage */
+    size_t size;        /* bytes accessible from data */
+    unsigned int bank;  /* bank this mapping was computed for */
+};
+
 struct gb_cart
 {
     void* rom_storage;
@@ -59,6 +67,11 @@ struct gb_cart
     unsigned int rom_bank;
     unsigned int ram_bank;
 
+    /* ROM windows 0x0000-0x3fff and 0x4000-0x7fff, and RAM window 0xa000-0xbfff.
+     * They are remapped whenever the selected bank differs from the cached one. */
+    struct gb_cart_bank rom_map[2];
+    struct gb_cart_bank ram_map;
+
     unsigned int ram_enable;
     unsigned int mbc1_mode;
 
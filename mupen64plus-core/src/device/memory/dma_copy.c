@@ -0,0 +1,185 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - dma_copy.c                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "dma_copy.h"
+
+#include <string.h>
+
+#include "osal/preproc.h"
+
+#if defined(OSAL_SSE) && defined(__SSE2__)
+#include <emmintrin.h>
+#define DMA_COPY_SSE2
+#endif
+
+static osal_inline uint32_t load32(const uint8_t* p)
+{
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+static osal_inline void store32(uint8_t* p, uint32_t w)
+{
+    memcpy(p, &w, sizeof(w));
+}
+
+void dma_copy(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length)
+{
+#if S8 == 0
+    memcpy(dst + dst_addr, src + src_addr, length);
+#else
+    size_t i = 0;
+
+    /* bytes up to the first destination word boundary */
+    for (; i < length && ((dst_addr + i) & 3) != 0; ++i) {
+        dst[(dst_addr + i) ^ S8] = src[(src_addr + i) ^ S8];
+    }
+
+    if (((dst_addr ^ src_addr) & 3) == 0) {
+        /* same alignment on both sides: whole words have identical layouts */
+        size_t n = (length - i) & ~(size_t)3;
+        memcpy(dst + dst_addr + i, src + src_addr + i, n);
+        i += n;
+    }
+    else {
+        /* host words hold the bytes in big-endian numeric order,
+         * so realigning the source is a funnel shift of two words */
+        unsigned int lshift = ((src_addr + i) & 3) * 8;
+        unsigned int rshift = 32 - lshift;
+        const uint8_t* s = src + ((src_addr + i) & ~UINT32_C(3));
+        uint32_t w0 = load32(s);
+
+        for (; i + 4 <= length; i += 4) {
+            uint32_t w1 = load32(s += 4);
+            store32(dst + dst_addr + i, (w0 << lshift) | (w1 >> rshift));
+            w0 = w1;
+        }
+    }
+
+    for (; i < length; ++i) {
+        dst[(dst_addr + i) ^ S8] = src[(src_addr + i) ^ S8];
+    }
+#endif
+}
+
+void dma_copy_wrap(uint8_t* dst, uint32_t dst_addr, uint32_t dst_mask,
+                   const uint8_t* src, uint32_t src_addr, uint32_t src_mask,
+                   size_t length)
+{
+    while (length > 0) {
+        size_t n = length;
+        size_t dst_left = (size_t)dst_mask + 1 - (dst_addr & dst_mask);
+        size_t src_left = (size_t)src_mask + 1 - (src_addr & src_mask);
+
+        if (n > dst_left) { n = dst_left; }
+        if (n > src_left) { n = src_left; }
+
+        dma_copy(dst, dst_addr & dst_mask, src, src_addr & src_mask, n);
+
+        dst_addr += (uint32_t)n;
+        src_addr += (uint32_t)n;
+        length -= n;
+    }
+}
+
+void dma_copy_to_bytes(uint8_t* dst, const uint8_t* src, uint32_t src_addr, size_t length)
+{
+#if S8 == 0
+    memcpy(dst, src + src_addr, length);
+#else
+    size_t i = 0;
+
+    for (; i < length && ((src_addr + i) & 3) != 0; ++i) {
+        dst[i] = src[(src_addr + i) ^ S8];
+    }
+
+    for (; i + 4 <= length; i += 4) {
+        store32(dst + i, tohl(load32(src + src_addr + i)));
+    }
+
+    for (; i < length; ++i) {
+        dst[i] = src[(src_addr + i) ^ S8];
+    }
+#endif
+}
+
+void dma_copy_from_bytes(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, size_t length)
+{
+#if S8 == 0
+    memcpy(dst + dst_addr, src, length);
+#else
+    size_t i = 0;
+
+    for (; i < length && ((dst_addr + i) & 3) != 0; ++i) {
+        dst[(dst_addr + i) ^ S8] = src[i];
+    }
+
+    for (; i + 4 <= length; i += 4) {
+        store32(dst + dst_addr + i, tohl(load32(src + i)));
+    }
+
+    for (; i < length; ++i) {
+        dst[(dst_addr + i) ^ S8] = src[i];
+    }
+#endif
+}
+
+void dma_zero(uint8_t* dst, uint32_t dst_addr, size_t length)
+{
+    size_t i = 0;
+
+    for (; i < length && ((dst_addr + i) & 3) != 0; ++i) {
+        dst[(dst_addr + i) ^ S8] = 0;
+    }
+
+    size_t n = (length - i) & ~(size_t)3;
+    memset(dst + dst_addr + i, 0, n);
+    i += n;
+
+    for (; i < length; ++i) {
+        dst[(dst_addr + i) ^ S8] = 0;
+    }
+}
+
+void dma_copy_swap32(uint32_t* dst, const uint32_t* src, size_t count)
+{
+#if S8 == 0
+    memcpy(dst, src, count * sizeof(uint32_t));
+#else
+    size_t i = 0;
+
+#ifdef DMA_COPY_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        /* swap bytes inside 16-bit lanes, then the 16-bit halves of each word */
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        dst[i] = tohl(src[i]);
+    }
+#endif
+}
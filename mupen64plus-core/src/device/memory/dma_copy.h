@@ -0,0 +1,58 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - dma_copy.h                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_DEVICE_MEMORY_DMA_COPY_H
+#define M64P_DEVICE_MEMORY_DMA_COPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bulk copy helpers for DMA transfers between emulated memories.
+ *
+ * All emulated memories (RDRAM, SP mem, cart ROM, save memories, ...) store
+ * bytes within 32-bit words in host order, so that the byte at address a lives
+ * at offset a ^ S8. These helpers are equivalent to the byte loops
+ *
+ *   for (i = 0; i < length; ++i)
+ *       dst[(dst_addr + i) ^ S8] = src[(src_addr + i) ^ S8];
+ *
+ * but move whole words whenever possible.
+ */
+
+void dma_copy(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length);
+
+/* Same as dma_copy, but addresses wrap around inside each memory
+ * (dst_mask + 1 and src_mask + 1 must be powers of two, at least 4) */
+void dma_copy_wrap(uint8_t* dst, uint32_t dst_addr, uint32_t dst_mask,
+                   const uint8_t* src, uint32_t src_addr, uint32_t src_mask,
+                   size_t length);
+
+/* Copy between a word-swizzled memory and a plain byte buffer */
+void dma_copy_to_bytes(uint8_t* dst, const uint8_t* src, uint32_t src_addr, size_t length);
+void dma_copy_from_bytes(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, size_t length);
+
+/* Fill length bytes starting at dst_addr with zeros */
+void dma_zero(uint8_t* dst, uint32_t dst_addr, size_t length);
+
+/* Copy count 32-bit words, swapping their byte order on little-endian hosts */
+void dma_copy_swap32(uint32_t* dst, const uint32_t* src, size_t count);
+
+#endif
@@ -62,7 +62,37 @@ void print_pif(struct pif* pif)
 }
 #endif
 
-static void process_channel(struct pif_channel* channel)
+static enum pif_joybus_stats joybus_stats_class(uint8_t cmd)
+{
+    switch (cmd)
+    {
+    case JCMD_STATUS:
+    case JCMD_RESET:
+        return PIF_JSTATS_STATUS;
+    case JCMD_CONTROLLER_READ:
+        return PIF_JSTATS_CONTROLLER;
+    case JCMD_PAK_READ:
+    case JCMD_PAK_WRITE:
+        return PIF_JSTATS_PAK;
+    case JCMD_EEPROM_READ:
+    case JCMD_EEPROM_WRITE:
+        return PIF_JSTATS_EEPROM;
+    case JCMD_AF_RTC_STATUS:
+    case JCMD_AF_RTC_READ:
+    case JCMD_AF_RTC_WRITE:
+        return PIF_JSTATS_AF_RTC;
+    case JCMD_VRU_READ:
+    case JCMD_VRU_WRITE:
+    case JCMD_VRU_READ_STATUS:
+    case JCMD_VRU_WRITE_CONFIG:
+    case JCMD_VRU_WRITE_INIT:
+        return PIF_JSTATS_VRU;
+    default:
+        return PIF_JSTATS_OTHER;
+    }
+}
+
+static void process_channel(struct pif* pif, struct pif_channel* channel)
 {
     /* don't process channel if it has been disabled */
     if (channel->tx == NULL) {
@@ -76,9 +106,12 @@ static void process_channel(struct pif_channel* channel)
     /* set NoResponse if no device is connected */
     if (channel->ijbd == NULL) {
         *channel->rx |= 0x80;
+        ++pif->joybus_stats[PIF_JSTATS_NO_DEVICE];
         return;
     }
 
+    ++pif->joybus_stats[(*channel->tx != 0) ? joybus_stats_class(channel->tx_buf[0]) : PIF_JSTATS_OTHER];
+
     /* do device processing */
     channel->ijbd->process(channel->jbd,
         channel->tx, channel->tx_buf,
@@ -176,14 +209,81 @@ void reset_pif(struct pif* pif, unsigned int reset_type)
     pif->ram[0x3f] = 0x00;
 }
 
+static void setup_pif_reset_channel(struct pif_channel* channel, size_t k)
+{
+    static uint8_t dummy_reset_buffer[PIF_CHANNELS_COUNT][6];
+
+    /* setup reset command Tx=1, Rx=3, cmd=0xff */
+    dummy_reset_buffer[k][0] = 0x01;
+    dummy_reset_buffer[k][1] = 0x03;
+    dummy_reset_buffer[k][2] = 0xff;
+
+    setup_pif_channel(channel, dummy_reset_buffer[k]);
+}
+
+static int match_format_cache(const struct pif* pif)
+{
+    const struct pif_format_cache* cache = &pif->format_cache;
+    size_t i;
+
+    if (!cache->valid) {
+        return 0;
+    }
+
+    for (i = 0; i < PIF_RAM_SIZE; ++i) {
+        if ((pif->ram[i] & cache->mask[i]) != cache->ram[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* same as parsing the PIF RAM again, but using the cached channel layout */
+static void setup_channels_from_cache(struct pif* pif)
+{
+    const struct pif_format_cache* cache = &pif->format_cache;
+    size_t k;
+
+    for (k = 0; k < PIF_CHANNELS_COUNT; ++k) {
+        switch (cache->offsets[k])
+        {
+        case PIF_CHANNEL_DISABLED:
+            disable_pif_channel(&pif->channels[k]);
+            break;
+
+        case PIF_CHANNEL_RESET:
+            setup_pif_reset_channel(&pif->channels[k], k);
+            break;
+
+        default:
+            setup_pif_channel(&pif->channels[k], &pif->ram[cache->offsets[k]]);
+        }
+    }
+}
+
 void setup_channels_format(struct pif* pif)
 {
+    struct pif_format_cache* cache = &pif->format_cache;
     size_t i = 0;
     size_t k = 0;
 
+    if (match_format_cache(pif)) {
+        setup_channels_from_cache(pif);
+        ++pif->format_cache_hits;
+        goto done;
+    }
+
+    ++pif->format_cache_misses;
+
+    /* record examined bytes and resulting layout while parsing */
+#define EXAMINE(n) (cache->mask[(n)] = 0xff, pif->ram[(n)])
+    memset(cache->mask, 0, PIF_RAM_SIZE);
+    memset(cache->offsets, PIF_CHANNEL_DISABLED, PIF_CHANNELS_COUNT);
+
     while (i < PIF_RAM_SIZE && k < PIF_CHANNELS_COUNT)
     {
-        switch(pif->ram[i])
+        switch(EXAMINE(i))
         {
         case 0x00: /* skip channel */
             disable_pif_channel(&pif->channels[k++]);
@@ -200,18 +300,11 @@ void setup_channels_format(struct pif* pif)
             }
             break;
 
-        case 0xfd: /* channel reset - send reset command and discard the results */ {
-            static uint8_t dummy_reset_buffer[PIF_CHANNELS_COUNT][6];
-
-            /* setup reset command Tx=1, Rx=3, cmd=0xff */
-            dummy_reset_buffer[k][0] = 0x01;
-            dummy_reset_buffer[k][1] = 0x03;
-            dummy_reset_buffer[k][2] = 0xff;
-
-            setup_pif_channel(&pif->channels[k], dummy_reset_buffer[k]);
+        case 0xfd: /* channel reset - send reset command and discard the results */
+            cache->offsets[k] = PIF_CHANNEL_RESET;
+            setup_pif_reset_channel(&pif->channels[k], k);
             ++k;
             ++i;
-            }
             break;
 
         default: /* setup channel */
@@ -220,7 +313,7 @@ void setup_channels_format(struct pif* pif)
              * Yoshi Story, Top Gear Rally 2, Indiana Jones, ...
              * When encountering such commands, we skip this bogus byte.
              */
-            if ((i+1 < PIF_RAM_SIZE) && (pif->ram[i+1] == 0xfe)) {
+            if ((i+1 < PIF_RAM_SIZE) && (EXAMINE(i+1) == 0xfe)) {
                 ++i;
                 continue;
             }
@@ -231,11 +324,20 @@ void setup_channels_format(struct pif* pif)
                 continue;
             }
 
-
+            /* Rx size */
+            cache->mask[i+1] = 0xff;
+            cache->offsets[k] = (int8_t)i;
             i += setup_pif_channel(&pif->channels[k++], &pif->ram[i]);
         }
     }
+#undef EXAMINE
 
+    for (i = 0; i < PIF_RAM_SIZE; ++i) {
+        cache->ram[i] = pif->ram[i] & cache->mask[i];
+    }
+    cache->valid = 1;
+
+done:
     /* Zilmar-Spec plugin expect a call with control_id = -1 when RAM processing is done */
     if (input.controllerCommand) {
         input.controllerCommand(-1, NULL);
@@ -280,6 +382,11 @@ void poweron_pif(struct pif* pif)
 {
     memset(pif->ram, 0, PIF_RAM_SIZE);
 
+    memset(&pif->format_cache, 0, sizeof(pif->format_cache));
+    pif->format_cache_hits = 0;
+    pif->format_cache_misses = 0;
+    memset(pif->joybus_stats, 0, sizeof(pif->joybus_stats));
+
     reset_pif(pif, 0); /* cold reset */
 }
 
@@ -373,7 +480,7 @@ void update_pif_ram(struct pif* pif)
 
     /* perform PIF/Channel communications */
     for (k = 0; k < PIF_CHANNELS_COUNT; ++k) {
-        process_channel(&pif->channels[k]);
+        process_channel(pif, &pif->channels[k]);
     }
 
     /* Zilmar-Spec plugin expect a call with control_id = -1 when RAM processing is done */
@@ -396,3 +503,18 @@ void hw2_int_handler(void* opaque)
     raise_maskable_interrupt(pif->r4300, CP0_CAUSE_IP4);
 }
 
+void print_pif_stats(const struct pif* pif)
+{
+    static const char* const names[PIF_JSTATS_COUNT] = {
+        "status/reset", "controller read", "pak", "eeprom", "rtc", "vru", "other", "no device"
+    };
+    size_t i;
+
+    DebugMessage(M64MSG_VERBOSE, "PIF channel setup: %" PRIu64 " reused, %" PRIu64 " parsed",
+        pif->format_cache_hits, pif->format_cache_misses);
+
+    for (i = 0; i < PIF_JSTATS_COUNT; ++i) {
+        DebugMessage(M64MSG_VERBOSE, "Joybus %s transactions: %" PRIu64, names[i], pif->joybus_stats[i]);
+    }
+}
+
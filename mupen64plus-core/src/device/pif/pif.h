@@ -51,12 +51,48 @@ struct pif_channel
 void disable_pif_channel(struct pif_channel* channel);
 size_t setup_pif_channel(struct pif_channel* channel, uint8_t* buf);
 
+/* Channel layout found by the last setup_channels_format.
+ * The layout only depends on the PIF RAM bytes examined while parsing,
+ * so it can be reused as long as these bytes are unchanged. */
+enum
+{
+    PIF_CHANNEL_DISABLED = -1,
+    PIF_CHANNEL_RESET    = -2
+};
+
+struct pif_format_cache
+{
+    int valid;
+    uint8_t mask[PIF_RAM_SIZE];     /* 0xff for examined bytes, 0x00 otherwise */
+    uint8_t ram[PIF_RAM_SIZE];      /* examined bytes (others are zeroed) */
+    int8_t offsets[PIF_CHANNELS_COUNT]; /* channel offset in PIF RAM or one of the above */
+};
+
+/* Joybus transactions counters, by class of command */
+enum pif_joybus_stats
+{
+    PIF_JSTATS_STATUS,
+    PIF_JSTATS_CONTROLLER,
+    PIF_JSTATS_PAK,
+    PIF_JSTATS_EEPROM,
+    PIF_JSTATS_AF_RTC,
+    PIF_JSTATS_VRU,
+    PIF_JSTATS_OTHER,
+    PIF_JSTATS_NO_DEVICE,
+    PIF_JSTATS_COUNT
+};
+
 struct pif
 {
     uint8_t* base;
     uint8_t* ram;
     struct pif_channel channels[PIF_CHANNELS_COUNT];
 
+    struct pif_format_cache format_cache;
+    uint64_t format_cache_hits;
+    uint64_t format_cache_misses;
+    uint64_t joybus_stats[PIF_JSTATS_COUNT];
+
     struct cic cic;
 
     struct r4300_core* r4300;
@@ -91,5 +127,7 @@ void update_pif_ram(struct pif* pif);
 
 void hw2_int_handler(void* opaque);
 
+void print_pif_stats(const struct pif* pif);
+
 #endif
 
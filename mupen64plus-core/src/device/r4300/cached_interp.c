@@ -34,6 +34,9 @@
 #include "api/m64p_types.h"
 #include "device/r4300/r4300_core.h"
 #include "device/r4300/idec.h"
+#include "device/r4300/idle_loop.h"
+#include "device/r4300/op_cost.h"
+#include "device/rdram/rdram.h"
 #include "main/main.h"
 #include "osal/preproc.h"
 
@@ -146,6 +149,8 @@ void cached_interp_##name##_IDLE(void) \
         if(*cp0_cycle_count < 0) \
         { \
             cp0_regs[CP0_COUNT_REG] -= *cp0_cycle_count; \
+            r4300->cached_interp.idle_loop_stats.pending_cycles -= *cp0_cycle_count; \
+            ++r4300->cached_interp.idle_loop_stats.pending_skips; \
             *cp0_cycle_count = 0; \
         } \
     } \
@@ -231,6 +236,8 @@ Used by dynarec only, check should be unnecessary
 void cached_interp_NOTCOMPILED(void)
 {
     DECLARE_R4300
+    /* the whole block is read behind the memory handlers' back */
+    rdram_flush_pending_dma(r4300->rdram);
     uint32_t *mem = fast_mem_access(r4300, r4300->cached_interp.blocks[*r4300_pc(r4300)>>12]->start);
 #ifdef DBG
     DebugMessage(M64MSG_INFO, "NOTCOMPILED: addr = %x ops = %lx", *r4300_pc(r4300), (long) (*r4300_pc_struct(r4300))->ops);
@@ -341,26 +348,26 @@ static void (*const ci_table[R4300_OPCODES_COUNT])(void) =
 #undef X
 
 /* return 0:normal, 1:idle, 2:out */
-static int infer_jump_sub_type(uint32_t target, uint32_t pc, uint32_t next_iw, const struct precomp_block* block)
+static int infer_jump_sub_type(struct r4300_core* r4300, uint32_t target, uint32_t pc, const uint32_t* block_iw, const struct precomp_block* block)
 {
-    /* test if jumping to same location with empty delay slot */
-    if (target == pc) {
-        if (next_iw == 0) {
-            return 1;
-        }
+    /* test if target is outside of block, or if we're at the end of block */
+    if (target != pc
+    && (target < block->start || target >= block->end || (pc == (block->end - 4)))) {
+        return 2;
     }
-    else {
-        /* test if target is outside of block, or if we're at the end of block */
-        if (target < block->start || target >= block->end || (pc == (block->end - 4))) {
-            return 2;
-        }
+
+    /* test if jumping backward to an idle loop */
+    if (block_iw != NULL && target <= pc
+    && r4300_idle_loop(block_iw + ((target - block->start) >> 2), ((pc - target) >> 2) + 2)) {
+        ++r4300->cached_interp.idle_loop_stats.loops;
+        return 1;
     }
 
     /* regular jump */
     return 0;
 }
 
-enum r4300_opcode r4300_decode(struct precomp_instr* inst, struct r4300_core* r4300, const struct r4300_idec* idec, uint32_t iw, uint32_t next_iw, const struct precomp_block* block)
+enum r4300_opcode r4300_decode(struct precomp_instr* inst, struct r4300_core* r4300, const struct r4300_idec* idec, uint32_t iw, const uint32_t* block_iw, const struct precomp_block* block)
 {
     /* assume instr->addr is already setup */
     uint8_t dummy;
@@ -393,7 +400,7 @@ enum r4300_opcode r4300_decode(struct precomp_instr* inst, struct r4300_core* r4
     case R4300_OP_JAL:
         inst->f.j.inst_index  = (iw & UINT32_C(0x3ffffff));
         /* select normal, idle or out jump type */
-        opcode += infer_jump_sub_type((inst->addr & ~0xfffffff) | (idec_imm(iw, idec) & 0xfffffff), inst->addr, next_iw, block);
+        opcode += infer_jump_sub_type(r4300, (inst->addr & ~0xfffffff) | (idec_imm(iw, idec) & 0xfffffff), inst->addr, block_iw, block);
         break;
 
     case R4300_OP_BC0F:
@@ -429,7 +436,7 @@ enum r4300_opcode r4300_decode(struct precomp_instr* inst, struct r4300_core* r4
         inst->f.i.immediate  = (int16_t)iw;
 
         /* select normal, idle or out branch type */
-        opcode += infer_jump_sub_type(inst->addr + inst->f.i.immediate*4 + 4, inst->addr, next_iw, block);
+        opcode += infer_jump_sub_type(r4300, inst->addr + inst->f.i.immediate*4 + 4, inst->addr, block_iw, block);
         break;
 
     case R4300_OP_ADD:
@@ -764,6 +771,8 @@ void cached_interp_init_block(struct r4300_core* r4300, uint32_t address)
     struct precomp_block* b = *block;
 
     length = get_block_length(b);
+    b->cost = 0;
+    b->ops = 0;
 
 #ifdef DBG
     DebugMessage(M64MSG_INFO, "init block %" PRIX32 " - %" PRIX32, b->start, b->end);
@@ -793,6 +802,7 @@ void cached_interp_init_block(struct r4300_core* r4300, uint32_t address)
      * yet as the game should have already set up the code correctly.
      */
     r4300->cached_interp.invalid_code[b->start>>12] = 0;
+    mark_code_page(&r4300->cached_interp, b->start>>12);
 
 
     if (b->end < UINT32_C(0x80000000) || b->start >= UINT32_C(0xc0000000))
@@ -800,11 +810,13 @@ void cached_interp_init_block(struct r4300_core* r4300, uint32_t address)
         uint32_t paddr = virtual_to_physical_address(r4300, b->start, 2);
 
         r4300->cached_interp.invalid_code[paddr>>12] = 0;
+        mark_code_page(&r4300->cached_interp, paddr>>12);
         cached_interp_init_block(r4300, paddr);
 
         paddr += b->end - b->start - 4;
 
         r4300->cached_interp.invalid_code[paddr>>12] = 0;
+        mark_code_page(&r4300->cached_interp, paddr>>12);
         cached_interp_init_block(r4300, paddr);
     }
     else
@@ -859,7 +871,9 @@ void cached_interp_recompile_block(struct r4300_core* r4300, const uint32_t* iw,
         }
 
         /* decode instruction */
-        opcode = r4300_decode(inst, r4300, r4300_get_idec(iw[i]), iw[i], iw[i+1], block);
+        opcode = r4300_decode(inst, r4300, r4300_get_idec(iw[i]), iw[i], iw, block);
+        block->cost += r4300_op_cost(opcode, iw[i]);
+        ++block->ops;
 
         /* decode ending conditions */
         if (i >= length2) { finished = 2; }
@@ -927,6 +941,10 @@ void init_blocks(struct cached_interp* cinterp)
         cinterp->invalid_code[i] = 1;
         cinterp->blocks[i] = NULL;
     }
+
+    memset(cinterp->code_pages, 0, sizeof(cinterp->code_pages));
+    memset(cinterp->code_write_stats, 0, sizeof(cinterp->code_write_stats));
+    memset(&cinterp->idle_loop_stats, 0, sizeof(cinterp->idle_loop_stats));
 }
 
 void free_blocks(struct cached_interp* cinterp)
@@ -953,6 +971,7 @@ void invalidate_cached_code_hacktarux(struct r4300_core* r4300, uint32_t address
     {
         /* invalidate everthing */
         memset(r4300->cached_interp.invalid_code, 1, 0x100000);
+        memset(r4300->cached_interp.code_pages, 0, sizeof(r4300->cached_interp.code_pages));
     }
     else
     {
@@ -33,7 +33,9 @@ struct r4300_idec;
 struct precomp_block;
 struct precomp_instr;
 
-enum r4300_opcode r4300_decode(struct precomp_instr* inst, struct r4300_core* r4300, const struct r4300_idec* idec, uint32_t iw, uint32_t next_iw, const struct precomp_block* block);
+/* block_iw holds the instruction words of block (block_iw[0] is at block->start),
+ * or is NULL to disable idle loop detection (eg in delay slots) */
+enum r4300_opcode r4300_decode(struct precomp_instr* inst, struct r4300_core* r4300, const struct r4300_idec* idec, uint32_t iw, const uint32_t* block_iw, const struct precomp_block* block);
 
 int get_block_length(const struct precomp_block *block);
 size_t get_block_memsize(const struct precomp_block *block);
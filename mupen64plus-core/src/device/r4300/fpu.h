@@ -25,6 +25,8 @@
 #include <math.h>
 #include <stdint.h>
 
+#include "osal/preproc.h"
+
 #ifdef _MSC_VER
 #define M64P_FPU_INLINE static __inline
 #include <float.h>
@@ -66,24 +68,53 @@ static __inline float  truncf(float x) { return (float)(int)x; }
 #define FCR31_FLAG_DIVBYZERO_BIT UINT32_C(0x000020)
 #define FCR31_FLAG_INVALIDOP_BIT UINT32_C(0x000040)
 
+#if defined(OSAL_SSE) && (defined(__SSE2_MATH__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+/* floating point code is compiled to SSE, only MXCSR rounding matters */
+#define M64P_FPU_SSE_MATH
+#endif
 
-M64P_FPU_INLINE void set_rounding(uint32_t fcr31)
+M64P_FPU_INLINE int host_rounding(uint32_t fcr31)
 {
     switch(fcr31 & 3) {
     case 0: /* Round to nearest, or to even if equidistant */
-        fesetround(FE_TONEAREST);
-        break;
+        return FE_TONEAREST;
     case 1: /* Truncate (toward 0) */
-        fesetround(FE_TOWARDZERO);
-        break;
+        return FE_TOWARDZERO;
     case 2: /* Round up (toward +Inf) */
-        fesetround(FE_UPWARD);
-        break;
-    case 3: /* Round down (toward -Inf) */
-        fesetround(FE_DOWNWARD);
-        break;
+        return FE_UPWARD;
+    default: /* Round down (toward -Inf) */
+        return FE_DOWNWARD;
+    }
+}
+
+#ifdef M64P_FPU_SSE_MATH
+M64P_FPU_INLINE unsigned int host_sse_rounding(uint32_t fcr31)
+{
+    switch(fcr31 & 3) {
+    case 0: return _MM_ROUND_NEAREST;
+    case 1: return _MM_ROUND_TOWARD_ZERO;
+    case 2: return _MM_ROUND_UP;
+    default: return _MM_ROUND_DOWN;
     }
 }
+#endif
+
+/* Writing the host rounding mode serializes the FPU, while reading it is cheap
+ * and games seldom change the FCR31 rounding mode (CTC1): the host mode is
+ * only written when it differs, which also catches changes made behind our
+ * back by the dynarecs or plugins. */
+M64P_FPU_INLINE void set_rounding(uint32_t fcr31)
+{
+#ifdef M64P_FPU_SSE_MATH
+    if (_MM_GET_ROUNDING_MODE() == host_sse_rounding(fcr31))
+        return;
+#else
+    if (fegetround() == host_rounding(fcr31))
+        return;
+#endif
+
+    fesetround(host_rounding(fcr31));
+}
 
 #ifdef ACCURATE_FPU_BEHAVIOR
 M64P_FPU_INLINE void fpu_reset_cause(uint32_t* fcr31)
@@ -0,0 +1,215 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - idle_loop.c                                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "idle_loop.h"
+
+#include "idec.h"
+
+#define RS(iw) (((iw) >> 21) & 0x1f)
+#define RT(iw) (((iw) >> 16) & 0x1f)
+#define RD(iw) (((iw) >> 11) & 0x1f)
+
+#define REG(r) (UINT64_C(1) << (r))
+
+/* HI and LO follow the 32 GPRs in register masks */
+#define REG_HI REG(32)
+#define REG_LO REG(33)
+
+/* load addresses must be known at translation time and be in RDRAM (through KSEG0/1),
+ * as I/O registers may depend on COUNT or have side effects */
+static int is_rdram_address(uint32_t address)
+{
+    return (address & UINT32_C(0xc0000000)) == UINT32_C(0x80000000)
+        && (address & UINT32_C(0x1fffffff)) < UINT32_C(0x03f00000);
+}
+
+int r4300_idle_loop(const uint32_t* iw, size_t count)
+{
+    /* registers read before being written, and registers written, in one iteration */
+    uint64_t read_first = 0;
+    uint64_t written = 0;
+    /* values of the registers set to a constant earlier in this iteration */
+    uint32_t known = 1;
+    uint32_t value[32];
+    size_t i;
+
+    if (count == 2 && iw[1] == 0) {
+        return 1;
+    }
+
+    if (count < 2 || count > IDLE_LOOP_MAX_LENGTH) {
+        return 0;
+    }
+
+    value[0] = 0;
+
+    for (i = 0; i < count; ++i) {
+        uint32_t w = iw[i];
+        uint32_t rs = RS(w);
+        uint32_t rt = RT(w);
+        uint32_t rd = RD(w);
+        int16_t imm = (int16_t)w;
+        uint64_t src = 0;
+        uint32_t dst = 0;
+        int is_const = 0;
+        uint32_t const_value = 0;
+
+        enum r4300_opcode opcode = r4300_get_idec(w)->opcode;
+
+        if (i == count - 2) {
+            /* the loop branch: only its condition registers matter */
+            switch (opcode)
+            {
+            case R4300_OP_J:
+                break;
+            case R4300_OP_BEQ:
+            case R4300_OP_BEQL:
+            case R4300_OP_BNE:
+            case R4300_OP_BNEL:
+                src = REG(rs) | REG(rt);
+                break;
+            case R4300_OP_BGEZ:
+            case R4300_OP_BGEZL:
+            case R4300_OP_BGTZ:
+            case R4300_OP_BGTZL:
+            case R4300_OP_BLEZ:
+            case R4300_OP_BLEZL:
+            case R4300_OP_BLTZ:
+            case R4300_OP_BLTZL:
+                src = REG(rs);
+                break;
+            default:
+                return 0;
+            }
+        }
+        else {
+            switch (opcode)
+            {
+            case R4300_OP_NOP:
+            case R4300_OP_SYNC:
+                break;
+
+            case R4300_OP_LB:
+            case R4300_OP_LBU:
+            case R4300_OP_LH:
+            case R4300_OP_LHU:
+            case R4300_OP_LW:
+            case R4300_OP_LWU:
+            case R4300_OP_LD:
+                if (!((known >> rs) & 1) || !is_rdram_address(value[rs] + (uint32_t)(int32_t)imm)) {
+                    return 0;
+                }
+                src = REG(rs);
+                dst = rt;
+                break;
+
+            case R4300_OP_LUI:
+                dst = rt;
+                is_const = 1;
+                const_value = (uint32_t)(int32_t)imm << 16;
+                break;
+
+            case R4300_OP_ADDIU:
+            case R4300_OP_ORI:
+                src = REG(rs);
+                dst = rt;
+                if ((known >> rs) & 1) {
+                    is_const = 1;
+                    const_value = (opcode == R4300_OP_ORI)
+                        ? value[rs] | (uint16_t)imm
+                        : value[rs] + (uint32_t)(int32_t)imm;
+                }
+                break;
+
+            case R4300_OP_ANDI:
+            case R4300_OP_XORI:
+            case R4300_OP_SLTI:
+            case R4300_OP_SLTIU:
+            case R4300_OP_DADDIU:
+                src = REG(rs);
+                dst = rt;
+                break;
+
+            case R4300_OP_ADDU:
+            case R4300_OP_SUBU:
+            case R4300_OP_DADDU:
+            case R4300_OP_DSUBU:
+            case R4300_OP_AND:
+            case R4300_OP_OR:
+            case R4300_OP_XOR:
+            case R4300_OP_NOR:
+            case R4300_OP_SLT:
+            case R4300_OP_SLTU:
+            case R4300_OP_SLLV:
+            case R4300_OP_SRLV:
+            case R4300_OP_SRAV:
+            case R4300_OP_DSLLV:
+            case R4300_OP_DSRLV:
+            case R4300_OP_DSRAV:
+                src = REG(rs) | REG(rt);
+                dst = rd;
+                break;
+
+            case R4300_OP_SLL:
+            case R4300_OP_SRL:
+            case R4300_OP_SRA:
+            case R4300_OP_DSLL:
+            case R4300_OP_DSRL:
+            case R4300_OP_DSRA:
+            case R4300_OP_DSLL32:
+            case R4300_OP_DSRL32:
+            case R4300_OP_DSRA32:
+                src = REG(rt);
+                dst = rd;
+                break;
+
+            case R4300_OP_MFHI:
+                src = REG_HI;
+                dst = rd;
+                break;
+            case R4300_OP_MFLO:
+                src = REG_LO;
+                dst = rd;
+                break;
+
+            /* stores, COP0/1 accesses, multiplications, traps, branches, ... */
+            default:
+                return 0;
+            }
+        }
+
+        read_first |= src & ~written;
+
+        if (dst != 0) {
+            written |= REG(dst);
+            if (is_const) {
+                known |= UINT32_C(1) << dst;
+                value[dst] = const_value;
+            }
+            else {
+                known &= ~(UINT32_C(1) << dst);
+            }
+        }
+    }
+
+    /* a register read before being written carries state across iterations */
+    return (read_first & written & ~REG(0)) == 0;
+}
@@ -0,0 +1,47 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - idle_loop.h                                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_DEVICE_R4300_IDLE_LOOP_H
+#define M64P_DEVICE_R4300_IDLE_LOOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Longest loop body (including the branch and its delay slot) considered */
+enum { IDLE_LOOP_MAX_LENGTH = 16 };
+
+/* Idle loop detection, shared by the cached interpreter and the dynarecs.
+ *
+ * iw holds the count instruction words of a loop: from the branch target
+ * up to the backward branch (or jump) at iw[count - 2] and its delay slot.
+ * The loop is idle when every iteration recomputes the same registers from
+ * loop-invariant registers and memory, and writes nothing else: it can then
+ * only exit once an interrupt changed that memory, so running it until the
+ * next event is equivalent to advancing COUNT straight to that event.
+ *
+ * Loads are only accepted from RDRAM addresses built inside the loop
+ * (LUI, then ADDIU/ORI or an offset): a base register set before the loop
+ * may point to an I/O register such as VI_CURRENT, which changes with COUNT.
+ * Branches to self with a NOP delay slot are always idle.
+ */
+int r4300_idle_loop(const uint32_t* iw, size_t count);
+
+#endif
@@ -39,11 +39,14 @@
 #include "device/r4300/cached_interp.h"
 #include "device/r4300/cp0.h"
 #include "device/r4300/new_dynarec/new_dynarec.h"
+#include "device/r4300/op_cost.h"
 #include "device/r4300/r4300_core.h"
 #include "device/r4300/recomp.h"
 #include "device/rcp/ai/ai_controller.h"
 #include "device/rcp/vi/vi_controller.h"
 #include "main/main.h"
+#include "main/netplay.h"
+#include "main/runahead.h"
 #include "main/savestates.h"
 
 
@@ -537,6 +540,20 @@ void gen_interrupt(struct r4300_core* r4300)
     uint32_t* cp0_regs = r4300_cp0_regs(&r4300->cp0);
     unsigned int* cp0_next_interrupt = r4300_cp0_next_interrupt(&r4300->cp0);
     int* cp0_cycle_count = r4300_cp0_cycle_count(&r4300->cp0);
+    struct idle_loop_stats* idle_loop_stats = &r4300->cached_interp.idle_loop_stats;
+
+    /* an idle loop skip is always directly followed by an interrupt */
+    if (idle_loop_stats->pending_skips != 0)
+    {
+        idle_loop_stats->skips += idle_loop_stats->pending_skips;
+        idle_loop_stats->cycles += idle_loop_stats->pending_cycles;
+        idle_loop_stats->pending_skips = 0;
+        idle_loop_stats->pending_cycles = 0;
+    }
+    else
+    {
+        r4300_sample_op_cost(r4300);
+    }
 
     if (*r4300_stop(r4300) == 1)
     {
@@ -552,12 +569,14 @@ void gen_interrupt(struct r4300_core* r4300)
     {
         if (savestates_get_job() == savestates_job_load)
         {
+            runahead_cancel();
             savestates_load();
             return;
         }
 
         if (r4300->reset_hard_job)
         {
+            runahead_cancel();
             call_interrupt_handler(&r4300->cp0, 11);
             return;
         }
@@ -627,6 +646,8 @@ void gen_interrupt(struct r4300_core* r4300)
             break;
 
         case HW2_INT:
+            /* the soft reset must not be rolled back */
+            runahead_cancel();
             remove_interrupt_event(&r4300->cp0);
             call_interrupt_handler(&r4300->cp0, 9);
             break;
@@ -665,11 +686,15 @@ void gen_interrupt(struct r4300_core* r4300)
 
     if (!r4300->cp0.interrupt_unsafe_state)
     {
-        if (savestates_get_job() == savestates_job_save)
+        /* don't save frames emulated ahead or again */
+        if (savestates_get_job() == savestates_job_save && !runahead_is_ahead() && !netplay_is_resimulating())
         {
             savestates_save();
             return;
         }
+
+        runahead_update();
+        netplay_update();
     }
 }
 
@@ -41,6 +41,7 @@
 #include "device/r4300/interrupt.h"
 #include "device/r4300/tlb.h"
 #include "device/r4300/fpu.h"
+#include "device/r4300/idle_loop.h"
 #include "device/rcp/mi/mi_controller.h"
 #include "device/rcp/rsp/rsp_core.h"
 
@@ -1666,6 +1667,15 @@ static int internal_branch(uint64_t i_is32,int addr)
   return 0;
 }
 
+// Does the branch close an idle loop starting inside the block?
+static int idle_loop(int i)
+{
+  int t;
+  if(ba[i]<start||ba[i]>start+i*4) return 0;
+  t=(ba[i]-start)>>2;
+  return r4300_idle_loop(source+t,i-t+2);
+}
+
 static int get_final_value(int hr, int i, int *value)
 {
   int reg=regs[i].regmap[hr];
@@ -2511,10 +2521,12 @@ static struct ll_entry *get_dirty(struct r4300_core* r4300,u_int vaddr,u_int fla
       if((((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
         if(verify_dirty(head)==0) {
           r4300->cached_interp.invalid_code[vaddr>>12]=0;
+          mark_code_page(&r4300->cached_interp,vaddr>>12);
           r4300->new_dynarec_hot_state.memory_map[vaddr>>12]|=WRITE_PROTECT;
           if(vpage<2048) {
             if(r4300->cp0.tlb.LUT_r[vaddr>>12]) {
               r4300->cached_interp.invalid_code[r4300->cp0.tlb.LUT_r[vaddr>>12]>>12]=0;
+              mark_code_page(&r4300->cached_interp,r4300->cp0.tlb.LUT_r[vaddr>>12]>>12);
               r4300->new_dynarec_hot_state.memory_map[r4300->cp0.tlb.LUT_r[vaddr>>12]>>12]|=WRITE_PROTECT;
             }
             restore_candidate[vpage>>3]|=1<<(vpage&7);
@@ -4471,8 +4483,19 @@ static void do_cc(int i,signed char i_regmap[],int *adj,int addr,int taken,int i
     *adj=0;
   }
   count=ccadj[i];
+  if(taken==TAKEN && (i!=(ba[i]-start)>>2 || source[i+1]!=0) && idle_loop(i)) {
+    // Longer idle loop: skip to the next event, the check below then takes it
+    g_dev.r4300.cached_interp.idle_loop_stats.loops++;
+    emit_test(HOST_CCREG,HOST_CCREG);
+#if NEW_DYNAREC >= NEW_DYNAREC_ARM
+    emit_cmovs_imm(0,HOST_CCREG);
+#else
+    emit_cmovs(&const_zero,HOST_CCREG);
+#endif
+  }
   if(taken==TAKEN && i==(ba[i]-start)>>2 && source[i+1]==0) {
     // Idle loop
+    g_dev.r4300.cached_interp.idle_loop_stats.loops++;
     idle=(intptr_t)out;
     emit_test(HOST_CCREG,HOST_CCREG);
 #if NEW_DYNAREC >= NEW_DYNAREC_ARM
@@ -9727,7 +9750,7 @@ int new_recompile_block(int addr)
                 if(rs2[i]) alloc_reg64(&current,i,rs2[i]);
               }
             }
-            else if((i!=(ba[i]-start)>>2 || source[i+1]!=0))
+            else if(!idle_loop(i))
             {
               ooo[i]=1;
               delayslot_alloc(&current,i+1);
@@ -9755,7 +9778,7 @@ int new_recompile_block(int addr)
                 if(rs1[i]) alloc_reg64(&current,i,rs1[i]);
               }
             }
-            else if((i!=(ba[i]-start)>>2 || source[i+1]!=0))
+            else if(!idle_loop(i))
             {
               ooo[i]=1;
               delayslot_alloc(&current,i+1);
@@ -9832,7 +9855,7 @@ int new_recompile_block(int addr)
                 if(rs1[i]) alloc_reg64(&current,i,rs1[i]);
               }
             }
-            else if((i!=(ba[i]-start)>>2 || source[i+1]!=0))
+            else if(!idle_loop(i))
             {
               ooo[i]=1;
               delayslot_alloc(&current,i+1);
@@ -9879,7 +9902,7 @@ int new_recompile_block(int addr)
               alloc_reg(&current,i,CSREG);
               alloc_reg(&current,i,FSREG);
             }
-            else if((i!=(ba[i]-start)>>2 || source[i+1]!=0)) {
+            else if(!idle_loop(i)) {
               ooo[i]=1;
               delayslot_alloc(&current,i+1);
               alloc_reg(&current,i+1,CSREG);
@@ -11818,12 +11841,14 @@ int new_recompile_block(int addr)
   // Trap writes to any of the pages we compiled
   for(i=start>>12;i<=(int)((start+slen*4-4)>>12);i++) {
     g_dev.r4300.cached_interp.invalid_code[i]=0;
+    mark_code_page(&g_dev.r4300.cached_interp,i);
     g_dev.r4300.new_dynarec_hot_state.memory_map[i]|=WRITE_PROTECT;
     if((signed int)start>=(signed int)0xC0000000) {
       assert(using_tlb);
       assert(g_dev.r4300.new_dynarec_hot_state.memory_map[i]!=-1);
       j=(((uintptr_t)i<<12)+(uintptr_t)(g_dev.r4300.new_dynarec_hot_state.memory_map[i]<<2)-(uintptr_t)g_dev.rdram.dram+(uintptr_t)0x80000000)>>12;
       g_dev.r4300.cached_interp.invalid_code[j]=0;
+      mark_code_page(&g_dev.r4300.cached_interp,j);
       g_dev.r4300.new_dynarec_hot_state.memory_map[j]|=WRITE_PROTECT;
       //DebugMessage(M64MSG_VERBOSE, "write protect physical page: %x (virtual %x)",j<<12,start);
     }
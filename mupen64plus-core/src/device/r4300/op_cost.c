@@ -0,0 +1,111 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - op_cost.c                                               *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "op_cost.h"
+
+#include "r4300_core.h"
+#include "recomp_types.h"
+
+/* CP1 format field */
+#define FMT(iw) (((iw) >> 21) & 0x1f)
+#define FMT_D 17
+
+unsigned int r4300_op_cost(enum r4300_opcode opcode, uint32_t iw)
+{
+    int d = (FMT(iw) == FMT_D);
+
+    switch (opcode)
+    {
+    /* loads */
+    case R4300_OP_LB:
+    case R4300_OP_LBU:
+    case R4300_OP_LH:
+    case R4300_OP_LHU:
+    case R4300_OP_LW:
+    case R4300_OP_LWU:
+    case R4300_OP_LWL:
+    case R4300_OP_LWR:
+    case R4300_OP_LD:
+    case R4300_OP_LDL:
+    case R4300_OP_LDR:
+    case R4300_OP_LL:
+    case R4300_OP_LLD:
+    case R4300_OP_LWC1:
+    case R4300_OP_LDC1:
+        return 2;
+
+    /* multiplications and divisions */
+    case R4300_OP_MULT:
+    case R4300_OP_MULTU:
+        return 5;
+    case R4300_OP_DMULT:
+    case R4300_OP_DMULTU:
+        return 8;
+    case R4300_OP_DIV:
+    case R4300_OP_DIVU:
+        return 37;
+    case R4300_OP_DDIV:
+    case R4300_OP_DDIVU:
+        return 69;
+
+    /* FPU */
+    case R4300_OP_CP1_ADD:
+    case R4300_OP_CP1_SUB:
+        return 3;
+    case R4300_OP_CP1_MUL:
+        return d ? 8 : 5;
+    case R4300_OP_CP1_DIV:
+    case R4300_OP_CP1_SQRT:
+        return d ? 58 : 29;
+    case R4300_OP_CP1_CVT_D:
+    case R4300_OP_CP1_CVT_L:
+    case R4300_OP_CP1_CVT_S:
+    case R4300_OP_CP1_CVT_W:
+    case R4300_OP_CP1_ROUND_L:
+    case R4300_OP_CP1_ROUND_W:
+    case R4300_OP_CP1_TRUNC_L:
+    case R4300_OP_CP1_TRUNC_W:
+    case R4300_OP_CP1_CEIL_L:
+    case R4300_OP_CP1_CEIL_W:
+    case R4300_OP_CP1_FLOOR_L:
+    case R4300_OP_CP1_FLOOR_W:
+        return 5;
+
+    default:
+        return 1;
+    }
+}
+
+void r4300_sample_op_cost(struct r4300_core* r4300)
+{
+    struct op_cost_stats* stats = &r4300->cached_interp.op_cost_stats;
+    const struct precomp_block* block;
+
+    if (!stats->enabled) {
+        return;
+    }
+
+    block = r4300->cached_interp.blocks[*r4300_pc(r4300) >> 12];
+    if (block != NULL && block->ops != 0) {
+        stats->cost += ((uint64_t)block->cost << 8) / block->ops;
+        ++stats->samples;
+    }
+}
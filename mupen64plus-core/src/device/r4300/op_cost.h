@@ -0,0 +1,40 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - op_cost.h                                               *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_DEVICE_R4300_OP_COST_H
+#define M64P_DEVICE_R4300_OP_COST_H
+
+#include <stdint.h>
+
+#include "idec.h"
+
+struct r4300_core;
+
+/* Pipeline cycles taken by an instruction on the VR4300, ignoring cache
+ * misses and interlocks other than the load delay. COUNT advances by one
+ * every two pipeline cycles. */
+unsigned int r4300_op_cost(enum r4300_opcode opcode, uint32_t iw);
+
+/* Add the average cost per instruction of the code block being executed
+ * to the op cost profile, if enabled */
+void r4300_sample_op_cost(struct r4300_core* r4300);
+
+#endif
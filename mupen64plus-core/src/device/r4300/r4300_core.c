@@ -34,8 +34,10 @@
 #ifdef DBG
 #include "debugger/dbg_debugger.h"
 #endif
+#include "device/rdram/rdram.h"
 #include "main/main.h"
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -123,6 +125,25 @@ void poweron_r4300(struct r4300_core* r4300)
     poweron_cp2(&r4300->cp2);
 }
 
+static void print_code_write_stats(const struct cached_interp* cinterp)
+{
+    static const char* const names[CODE_WRITE_SOURCES_COUNT] = { "CPU", "PI", "SP", "Cheat", "State" };
+    size_t i;
+
+    for (i = 0; i < CODE_WRITE_SOURCES_COUNT; ++i) {
+        const struct code_write_stats* stats = &cinterp->code_write_stats[i];
+        DebugMessage(M64MSG_VERBOSE, "%s code invalidations: %" PRIu64 " requests (%" PRIu64 " bytes), %" PRIu64 " skipped, %" PRIu64 " pages invalidated",
+            names[i], stats->requests, stats->bytes, stats->skipped, stats->pages);
+    }
+}
+
+static void print_idle_loop_stats(const struct cached_interp* cinterp)
+{
+    const struct idle_loop_stats* stats = &cinterp->idle_loop_stats;
+
+    DebugMessage(M64MSG_VERBOSE, "Idle loops: %" PRIu64 " found, %" PRIu64 " skips, %" PRIu64 " COUNT cycles skipped",
+        stats->loops, stats->skips, stats->cycles);
+}
 
 void run_r4300(struct r4300_core* r4300)
 {
@@ -203,6 +224,11 @@ void run_r4300(struct r4300_core* r4300)
 
     DebugMessage(M64MSG_INFO, "R4300 emulator finished.");
 
+    if (r4300->emumode != EMUMODE_PURE_INTERPRETER) {
+        print_code_write_stats(&r4300->cached_interp);
+        print_idle_loop_stats(&r4300->cached_interp);
+    }
+
     /* print instruction counts */
 #if defined(COUNT_INSTR)
     if (r4300->emumode == EMUMODE_DYNAREC)
@@ -294,6 +320,9 @@ uint32_t *fast_mem_access(struct r4300_core* r4300, uint32_t address)
 
     address &= UINT32_C(0x1ffffffc);
 
+    /* instructions are fetched without going through the memory handlers */
+    rdram_flush_pending_dma_range(r4300->rdram, address, 4);
+
     return mem_base_u32(r4300->mem->base, address);
 }
 
@@ -363,8 +392,7 @@ int r4300_write_aligned_word(struct r4300_core* r4300, uint32_t address, uint32_
         }
     }
 
-    invalidate_r4300_cached_code(r4300, address, 4);
-    invalidate_r4300_cached_code(r4300, address ^ UINT32_C(0x20000000), 4);
+    invalidate_r4300_cached_code_physical(r4300, address, 4, CODE_WRITE_CPU);
 
     address &= UINT32_C(0x1ffffffc);
 
@@ -393,8 +421,7 @@ int r4300_write_aligned_dword(struct r4300_core* r4300, uint32_t address, uint64
         }
     }
 
-    invalidate_r4300_cached_code(r4300, address, 8);
-    invalidate_r4300_cached_code(r4300, address ^ UINT32_C(0x20000000), 8);
+    invalidate_r4300_cached_code_physical(r4300, address, 8, CODE_WRITE_CPU);
 
     address &= UINT32_C(0x1ffffffc);
 
@@ -422,6 +449,59 @@ void invalidate_r4300_cached_code(struct r4300_core* r4300, uint32_t address, si
     }
 }
 
+void invalidate_r4300_cached_code_physical(struct r4300_core* r4300, uint32_t address, size_t size, unsigned int source)
+{
+    struct cached_interp* cinterp = &r4300->cached_interp;
+    struct code_write_stats* stats = &cinterp->code_write_stats[source];
+    uint32_t page, last_page, begin, end;
+    int hit = 0;
+
+    if (r4300->emumode == EMUMODE_PURE_INTERPRETER || size == 0) {
+        return;
+    }
+
+    address &= UINT32_C(0x1fffffff);
+    if (size > UINT32_C(0x20000000) - address) {
+        size = UINT32_C(0x20000000) - address;
+    }
+
+    ++stats->requests;
+    stats->bytes += size;
+
+    page = address >> 12;
+    last_page = (uint32_t)((address + size - 1) >> 12);
+
+    while (page <= last_page) {
+        /* skip whole words of code free pages at once */
+        if ((cinterp->code_pages[page >> 5] >> (page & 31)) == 0) {
+            page = (page | 31) + 1;
+            continue;
+        }
+
+        if (cinterp->code_pages[page >> 5] & (UINT32_C(1) << (page & 31))) {
+            begin = (page == (address >> 12)) ? address : (page << 12);
+            end = (page == last_page) ? (uint32_t)(address + size) : ((page + 1) << 12);
+
+            invalidate_r4300_cached_code(r4300, UINT32_C(0x80000000) + begin, end - begin);
+            invalidate_r4300_cached_code(r4300, UINT32_C(0xa0000000) + begin, end - begin);
+
+            /* forget pages where neither alias holds valid code anymore */
+            if (cinterp->invalid_code[0x80000 + page] && cinterp->invalid_code[0xa0000 + page]) {
+                cinterp->code_pages[page >> 5] &= ~(UINT32_C(1) << (page & 31));
+            }
+
+            ++stats->pages;
+            hit = 1;
+        }
+
+        ++page;
+    }
+
+    if (!hit) {
+        ++stats->skipped;
+    }
+}
+
 
 void generic_jump_to(struct r4300_core* r4300, uint32_t address)
 {
@@ -44,6 +44,47 @@ struct mi_controller;
 struct rdram;
 
 struct jump_table;
+
+/* Sources of writes which may hit cached code */
+enum code_write_source
+{
+    CODE_WRITE_CPU,
+    CODE_WRITE_PI,
+    CODE_WRITE_SP,
+    CODE_WRITE_CHEAT,
+    CODE_WRITE_STATE,
+    CODE_WRITE_SOURCES_COUNT
+};
+
+struct code_write_stats
+{
+    uint64_t requests;      /* invalidation requests */
+    uint64_t bytes;         /* bytes covered by these requests */
+    uint64_t skipped;       /* requests which didn't touch any code page */
+    uint64_t pages;         /* code pages invalidated */
+};
+
+struct idle_loop_stats
+{
+    uint64_t loops;         /* idle loops found while translating code */
+    uint64_t skips;         /* times COUNT was advanced to the next event */
+    uint64_t cycles;        /* COUNT cycles skipped */
+
+    /* updated by the skipping code, folded into the totals by gen_interrupt */
+    uint32_t pending_skips;
+    uint32_t pending_cycles;
+};
+
+struct op_cost_stats
+{
+    int enabled;
+    uint64_t samples;       /* non-idle interrupts which hit a decoded block */
+    uint64_t cost;          /* sum of the sampled blocks costs per op, in 1/256 cycles */
+};
+
+/* 4KiB pages of the physical address space */
+enum { CODE_PAGES_COUNT = 0x20000 };
+
 struct cached_interp
 {
     char invalid_code[0x100000];
@@ -59,8 +100,24 @@ struct cached_interp
 
     void (*recompile_block)(struct r4300_core* r4300,
         const uint32_t* source, struct precomp_block* block, uint32_t func);
+
+    /* physical pages which may hold valid code through their KSEG0 or KSEG1 alias,
+     * ie a superset of the pages whose invalid_code entries are cleared */
+    uint32_t code_pages[CODE_PAGES_COUNT / 32];
+    struct code_write_stats code_write_stats[CODE_WRITE_SOURCES_COUNT];
+    struct idle_loop_stats idle_loop_stats;
+    struct op_cost_stats op_cost_stats;
 };
 
+/* Must be called whenever invalid_code[page] gets cleared */
+static osal_inline void mark_code_page(struct cached_interp* cinterp, uint32_t page)
+{
+    if ((page & UINT32_C(0xc0000)) == UINT32_C(0x80000)) {
+        page &= CODE_PAGES_COUNT - 1;
+        cinterp->code_pages[page >> 5] |= UINT32_C(1) << (page & 31);
+    }
+}
+
 enum {
     EMUMODE_PURE_INTERPRETER = 0,
     EMUMODE_INTERPRETER      = 1,
@@ -247,6 +304,12 @@ int r4300_write_aligned_dword(struct r4300_core* r4300, uint32_t address, uint64
  */
 void invalidate_r4300_cached_code(struct r4300_core* r4300, uint32_t address, size_t size);
 
+/* Invalidate cached code of both KSEG0 and KSEG1 aliases of the physical
+ * range [address, address+size[. Pages known to hold no code are skipped.
+ * source is one of code_write_source and is only used for statistics.
+ */
+void invalidate_r4300_cached_code_physical(struct r4300_core* r4300, uint32_t address, size_t size, unsigned int source);
+
 /* Jump to the given address. This works for all r4300 emulator, but is slower.
  * Use this for common code which can be executed from any r4300 emulator. */
 void generic_jump_to(struct r4300_core* r4300, unsigned int address);
@@ -40,6 +40,7 @@
 #include "device/r4300/cached_interp.h"
 #include "device/r4300/cp0.h"
 #include "device/r4300/idec.h"
+#include "device/r4300/op_cost.h"
 #include "device/r4300/recomp_types.h"
 #include "device/r4300/tlb.h"
 #include "main/main.h"
@@ -475,6 +476,8 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
     struct precomp_block* b = *block;
 
     length = get_block_length(b);
+    b->cost = 0;
+    b->ops = 0;
 
 #ifdef DBG
     DebugMessage(M64MSG_INFO, "init block %" PRIX32 " - %" PRIX32, b->start, b->end);
@@ -580,14 +583,17 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
      * yet as the game should have already set up the code correctly.
      */
     r4300->cached_interp.invalid_code[b->start>>12] = 0;
+    mark_code_page(&r4300->cached_interp, b->start>>12);
     if (b->end < UINT32_C(0x80000000) || b->start >= UINT32_C(0xc0000000))
     {
         uint32_t paddr = virtual_to_physical_address(r4300, b->start, 2);
         r4300->cached_interp.invalid_code[paddr>>12] = 0;
+        mark_code_page(&r4300->cached_interp, paddr>>12);
         dynarec_init_block(r4300, paddr);
 
         paddr += b->end - b->start - 4;
         r4300->cached_interp.invalid_code[paddr>>12] = 0;
+        mark_code_page(&r4300->cached_interp, paddr>>12);
         dynarec_init_block(r4300, paddr);
 
     }
@@ -680,7 +686,9 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
 #endif
 
         /* decode instruction */
-        opcode = r4300_decode(r4300->recomp.dst, r4300, r4300_get_idec(iw[i]), iw[i], iw[i+1], block);
+        opcode = r4300_decode(r4300->recomp.dst, r4300, r4300_get_idec(iw[i]), iw[i], iw, block);
+        block->cost += r4300_op_cost(opcode, iw[i]);
+        ++block->ops;
         recomp_funcs[opcode](r4300);
 
         if (r4300->recomp.delay_slot_compiled)
@@ -772,10 +780,10 @@ void recompile_opcode(struct r4300_core* r4300)
     r4300->recomp.dst++;
     r4300->recomp.dst->addr = (r4300->recomp.dst-1)->addr + 4;
     r4300->recomp.dst->reg_cache_infos.need_map = 0;
-    /* we disable next_iw == NOP check by passing 1, because we are already in delay slot */
+    /* we disable idle loop detection by passing NULL, because we are already in delay slot */
 
     uint32_t iw = r4300->recomp.src;
-    enum r4300_opcode opcode = r4300_decode(r4300->recomp.dst, r4300, r4300_get_idec(iw), iw, 1, r4300->recomp.dst_block);
+    enum r4300_opcode opcode = r4300_decode(r4300->recomp.dst, r4300, r4300_get_idec(iw), iw, NULL, r4300->recomp.dst_block);
 
     switch(opcode)
     {
@@ -89,6 +89,10 @@ struct precomp_block
     void *riprel_table;
     int riprel_number;
     uint64_t xxhash;
+
+    /* r4300_op_cost() and count of the decoded instructions */
+    uint32_t cost;
+    uint32_t ops;
 };
 
 #endif /* M64P_DEVICE_R4300_RECOMP_TYPES_H */
@@ -2188,9 +2188,11 @@ static void gentest_idle(struct r4300_core* r4300)
 
     mov_reg32_m32(reg, (unsigned int *)(r4300_cp0_cycle_count(&r4300->cp0)));
     test_reg32_reg32(reg, reg);
-    jns_rj(16);
+    jns_rj(28);
 
     sub_m32_reg32((unsigned int *)(&r4300_cp0_regs(&r4300->cp0)[CP0_COUNT_REG]), reg); // 6
+    sub_m32_reg32((unsigned int *)(&r4300->cached_interp.idle_loop_stats.pending_cycles), reg); // 6
+    inc_m32((unsigned int *)(&r4300->cached_interp.idle_loop_stats.pending_skips)); // 6
     mov_m32_imm32((unsigned int *)(r4300_cp0_cycle_count(&r4300->cp0)), 0); //10
 
     jump_end_rel32(r4300);
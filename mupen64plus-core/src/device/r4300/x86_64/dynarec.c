@@ -2344,6 +2344,8 @@ static void gentest_idle(struct r4300_core* r4300)
     jump_start_rel8(r4300);
 
     sub_m32rel_xreg32((unsigned int *)(&r4300_cp0_regs(&r4300->cp0)[CP0_COUNT_REG]), reg);
+    sub_m32rel_xreg32((unsigned int *)(&r4300->cached_interp.idle_loop_stats.pending_cycles), reg);
+    inc_m32rel((unsigned int *)(&r4300->cached_interp.idle_loop_stats.pending_skips));
     mov_m32rel_imm32((unsigned int *)r4300_cp0_cycle_count(&r4300->cp0), 0);
 
     jump_end_rel8(r4300);
@@ -176,6 +176,7 @@ void read_ai_regs(void* opaque, uint32_t address, uint32_t* value)
         {
             unsigned int diff = ai->fifo[0].length - ai->last_read;
             unsigned char *p = (unsigned char*)&ai->ri->rdram->dram[ai->fifo[0].address/4];
+            rdram_flush_pending_dma(ai->ri->rdram);
             ai->iaout->push_samples(ai->aout, p + diff, ai->last_read - *value);
             ai->last_read = *value;
         }
@@ -227,6 +228,7 @@ void ai_end_of_dma_event(void* opaque)
     {
         unsigned int diff = ai->fifo[0].length - ai->last_read;
         unsigned char *p = (unsigned char*)&ai->ri->rdram->dram[ai->fifo[0].address/4];
+        rdram_flush_pending_dma(ai->ri->rdram);
         ai->iaout->push_samples(ai->aout, p + diff, ai->last_read);
         ai->last_read = 0;
     }
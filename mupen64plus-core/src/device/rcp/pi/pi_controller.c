@@ -38,6 +38,102 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+static void read_rdram_pi_pending(void* opaque, uint32_t address, uint32_t* value);
+static void write_rdram_pi_pending(void* opaque, uint32_t address, uint32_t value, uint32_t mask);
+
+/* Restore the dram handlers trapped by a pending DMA */
+static void release_pi_dma_regions(struct pi_controller* pi)
+{
+    const struct pi_pending_dma* dma = &pi->pending_dma;
+    uint32_t region;
+
+    for (region = dma->dram_addr >> 16; region <= ((dma->dram_addr + dma->length - 1) >> 16); ++region) {
+        pi->mem->handlers[region] = pi->saved_handlers[region];
+    }
+
+    pi->ri->rdram->flush_pending_dma = NULL;
+    pi->ri->rdram->pending_dma_opaque = NULL;
+    pi->ri->rdram->pending_dma_begin = 0;
+    pi->ri->rdram->pending_dma_end = 0;
+}
+
+/* Perform the deferred DMA write (if any).
+ * Called whenever someone is about to look at the destination. */
+static void flush_pi_dma(void* opaque)
+{
+    struct pi_controller* pi = (struct pi_controller*)opaque;
+    struct pi_pending_dma* dma = &pi->pending_dma;
+
+    if (dma->length == 0) {
+        return;
+    }
+
+    release_pi_dma_regions(pi);
+
+    dma->handler->dma_write_data(dma->opaque, (uint8_t*)pi->ri->rdram->dram, dma->dram_addr, dma->cart_addr, dma->length);
+    post_framebuffer_write(&pi->dp->fb, dma->dram_addr, dma->length);
+
+    dma->length = 0;
+}
+
+/* Record a DMA write and trap accesses to the dram regions it covers */
+static void defer_pi_dma(struct pi_controller* pi, void* opaque, const struct pi_dma_handler* handler,
+                         uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
+{
+    struct pi_pending_dma* dma = &pi->pending_dma;
+    struct mem_handler pending_handler = { pi, read_rdram_pi_pending, write_rdram_pi_pending };
+    uint32_t region;
+
+    dma->opaque = opaque;
+    dma->handler = handler;
+    dma->dram_addr = dram_addr;
+    dma->cart_addr = cart_addr;
+    dma->length = length;
+
+    for (region = dram_addr >> 16; region <= ((dram_addr + length - 1) >> 16); ++region) {
+        pi->saved_handlers[region] = pi->mem->handlers[region];
+        pi->mem->handlers[region] = pending_handler;
+    }
+
+    pi->ri->rdram->flush_pending_dma = flush_pi_dma;
+    pi->ri->rdram->pending_dma_opaque = pi;
+    pi->ri->rdram->pending_dma_begin = dram_addr;
+    pi->ri->rdram->pending_dma_end = dram_addr + length;
+}
+
+static void read_rdram_pi_pending(void* opaque, uint32_t address, uint32_t* value)
+{
+    struct pi_controller* pi = (struct pi_controller*)opaque;
+    const struct mem_handler* handler;
+
+    flush_pi_dma(pi);
+
+    handler = mem_get_handler(pi->mem, address);
+    if (handler->read32 == read_rdram_pi_pending) {
+        /* handlers got saved behind our back (debugger breakpoints) */
+        read_rdram_dram(pi->ri->rdram, address, value);
+    }
+    else {
+        mem_read32(handler, address, value);
+    }
+}
+
+static void write_rdram_pi_pending(void* opaque, uint32_t address, uint32_t value, uint32_t mask)
+{
+    struct pi_controller* pi = (struct pi_controller*)opaque;
+    const struct mem_handler* handler;
+
+    flush_pi_dma(pi);
+
+    handler = mem_get_handler(pi->mem, address);
+    if (handler->write32 == write_rdram_pi_pending) {
+        write_rdram_dram(pi->ri->rdram, address, value, mask);
+    }
+    else {
+        mem_write32(handler, address, value, mask);
+    }
+}
+
 int validate_pi_request(struct pi_controller* pi)
 {
     if (pi->regs[PI_STATUS_REG] & (PI_STATUS_DMA_BUSY | PI_STATUS_IO_BUSY)) {
@@ -68,6 +164,7 @@ static void dma_pi_read(struct pi_controller* pi)
         return;
     }
 
+    flush_pi_dma(pi);
     pre_framebuffer_read(&pi->dp->fb, dram_addr);
 
     /* PI seems to treat the first 128 bytes differently, see https://n64brew.dev/wiki/Peripheral_Interface#Unaligned_DMA_transfer */
@@ -111,9 +208,26 @@ static void dma_pi_write(struct pi_controller* pi)
         length += 1;
     if (length <= 0x80)
         length -= dram_addr & 0x7;
-    unsigned int cycles = handler->dma_write(opaque, dram, dram_addr, cart_addr, length);
 
-    post_framebuffer_write(&pi->dp->fb, dram_addr, length);
+    flush_pi_dma(pi);
+
+    unsigned int cycles;
+
+    /* the transfer can't be observed before PI_INT unless dram is accessed,
+     * so let the copy happen on first access or at PI_INT, whichever comes first.
+     * Dynarecs access dram directly, hence can't use that. */
+    if (pi->lazy_dma
+     && handler->dma_write_data != NULL
+     && pi->mi->r4300->emumode != EMUMODE_DYNAREC
+     && length != 0
+     && dram_addr + length <= RDRAM_MAX_SIZE) {
+        cycles = handler->dma_write_cycles(opaque, dram_addr, cart_addr, length);
+        defer_pi_dma(pi, opaque, handler, dram_addr, cart_addr, length);
+    }
+    else {
+        cycles = handler->dma_write(opaque, dram, dram_addr, cart_addr, length);
+        post_framebuffer_write(&pi->dp->fb, dram_addr, length);
+    }
 
     /* Mark DMA as busy */
     pi->regs[PI_STATUS_REG] |= PI_STATUS_DMA_BUSY;
@@ -133,7 +247,9 @@ void init_pi(struct pi_controller* pi,
              struct dd_controller* dd,
              struct mi_controller* mi,
              struct ri_controller* ri,
-             struct rdp_core* dp)
+             struct rdp_core* dp,
+             struct memory* mem,
+             int lazy_dma)
 {
     pi->get_pi_dma_handler = get_pi_dma_handler;
     pi->cart = cart;
@@ -141,10 +257,19 @@ void init_pi(struct pi_controller* pi,
     pi->mi = mi;
     pi->ri = ri;
     pi->dp = dp;
+    pi->mem = mem;
+    pi->lazy_dma = lazy_dma;
+    pi->pending_dma.length = 0;
 }
 
 void poweron_pi(struct pi_controller* pi)
 {
+    /* drop any pending DMA, dram is being reset anyway */
+    if (pi->pending_dma.length != 0) {
+        release_pi_dma_regions(pi);
+        pi->pending_dma.length = 0;
+    }
+
     memset(pi->regs, 0, PI_REGS_COUNT*sizeof(uint32_t));
 }
 
@@ -215,6 +340,9 @@ void write_pi_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
 void pi_end_of_dma_event(void* opaque)
 {
     struct pi_controller* pi = (struct pi_controller*)opaque;
+
+    flush_pi_dma(pi);
+
     pi->regs[PI_STATUS_REG] &= ~(PI_STATUS_DMA_BUSY | PI_STATUS_IO_BUSY);
     pi->regs[PI_STATUS_REG] |= PI_STATUS_INTERRUPT;
 
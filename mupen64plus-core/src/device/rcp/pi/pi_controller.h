@@ -25,6 +25,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "device/memory/memory.h"
 #include "osal/preproc.h"
 
 struct cart;
@@ -68,10 +69,27 @@ struct pi_dma_handler
 {
     unsigned int (*dma_read)(void* opaque, const uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
     unsigned int (*dma_write)(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
+
+    /* optional split version of dma_write, for sources which can be read at any time.
+     * When present, the copy can be deferred until its data is actually needed. */
+    unsigned int (*dma_write_cycles)(void* opaque, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
+    void (*dma_write_data)(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
 };
 
 typedef void (*pi_dma_handler_getter)(struct cart* cart, struct dd_controller* dd, uint32_t address, void** opaque, const struct pi_dma_handler** handler);
 
+/* DMA write to dram which hasn't been performed yet */
+struct pi_pending_dma
+{
+    void* opaque;
+    const struct pi_dma_handler* handler;
+    uint32_t dram_addr;
+    uint32_t cart_addr;
+    uint32_t length;        /* 0 if nothing is pending */
+};
+
+enum { PI_DMA_REGIONS_COUNT = RDRAM_MAX_SIZE >> 16 };
+
 struct pi_controller
 {
     uint32_t regs[PI_REGS_COUNT];
@@ -83,6 +101,12 @@ struct pi_controller
     struct mi_controller* mi;
     struct ri_controller* ri;
     struct rdp_core* dp;
+    struct memory* mem;
+
+    int lazy_dma;
+    struct pi_pending_dma pending_dma;
+    /* memory handlers of the dram regions covered by pending_dma */
+    struct mem_handler saved_handlers[PI_DMA_REGIONS_COUNT];
 };
 
 static osal_inline uint32_t pi_reg(uint32_t address)
@@ -98,7 +122,9 @@ void init_pi(struct pi_controller* pi,
              struct dd_controller* dd,
              struct mi_controller* mi,
              struct ri_controller* ri,
-             struct rdp_core* dp);
+             struct rdp_core* dp,
+             struct memory* mem,
+             int lazy_dma);
 
 void poweron_pi(struct pi_controller* pi);
 
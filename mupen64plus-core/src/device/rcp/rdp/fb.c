@@ -36,40 +36,106 @@ static osal_inline size_t fb_buffer_size(const FrameBufferInfo* fb_info)
     return fb_info->width * fb_info->height * fb_info->size;
 }
 
-void pre_framebuffer_read(struct fb* fb, uint32_t address)
+/* rebuild the sorted range list and page bitmap from fb infos */
+static void update_fb_ranges(struct fb* fb)
 {
-    if (!fb->infos[0].addr) {
-        return;
-    }
+    size_t i, j, n = 0;
+    struct fb_range* ranges = fb->ranges;
 
-    size_t i;
+    memset(fb->fb_page, 0, FB_DIRTY_PAGES_COUNT*sizeof(fb->fb_page[0]));
 
     for (i = 0; i < FB_INFOS_COUNT; ++i) {
 
         /* skip empty fb info */
-        if (fb->infos[i].addr == 0) {
+        if (fb->infos[i].addr == 0 || fb_buffer_size(&fb->infos[i]) == 0) {
             continue;
         }
 
-        /* if address in within a fb and its page is dirty,
-         * notify GFX plugin and mark page as not dirty */
-        uint32_t begin = fb->infos[i].addr;
-        uint32_t end   = fb->infos[i].addr + fb_buffer_size(&fb->infos[i]) - 1;
+        struct fb_range r = {
+            fb->infos[i].addr,
+            fb->infos[i].addr + fb_buffer_size(&fb->infos[i]) - 1
+        };
 
-        if ((address >= begin) && (address <= end) && (fb->dirty_page[address >> 12])) {
-            gfx.fBRead(address);
-            fb->dirty_page[address >> 12] = 0;
+        /* insertion sort by begin address */
+        for (j = n; j > 0 && ranges[j - 1].begin > r.begin; --j) {
+            ranges[j] = ranges[j - 1];
         }
+        ranges[j] = r;
+        ++n;
+    }
+
+    /* merge overlapping or adjacent ranges */
+    fb->ranges_count = 0;
+    for (i = 0; i < n; ++i) {
+        if (fb->ranges_count > 0 && ranges[i].begin <= ranges[fb->ranges_count - 1].end + 1) {
+            if (ranges[i].end > ranges[fb->ranges_count - 1].end) {
+                ranges[fb->ranges_count - 1].end = ranges[i].end;
+            }
+        }
+        else {
+            ranges[fb->ranges_count++] = ranges[i];
+        }
+    }
+
+    for (i = 0; i < fb->ranges_count; ++i) {
+        for (j = ranges[i].begin >> 12; j <= (ranges[i].end >> 12) && j < FB_DIRTY_PAGES_COUNT; ++j) {
+            fb->fb_page[j] = 1;
+        }
+    }
+}
+
+/* index of the first range which ends at or after address */
+static size_t find_fb_range(const struct fb* fb, uint32_t address)
+{
+    size_t lo = 0, hi = fb->ranges_count;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (fb->ranges[mid].end < address) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+void pre_framebuffer_read(struct fb* fb, uint32_t address)
+{
+    uint32_t page = address >> 12;
+
+    /* only dirty pages that belong to a fb are of interest */
+    if (page >= FB_DIRTY_PAGES_COUNT || !fb->fb_page[page] || !fb->dirty_page[page]) {
+        return;
+    }
+
+    /* if address in within a fb and its page is dirty,
+     * notify GFX plugin and mark page as not dirty */
+    size_t i = find_fb_range(fb, address);
+
+    if (i < fb->ranges_count && address >= fb->ranges[i].begin) {
+        gfx.fBRead(address);
+        fb->dirty_page[page] = 0;
     }
 }
 
 void post_framebuffer_write(struct fb* fb, uint32_t address, uint32_t length)
 {
-    if (!fb->infos[0].addr) {
+    if (fb->ranges_count == 0 || length == 0) {
         return;
     }
 
-    size_t i, j;
+    uint32_t last = address + length - 1;
+
+    /* most writes stay within a single page */
+    if ((address >> 12) == (last >> 12)
+     && ((address >> 12) >= FB_DIRTY_PAGES_COUNT || !fb->fb_page[address >> 12])) {
+        return;
+    }
+
+    uint32_t j;
     unsigned char size;
     if (length % 4 == 0)
         size = 4;
@@ -78,21 +144,25 @@ void post_framebuffer_write(struct fb* fb, uint32_t address, uint32_t length)
     else
         size = 1;
 
-    for (i = 0; i < FB_INFOS_COUNT; ++i) {
+    size_t i;
 
-        /* skip empty fb info */
-        if (fb->infos[i].addr == 0) {
+    for (i = find_fb_range(fb, address); i < fb->ranges_count && fb->ranges[i].begin <= last; ++i) {
+
+        /* part of the write which lies within a fb */
+        uint32_t begin = (fb->ranges[i].begin > address) ? fb->ranges[i].begin : address;
+        uint32_t end   = (fb->ranges[i].end < last) ? fb->ranges[i].end : last;
+
+        /* notify GFX plugin with a single call when supported */
+        if (gfx.fBWriteRange != NULL) {
+            gfx.fBWriteRange(begin, end - begin + 1);
             continue;
         }
 
-        /* if address in within a fb notify GFX plugin */
-        uint32_t begin = fb->infos[i].addr;
-        uint32_t end   = fb->infos[i].addr + fb_buffer_size(&fb->infos[i]) - 1;
-
-        for (j = 0; j < length; j += size) {
-            if ((address + j >= begin) && (address + j <= end)) {
-                gfx.fBWrite(address + j, size);
-            }
+        /* otherwise notify each written unit which starts within the fb */
+        j = begin - address;
+        j += (size - j % size) % size;
+        for (; address + j <= end; j += size) {
+            gfx.fBWrite(address + j, size);
         }
     }
 }
@@ -113,6 +183,7 @@ void poweron_fb(struct fb* fb)
     memset(fb->dirty_page, 0, FB_DIRTY_PAGES_COUNT*sizeof(fb->dirty_page[0]));
     memset(fb->infos, 0, FB_INFOS_COUNT*sizeof(fb->infos[0]));
     fb->once = 1;
+    update_fb_ranges(fb);
 }
 
 void read_rdram_fb(void* opaque, uint32_t address, uint32_t* value)
@@ -202,6 +273,7 @@ void protect_framebuffers(struct fb* fb)
 
     /* ask fb info to gfx plugin */
     gfx.fBGetFrameBufferInfo(fb->infos);
+    update_fb_ranges(fb);
 
     /* return early if not FB info is present */
     if (fb->infos[0].addr == 0) {
@@ -220,11 +292,6 @@ void protect_framebuffers(struct fb* fb)
         fb_mapping.end   = fb->infos[i].addr + fb_buffer_size(&fb->infos[i]) - 1;
         apply_mem_mapping(fb->mem, &fb_mapping);
 
-        /* mark all pages that are within a fb as dirty */
-        for (j = fb_mapping.begin >> 12; j <= (fb_mapping.end >> 12); ++j) {
-            fb->dirty_page[j] = 1;
-        }
-
         /* disable dynarec "fast memory" code generation to avoid direct memory accesses */
         if (fb->once) {
             fb->once = 0;
@@ -236,6 +303,11 @@ void protect_framebuffers(struct fb* fb)
             invalidate_r4300_cached_code(fb->r4300, 0, 0);
         }
     }
+
+    /* mark all pages that are within a fb as dirty */
+    for (j = 0; j < FB_DIRTY_PAGES_COUNT; ++j) {
+        fb->dirty_page[j] |= fb->fb_page[j];
+    }
 }
 
 void unprotect_framebuffers(struct fb* fb)
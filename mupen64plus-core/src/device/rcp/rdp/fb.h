@@ -22,6 +22,7 @@
 #ifndef M64P_DEVICE_RCP_RDP_FB_H
 #define M64P_DEVICE_RCP_RDP_FB_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "api/m64p_plugin.h"
@@ -33,6 +34,13 @@ struct r4300_core;
 enum { FB_INFOS_COUNT = 6 };
 enum { FB_DIRTY_PAGES_COUNT = 0x800 };
 
+/* inclusive RDRAM address range covered by one or more framebuffers */
+struct fb_range
+{
+    uint32_t begin;
+    uint32_t end;
+};
+
 struct fb
 {
     struct memory* mem;
@@ -42,6 +50,12 @@ struct fb
     unsigned char dirty_page[FB_DIRTY_PAGES_COUNT];
     FrameBufferInfo infos[FB_INFOS_COUNT];
     unsigned int once;
+
+    /* sorted, non-overlapping ranges built from infos,
+     * and pages of RDRAM touched by at least one of them */
+    struct fb_range ranges[FB_INFOS_COUNT];
+    size_t ranges_count;
+    unsigned char fb_page[FB_DIRTY_PAGES_COUNT];
 };
 
 void init_fb(struct fb* fb,
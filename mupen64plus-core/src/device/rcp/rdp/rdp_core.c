@@ -26,6 +26,7 @@
 #include "device/memory/memory.h"
 #include "device/rcp/mi/mi_controller.h"
 #include "device/rcp/rsp/rsp_core.h"
+#include "device/rdram/rdram.h"
 #include "plugin/plugin.h"
 
 static void update_dpc_status(struct rdp_core* dp, uint32_t w)
@@ -41,8 +42,10 @@ static void update_dpc_status(struct rdp_core* dp, uint32_t w)
 
         if (dp->do_on_unfreeze & DELAY_DP_INT)
             signal_rcp_interrupt(dp->mi, MI_INTR_DP);
-        if (dp->do_on_unfreeze & DELAY_UPDATESCREEN)
+        if (dp->do_on_unfreeze & DELAY_UPDATESCREEN) {
+            rdram_flush_pending_dma(dp->fb.rdram);
             gfx.updateScreen();
+        }
         dp->do_on_unfreeze = 0;
     }
     if (w & DPC_SET_FREEZE) dp->dpc_regs[DPC_STATUS_REG] |= DPC_STATUS_FREEZE;
@@ -114,6 +117,7 @@ void write_dpc_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mas
         dp->dpc_regs[DPC_CURRENT_REG] = dp->dpc_regs[DPC_START_REG];
         break;
     case DPC_END_REG:
+        rdram_flush_pending_dma(dp->fb.rdram);
         unprotect_framebuffers(&dp->fb);
         gfx.processRDPList();
         protect_framebuffers(&dp->fb);
@@ -23,6 +23,7 @@
 
 #include <string.h>
 
+#include "device/memory/dma_copy.h"
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rcp/mi/mi_controller.h"
@@ -38,7 +39,7 @@
 
 static void do_sp_dma(struct rsp_core* sp, const struct sp_dma* dma)
 {
-    unsigned int i,j;
+    unsigned int j;
 
     unsigned int l = dma->length;
 
@@ -52,16 +53,17 @@ static void do_sp_dma(struct rsp_core* sp, const struct sp_dma* dma)
     unsigned char *spmem = (unsigned char*)sp->mem + (dma->memaddr & 0x1000);
     unsigned char *dram = (unsigned char*)sp->ri->rdram->dram;
 
+    rdram_flush_pending_dma(sp->ri->rdram);
+
     if (dma->dir == SP_DMA_READ)
     {
         for(j=0; j<count; j++) {
-            for(i=0; i<length; i++) {
-                dram[(dramaddr^S8) & 0x7fffffu] = spmem[(memaddr^S8) & 0xfffu];
-                memaddr++;
-                dramaddr++;
-            }
+            dma_copy_wrap(dram, dramaddr, 0x7fffffu, spmem, memaddr, 0xfffu, length);
+            memaddr += length;
+            dramaddr += length;
 
             post_framebuffer_write(&sp->dp->fb, dramaddr - length, length);
+            invalidate_r4300_cached_code_physical(sp->mi->r4300, dramaddr - length, length, CODE_WRITE_SP);
             dramaddr+=skip;
         }
     }
@@ -70,11 +72,9 @@ static void do_sp_dma(struct rsp_core* sp, const struct sp_dma* dma)
         for(j=0; j<count; j++) {
             pre_framebuffer_read(&sp->dp->fb, dramaddr);
 
-            for(i=0; i<length; i++) {
-                spmem[(memaddr^S8) & 0xfffu] = dram[(dramaddr^S8) & 0x7fffffu];
-                memaddr++;
-                dramaddr++;
-            }
+            dma_copy_wrap(spmem, memaddr, 0xfffu, dram, dramaddr, 0x7fffffu, length);
+            memaddr += length;
+            dramaddr += length;
             dramaddr+=skip;
         }
     }
@@ -310,6 +310,9 @@ void do_SP_Task(struct rsp_core* sp)
 
     uint32_t sp_delay_time;
 
+    /* RSP and plugins access dram directly */
+    rdram_flush_pending_dma(sp->ri->rdram);
+
     if (sp->mem[0xfc0/4] == 1)
     {
         unprotect_framebuffers(&sp->dp->fb);
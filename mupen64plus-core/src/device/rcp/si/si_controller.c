@@ -25,6 +25,7 @@
 
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
+#include "device/memory/dma_copy.h"
 #include "device/memory/memory.h"
 #include "device/pif/pif.h"
 #include "device/r4300/r4300_core.h"
@@ -52,22 +53,19 @@ static int validate_dma(struct si_controller* si, uint32_t reg)
 
 static void copy_pif_rdram(struct si_controller* si)
 {
-    size_t i;
     /* DRAM address must be word-aligned */
     uint32_t dram_addr = si->regs[SI_DRAM_ADDR_REG] & ~UINT32_C(3);
 
     uint32_t* pif_ram = (uint32_t*)si->pif->ram;
     uint32_t* dram = (uint32_t*)(&si->ri->rdram->dram[rdram_dram_address(dram_addr)]);
 
+    rdram_flush_pending_dma(si->ri->rdram);
+
     if (si->dma_dir == SI_DMA_WRITE) {
-        for(i = 0; i < (PIF_RAM_SIZE / 4); ++i) {
-            pif_ram[i] = fromhl(dram[i]);
-        }
+        dma_copy_swap32(pif_ram, dram, PIF_RAM_SIZE / 4);
     }
     else if (si->dma_dir == SI_DMA_READ) {
-        for(i = 0; i < (PIF_RAM_SIZE / 4); ++i) {
-            dram[i] = tohl(pif_ram[i]);
-        }
+        dma_copy_swap32(dram, pif_ram, PIF_RAM_SIZE / 4);
     }
 }
 
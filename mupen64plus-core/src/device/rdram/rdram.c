@@ -131,6 +131,10 @@ void init_rdram(struct rdram* rdram,
     rdram->dram = dram;
     rdram->dram_size = dram_size;
     rdram->r4300 = r4300;
+    rdram->flush_pending_dma = NULL;
+    rdram->pending_dma_opaque = NULL;
+    rdram->pending_dma_begin = 0;
+    rdram->pending_dma_end = 0;
 }
 
 void poweron_rdram(struct rdram* rdram)
@@ -55,6 +55,13 @@ struct rdram
     size_t dram_size;
 
     struct r4300_core* r4300;
+
+    /* set while a DMA write to dram is deferred */
+    void (*flush_pending_dma)(void* opaque);
+    void* pending_dma_opaque;
+    /* dram range [begin, end) covered by the deferred write */
+    uint32_t pending_dma_begin;
+    uint32_t pending_dma_end;
 };
 
 static osal_inline uint32_t rdram_reg(uint32_t address)
@@ -67,6 +74,26 @@ static osal_inline uint32_t rdram_dram_address(uint32_t address)
     return (address & 0xffffff) >> 2;
 }
 
+/* Complete deferred DMA writes to dram, if any.
+ * Must be called before accessing dram without going through the memory handlers. */
+static osal_inline void rdram_flush_pending_dma(struct rdram* rdram)
+{
+    if (rdram->flush_pending_dma != NULL) {
+        rdram->flush_pending_dma(rdram->pending_dma_opaque);
+    }
+}
+
+/* Same as rdram_flush_pending_dma, but only if the deferred writes
+ * overlap the size bytes of dram starting at address. */
+static osal_inline void rdram_flush_pending_dma_range(struct rdram* rdram, uint32_t address, uint32_t size)
+{
+    if (rdram->flush_pending_dma != NULL
+     && address < rdram->pending_dma_end
+     && address + size > rdram->pending_dma_begin) {
+        rdram->flush_pending_dma(rdram->pending_dma_opaque);
+    }
+}
+
 void init_rdram(struct rdram* rdram,
                 uint32_t* dram,
                 size_t dram_size,
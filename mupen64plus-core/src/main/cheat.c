@@ -39,116 +39,509 @@
 
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
+#include "device/memory/dma_copy.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rdram/rdram.h"
 #include "osal/preproc.h"
 
 /* local definitions */
-#define CHEAT_CODE_MAGIC_VALUE UINT32_C(0xDEAD0000)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define cheat_xchg(p, v) _InterlockedExchangePointer((void* volatile*)(p), (v))
+#else
+#define cheat_xchg(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#endif
 
 typedef struct cheat_code {
     uint32_t address;
     uint32_t value;
-    uint32_t old_value;
     struct list_head list;
 } cheat_code_t;
 
 typedef struct cheat {
     char *name;
     int enabled;
-    int was_enabled;
+    unsigned int id;
+    /* incremented whenever the codes are replaced */
+    unsigned int revision;
     struct list_head cheat_codes;
     struct list_head list;
 } cheat_t;
 
+/* Compiled cheats
+ *
+ * Codes are decoded once, whenever the cheats change, into a flat list of
+ * operations. Contiguous writes of a cheat are merged into a single
+ * operation. A new program is published to the emulation thread through
+ * ctx->pending and picked up by the next cheat_apply_cheats(), which is the
+ * only user of ctx->program.
+ */
+enum cheat_op_type
+{
+    CHEAT_OP_WRITE,
+    CHEAT_OP_WRITE_GS,  /* only while the GS button is pressed */
+    CHEAT_OP_TEST_EQ,
+    CHEAT_OP_TEST_NE,
+    CHEAT_OP_SKIP       /* consumes a failed condition */
+};
+
+struct cheat_op
+{
+    uint8_t type;
+    /* condition also fails when the GS button isn't pressed */
+    uint8_t gs;
+    /* overwritten bytes are saved for restoring when the cheat is disabled */
+    uint8_t save;
+    /* state: overwritten bytes have been saved to program->old */
+    uint8_t saved;
+    uint32_t address;   /* RDRAM offset */
+    uint32_t length;    /* in bytes, 0 if out of RDRAM */
+    uint32_t data;      /* offset in program->data and program->old, value for tests */
+};
+
+/* bytes saved by a code, restored in code order */
+struct cheat_restore
+{
+    uint32_t code;
+    uint32_t op;
+    uint32_t offset;    /* in the op */
+    uint32_t length;
+};
+
+struct cheat_record
+{
+    unsigned int id;
+    unsigned int revision;
+    int enabled;
+    /* state: applied since last enabled */
+    int was_enabled;
+    size_t boot_op;     /* [boot_op, vi_op[ : boot time codes */
+    size_t vi_op;       /* [vi_op, end_op[ : codes applied every VI */
+    size_t end_op;
+    size_t restore;     /* [restore, end_restore[ : saved bytes by code */
+    size_t end_restore;
+};
+
+struct cheat_program
+{
+    struct cheat_record* cheats;
+    size_t cheat_count;
+    struct cheat_op* ops;
+    size_t op_count;
+    struct cheat_restore* restores;
+    size_t restore_count;
+    uint8_t* data;
+    uint8_t* old;
+    size_t data_size;
+
+    /* set when the program is picked up */
+    uint8_t* dram;
+    size_t dram_size;
+};
+
+struct cheat_builder
+{
+    struct cheat_program* prog;
+    size_t cheat_capacity;
+    size_t op_capacity;
+    size_t restore_capacity;
+    size_t data_capacity;
+    /* index of the code being compiled */
+    uint32_t code;
+    /* last write can be extended by the next contiguous one */
+    int can_merge;
+    int failed;
+};
+
 /* private functions */
-static uint16_t read_address_16bit(struct r4300_core* r4300, uint32_t address)
+static void *grow_array(void* array, size_t* capacity, size_t count, size_t elem_size)
 {
-    return *(uint16_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S16)));
+    size_t new_capacity;
+    void* new_array;
+
+    if (count < *capacity)
+        return array;
+
+    new_capacity = (*capacity == 0) ? 64 : 2 * *capacity;
+    new_array = realloc(array, new_capacity * elem_size);
+    if (new_array != NULL)
+        *capacity = new_capacity;
+
+    return new_array;
 }
 
-static uint8_t read_address_8bit(struct r4300_core* r4300, uint32_t address)
+static void free_program(struct cheat_program* prog)
 {
-    return *(uint8_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S8)));
+    if (prog == NULL)
+        return;
+
+    free(prog->cheats);
+    free(prog->ops);
+    free(prog->restores);
+    free(prog->data);
+    free(prog->old);
+    free(prog);
 }
 
-static void update_address_16bit(struct r4300_core* r4300, uint32_t address, uint16_t new_value)
+static struct cheat_op* emit_op(struct cheat_builder* b, uint8_t type)
 {
-    *(uint16_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S16))) = new_value;
-    /* mask out bit 24 which is used by GS codes to specify 8/16 bits */
-    address &= 0xfeffffff;
-    invalidate_r4300_cached_code(r4300, address, 2);
+    struct cheat_program* prog = b->prog;
+    struct cheat_op* ops;
+
+    ops = grow_array(prog->ops, &b->op_capacity, prog->op_count, sizeof(*ops));
+    if (ops == NULL) {
+        b->failed = 1;
+        return NULL;
+    }
+    prog->ops = ops;
+
+    memset(&ops[prog->op_count], 0, sizeof(ops[0]));
+    ops[prog->op_count].type = type;
+    b->can_merge = 0;
+    return &ops[prog->op_count++];
 }
 
-static void update_address_8bit(struct r4300_core* r4300, uint32_t address, uint8_t new_value)
+static void emit_test(struct cheat_builder* b, uint8_t type, int gs, uint32_t address, uint32_t length, uint32_t value)
 {
-    *(uint8_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S8))) = new_value;
-    invalidate_r4300_cached_code(r4300, address, 1);
+    struct cheat_op* op = emit_op(b, type);
+    if (op == NULL)
+        return;
+
+    op->gs = (uint8_t)gs;
+    op->address = address & 0xFFFFFF;
+    op->length = length;
+    op->data = value;
 }
 
-static int address_equal_to_8bit(struct r4300_core* r4300, uint32_t address, uint8_t value)
+/* bytes are given in N64 memory order */
+static void emit_write(struct cheat_builder* b, uint8_t type, int save, int guarded,
+                       uint32_t address, const uint8_t* bytes, uint32_t length)
 {
-    uint8_t value_read;
-    value_read = *(uint8_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S8)));
-    return value_read == value;
+    struct cheat_program* prog = b->prog;
+    struct cheat_op* op = NULL;
+    uint8_t* data;
+
+    address &= 0xFFFFFF;
+
+    data = grow_array(prog->data, &b->data_capacity, prog->data_size + length, 1);
+    if (data == NULL) {
+        b->failed = 1;
+        return;
+    }
+    prog->data = data;
+
+    if (b->can_merge && !guarded) {
+        op = &prog->ops[prog->op_count - 1];
+        if (op->type != type || op->save != save || op->address + op->length != address)
+            op = NULL;
+    }
+
+    if (op == NULL) {
+        op = emit_op(b, type);
+        if (op == NULL)
+            return;
+        op->save = (uint8_t)save;
+        op->address = address;
+        op->data = (uint32_t)prog->data_size;
+    }
+
+    if (save) {
+        struct cheat_restore* restores = grow_array(prog->restores, &b->restore_capacity, prog->restore_count, sizeof(*restores));
+        if (restores == NULL) {
+            b->failed = 1;
+            return;
+        }
+        prog->restores = restores;
+
+        restores[prog->restore_count].code = b->code;
+        restores[prog->restore_count].op = (uint32_t)(op - prog->ops);
+        restores[prog->restore_count].offset = op->length;
+        restores[prog->restore_count].length = length;
+        prog->restore_count++;
+    }
+
+    memcpy(prog->data + prog->data_size, bytes, length);
+    prog->data_size += length;
+    op->length += length;
+
+    /* a guarded write must stay alone, it may be skipped */
+    b->can_merge = !guarded;
 }
 
-static int address_equal_to_16bit(struct r4300_core* r4300, uint32_t address, uint16_t value)
+static void emit_code_write(struct cheat_builder* b, uint8_t type, int save, int guarded, uint32_t address, uint32_t value)
 {
-    uint16_t value_read;
-    value_read = *(unsigned short *)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S16)));
-    return value_read == value;
+    uint8_t bytes[2];
+
+    if (address & 0x01000000) {
+        bytes[0] = (uint8_t)(value >> 8);
+        bytes[1] = (uint8_t)value;
+        emit_write(b, type, save, guarded, address, bytes, 2);
+    }
+    else {
+        bytes[0] = (uint8_t)value;
+        emit_write(b, type, save, guarded, address, bytes, 1);
+    }
 }
 
-/* individual application - returns 0 if we are supposed to skip the next cheat
- * (only really used on conditional codes)
- */
-static int execute_cheat(struct r4300_core* r4300, uint32_t address, uint32_t value, uint32_t* old_value)
+static int compare_restores(const void* a, const void* b)
 {
-    switch (address & 0xFF000000)
-    {
-    case 0x80000000:
-    case 0x88000000:
-    case 0xA0000000:
-    case 0xA8000000:
-    case 0xF0000000:
-        /* if pointer to old value is valid and uninitialized, write current value to it */
-        if (old_value && (*old_value == CHEAT_CODE_MAGIC_VALUE)) {
-            *old_value = read_address_8bit(r4300, address);
+    uint32_t code_a = ((const struct cheat_restore*)a)->code;
+    uint32_t code_b = ((const struct cheat_restore*)b)->code;
+
+    return (code_a > code_b) - (code_a < code_b);
+}
+
+static void compile_cheat(struct cheat_builder* b, const cheat_t* cheat)
+{
+    struct cheat_program* prog = b->prog;
+    struct cheat_record* record;
+    const cheat_code_t* code;
+    int guarded;
+
+    record = grow_array(prog->cheats, &b->cheat_capacity, prog->cheat_count, sizeof(*record));
+    if (record == NULL) {
+        b->failed = 1;
+        return;
+    }
+    prog->cheats = record;
+    record = &prog->cheats[prog->cheat_count++];
+
+    memset(record, 0, sizeof(*record));
+    record->id = cheat->id;
+    record->revision = cheat->revision;
+    record->enabled = cheat->enabled;
+    record->boot_op = prog->op_count;
+    record->restore = prog->restore_count;
+
+    /* boot time codes are written once, whatever the conditions */
+    b->can_merge = 0;
+    b->code = 0;
+    list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+        b->code++;
+
+        switch (code->address & 0xFF000000)
+        {
+        case 0xF0000000:
+        case 0xF1000000:
+            emit_code_write(b, CHEAT_OP_WRITE, 1, 0, code->address, code->value);
+            break;
+        default:
+            break;
         }
-        update_address_8bit(r4300, address, (uint8_t)value);
-        return 1;
-    case 0x81000000:
-    case 0x89000000:
-    case 0xA1000000:
-    case 0xA9000000:
-    case 0xF1000000:
-        /* if pointer to old value is valid and uninitialized, write current value to it */
-        if (old_value && (*old_value == CHEAT_CODE_MAGIC_VALUE)) {
-            *old_value = read_address_16bit(r4300, address);
+    }
+    record->vi_op = prog->op_count;
+
+    /* a non-test code following a test code is skipped if the test failed */
+    b->can_merge = 0;
+    b->code = 0;
+    guarded = 0;
+    list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+        static const uint8_t ee_bytes[4] = { 0x00, 0x40, 0x00, 0x00 };
+
+        b->code++;
+
+        switch (code->address & 0xFF000000)
+        {
+        case 0xD0000000:
+        case 0xD8000000:
+            emit_test(b, CHEAT_OP_TEST_EQ, (code->address & 0x08000000) != 0, code->address, 1, code->value & 0xFF);
+            guarded = 1;
+            continue;
+        case 0xD1000000:
+        case 0xD9000000:
+            emit_test(b, CHEAT_OP_TEST_EQ, (code->address & 0x08000000) != 0, code->address, 2, code->value & 0xFFFF);
+            guarded = 1;
+            continue;
+        case 0xD2000000:
+        case 0xDB000000:
+            emit_test(b, CHEAT_OP_TEST_NE, (code->address & 0x08000000) != 0, code->address, 1, code->value & 0xFF);
+            guarded = 1;
+            continue;
+        case 0xD3000000:
+        case 0xDA000000:
+            emit_test(b, CHEAT_OP_TEST_NE, (code->address & 0x08000000) != 0, code->address, 2, code->value & 0xFFFF);
+            guarded = 1;
+            continue;
+        case 0x80000000:
+        case 0x81000000:
+        case 0xA0000000:
+        case 0xA1000000:
+            emit_code_write(b, CHEAT_OP_WRITE, 1, guarded, code->address, code->value);
+            break;
+        /* GS button triggers cheat code */
+        case 0x88000000:
+        case 0x89000000:
+        case 0xA8000000:
+        case 0xA9000000:
+            emit_code_write(b, CHEAT_OP_WRITE_GS, 0, guarded, code->address, code->value);
+            break;
+        case 0xEE000000:
+            /* most likely, this doesnt do anything. */
+            emit_write(b, CHEAT_OP_WRITE, 0, guarded, 0x318, ee_bytes, 4);
+            break;
+        default:
+            /* other codes (including boot time codes) do nothing,
+             * but still consume a failed condition */
+            if (guarded)
+                emit_op(b, CHEAT_OP_SKIP);
+            break;
+        }
+
+        guarded = 0;
+    }
+    record->end_op = prog->op_count;
+
+    /* boot time and VI codes are interleaved */
+    record->end_restore = prog->restore_count;
+    if (record->end_restore - record->restore > 1) {
+        qsort(prog->restores + record->restore, record->end_restore - record->restore,
+              sizeof(*prog->restores), compare_restores);
+    }
+}
+
+/* must be called with ctx->mutex locked */
+static void publish_program(struct cheat_ctx* ctx)
+{
+    struct cheat_builder b;
+    const cheat_t* cheat;
+
+    memset(&b, 0, sizeof(b));
+    b.prog = calloc(1, sizeof(*b.prog));
+    if (b.prog == NULL) {
+        DebugMessage(M64MSG_ERROR, "Failed to allocate cheat program");
+        return;
+    }
+
+    list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
+        compile_cheat(&b, cheat);
+    }
+
+    if (!b.failed && b.prog->data_size != 0) {
+        b.prog->old = malloc(b.prog->data_size);
+        b.failed = (b.prog->old == NULL);
+    }
+
+    if (b.failed) {
+        DebugMessage(M64MSG_ERROR, "Failed to allocate cheat program");
+        free_program(b.prog);
+        return;
+    }
+
+    /* an unused previous program can be dropped */
+    free_program(cheat_xchg(&ctx->pending, b.prog));
+}
+
+static uint32_t read_bytes(const struct cheat_program* prog, const struct cheat_op* op)
+{
+    uint32_t value = 0;
+    uint32_t i;
+
+    for (i = 0; i < op->length; ++i) {
+        value = (value << 8) | prog->dram[(op->address + i) ^ S8];
+    }
+
+    return value;
+}
+
+static void write_bytes(const struct cheat_program* prog, struct r4300_core* r4300,
+                        const struct cheat_op* op, const uint8_t* bytes)
+{
+    uint32_t i;
+
+    /* cheats mostly write the same values over and over:
+     * leave memory and cached code alone when nothing changes */
+    for (i = 0; i < op->length; ++i) {
+        if (prog->dram[(op->address + i) ^ S8] != bytes[i])
+            break;
+    }
+
+    if (i == op->length)
+        return;
+
+    dma_copy_from_bytes(prog->dram, op->address, bytes, op->length);
+    invalidate_r4300_cached_code_physical(r4300, op->address, op->length, CODE_WRITE_CHEAT);
+}
+
+static void execute_write(struct cheat_program* prog, struct r4300_core* r4300, struct cheat_op* op)
+{
+    /* save current bytes the first time they are overwritten */
+    if (op->save && !op->saved) {
+        dma_copy_to_bytes(prog->old + op->data, prog->dram, op->address, op->length);
+        op->saved = 1;
+    }
+
+    write_bytes(prog, r4300, op, prog->data + op->data);
+}
+
+static void restore_cheat(struct cheat_program* prog, struct r4300_core* r4300, struct cheat_record* record)
+{
+    size_t i;
+
+    for (i = record->restore; i < record->end_restore; ++i) {
+        const struct cheat_restore* restore = &prog->restores[i];
+        struct cheat_op op = prog->ops[restore->op];
+
+        if (!op.saved)
+            continue;
+
+        op.address += restore->offset;
+        op.length = (op.length != 0) ? restore->length : 0;
+        write_bytes(prog, r4300, &op, prog->old + op.data + restore->offset);
+    }
+
+    for (i = record->boot_op; i < record->end_op; ++i) {
+        prog->ops[i].saved = 0;
+    }
+}
+
+/* Switch to the program published last, keeping the saved bytes of cheats
+ * whose codes didn't change */
+static void pick_up_program(struct cheat_ctx* ctx, struct r4300_core* r4300, struct cheat_program* prog)
+{
+    struct cheat_program* prev = ctx->program;
+    size_t i, j = 0, k;
+
+    prog->dram = (uint8_t*)r4300->rdram->dram;
+    prog->dram_size = r4300->rdram->dram_size;
+
+    for (i = 0; i < prog->op_count; ++i) {
+        struct cheat_op* op = &prog->ops[i];
+        if (op->type != CHEAT_OP_SKIP && op->address + op->length > prog->dram_size)
+            op->length = 0;
+    }
+
+    if (prev != NULL) {
+        for (i = 0; i < prev->cheat_count; ++i) {
+            struct cheat_record* old_record = &prev->cheats[i];
+            struct cheat_record* record = NULL;
+
+            /* cheats stay in the same order, so the search resumes from the last match */
+            for (k = 0; k < prog->cheat_count; ++k, j = (j + 1) % prog->cheat_count) {
+                if (prog->cheats[j].id == old_record->id) {
+                    record = &prog->cheats[j];
+                    break;
+                }
+            }
+
+            /* replaced or deleted cheats don't restore memory */
+            if (record == NULL || record->revision != old_record->revision)
+                continue;
+
+            /* same codes, so the same operations */
+            for (k = 0; k < old_record->end_op - old_record->boot_op; ++k) {
+                struct cheat_op* old_op = &prev->ops[old_record->boot_op + k];
+                struct cheat_op* op = &prog->ops[record->boot_op + k];
+                if (old_op->saved) {
+                    op->saved = 1;
+                    memcpy(prog->old + op->data, prev->old + old_op->data, op->length);
+                }
+            }
+            record->was_enabled = old_record->was_enabled;
         }
-        update_address_16bit(r4300, address, (uint16_t)value);
-        return 1;
-    case 0xD0000000:
-    case 0xD8000000:
-        return address_equal_to_8bit(r4300, address, (uint8_t)value);
-    case 0xD1000000:
-    case 0xD9000000:
-        return address_equal_to_16bit(r4300, address, (uint16_t)value);
-    case 0xD2000000:
-    case 0xDB000000:
-        return !(address_equal_to_8bit(r4300, address, (uint8_t)value));
-    case 0xD3000000:
-    case 0xDA000000:
-        return !(address_equal_to_16bit(r4300, address, (uint16_t)value));
-    case 0xEE000000:
-        /* most likely, this doesnt do anything. */
-        execute_cheat(r4300, 0xF1000318, 0x0040, NULL);
-        execute_cheat(r4300, 0xF100031A, 0x0000, NULL);
-        return 1;
-    default:
-        return 1;
     }
+
+    free_program(prev);
+    ctx->program = prog;
 }
 
 static cheat_t *find_or_create_cheat(struct cheat_ctx* ctx, const char *name)
@@ -174,14 +567,15 @@ static cheat_t *find_or_create_cheat(struct cheat_ctx* ctx, const char *name)
         }
 
         cheat->enabled = 0;
-        cheat->was_enabled = 0;
+        cheat->revision++;
     }
     else
     {
         cheat = malloc(sizeof(*cheat));
         cheat->name = strdup(name);
         cheat->enabled = 0;
-        cheat->was_enabled = 0;
+        cheat->id = ctx->next_id++;
+        cheat->revision = 0;
         INIT_LIST_HEAD(&cheat->cheat_codes);
         list_add_tail(&cheat->list, &ctx->active_cheats);
     }
@@ -195,6 +589,9 @@ void cheat_init(struct cheat_ctx* ctx)
 {
     ctx->mutex = SDL_CreateMutex();
     INIT_LIST_HEAD(&ctx->active_cheats);
+    ctx->program = NULL;
+    ctx->pending = NULL;
+    ctx->next_id = 0;
 }
 
 void cheat_uninit(struct cheat_ctx* ctx)
@@ -203,117 +600,101 @@ void cheat_uninit(struct cheat_ctx* ctx)
         SDL_DestroyMutex(ctx->mutex);
     }
     ctx->mutex = NULL;
+
+    free_program(ctx->program);
+    free_program(cheat_xchg(&ctx->pending, NULL));
+    ctx->program = NULL;
 }
 
 void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry)
 {
-    cheat_t *cheat;
-    cheat_code_t *code;
-    int cond_failed;
+    struct cheat_program* prog;
+    size_t i, j;
+    int cond_failed, gs_active;
 
-    if (list_empty(&ctx->active_cheats))
+    prog = cheat_xchg(&ctx->pending, NULL);
+    if (prog == NULL && (ctx->program == NULL || ctx->program->op_count == 0))
         return;
 
-    if (ctx->mutex == NULL || SDL_LockMutex(ctx->mutex) != 0)
-    {
-        DebugMessage(M64MSG_ERROR, "Internal error: failed to lock mutex in cheat_apply_cheats()");
-        return;
-    }
+    /* cheats peek and poke dram directly */
+    rdram_flush_pending_dma(r4300->rdram);
 
-    list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
-        if (cheat->enabled)
-        {
-            cheat->was_enabled = 1;
-            switch(entry)
-            {
-            case ENTRY_BOOT:
-                list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
-                    /* code should only be written once at boot time */
-                    if ((code->address & 0xF0000000) == 0xF0000000) {
-                        execute_cheat(r4300, code->address, code->value, &code->old_value);
-                    }
-                }
-                break;
-            case ENTRY_VI:
-                /* a cheat starts without failed preconditions */
-                cond_failed = 0;
-
-                list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
-                    /* conditional cheat codes */
-                    if ((code->address & 0xF0000000) == 0xD0000000)
-                    {
-                        /* if code needs GS button pressed and it's not, skip it */
-                        if (((code->address & 0xFF000000) == 0xD8000000 ||
-                                    (code->address & 0xFF000000) == 0xD9000000 ||
-                                    (code->address & 0xFF000000) == 0xDA000000 ||
-                                    (code->address & 0xFF000000) == 0xDB000000) &&
-                                !event_gameshark_active()) {
-                            /* if condition false, skip next code non-test code */
-                            cond_failed = 1;
-                        }
-
-                        /* if condition false, skip next code non-test code */
-                        if (!execute_cheat(r4300, code->address, code->value, NULL)) {
-                            cond_failed = 1;
-                        }
-                    }
-                    else {
-                        /* preconditions were false for this non-test code
-                         * reset the condition state and skip the cheat
-                         */
-                        if (cond_failed) {
-                            cond_failed = 0;
-                            continue;
-                        }
-
-                        switch (code->address & 0xFF000000) {
-                        /* GS button triggers cheat code */
-                        case 0x88000000:
-                        case 0x89000000:
-                        case 0xA8000000:
-                        case 0xA9000000:
-                            if (event_gameshark_active()) {
-                                execute_cheat(r4300, code->address, code->value, NULL);
-                            }
-                            break;
-                            /* normal cheat code */
-                        default:
-                            /* exclude boot-time cheat codes */
-                            if ((code->address & 0xF0000000) != 0xF0000000) {
-                                execute_cheat(r4300, code->address, code->value, &code->old_value);
-                            }
-                            break;
-                        }
-                    }
-                }
-                break;
-            default:
-                break;
+    if (prog != NULL)
+        pick_up_program(ctx, r4300, prog);
+    prog = ctx->program;
+
+    gs_active = event_gameshark_active();
+
+    for (i = 0; i < prog->cheat_count; ++i) {
+        struct cheat_record* record = &prog->cheats[i];
+
+        /* if cheat was enabled, but is now disabled, restore old memory values */
+        if (!record->enabled) {
+            if (record->was_enabled) {
+                record->was_enabled = 0;
+                if (entry == ENTRY_VI)
+                    restore_cheat(prog, r4300, record);
             }
+            continue;
         }
-        /* if cheat was enabled, but is now disabled, restore old memory values */
-        else if (cheat->was_enabled)
+
+        record->was_enabled = 1;
+
+        switch (entry)
         {
-            cheat->was_enabled = 0;
-            switch(entry)
-            {
-            case ENTRY_VI:
-                list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
-                    /* set memory back to old value and clear saved copy of old value */
-                    if(code->old_value != CHEAT_CODE_MAGIC_VALUE)
-                    {
-                        execute_cheat(r4300, code->address, code->old_value, NULL);
-                        code->old_value = CHEAT_CODE_MAGIC_VALUE;
+        case ENTRY_BOOT:
+            /* code should only be written once at boot time */
+            for (j = record->boot_op; j < record->vi_op; ++j) {
+                execute_write(prog, r4300, &prog->ops[j]);
+            }
+            break;
+        case ENTRY_VI:
+            /* a cheat starts without failed preconditions */
+            cond_failed = 0;
+
+            for (j = record->vi_op; j < record->end_op; ++j) {
+                struct cheat_op* op = &prog->ops[j];
+
+                switch (op->type)
+                {
+                case CHEAT_OP_TEST_EQ:
+                case CHEAT_OP_TEST_NE:
+                    /* if condition false, skip next code non-test code */
+                    if ((op->gs && !gs_active) ||
+                        ((read_bytes(prog, op) == op->data) != (op->type == CHEAT_OP_TEST_EQ))) {
+                        cond_failed = 1;
                     }
+                    continue;
+                default:
+                    break;
+                }
+
+                /* preconditions were false for this non-test code
+                 * reset the condition state and skip the cheat
+                 */
+                if (cond_failed) {
+                    cond_failed = 0;
+                    continue;
+                }
+
+                switch (op->type)
+                {
+                case CHEAT_OP_WRITE_GS:
+                    if (!gs_active)
+                        break;
+                    /* fallthrough */
+                case CHEAT_OP_WRITE:
+                    execute_write(prog, r4300, op);
+                    break;
+                default:
+                    break;
                 }
-                break;
-            default:
-                break;
             }
+            break;
+        default:
+            break;
         }
     }
-
-    SDL_UnlockMutex(ctx->mutex);
 }
 
 
@@ -342,6 +723,8 @@ void cheat_delete_all(struct cheat_ctx* ctx)
         free(cheat);
     }
 
+    publish_program(ctx);
+
     SDL_UnlockMutex(ctx->mutex);
 }
 
@@ -361,7 +744,11 @@ int cheat_set_enabled(struct cheat_ctx* ctx, const char* name, int enabled)
     list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
         if (strcmp(name, cheat->name) == 0)
         {
-            cheat->enabled = enabled;
+            if (cheat->enabled != enabled)
+            {
+                cheat->enabled = enabled;
+                publish_program(ctx);
+            }
             SDL_UnlockMutex(ctx->mutex);
             return 1;
         }
@@ -409,7 +796,6 @@ int cheat_add_new(struct cheat_ctx* ctx, const char* name, m64p_cheat_code* code
                 cheat_code_t *code = malloc(sizeof(*code));
                 code->address = cur_addr;
                 code->value = cur_value;
-                code->old_value = CHEAT_CODE_MAGIC_VALUE;
                 list_add_tail(&code->list, &cheat->cheat_codes);
                 cur_addr += incr_addr;
                 cur_value += incr_value;
@@ -421,11 +807,12 @@ int cheat_add_new(struct cheat_ctx* ctx, const char* name, m64p_cheat_code* code
             cheat_code_t *code = malloc(sizeof(*code));
             code->address = code_list[i].address;
             code->value = code_list[i].value;
-            code->old_value = CHEAT_CODE_MAGIC_VALUE;
             list_add_tail(&code->list, &cheat->cheat_codes);
         }
     }
 
+    publish_program(ctx);
+
     SDL_UnlockMutex(ctx->mutex);
     return 1;
 }
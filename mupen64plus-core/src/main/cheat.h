@@ -33,11 +33,17 @@
 
 struct SDL_mutex;
 struct r4300_core;
+struct cheat_program;
 
 struct cheat_ctx
 {
     struct SDL_mutex* mutex;
     struct list_head active_cheats;
+    unsigned int next_id;
+    /* compiled cheats, used by cheat_apply_cheats() only */
+    struct cheat_program* program;
+    /* compiled cheats not yet picked up by cheat_apply_cheats() */
+    struct cheat_program* pending;
 };
 
 void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry);
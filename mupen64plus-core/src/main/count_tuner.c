@@ -0,0 +1,336 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - count_tuner.c                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "count_tuner.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/callbacks.h"
+#include "api/config.h"
+#include "api/m64p_config.h"
+#include "api/m64p_types.h"
+#include "device/device.h"
+#include "main.h"
+#include "osal/files.h"
+#include "util.h"
+
+#define COUNT_TUNER_FILENAME "countperop.ini"
+
+enum {
+    /* frames profiled before suggesting anything (30s at 60Hz) */
+    COUNT_TUNER_MIN_FRAMES = 1800,
+    /* frames lasting longer than this many COUNT cycles are ignored (savestates, pauses) */
+    COUNT_TUNER_MAX_FRAME_CYCLES = 2000000,
+    /* frames are binned by idle share in 5% steps */
+    COUNT_TUNER_BUCKETS = 20,
+    /* share of the busiest frames which must keep some idle time */
+    COUNT_TUNER_BUSIEST_PERCENT = 10,
+    /* headroom left when raising CountPerOp, in percent */
+    COUNT_TUNER_MARGIN_PERCENT = 10,
+    /* idle share under which the game may be running slow, in percent */
+    COUNT_TUNER_BUSY_PERCENT = 5,
+    COUNT_TUNER_MAX_COUNT_PER_OP = 4
+};
+
+struct count_tuner_entry
+{
+    char md5[33];
+    unsigned int count_per_op;
+};
+
+static struct
+{
+    int enabled;
+    char md5[33];
+    unsigned int count_per_op;
+
+    int have_last;
+    uint32_t last_count;
+    uint64_t last_idle_cycles;
+
+    unsigned int frames;
+    unsigned int histogram[COUNT_TUNER_BUCKETS];
+} l_tuner;
+
+static char* count_tuner_path(void)
+{
+    const char* cachepath = ConfigGetUserCachePath();
+
+    return (cachepath != NULL) ? combinepath(cachepath, COUNT_TUNER_FILENAME) : NULL;
+}
+
+/* Read the entries of the cache file, returns a malloc'd array */
+static struct count_tuner_entry* read_entries(const char* path, size_t* count)
+{
+    struct count_tuner_entry* entries = NULL;
+    struct count_tuner_entry* entry = NULL;
+    size_t capacity = 0;
+    char buffer[256];
+    FILE* f;
+
+    *count = 0;
+
+    if ((f = osal_file_open(path, "rb")) == NULL)
+        return NULL;
+
+    while (fgets(buffer, sizeof(buffer), f) != NULL)
+    {
+        char* line = buffer;
+        ini_line l = ini_parse_line(&line);
+        int value;
+
+        switch (l.type)
+        {
+        case INI_SECTION:
+            entry = NULL;
+            if (strlen(l.name) != 32)
+                break;
+
+            if (*count == capacity)
+            {
+                size_t new_capacity = (capacity == 0) ? 16 : 2 * capacity;
+                struct count_tuner_entry* new_entries = realloc(entries, new_capacity * sizeof(*entries));
+                if (new_entries == NULL)
+                    break;
+                entries = new_entries;
+                capacity = new_capacity;
+            }
+
+            entry = &entries[(*count)++];
+            strcpy(entry->md5, l.name);
+            entry->count_per_op = 0;
+            break;
+
+        case INI_PROPERTY:
+            if (entry != NULL && !strcmp(l.name, "CountPerOp")
+             && string_to_int(l.value, &value) && value > 0 && value <= COUNT_TUNER_MAX_COUNT_PER_OP)
+                entry->count_per_op = (unsigned int)value;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    fclose(f);
+    return entries;
+}
+
+static void write_entries(const char* path, const struct count_tuner_entry* entries, size_t count)
+{
+    FILE* f;
+    size_t i;
+
+    if ((f = osal_file_open(path, "wb")) == NULL)
+    {
+        DebugMessage(M64MSG_WARNING, "Couldn't write CountPerOp suggestions to '%s'", path);
+        return;
+    }
+
+    fprintf(f, "; CountPerOp suggested by auto-tuning, by ROM MD5\n");
+    for (i = 0; i < count; ++i)
+    {
+        if (entries[i].count_per_op != 0)
+            fprintf(f, "\n[%s]\nCountPerOp=%u\n", entries[i].md5, entries[i].count_per_op);
+    }
+
+    fclose(f);
+}
+
+unsigned int count_tuner_lookup(const char* md5)
+{
+    struct count_tuner_entry* entries;
+    unsigned int count_per_op = 0;
+    char* path = count_tuner_path();
+    size_t count, i;
+
+    if (path == NULL)
+        return 0;
+
+    entries = read_entries(path, &count);
+    for (i = 0; i < count; ++i)
+    {
+        if (!strcmp(entries[i].md5, md5))
+            count_per_op = entries[i].count_per_op;
+    }
+
+    free(entries);
+    free(path);
+    return count_per_op;
+}
+
+static void count_tuner_save(const char* md5, unsigned int count_per_op)
+{
+    struct count_tuner_entry* entries;
+    char* path = count_tuner_path();
+    size_t count, i;
+
+    if (path == NULL)
+        return;
+
+    entries = read_entries(path, &count);
+    for (i = 0; i < count; ++i)
+    {
+        if (!strcmp(entries[i].md5, md5))
+            break;
+    }
+
+    if (i == count)
+    {
+        struct count_tuner_entry* new_entries = realloc(entries, (count + 1) * sizeof(*entries));
+        if (new_entries == NULL)
+        {
+            free(entries);
+            free(path);
+            return;
+        }
+        entries = new_entries;
+        strcpy(entries[count++].md5, md5);
+    }
+
+    entries[i].count_per_op = count_per_op;
+    write_entries(path, entries, count);
+
+    free(entries);
+    free(path);
+}
+
+void count_tuner_start(const char* md5, unsigned int count_per_op, int emumode)
+{
+#ifdef NEW_DYNAREC
+    int supported = (emumode == EMUMODE_INTERPRETER);
+#else
+    int supported = (emumode == EMUMODE_INTERPRETER || emumode == EMUMODE_DYNAREC);
+#endif
+
+    memset(&l_tuner, 0, sizeof(l_tuner));
+
+    if (!supported || strlen(md5) != 32)
+    {
+        DebugMessage(M64MSG_WARNING, "CountPerOp auto-tuning is not available with this CPU emulator");
+        return;
+    }
+
+    l_tuner.enabled = 1;
+    strcpy(l_tuner.md5, md5);
+    l_tuner.count_per_op = count_per_op;
+
+    memset(&g_dev.r4300.cached_interp.op_cost_stats, 0, sizeof(g_dev.r4300.cached_interp.op_cost_stats));
+    g_dev.r4300.cached_interp.op_cost_stats.enabled = 1;
+}
+
+void count_tuner_new_vi(void)
+{
+    const struct idle_loop_stats* idle_stats = &g_dev.r4300.cached_interp.idle_loop_stats;
+    uint32_t count;
+    uint64_t idle_cycles;
+
+    if (!l_tuner.enabled)
+        return;
+
+    count = r4300_cp0_regs(&g_dev.r4300.cp0)[CP0_COUNT_REG];
+    idle_cycles = idle_stats->cycles + idle_stats->pending_cycles;
+
+    if (l_tuner.have_last)
+    {
+        uint32_t elapsed = count - l_tuner.last_count;
+        uint64_t idled = idle_cycles - l_tuner.last_idle_cycles;
+
+        if (elapsed != 0 && elapsed <= COUNT_TUNER_MAX_FRAME_CYCLES && idled <= elapsed)
+        {
+            unsigned int bucket = (unsigned int)(idled * COUNT_TUNER_BUCKETS / elapsed);
+            if (bucket >= COUNT_TUNER_BUCKETS)
+                bucket = COUNT_TUNER_BUCKETS - 1;
+
+            ++l_tuner.histogram[bucket];
+            ++l_tuner.frames;
+        }
+    }
+
+    l_tuner.have_last = 1;
+    l_tuner.last_count = count;
+    l_tuner.last_idle_cycles = idle_cycles;
+}
+
+void count_tuner_stop(void)
+{
+    struct op_cost_stats* cost_stats = &g_dev.r4300.cached_interp.op_cost_stats;
+    unsigned int busiest, frames, idle_percent;
+    unsigned int cost, hw_count_per_op, suggestion;
+    unsigned int c = l_tuner.count_per_op;
+    unsigned int i;
+
+    if (!l_tuner.enabled)
+        return;
+
+    l_tuner.enabled = 0;
+    cost_stats->enabled = 0;
+
+    if (l_tuner.frames < COUNT_TUNER_MIN_FRAMES)
+    {
+        DebugMessage(M64MSG_VERBOSE, "CountPerOp auto-tuning: %u frames profiled, not enough to suggest a value", l_tuner.frames);
+        return;
+    }
+
+    /* idle share of the busiest frames */
+    busiest = (l_tuner.frames * COUNT_TUNER_BUSIEST_PERCENT + 99) / 100;
+    for (i = 0, frames = 0; i < COUNT_TUNER_BUCKETS - 1; ++i)
+    {
+        frames += l_tuner.histogram[i];
+        if (frames >= busiest)
+            break;
+    }
+    idle_percent = i * (100 / COUNT_TUNER_BUCKETS);
+
+    /* COUNT cycles per op the sampled code would take on hardware, in 1/256 */
+    cost = (cost_stats->samples != 0) ? (unsigned int)(cost_stats->cost / cost_stats->samples) : 256;
+    hw_count_per_op = (cost + 256) / 512;
+    if (hw_count_per_op < 1)
+        hw_count_per_op = 1;
+
+    if (idle_percent < COUNT_TUNER_BUSY_PERCENT)
+    {
+        /* the game may be running slow: give it more instructions per frame */
+        suggestion = (c > 1) ? c - 1 : 1;
+        if (suggestion < hw_count_per_op)
+            suggestion = hw_count_per_op;
+        if (suggestion > c)
+            suggestion = c;
+    }
+    else
+    {
+        /* spend the busiest frames idle time, minus some headroom */
+        suggestion = c * (100 - COUNT_TUNER_MARGIN_PERCENT) / (100 - idle_percent);
+        if (suggestion < c)
+            suggestion = c;
+        if (suggestion > COUNT_TUNER_MAX_COUNT_PER_OP)
+            suggestion = COUNT_TUNER_MAX_COUNT_PER_OP;
+    }
+
+    DebugMessage(M64MSG_INFO, "CountPerOp auto-tuning: suggesting %u (was %u): busiest frames %u%% idle, %u.%02u cycles per op over %u frames",
+        suggestion, c, idle_percent, cost / 256, (cost % 256) * 100 / 256, l_tuner.frames);
+
+    count_tuner_save(l_tuner.md5, suggestion);
+}
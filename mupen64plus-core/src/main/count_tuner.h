@@ -0,0 +1,49 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - count_tuner.h                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_COUNT_TUNER_H
+#define M64P_MAIN_COUNT_TUNER_H
+
+/* CountPerOp auto-tuning: finds the highest CountPerOp (fewest emulated
+ * instructions per frame, thus least host CPU) a game still runs at full
+ * speed with.
+ *
+ * While running, the share of each frame the game spends in idle loops
+ * (see device/r4300/idle_loop.h) and the average cost of the code it runs
+ * (see device/r4300/op_cost.h) are profiled. When emulation stops, the
+ * CountPerOp value which leaves the busiest frames some idle time is stored
+ * for the ROM in the user cache. Busy games get a lower value instead,
+ * though not below what their instruction mix would take on hardware.
+ *
+ * Profiling relies on idle loop skipping, so it is only available with the
+ * cached interpreter and the old dynarec.
+ */
+
+/* CountPerOp stored for the ROM with this MD5, 0 if none */
+unsigned int count_tuner_lookup(const char* md5);
+
+void count_tuner_start(const char* md5, unsigned int count_per_op, int emumode);
+void count_tuner_stop(void);
+
+/* Called on each VI */
+void count_tuner_new_vi(void);
+
+#endif
@@ -0,0 +1,206 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_pacer.c                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "frame_pacer.h"
+
+#include <SDL.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "backends/api/clock_backend.h"
+
+/* drop the schedule when lagging or leading by more than this */
+#define MAX_DRIFT_NS INT64_C(50000000)
+
+/* in audio pacing mode, fall back to the VI period after this many frames without audio */
+#define AUDIO_FALLBACK_FRAMES 8
+
+#define MIN_SLEEP_MARGIN_NS  INT64_C(200000)
+#define MAX_SLEEP_MARGIN_NS  INT64_C(4000000)
+#define INIT_SLEEP_MARGIN_NS INT64_C(2000000)
+
+static struct
+{
+    void* clock;
+    const struct monotonic_clock_backend_interface* iclock;
+    int audio_pacing;
+
+    int64_t deadline;
+    int64_t last_release;   /* 0 before the first frame */
+    int64_t sleep_margin;
+    double audio_duration;  /* audio produced since the previous frame (ns) */
+    unsigned int frames_without_audio;
+
+    m64p_frame_pacer_stats stats;
+} l_pacer;
+
+static int64_t get_time(void)
+{
+    return (int64_t)l_pacer.iclock->get_time_ns(l_pacer.clock);
+}
+
+static void record(unsigned int* histogram, int64_t duration)
+{
+    unsigned int i = 0;
+    uint64_t us = (duration > 0) ? (uint64_t)duration / 1000 : 0;
+
+    while (us >= 2 && i < M64P_FRAME_PACER_BUCKETS - 1) {
+        us >>= 1;
+        ++i;
+    }
+
+    ++histogram[i];
+}
+
+static int64_t sleep_until(int64_t deadline)
+{
+    int64_t now = get_time();
+    int64_t sleep_time = deadline - now - l_pacer.sleep_margin;
+
+    /* coarse sleep, leaving the margin for the spin below */
+    if (sleep_time >= 1000000) {
+        unsigned int ms = (unsigned int)(sleep_time / 1000000);
+        int64_t wake, target;
+
+        SDL_Delay(ms);
+        wake = get_time();
+
+        /* follow late wakeups immediately, relax slowly otherwise */
+        target = (wake - now) - (int64_t)ms * 1000000 + MIN_SLEEP_MARGIN_NS;
+        if (target > l_pacer.sleep_margin) {
+            l_pacer.sleep_margin = target;
+        }
+        else {
+            l_pacer.sleep_margin -= (l_pacer.sleep_margin - target) / 16;
+        }
+
+        if (l_pacer.sleep_margin < MIN_SLEEP_MARGIN_NS) {
+            l_pacer.sleep_margin = MIN_SLEEP_MARGIN_NS;
+        }
+        else if (l_pacer.sleep_margin > MAX_SLEEP_MARGIN_NS) {
+            l_pacer.sleep_margin = MAX_SLEEP_MARGIN_NS;
+        }
+
+        now = wake;
+    }
+
+    while (now < deadline) {
+        now = get_time();
+    }
+
+    return now;
+}
+
+void frame_pacer_start(void* clock, const struct monotonic_clock_backend_interface* iclock, int audio_pacing)
+{
+    memset(&l_pacer, 0, sizeof(l_pacer));
+
+    l_pacer.clock = clock;
+    l_pacer.iclock = iclock;
+    l_pacer.audio_pacing = audio_pacing;
+    l_pacer.sleep_margin = INIT_SLEEP_MARGIN_NS;
+}
+
+void frame_pacer_stop(void)
+{
+    unsigned int i, late = 0;
+
+    if (l_pacer.iclock == NULL) {
+        return;
+    }
+
+    /* frames released more than 1ms after their deadline */
+    for (i = 10; i < M64P_FRAME_PACER_BUCKETS; ++i) {
+        late += l_pacer.stats.overshoot[i];
+    }
+
+    DebugMessage(M64MSG_VERBOSE, "Frame pacer: %u frames, %u late by more than 1ms, %u resyncs, sleep margin %u us",
+        l_pacer.stats.frames, late, l_pacer.stats.resyncs, l_pacer.stats.sleep_margin_us);
+
+    l_pacer.iclock = NULL;
+}
+
+void frame_pacer_push_audio(size_t size, unsigned int frequency)
+{
+    if (frequency != 0) {
+        l_pacer.audio_duration += (double)(size / 4) * 1000000000.0 / frequency;
+    }
+}
+
+void frame_pacer_wait(double frame_duration, double time_scale, int limit)
+{
+    int64_t now, release;
+    double duration = frame_duration;
+
+    if (l_pacer.iclock == NULL) {
+        return;
+    }
+
+    now = get_time();
+
+    if (l_pacer.audio_pacing) {
+        if (l_pacer.audio_duration > 0) {
+            duration = l_pacer.audio_duration;
+            l_pacer.frames_without_audio = 0;
+        }
+        else if (++l_pacer.frames_without_audio < AUDIO_FALLBACK_FRAMES) {
+            /* audio is produced in bursts, the next frames will catch up */
+            duration = 0;
+        }
+        l_pacer.audio_duration = 0;
+    }
+
+    if (l_pacer.last_release == 0) {
+        l_pacer.deadline = now;
+    }
+    else {
+        record(l_pacer.stats.emulation, now - l_pacer.last_release);
+        l_pacer.deadline += (int64_t)(duration * time_scale);
+    }
+
+    if (!limit) {
+        l_pacer.deadline = now;
+    }
+    else if (l_pacer.deadline < now - MAX_DRIFT_NS
+          || l_pacer.deadline > now + (int64_t)(MAX_DRIFT_NS * time_scale)) {
+        /* after a pause or a long stall, start over instead of rushing */
+        l_pacer.deadline = now;
+        ++l_pacer.stats.resyncs;
+    }
+
+    release = (l_pacer.deadline > now)
+        ? sleep_until(l_pacer.deadline)
+        : now;
+
+    record(l_pacer.stats.idle, release - now);
+    record(l_pacer.stats.overshoot, release - l_pacer.deadline);
+    ++l_pacer.stats.frames;
+    l_pacer.stats.sleep_margin_us = (unsigned int)(l_pacer.sleep_margin / 1000);
+
+    l_pacer.last_release = release;
+}
+
+void frame_pacer_get_stats(m64p_frame_pacer_stats* stats)
+{
+    memcpy(stats, &l_pacer.stats, sizeof(*stats));
+}
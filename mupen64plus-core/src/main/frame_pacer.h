@@ -0,0 +1,55 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_pacer.h                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_FRAME_PACER_H
+#define M64P_MAIN_FRAME_PACER_H
+
+#include <stddef.h>
+
+#include "api/m64p_types.h"
+
+struct monotonic_clock_backend_interface;
+
+/* Frame pacer: releases each emulated frame at its deadline.
+ *
+ * Deadlines are kept on a nanosecond monotonic clock. The pacer sleeps until
+ * shortly before a deadline, then spins for the remaining time. The margin
+ * kept for spinning follows the wakeup latency measured after each sleep.
+ *
+ * In audio pacing mode, deadlines advance by the duration of the audio
+ * samples produced during the frame instead of the VI period, so that audio
+ * is produced at the rate it is played.
+ */
+
+void frame_pacer_start(void* clock, const struct monotonic_clock_backend_interface* iclock, int audio_pacing);
+void frame_pacer_stop(void);
+
+/* Account samples pushed to the audio output (4 bytes per stereo sample) */
+void frame_pacer_push_audio(size_t size, unsigned int frequency);
+
+/* Wait for the deadline of the current frame.
+ * frame_duration is the VI period in nanoseconds, time_scale the inverse of
+ * the speed factor. When limit is 0, frames are only measured. */
+void frame_pacer_wait(double frame_duration, double time_scale, int limit);
+
+void frame_pacer_get_stats(m64p_frame_pacer_stats* stats);
+
+#endif
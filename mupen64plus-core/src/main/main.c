@@ -53,6 +53,7 @@
 #include "backends/api/video_capture_backend.h"
 #include "backends/plugins_compat/plugins_compat.h"
 #include "backends/clock_ctime_plus_delta.h"
+#include "backends/clock_monotonic.h"
 #include "backends/file_storage.h"
 #include "cheat.h"
 #include "device/device.h"
@@ -65,6 +66,7 @@
 #include "device/gb/gb_cart.h"
 #include "device/pif/bootrom_hle.h"
 #include "eventloop.h"
+#include "frame_pacer.h"
 #include "main.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
@@ -74,8 +76,11 @@
 #include "profile.h"
 #endif
 #include "rom.h"
+#include "runahead.h"
+#include "count_tuner.h"
 #include "savestates.h"
 #include "screenshot.h"
+#include "snapshot.h"
 #include "util.h"
 #include "netplay.h"
 
@@ -427,6 +432,7 @@ int main_set_core_defaults(void)
     ConfigSetDefaultBool(g_CoreConfig, "DisableExtraMem", 0, "Disable 4MB expansion RAM pack. May be necessary for some games");
     ConfigSetDefaultInt(g_CoreConfig, "CountPerOp", 0, "Force number of cycles per emulated instruction");
     ConfigSetDefaultInt(g_CoreConfig, "CountPerOpDenomPot", 0, "Reduce number of cycles per update by power of two when set greater than 0 (overclock)");
+    ConfigSetDefaultBool(g_CoreConfig, "CountPerOpAutoTune", 0, "When CountPerOp is 0, profile how much each game idles and use the highest CountPerOp it still runs at full speed with on the next runs (Cached Interpreter or Dynamic Recompiler)");
     ConfigSetDefaultBool(g_CoreConfig, "AutoStateSlotIncrement", 0, "Increment the save state slot after each save operation");
     ConfigSetDefaultInt(g_CoreConfig, "CurrentStateSlot", 0, "Save state slot (0-9) to use when saving/loading the emulator state");
     ConfigSetDefaultBool(g_CoreConfig, "EnableDebugger", 0, "Activate the R4300 debugger when ROM execution begins, if core was built with Debugger support");
@@ -436,6 +442,14 @@ int main_set_core_defaults(void)
     ConfigSetDefaultString(g_CoreConfig, "SharedDataPath", "", "Path to a directory to search when looking for shared data files");
     ConfigSetDefaultBool(g_CoreConfig, "RandomizeInterrupt", 1, "Randomize PI/SI Interrupt Timing");
     ConfigSetDefaultInt(g_CoreConfig, "SiDmaDuration", -1, "Duration of SI DMA (-1: use per game settings)");
+    ConfigSetDefaultBool(g_CoreConfig, "LazyPiDma", 0, "Defer cartridge ROM DMA copies until their data is accessed (interpreters only)");
+    ConfigSetDefaultInt(g_CoreConfig, "SaveWritebackDelay", 500, "Delay in milliseconds before in-game saves are written to disk by a background thread (0: write synchronously)");
+    ConfigSetDefaultBool(g_CoreConfig, "AudioPacing", 0, "Pace frames on the duration of the audio produced instead of the VI rate");
+    ConfigSetDefaultBool(g_CoreConfig, "CowSavestates", 0, "Capture savestate memories by write-protecting them instead of copying them upfront (not suitable for plugins writing RDRAM from the GPU)");
+    ConfigSetDefaultInt(g_CoreConfig, "RunAheadFrames", 0, "Number of frames emulated ahead of time to reduce input latency (0 to disable, not available in netplay)");
+    ConfigSetDefaultInt(g_CoreConfig, "NetplayRollbackFrames", 0, "Number of frames netplay can roll back to hide late inputs (0 for delay-based netplay, up to 10)");
+    ConfigSetDefaultInt(g_CoreConfig, "NetplayLoopbackLatency", 0, "Latency in milliseconds added to packets received in netplay, for testing");
+    ConfigSetDefaultInt(g_CoreConfig, "NetplayLoopbackLoss", 0, "Percentage of netplay packets dropped on purpose, for testing");
     ConfigSetDefaultString(g_CoreConfig, "GbCameraVideoCaptureBackend1", DEFAULT_VIDEO_CAPTURE_BACKEND, "Gameboy Camera Video Capture backend");
     ConfigSetDefaultInt(g_CoreConfig, "SaveDiskFormat", 1, "Disk Save Format (0: Full Disk Copy (*.ndr/*.d6r), 1: RAM Area Only (*.ram))");
     ConfigSetDefaultInt(g_CoreConfig, "SaveFilenameFormat", 1, "Save (SRAM/State) Filename Format (0: ROM Header Name, 1: Automatic (including partial MD5 hash))");
@@ -948,6 +962,10 @@ static void video_plugin_render_callback(int bScreenRedrawn)
 
 void new_frame(void)
 {
+    /* frames emulated ahead will be emulated again */
+    if (runahead_is_ahead() || netplay_is_resimulating())
+        return;
+
     if (g_FrameCallback != NULL)
         (*g_FrameCallback)(l_CurrentFrame);
 
@@ -963,31 +981,11 @@ void new_frame(void)
 
 static void apply_speed_limiter(void)
 {
-    static unsigned long totalVIs = 0;
-    static int resetOnce = 0;
-    static int lastSpeedFactor = 100;
-    static unsigned int StartFPSTime = 0;
     static const double defaultSpeedFactor = 100.0;
-    unsigned int CurrentFPSTime = SDL_GetTicks();
 
     // calculate frame duration based upon ROM setting (50/60hz) and mupen64plus speed adjustment
-    const double VILimitMilliseconds = 1000.0 / g_dev.vi.expected_refresh_rate;
+    const double VILimitNanoseconds = 1000000000.0 / g_dev.vi.expected_refresh_rate;
     const double SpeedFactorMultiple = defaultSpeedFactor/l_SpeedFactor;
-    const double AdjustedLimit = VILimitMilliseconds * SpeedFactorMultiple;
-
-    //if this is the first time or we are resuming from pause
-    if(StartFPSTime == 0 || !resetOnce || lastSpeedFactor != l_SpeedFactor)
-    {
-       StartFPSTime = CurrentFPSTime;
-       totalVIs = 0;
-       resetOnce = 1;
-    }
-    else
-    {
-        ++totalVIs;
-    }
-
-    lastSpeedFactor = l_SpeedFactor;
 
 #if defined(PROFILE)
     timed_section_start(TIMED_SECTION_IDLE);
@@ -997,33 +995,7 @@ static void apply_speed_limiter(void)
     if(g_DebuggerActive) DebuggerCallback(DEBUG_UI_VI, 0);
 #endif
 
-    double totalElapsedGameTime = AdjustedLimit*totalVIs;
-    double elapsedRealTime = CurrentFPSTime - StartFPSTime;
-    double sleepTime = totalElapsedGameTime - elapsedRealTime;
-
-    //Reset if the sleep needed is an unreasonable value
-    static const double minSleepNeeded = -50;
-    static const double maxSleepNeeded = 50;
-    if(sleepTime < minSleepNeeded || sleepTime > (maxSleepNeeded*SpeedFactorMultiple))
-    {
-       resetOnce = 0;
-    }
-
-    if (sleepTime < minSleepNeeded) {
-        totalVIs += (unsigned long)(minSleepNeeded/AdjustedLimit);
-    }
-
-    if(l_MainSpeedLimit && sleepTime > 0 && sleepTime < maxSleepNeeded*SpeedFactorMultiple)
-    {
-        while(sleepTime >= 0) {
-            SDL_Delay((unsigned int) sleepTime);
-
-            CurrentFPSTime = SDL_GetTicks();
-            elapsedRealTime = CurrentFPSTime - StartFPSTime;
-            sleepTime = totalElapsedGameTime - elapsedRealTime;
-        }
-    }
-
+    frame_pacer_wait(VILimitNanoseconds, SpeedFactorMultiple, l_MainSpeedLimit);
 
 #if defined(PROFILE)
     timed_section_end(TIMED_SECTION_IDLE);
@@ -1071,12 +1043,22 @@ void new_vi(void)
 
     gs_apply_cheats(&g_cheat_ctx);
 
-    apply_speed_limiter();
-    main_check_inputs();
+    if (!runahead_is_ahead())
+    {
+        if (!netplay_is_resimulating())
+        {
+            apply_speed_limiter();
+            main_check_inputs();
 
-    pause_loop();
+            pause_loop();
+        }
+
+        netplay_check_sync(&g_dev.r4300.cp0);
+    }
 
-    netplay_check_sync(&g_dev.r4300.cp0);
+    runahead_new_vi();
+    netplay_new_vi();
+    count_tuner_new_vi();
 }
 
 static void main_switch_pak(int control_id)
@@ -1247,6 +1229,21 @@ no_dd:
     *rom_size = 0;
 }
 
+/* MAME and SDK dumps are used in place, so map them instead of reading
+ * them upfront. D64 dumps get expanded and are always loaded. */
+int open_dd_disk_file_storage(struct file_storage* fstorage, const char* filename)
+{
+    size_t size = 0;
+
+    if (get_file_size(filename, &size) == file_ok
+     && (size == MAME_FORMAT_DUMP_SIZE || size == SDK_FORMAT_DUMP_SIZE)
+     && open_mapped_file_storage(fstorage, filename) == file_ok) {
+        return file_ok;
+    }
+
+    return open_rom_file_storage(fstorage, filename);
+}
+
 static int load_dd_disk(struct dd_disk* dd_disk, const struct storage_backend_interface** dd_idisk)
 {
     /* ask the core loader for DD disk filename */
@@ -1291,13 +1288,17 @@ static int load_dd_disk(struct dd_disk* dd_disk, const struct storage_backend_in
     }
 
     /* Try loading *.{nd,d6}r file first (if SaveDiskFormat == 0) */
+    int loaded_save = 0;
     if (save_format == 0)
     {
-        if (open_rom_file_storage(fstorage, save_filename) != file_ok) {
+        if (open_dd_disk_file_storage(fstorage, save_filename) == file_ok) {
+            loaded_save = 1;
+        }
+        else {
             DebugMessage(M64MSG_WARNING, "Failed to load DD Disk save: %s.", save_filename);
 
             /* Try loading regular disk file */
-            if (open_rom_file_storage(fstorage, dd_disk_filename) != file_ok) {
+            if (open_dd_disk_file_storage(fstorage, dd_disk_filename) != file_ok) {
                 DebugMessage(M64MSG_ERROR, "Failed to load DD Disk: %s.", dd_disk_filename);
                 goto free_fstorage;
             }
@@ -1306,7 +1307,7 @@ static int load_dd_disk(struct dd_disk* dd_disk, const struct storage_backend_in
     else
     {
         /* Try loading regular disk file */
-        if (open_rom_file_storage(fstorage, dd_disk_filename) != file_ok) {
+        if (open_dd_disk_file_storage(fstorage, dd_disk_filename) != file_ok) {
             DebugMessage(M64MSG_ERROR, "Failed to load DD Disk: %s.", dd_disk_filename);
             goto free_fstorage;
         }
@@ -1351,7 +1352,9 @@ static int load_dd_disk(struct dd_disk* dd_disk, const struct storage_backend_in
         fstorage_save->filename = save_filename;
         fstorage_save->data = fstorage->data;
         fstorage_save->size = fstorage->size;
-        fstorage_save->first_access = 1;
+        /* The save file already holds the full disk, don't rewrite it
+         * (it may also be the file backing a mapped disk) */
+        fstorage_save->first_access = !loaded_save;
         break;
     case 1: /* RAM only */
         *dd_idisk = &g_istorage_disk_ram_only;
@@ -1582,11 +1585,13 @@ m64p_error main_run(void)
     size_t rdram_size;
     uint32_t count_per_op;
     uint32_t count_per_op_denom_pot;
+    int auto_tune_count_per_op = 0;
     uint32_t emumode;
     uint32_t disable_extra_mem;
     int32_t si_dma_duration;
     int32_t no_compiled_jump;
     int32_t randomize_interrupt;
+    int32_t lazy_pi_dma;
     struct file_storage eep;
     struct file_storage fla;
     struct file_storage sra;
@@ -1629,6 +1634,7 @@ m64p_error main_run(void)
     no_compiled_jump = ConfigGetParamBool(g_CoreConfig, "NoCompiledJump");
     //We disable any randomness for netplay
     randomize_interrupt = !netplay_is_init() ? ConfigGetParamBool(g_CoreConfig, "RandomizeInterrupt") : 0;
+    lazy_pi_dma = ConfigGetParamBool(g_CoreConfig, "LazyPiDma");
     count_per_op = ConfigGetParamInt(g_CoreConfig, "CountPerOp");
     count_per_op_denom_pot = ConfigGetParamInt(g_CoreConfig, "CountPerOpDenomPot");
 
@@ -1637,6 +1643,12 @@ m64p_error main_run(void)
     else
         disable_extra_mem = ConfigGetParamInt(g_CoreConfig, "DisableExtraMem");
 
+    if (count_per_op <= 0 && ConfigGetParamBool(g_CoreConfig, "CountPerOpAutoTune"))
+    {
+        auto_tune_count_per_op = 1;
+        count_per_op = count_tuner_lookup(ROM_SETTINGS.MD5);
+    }
+
     if (count_per_op <= 0)
         count_per_op = ROM_SETTINGS.countperop;
 
@@ -1705,6 +1717,15 @@ m64p_error main_run(void)
     /* open GB cam video device */
     igbcam_backend->open(gbcam_backend, M64282FP_SENSOR_W, M64282FP_SENSOR_H);
 
+    /* start background writeback of in-game saves */
+    int writeback_delay = ConfigGetParamInt(g_CoreConfig, "SaveWritebackDelay");
+    file_storage_writeback_start((writeback_delay > 0) ? (unsigned int)writeback_delay : 0);
+
+    /* capture savestate memories lazily if requested */
+    snapshot_enable(ConfigGetParamBool(g_CoreConfig, "CowSavestates"));
+
+    frame_pacer_start(NULL, &g_iclock_monotonic, ConfigGetParamBool(g_CoreConfig, "AudioPacing"));
+
     /* open storage files, provide default content if not present */
     open_mpk_file(&mpk);
     open_eep_file(&eep);
@@ -1905,6 +1926,7 @@ m64p_error main_run(void)
                 randomize_interrupt,
                 g_start_address,
                 &g_dev.ai, &g_iaudio_out_backend_plugin_compat, ((float)ROM_SETTINGS.aidmamodifier / 100.0),
+                lazy_pi_dma,
                 si_dma_duration,
                 rdram_size,
                 joybus_devices, ijoybus_devices,
@@ -1962,6 +1984,25 @@ m64p_error main_run(void)
         init_debugger();
 #endif
 
+    /* emulate frames ahead of time if requested */
+    int runahead_frames = !netplay_is_init() ? ConfigGetParamInt(g_CoreConfig, "RunAheadFrames") : 0;
+    runahead_start((runahead_frames > 0) ? (unsigned int)runahead_frames : 0);
+
+    /* profile the game to tune CountPerOp for the next runs if requested */
+    if (auto_tune_count_per_op && !netplay_is_init() && runahead_frames <= 0 && count_per_op_denom_pot == 0)
+        count_tuner_start(ROM_SETTINGS.MD5, count_per_op, emumode);
+
+    /* predict remote netplay inputs if requested */
+    if (netplay_is_init())
+    {
+        int rollback_frames = ConfigGetParamInt(g_CoreConfig, "NetplayRollbackFrames");
+        int loopback_latency = ConfigGetParamInt(g_CoreConfig, "NetplayLoopbackLatency");
+        int loopback_loss = ConfigGetParamInt(g_CoreConfig, "NetplayLoopbackLoss");
+        netplay_simulate_network((loopback_latency > 0) ? (unsigned int)loopback_latency : 0,
+                                 (loopback_loss > 0) ? (unsigned int)loopback_loss : 0);
+        netplay_rollback_start((rollback_frames > 0) ? (unsigned int)rollback_frames : 0);
+    }
+
     /* Startup message on the OSD */
     osd_new_message(OSD_MIDDLE_CENTER, "Mupen64Plus Started...");
 
@@ -1972,6 +2013,8 @@ m64p_error main_run(void)
     pif_bootrom_hle_execute(&g_dev.r4300);
     run_device(&g_dev);
 
+    print_pif_stats(&g_dev.pif);
+
     /* now begin to shut down */
 #ifdef WITH_LIRC
     lircStop();
@@ -1981,6 +2024,14 @@ m64p_error main_run(void)
     if (g_DebuggerActive)
         destroy_debugger();
 #endif
+    /* write pending saves before releasing their storages */
+    file_storage_writeback_stop();
+    snapshot_enable(0);
+    frame_pacer_stop();
+    runahead_stop();
+    netplay_rollback_stop();
+    count_tuner_stop();
+
     /* release gb_carts */
     for(i = 0; i < GAME_CONTROLLERS_COUNT; ++i) {
         if (!Controls[i].RawData  && (Controls[i].Type == CONT_TYPE_STANDARD) && g_dev.gb_carts[i].read_gb_cart != NULL) {
@@ -2023,6 +2074,13 @@ on_input_open_failure:
 on_audio_open_failure:
     gfx.romClosed();
 on_gfx_open_failure:
+    file_storage_writeback_stop();
+    snapshot_enable(0);
+    frame_pacer_stop();
+    runahead_stop();
+    netplay_rollback_stop();
+    count_tuner_stop();
+
     /* release gb_carts */
     for(i = 0; i < GAME_CONTROLLERS_COUNT; ++i) {
         if (!Controls[i].RawData  && (Controls[i].Type == CONT_TYPE_STANDARD) && g_dev.gb_carts[i].read_gb_cart != NULL) {
@@ -103,5 +103,8 @@ m64p_error main_reset(int do_hard_reset);
 
 m64p_error open_pif(const unsigned char* pifimage, unsigned int size);
 
+struct file_storage;
+int open_dd_disk_file_storage(struct file_storage* fstorage, const char* filename);
+
 #endif /* __MAIN_H__ */
 
@@ -27,13 +27,30 @@
 #include "util.h"
 #include "plugin/plugin.h"
 #include "backends/plugins_compat/plugins_compat.h"
+#include "backends/clock_monotonic.h"
+#include "device/device.h"
+#include "runahead.h"
+#include "savestates.h"
 #include "netplay.h"
 
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include <stdio.h>
 #include <SDL_net.h>
 #if !defined(WIN32)
 #include <netinet/ip.h>
 #endif
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define netplay_load(p)     _InterlockedCompareExchange((p), 0, 0)
+#define netplay_store(p, v) _InterlockedExchange((p), (v))
+#else
+#define netplay_load(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define netplay_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
 static int l_canFF;
 static int l_netplay_controller;
 static int l_netplay_control[4];
@@ -49,6 +66,7 @@ static struct controller_input_compat *l_cin_compats;
 static uint8_t l_plugin[4];
 static uint8_t l_buffer_target;
 static uint8_t l_player_lag[4];
+static uint8_t l_server_caps;
 
 //UDP packet formats
 #define UDP_SEND_KEY_INFO 0
@@ -56,6 +74,7 @@ static uint8_t l_player_lag[4];
 #define UDP_REQUEST_KEY_INFO 2
 #define UDP_RECEIVE_KEY_INFO_GRATUITOUS 3
 #define UDP_SYNC_DATA 4
+#define UDP_SEND_KEY_INFO_BATCH 5
 
 //TCP packet formats
 #define TCP_SEND_SAVE 1
@@ -66,6 +85,10 @@ static uint8_t l_player_lag[4];
 #define TCP_GET_REGISTRATION 6
 #define TCP_DISCONNECT_NOTICE 7
 
+//Server capabilities, advertised in the upper bits of the registration response
+#define NETPLAY_CAP_ROLLBACK 0x02 //inputs are registered at the count sent, sync data carries a RDRAM hash
+#define NETPLAY_CAP_INPUT_BATCH 0x04 //UDP_SEND_KEY_INFO_BATCH is understood
+
 struct __UDPSocket {
     int ready;
     int channel;
@@ -73,6 +96,339 @@ struct __UDPSocket {
 
 #define CS4 32
 
+//UDP packets are received by an I/O thread and handed to the emulation thread
+//through a single producer, single consumer queue
+#define NETPLAY_QUEUE_SIZE 256 //must be a power of 2
+#define NETPLAY_MAX_DATAGRAM 512
+#define NETPLAY_INPUT_REDUNDANCY 4 //local inputs sent in each packet
+#define NETPLAY_MAX_BATCH 32 //inputs resent at once in rollback mode
+#define NETPLAY_HISTOGRAM_BUCKETS 11
+
+struct netplay_datagram {
+    uint64_t time_ns; //arrival time, or release time while delayed
+    int len;
+    uint8_t data[NETPLAY_MAX_DATAGRAM];
+};
+
+struct netplay_sent_input {
+    uint32_t count;
+    uint32_t keys;
+    uint8_t plugin;
+};
+
+static struct
+{
+    SDL_Thread* thread;
+    SDL_sem* received;
+    SDLNet_SocketSet set;
+    volatile long stop;
+
+    struct netplay_datagram* queue;
+    volatile long head; //written by the I/O thread
+    volatile long tail; //written by the emulation thread
+
+    //network faults simulated for loopback tests
+    volatile long latency_ms;
+    volatile long loss_percent;
+
+    //owned by the I/O thread
+    UDPpacket* packet;
+    struct netplay_datagram* delayed;
+    size_t delayed_count;
+    uint32_t rng_in;
+    unsigned int received_count;
+    unsigned int lost_in;
+    unsigned int overflows;
+
+    //owned by the emulation thread
+    uint32_t rng_out;
+    unsigned int sent_count;
+    unsigned int lost_out;
+    struct netplay_sent_input sent[4][NETPLAY_INPUT_REDUNDANCY];
+    uint32_t acked[4]; //first local input the server has not sent back yet, in rollback mode
+    uint64_t request_ns[4]; //time of the oldest unanswered input request
+    uint64_t rtt_ns[4];
+    unsigned int rtt_histogram[NETPLAY_HISTOGRAM_BUCKETS];
+    unsigned int jitter_histogram[NETPLAY_HISTOGRAM_BUCKETS];
+} l_transport;
+
+//Rollback mode: remote inputs which have not been received yet are predicted,
+//the machine state is saved in memory at the start of each frame,
+//and the frames emulated with a wrong prediction are emulated again once the real input arrives
+#define NETPLAY_MAX_ROLLBACK_FRAMES 10
+#define NETPLAY_INPUT_HISTORY 1024 //inputs kept per player, must be a power of 2
+
+struct netplay_input {
+    uint32_t count;
+    uint32_t buttons;
+    uint32_t frame; //frame during which the input was used
+    uint8_t plugin;
+    uint8_t confirmed; //received from the server, or entered locally
+    uint8_t used;
+};
+
+struct netplay_snapshot {
+    int valid;
+    uint32_t frame;
+    uint32_t netplay_count[4];
+    uint32_t vi_counter;
+    void* state;
+};
+
+enum netplay_rollback_job
+{
+    NETPLAY_JOB_NOTHING,
+    NETPLAY_JOB_SAVE,
+    NETPLAY_JOB_ROLLBACK
+};
+
+static struct
+{
+    //number of frames which can be rolled back, 0 for delay-based netplay
+    unsigned int frames;
+    //frame being emulated, counted from the first VI
+    uint32_t frame;
+    //first frame which is not being emulated again, 0 when not resimulating
+    uint32_t resim_end;
+    int has_target;
+    uint32_t target;
+    enum netplay_rollback_job job;
+
+    struct netplay_snapshot snapshots[NETPLAY_MAX_ROLLBACK_FRAMES + 1];
+    struct netplay_input inputs[4][NETPLAY_INPUT_HISTORY];
+    //first input count not confirmed yet, per player
+    uint32_t unconfirmed[4];
+
+    //sync data is only sent once the inputs of its frame are confirmed
+    int sync_pending;
+    uint32_t sync_frame;
+    uint8_t sync_data[(CP0_REGS_COUNT * 4) + 13];
+    uint32_t sync_len;
+
+    unsigned int rollbacks;
+    unsigned int resimulated;
+    unsigned int mispredictions;
+    unsigned int stalls;
+} l_rollback;
+
+static struct netplay_input* rollback_input(uint8_t control_id, uint32_t count)
+{
+    return &l_rollback.inputs[control_id][count & (NETPLAY_INPUT_HISTORY - 1)];
+}
+
+static int rollback_is_confirmed(uint8_t control_id, uint32_t count)
+{
+    struct netplay_input* input = rollback_input(control_id, count);
+    return (input->count == count && input->confirmed);
+}
+
+static uint32_t netplay_random(uint32_t* state)
+{
+    //xorshift32, only used to simulate packet loss
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static uint64_t netplay_time_ns(void)
+{
+    return g_iclock_monotonic.get_time_ns(NULL);
+}
+
+static void netplay_queue_push(const uint8_t* data, int len, uint64_t time_ns)
+{
+    long head = l_transport.head;
+    long next = (head + 1) & (NETPLAY_QUEUE_SIZE - 1);
+    if (next == netplay_load(&l_transport.tail))
+    {
+        //the emulation thread is not keeping up, the server will send it again
+        ++l_transport.overflows;
+        return;
+    }
+
+    struct netplay_datagram* datagram = &l_transport.queue[head];
+    datagram->time_ns = time_ns;
+    datagram->len = len;
+    memcpy(datagram->data, data, len);
+    netplay_store(&l_transport.head, next);
+    SDL_SemPost(l_transport.received);
+}
+
+static struct netplay_datagram* netplay_queue_peek(void)
+{
+    long tail = l_transport.tail;
+    return (tail != netplay_load(&l_transport.head)) ? &l_transport.queue[tail] : NULL;
+}
+
+static void netplay_queue_pop(void)
+{
+    netplay_store(&l_transport.tail, (l_transport.tail + 1) & (NETPLAY_QUEUE_SIZE - 1));
+}
+
+static void netplay_io_receive(const uint8_t* data, int len)
+{
+    uint64_t now = netplay_time_ns();
+    long latency_ms = netplay_load(&l_transport.latency_ms);
+
+    ++l_transport.received_count;
+    if (netplay_random(&l_transport.rng_in) % 100 < (uint32_t)netplay_load(&l_transport.loss_percent))
+    {
+        ++l_transport.lost_in;
+        return;
+    }
+
+    if (latency_ms == 0 || l_transport.delayed_count == NETPLAY_QUEUE_SIZE)
+    {
+        netplay_queue_push(data, len, now);
+        return;
+    }
+
+    struct netplay_datagram* datagram = &l_transport.delayed[l_transport.delayed_count++];
+    datagram->time_ns = now + (uint64_t)latency_ms * 1000000;
+    datagram->len = len;
+    memcpy(datagram->data, data, len);
+}
+
+static void netplay_io_release(void)
+{
+    uint64_t now = netplay_time_ns();
+    size_t released = 0;
+    while (released < l_transport.delayed_count && l_transport.delayed[released].time_ns <= now)
+    {
+        struct netplay_datagram* datagram = &l_transport.delayed[released++];
+        netplay_queue_push(datagram->data, datagram->len, datagram->time_ns);
+    }
+
+    l_transport.delayed_count -= released;
+    memmove(&l_transport.delayed[0], &l_transport.delayed[released], l_transport.delayed_count * sizeof(l_transport.delayed[0]));
+}
+
+static int netplay_io_thread(void* opaque)
+{
+    //Receives UDP packets as soon as they arrive, so the emulation thread never waits on the socket
+    while (!netplay_load(&l_transport.stop))
+    {
+        if (SDLNet_CheckSockets(l_transport.set, (l_transport.delayed_count != 0) ? 1 : 5) > 0)
+        {
+            while (SDLNet_UDP_Recv(l_udpSocket, l_transport.packet) == 1)
+                netplay_io_receive(l_transport.packet->data, l_transport.packet->len);
+        }
+        netplay_io_release();
+    }
+    return 0;
+}
+
+static void netplay_send_packet(UDPpacket* packet)
+{
+    ++l_transport.sent_count;
+    if (netplay_random(&l_transport.rng_out) % 100 < (uint32_t)netplay_load(&l_transport.loss_percent))
+    {
+        ++l_transport.lost_out;
+        return;
+    }
+    SDLNet_UDP_Send(l_udpSocket, l_udpChannel, packet);
+}
+
+static unsigned int netplay_histogram_bucket(uint64_t ns)
+{
+    //bucket 0 is below 1 ms, bucket n covers [2^(n-1), 2^n) ms
+    uint64_t ms = ns / 1000000;
+    unsigned int bucket = 0;
+    while (ms != 0 && bucket < NETPLAY_HISTOGRAM_BUCKETS - 1)
+    {
+        ms >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+static void netplay_record_rtt(uint8_t player, uint64_t arrival_ns)
+{
+    if (l_transport.request_ns[player] == 0 || arrival_ns < l_transport.request_ns[player])
+        return;
+
+    uint64_t rtt = arrival_ns - l_transport.request_ns[player];
+    ++l_transport.rtt_histogram[netplay_histogram_bucket(rtt)];
+    if (l_transport.rtt_ns[player] != 0)
+    {
+        uint64_t previous = l_transport.rtt_ns[player];
+        ++l_transport.jitter_histogram[netplay_histogram_bucket((rtt > previous) ? rtt - previous : previous - rtt)];
+    }
+    l_transport.rtt_ns[player] = rtt;
+    l_transport.request_ns[player] = 0;
+}
+
+static void netplay_print_histogram(const char* name, const unsigned int* histogram)
+{
+    char text[256];
+    int len = snprintf(text, sizeof(text), "Netplay: %s (ms)", name);
+    for (unsigned int i = 0; i < NETPLAY_HISTOGRAM_BUCKETS && len < (int)sizeof(text); ++i)
+    {
+        if (i == 0)
+            len += snprintf(text + len, sizeof(text) - len, " <1:%u", histogram[i]);
+        else if (i == 1)
+            len += snprintf(text + len, sizeof(text) - len, " 1:%u", histogram[i]);
+        else if (i == NETPLAY_HISTOGRAM_BUCKETS - 1)
+            len += snprintf(text + len, sizeof(text) - len, " >=%u:%u", 1u << (i - 1), histogram[i]);
+        else
+            len += snprintf(text + len, sizeof(text) - len, " %u-%u:%u", 1u << (i - 1), (1u << i) - 1, histogram[i]);
+    }
+    DebugMessage(M64MSG_VERBOSE, "%s", text);
+}
+
+static int netplay_start_transport(void)
+{
+    memset(&l_transport, 0, sizeof(l_transport));
+    l_transport.rng_in = 0x6d2b79f5;
+    l_transport.rng_out = 0x9e3779b9;
+
+    l_transport.queue = malloc(NETPLAY_QUEUE_SIZE * sizeof(*l_transport.queue));
+    l_transport.delayed = malloc(NETPLAY_QUEUE_SIZE * sizeof(*l_transport.delayed));
+    l_transport.packet = SDLNet_AllocPacket(NETPLAY_MAX_DATAGRAM);
+    l_transport.set = SDLNet_AllocSocketSet(1);
+    l_transport.received = SDL_CreateSemaphore(0);
+    if (l_transport.queue == NULL || l_transport.delayed == NULL || l_transport.packet == NULL
+     || l_transport.set == NULL || l_transport.received == NULL
+     || SDLNet_UDP_AddSocket(l_transport.set, l_udpSocket) < 0)
+        return 0;
+
+#if SDL_VERSION_ATLEAST(2,0,0)
+    l_transport.thread = SDL_CreateThread(netplay_io_thread, "m64pnetplay", NULL);
+#else
+    l_transport.thread = SDL_CreateThread(netplay_io_thread, NULL);
+#endif
+    return (l_transport.thread != NULL);
+}
+
+static void netplay_stop_transport(void)
+{
+    if (l_transport.thread != NULL)
+    {
+        netplay_store(&l_transport.stop, 1);
+        SDL_WaitThread(l_transport.thread, NULL);
+
+        DebugMessage(M64MSG_VERBOSE, "Netplay: %u packets sent, %u received, %u dropped by the receive queue",
+            l_transport.sent_count, l_transport.received_count, l_transport.overflows);
+        if (l_transport.lost_in != 0 || l_transport.lost_out != 0)
+            DebugMessage(M64MSG_VERBOSE, "Netplay: %u sent and %u received packets lost on purpose",
+                l_transport.lost_out, l_transport.lost_in);
+        netplay_print_histogram("input request round trip", l_transport.rtt_histogram);
+        netplay_print_histogram("round trip jitter", l_transport.jitter_histogram);
+    }
+
+    if (l_transport.received != NULL)
+        SDL_DestroySemaphore(l_transport.received);
+    if (l_transport.set != NULL)
+        SDLNet_FreeSocketSet(l_transport.set);
+    if (l_transport.packet != NULL)
+        SDLNet_FreePacket(l_transport.packet);
+    free(l_transport.delayed);
+    free(l_transport.queue);
+    memset(&l_transport, 0, sizeof(l_transport));
+}
+
 m64p_error netplay_start(const char* host, int port)
 {
     if (SDLNet_Init() < 0)
@@ -115,6 +471,17 @@ m64p_error netplay_start(const char* host, int port)
         return M64ERR_SYSTEM_FAIL;
     }
 
+    if (!netplay_start_transport())
+    {
+        DebugMessage(M64MSG_ERROR, "Netplay: could not start the network thread");
+        netplay_stop_transport();
+        SDLNet_TCP_Close(l_tcpSocket);
+        SDLNet_UDP_Close(l_udpSocket);
+        l_tcpSocket = NULL;
+        l_udpSocket = NULL;
+        return M64ERR_SYSTEM_FAIL;
+    }
+
     for (int i = 0; i < 4; ++i)
     {
         l_netplay_control[i] = -1;
@@ -129,6 +496,7 @@ m64p_error netplay_start(const char* host, int port)
     l_vi_counter = 0;
     l_status = 0;
     l_reg_id = 0;
+    l_server_caps = 0;
 
     return M64ERR_SUCCESS;
 }
@@ -159,6 +527,7 @@ m64p_error netplay_stop()
         SDLNet_Write32(l_reg_id, &output_data[1]);
         SDLNet_TCP_Send(l_tcpSocket, &output_data[0], 5);
 
+        netplay_stop_transport();
         SDLNet_UDP_Unbind(l_udpSocket, l_udpChannel);
         SDLNet_UDP_Close(l_udpSocket);
         SDLNet_TCP_Close(l_tcpSocket);
@@ -180,6 +549,15 @@ static uint8_t buffer_size(uint8_t control_id)
 {
     //This function returns the size of the local input buffer
     uint8_t counter = 0;
+    if (l_rollback.frames != 0)
+    {
+        //in rollback mode, the inputs received ahead of the current count
+        uint32_t count = l_cin_compats[control_id].netplay_count;
+        while (counter < UINT8_MAX && rollback_is_confirmed(control_id, count + counter))
+            ++counter;
+        return counter;
+    }
+
     struct netplay_event* current = l_cin_compats[control_id].event_first;
     while (current != NULL)
     {
@@ -189,18 +567,21 @@ static uint8_t buffer_size(uint8_t control_id)
     return counter;
 }
 
-static void netplay_request_input(uint8_t control_id)
+static void netplay_request_input(uint8_t control_id, uint32_t count)
 {
     UDPpacket *packet = SDLNet_AllocPacket(12);
     packet->data[0] = UDP_REQUEST_KEY_INFO;
     packet->data[1] = control_id; //The player we need input for
     SDLNet_Write32(l_reg_id, &packet->data[2]); //our registration ID
-    SDLNet_Write32(l_cin_compats[control_id].netplay_count, &packet->data[6]); //the current event count
+    SDLNet_Write32(count, &packet->data[6]); //the event count we need
     packet->data[10] = l_spectator; //whether we are a spectator
     packet->data[11] = buffer_size(control_id); //our local buffer size
     packet->len = 12;
-    SDLNet_UDP_Send(l_udpSocket, l_udpChannel, packet);
+    netplay_send_packet(packet);
     SDLNet_FreePacket(packet);
+
+    if (l_transport.request_ns[control_id] == 0)
+        l_transport.request_ns[control_id] = netplay_time_ns();
 }
 
 static int check_valid(uint8_t control_id, uint32_t count)
@@ -216,34 +597,52 @@ static int check_valid(uint8_t control_id, uint32_t count)
     return 0;
 }
 
-static int netplay_require_response(void* opaque)
+static void rollback_request(uint32_t frame)
 {
-    //This function runs inside a thread.
-    //It runs if our local buffer size is 0 (we need to execute a key event, but we don't have the data we need).
-    //We basically beg the server for input data.
-    //After 10 seconds a timeout occurs, we assume we have lost connection to the server.
-    uint8_t control_id = *(uint8_t*)opaque;
-    uint32_t timeout = SDL_GetTicks() + 10000;
-    while (!check_valid(control_id, l_cin_compats[control_id].netplay_count))
+    if (!l_rollback.has_target || (int32_t)(frame - l_rollback.target) < 0)
+        l_rollback.target = frame;
+    l_rollback.has_target = 1;
+}
+
+static void rollback_receive(uint8_t player, uint32_t count, uint32_t keys, uint8_t plugin)
+{
+    //inputs too far from the current count to be kept are requested again later
+    uint32_t ahead = count - l_cin_compats[player].netplay_count;
+    if (ahead >= NETPLAY_INPUT_HISTORY / 2 && -ahead > NETPLAY_INPUT_HISTORY / 2)
+        return;
+
+    struct netplay_input* input = rollback_input(player, count);
+    if (input->count == count && input->confirmed)
+        return;
+
+    if (input->count == count && input->used)
     {
-        if (SDL_GetTicks() > timeout)
+        //the prediction was wrong, emulate again from the frame which used it
+        if (input->buttons != keys || input->plugin != plugin)
         {
-            l_udpChannel = -1;
-            return 0;
+            ++l_rollback.mispredictions;
+            rollback_request(input->frame);
         }
-        netplay_request_input(control_id);
-        SDL_Delay(5);
     }
-    return 1;
+    else
+        input->used = 0;
+
+    input->count = count;
+    input->buttons = keys;
+    input->plugin = plugin;
+    input->confirmed = 1;
+
+    while (rollback_is_confirmed(player, l_rollback.unconfirmed[player]))
+        ++l_rollback.unconfirmed[player];
 }
 
 static void netplay_process()
 {
-    //In this function we process data we have received from the server
-    UDPpacket *packet = SDLNet_AllocPacket(512);
+    //In this function we process data the I/O thread has received from the server
+    struct netplay_datagram* packet;
     uint32_t curr, count, keys;
     uint8_t plugin, player, current_status;
-    while (SDLNet_UDP_Recv(l_udpSocket, packet) == 1)
+    while ((packet = netplay_queue_peek()) != NULL)
     {
         switch (packet->data[0])
         {
@@ -254,7 +653,10 @@ static void netplay_process()
                 //it will let us know if another player has disconnected, or the games have desynced
                 current_status = packet->data[2];
                 if (packet->data[0] == UDP_RECEIVE_KEY_INFO)
+                {
                     l_player_lag[player] = packet->data[3];
+                    netplay_record_rtt(player, packet->time_ns);
+                }
                 if (current_status != l_status)
                 {
                     if (((current_status & 0x1) ^ (l_status & 0x1)) != 0)
@@ -274,6 +676,22 @@ static void netplay_process()
                     count = SDLNet_Read32(&packet->data[curr]);
                     curr += 4;
 
+                    if (l_rollback.frames != 0)
+                    {
+                        keys = SDLNet_Read32(&packet->data[curr]);
+                        plugin = packet->data[curr + 4];
+                        curr += 5;
+                        //our own inputs coming back tell us which ones the server has
+                        if (l_netplay_control[player] != -1)
+                        {
+                            if (count == l_transport.acked[player])
+                                ++l_transport.acked[player];
+                            continue;
+                        }
+                        rollback_receive(player, count, keys, plugin);
+                        continue;
+                    }
+
                     if (((count - l_cin_compats[player].netplay_count) > (UINT32_MAX / 2)) || (check_valid(player, count))) //event doesn't need to be recorded
                     {
                         curr += 5;
@@ -298,30 +716,133 @@ static void netplay_process()
                 DebugMessage(M64MSG_ERROR, "Netplay: received unknown message from server");
                 break;
         }
+        netplay_queue_pop();
+    }
+}
+
+static void netplay_send_batch(uint8_t control_id)
+{
+    struct netplay_sent_input* sent = l_transport.sent[control_id];
+    UDPpacket *packet = SDLNet_AllocPacket(3 + (NETPLAY_INPUT_REDUNDANCY * 9));
+    if (!(l_server_caps & NETPLAY_CAP_INPUT_BATCH))
+    {
+        //older servers only understand one input per packet
+        packet->data[0] = UDP_SEND_KEY_INFO;
+        packet->data[1] = control_id; //player number
+        SDLNet_Write32(sent[0].count, &packet->data[2]); //event count
+        SDLNet_Write32(sent[0].keys, &packet->data[6]); //key data
+        packet->data[10] = sent[0].plugin; //plugin
+        packet->len = 11;
+        netplay_send_packet(packet);
+        SDLNet_FreePacket(packet);
+        return;
+    }
+
+    packet->data[0] = UDP_SEND_KEY_INFO_BATCH;
+    packet->data[1] = control_id; //player number
+    uint32_t curr = 3;
+    uint8_t n = 0;
+    //newest first, only the inputs right before this one
+    while (n < NETPLAY_INPUT_REDUNDANCY && sent[n].count == sent[0].count - n)
+    {
+        SDLNet_Write32(sent[n].count, &packet->data[curr]); //event count
+        SDLNet_Write32(sent[n].keys, &packet->data[curr + 4]); //key data
+        packet->data[curr + 8] = sent[n].plugin; //plugin
+        curr += 9;
+        ++n;
     }
+    packet->data[2] = n; //number of inputs
+    packet->len = curr;
+    netplay_send_packet(packet);
     SDLNet_FreePacket(packet);
 }
 
-static int netplay_ensure_valid(uint8_t control_id)
+static void netplay_send_input(uint8_t control_id, uint32_t keys)
 {
-    //This function makes sure we have data for a certain event
-    //If we don't have the data, it will create a new thread that will request the data
-    if (check_valid(control_id, l_cin_compats[control_id].netplay_count))
-        return 1;
+    //The previous inputs are sent again with the new one, so a lost packet is recovered by the next one
+    struct netplay_sent_input* sent = l_transport.sent[control_id];
+    memmove(&sent[1], &sent[0], (NETPLAY_INPUT_REDUNDANCY - 1) * sizeof(sent[0]));
+    sent[0].count = l_cin_compats[control_id].netplay_count;
+    sent[0].keys = keys;
+    sent[0].plugin = l_plugin[control_id];
+    netplay_send_batch(control_id);
+}
 
-    if (l_udpChannel == -1)
-        return 0;
+static void rollback_send_inputs(uint8_t control_id)
+{
+    //In rollback mode, the other clients don't wait for our inputs before using them,
+    //so every input the server has not sent back yet is sent again, oldest first
+    uint32_t count = l_transport.acked[control_id];
+    uint32_t end = l_rollback.unconfirmed[control_id];
+    UDPpacket *packet = SDLNet_AllocPacket(3 + (NETPLAY_MAX_BATCH * 9));
+    packet->data[0] = UDP_SEND_KEY_INFO_BATCH;
+    packet->data[1] = control_id; //player number
+    uint32_t curr = 3;
+    uint8_t n = 0;
+    while (n < NETPLAY_MAX_BATCH && count != end)
+    {
+        struct netplay_input* input = rollback_input(control_id, count);
+        SDLNet_Write32(count, &packet->data[curr]); //event count
+        SDLNet_Write32(input->buttons, &packet->data[curr + 4]); //key data
+        packet->data[curr + 8] = input->plugin; //plugin
+        curr += 9;
+        ++count;
+        ++n;
+    }
+    packet->data[2] = n; //number of inputs
+    packet->len = curr;
+    if (n != 0)
+    {
+        netplay_send_packet(packet);
+        //the answer acknowledges them
+        netplay_request_input(control_id, l_transport.acked[control_id]);
+    }
+    SDLNet_FreePacket(packet);
+}
 
-#if SDL_VERSION_ATLEAST(2,0,0)
-    SDL_Thread* thread = SDL_CreateThread(netplay_require_response, "Netplay key request", &control_id);
-#else
-    SDL_Thread* thread = SDL_CreateThread(netplay_require_response, &control_id);
-#endif
-    while (!check_valid(control_id, l_cin_compats[control_id].netplay_count) && l_udpChannel != -1)
+static int netplay_wait_input(uint8_t control_id, uint32_t count, int (*is_valid)(uint8_t, uint32_t))
+{
+    //This function runs if we need to execute a key event, but we don't have the data we need.
+    //We basically beg the server for input data, and process what the I/O thread receives.
+    //After 10 seconds a timeout occurs, we assume we have lost connection to the server.
+    uint32_t timeout = SDL_GetTicks() + 10000;
+    uint32_t next_request = SDL_GetTicks();
+    while (!is_valid(control_id, count))
+    {
+        uint32_t now = SDL_GetTicks();
+        if (l_udpChannel == -1 || now > timeout)
+        {
+            l_udpChannel = -1;
+            return 0;
+        }
+        if ((int32_t)(now - next_request) >= 0)
+        {
+            //our own input may have been lost on its way to the server
+            if (l_rollback.frames != 0)
+            {
+                //the other clients may be stalled on one of our inputs
+                for (uint8_t i = 0; i < 4; ++i)
+                {
+                    if (l_netplay_control[i] != -1)
+                        rollback_send_inputs(i);
+                }
+            }
+            else if (l_netplay_control[control_id] != -1)
+                netplay_send_batch(control_id);
+            netplay_request_input(control_id, count);
+            next_request = now + 5;
+        }
+        SDL_SemWaitTimeout(l_transport.received, 5);
         netplay_process();
-    int success;
-    SDL_WaitThread(thread, &success);
-    return success;
+    }
+    return 1;
+}
+
+static int netplay_ensure_valid(uint8_t control_id)
+{
+    //This function makes sure we have data for a certain event
+    //If we don't have the data, it will request it until it arrives
+    return netplay_wait_input(control_id, l_cin_compats[control_id].netplay_count, check_valid);
 }
 
 static void netplay_delete_event(struct netplay_event* current, uint8_t control_id)
@@ -342,12 +863,8 @@ static void netplay_delete_event(struct netplay_event* current, uint8_t control_
     free(current);
 }
 
-static uint32_t netplay_get_input(uint8_t control_id)
+static void netplay_update_speed(uint8_t control_id)
 {
-    uint32_t keys;
-    netplay_process();
-    netplay_request_input(control_id);
-
     //l_buffer_target is set by the server upon registration
     //l_player_lag is how far behind we are from the lead player
     //buffer_size is the local buffer size
@@ -361,6 +878,14 @@ static uint32_t netplay_get_input(uint8_t control_id)
         main_core_state_set(M64CORE_SPEED_LIMITER, 1);
         l_canFF = 0;
     }
+}
+
+static uint32_t netplay_get_input(uint8_t control_id)
+{
+    uint32_t keys;
+    netplay_process();
+    netplay_request_input(control_id, l_cin_compats[control_id].netplay_count);
+    netplay_update_speed(control_id);
 
     if (netplay_ensure_valid(control_id))
     {
@@ -384,17 +909,62 @@ static uint32_t netplay_get_input(uint8_t control_id)
     return keys;
 }
 
-static void netplay_send_input(uint8_t control_id, uint32_t keys)
+static int rollback_has_snapshot(uint32_t frame)
 {
-    UDPpacket *packet = SDLNet_AllocPacket(11);
-    packet->data[0] = UDP_SEND_KEY_INFO;
-    packet->data[1] = control_id; //player number
-    SDLNet_Write32(l_cin_compats[control_id].netplay_count, &packet->data[2]); // current event count
-    SDLNet_Write32(keys, &packet->data[6]); //key data
-    packet->data[10] = l_plugin[control_id]; //current plugin
-    packet->len = 11;
-    SDLNet_UDP_Send(l_udpSocket, l_udpChannel, packet);
-    SDLNet_FreePacket(packet);
+    struct netplay_snapshot* snapshot = &l_rollback.snapshots[frame % (l_rollback.frames + 1)];
+    return (snapshot->valid && snapshot->frame == frame);
+}
+
+static uint32_t rollback_get_input(uint8_t control_id, uint32_t local_keys)
+{
+    uint32_t count = l_cin_compats[control_id].netplay_count;
+    struct netplay_input* input = rollback_input(control_id, count);
+
+    netplay_process();
+    //local inputs are requested back by rollback_send_inputs
+    if (l_netplay_control[control_id] == -1)
+        netplay_request_input(control_id, l_rollback.unconfirmed[control_id]);
+    netplay_update_speed(control_id);
+
+    if (rollback_is_confirmed(control_id, count))
+    {
+        //already known, or being emulated again
+    }
+    else if (l_netplay_control[control_id] != -1)
+    {
+        //local inputs are sent when first used, and again until the server has them
+        input->count = count;
+        input->buttons = local_keys;
+        input->plugin = l_plugin[control_id];
+        input->confirmed = 1;
+        while (rollback_is_confirmed(control_id, l_rollback.unconfirmed[control_id]))
+            ++l_rollback.unconfirmed[control_id];
+        rollback_send_inputs(control_id);
+    }
+    else if (!rollback_has_snapshot(l_rollback.frame) && !netplay_wait_input(control_id, count, rollback_is_confirmed))
+    {
+        //this frame could not be emulated again, the input can't be predicted
+        DebugMessage(M64MSG_ERROR, "Netplay: lost connection to server");
+        main_core_state_set(M64CORE_EMU_STATE, M64EMU_STOPPED);
+        return 0;
+    }
+    else if (!rollback_is_confirmed(control_id, count))
+    {
+        //predict the input is the same as the previous one
+        struct netplay_input* previous = rollback_input(control_id, count - 1);
+        int known = (count != 0 && previous->count == count - 1);
+        input->count = count;
+        input->buttons = known ? previous->buttons : 0;
+        input->plugin = known ? previous->plugin : Controls[control_id].Plugin;
+        input->confirmed = 0;
+    }
+
+    input->used = 1;
+    input->frame = l_rollback.frame;
+    Controls[control_id].Plugin = input->plugin;
+    ++l_cin_compats[control_id].netplay_count;
+
+    return input->buttons;
 }
 
 uint8_t netplay_register_player(uint8_t player, uint8_t plugin, uint8_t rawdata, uint32_t reg_id)
@@ -414,7 +984,8 @@ uint8_t netplay_register_player(uint8_t player, uint8_t plugin, uint8_t rawdata,
     while (recv < 2)
         recv += SDLNet_TCP_Recv(l_tcpSocket, &response[recv], 2 - recv);
     l_buffer_target = response[1]; //local buffer size target
-    return response[0];
+    l_server_caps = response[0] & ~1; //servers unaware of them only send 0 or 1
+    return response[0] & 1;
 }
 
 int netplay_lag()
@@ -536,10 +1107,31 @@ void netplay_sync_settings(uint32_t *count_per_op, uint32_t *count_per_op_denom_
     }
 }
 
+static void netplay_send_sync(const uint8_t* data, uint32_t len)
+{
+    UDPpacket *packet = SDLNet_AllocPacket(len);
+    memcpy(packet->data, data, len);
+    packet->len = len;
+    netplay_send_packet(packet);
+    SDLNet_FreePacket(packet);
+}
+
+void netplay_simulate_network(unsigned int latency, unsigned int loss)
+{
+    if (!netplay_is_init())
+        return;
+
+    netplay_store(&l_transport.latency_ms, (long)latency);
+    netplay_store(&l_transport.loss_percent, (long)((loss > 100) ? 100 : loss));
+    if (latency != 0 || loss != 0)
+        DebugMessage(M64MSG_INFO, "Netplay: simulating %u ms of latency and %u%% packet loss", latency, loss);
+}
+
 void netplay_check_sync(struct cp0* cp0)
 {
     //This function is used to check if games have desynced
-    //Every 600 VIs, it sends the value of the CP0 registers to the server
+    //Every 600 VIs, it sends the value of the CP0 registers to the server,
+    //and a hash of RDRAM in rollback mode
     //The server will compare the values, and update the status byte if it detects a desync
     if (!netplay_is_init())
         return;
@@ -548,21 +1140,238 @@ void netplay_check_sync(struct cp0* cp0)
 
     if (l_vi_counter % 600 == 0)
     {
-        uint32_t packet_len = (CP0_REGS_COUNT * 4) + 5;
-        UDPpacket *packet = SDLNet_AllocPacket(packet_len);
-        packet->data[0] = UDP_SYNC_DATA;
-        SDLNet_Write32(l_vi_counter, &packet->data[1]); //current VI count
+        uint8_t* data = l_rollback.sync_data;
+        data[0] = UDP_SYNC_DATA;
+        SDLNet_Write32(l_vi_counter, &data[1]); //current VI count
         for (int i = 0; i < CP0_REGS_COUNT; ++i)
         {
-            SDLNet_Write32(cp0_regs[i], &packet->data[(i * 4) + 5]);
+            SDLNet_Write32(cp0_regs[i], &data[(i * 4) + 5]);
         }
-        packet->len = packet_len;
-        SDLNet_UDP_Send(l_udpSocket, l_udpChannel, packet);
-        SDLNet_FreePacket(packet);
+
+        l_rollback.sync_len = (CP0_REGS_COUNT * 4) + 5;
+
+        //in rollback mode, this frame may still be emulated again
+        if (l_rollback.frames != 0)
+        {
+            //only rollback servers expect the hash, RDRAM is hashed as stored,
+            //so only hosts of the same endianness can be compared
+            rdram_flush_pending_dma(&g_dev.rdram);
+            uint64_t hash = XXH3_64bits(g_dev.rdram.dram, g_dev.rdram.dram_size);
+            SDLNet_Write32((uint32_t)(hash >> 32), &data[(CP0_REGS_COUNT * 4) + 5]);
+            SDLNet_Write32((uint32_t)hash, &data[(CP0_REGS_COUNT * 4) + 9]);
+            l_rollback.sync_len += 8;
+
+            l_rollback.sync_pending = 1;
+            l_rollback.sync_frame = l_rollback.frame;
+        }
+        else
+            netplay_send_sync(data, l_rollback.sync_len);
     }
     ++l_vi_counter;
 }
 
+static int rollback_is_final(uint32_t frame)
+{
+    //a frame is final once all the inputs it used are confirmed
+    if (l_rollback.has_target && (int32_t)(l_rollback.target - frame) <= 0)
+        return 0;
+    if ((int32_t)(l_rollback.frame - frame) <= 0)
+        return 0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        struct netplay_input* input = rollback_input(i, l_rollback.unconfirmed[i]);
+        if (input->count == l_rollback.unconfirmed[i] && input->used && (int32_t)(input->frame - frame) <= 0)
+            return 0;
+    }
+    return 1;
+}
+
+void netplay_rollback_start(unsigned int frames)
+{
+    memset(&l_rollback, 0, sizeof(l_rollback));
+
+    if (!netplay_is_init() || frames == 0)
+        return;
+
+    //the server must register inputs where this client predicted them,
+    //and lost inputs are sent again in batches
+    if ((l_server_caps & (NETPLAY_CAP_ROLLBACK | NETPLAY_CAP_INPUT_BATCH)) != (NETPLAY_CAP_ROLLBACK | NETPLAY_CAP_INPUT_BATCH))
+    {
+        DebugMessage(M64MSG_WARNING, "Netplay: the server does not support rollback, using delay-based netplay");
+        return;
+    }
+
+    if (frames > NETPLAY_MAX_ROLLBACK_FRAMES)
+        frames = NETPLAY_MAX_ROLLBACK_FRAMES;
+
+    for (unsigned int i = 0; i <= frames; ++i)
+    {
+        l_rollback.snapshots[i].state = calloc(1, savestates_m64p_mem_size());
+        if (l_rollback.snapshots[i].state == NULL)
+        {
+            DebugMessage(M64MSG_WARNING, "Netplay: failed to allocate rollback states, using delay-based netplay");
+            for (unsigned int j = 0; j < i; ++j)
+                free(l_rollback.snapshots[j].state);
+            memset(&l_rollback, 0, sizeof(l_rollback));
+            return;
+        }
+    }
+
+    l_rollback.frames = frames;
+
+    DebugMessage(M64MSG_INFO, "Netplay: rollback enabled: %u frame(s)", frames);
+}
+
+void netplay_rollback_stop(void)
+{
+    if (l_rollback.frames == 0)
+        return;
+
+    if (l_rollback.resim_end != 0)
+    {
+        runahead_show_video(1);
+        runahead_play_audio(1);
+    }
+
+    DebugMessage(M64MSG_VERBOSE, "Netplay: %u rollbacks, %u frames emulated again, %u mispredictions, %u stalls",
+        l_rollback.rollbacks, l_rollback.resimulated, l_rollback.mispredictions, l_rollback.stalls);
+
+    for (unsigned int i = 0; i <= l_rollback.frames; ++i)
+        free(l_rollback.snapshots[i].state);
+    memset(&l_rollback, 0, sizeof(l_rollback));
+}
+
+int netplay_is_resimulating(void)
+{
+    return (l_rollback.resim_end != 0);
+}
+
+void netplay_new_vi(void)
+{
+    if (l_rollback.frames == 0)
+        return;
+
+    if (++l_rollback.frame == l_rollback.resim_end)
+    {
+        l_rollback.resim_end = 0;
+        runahead_show_video(1);
+        runahead_play_audio(1);
+    }
+
+    //the oldest predicted input must be confirmed before its frame leaves the snapshots
+    for (int i = 0; i < 4; ++i)
+    {
+        uint32_t count = l_rollback.unconfirmed[i];
+        struct netplay_input* input = rollback_input(i, count);
+        if (input->count == count && input->used && input->frame + l_rollback.frames <= l_rollback.frame)
+        {
+            ++l_rollback.stalls;
+            if (!netplay_wait_input(i, count, rollback_is_confirmed))
+            {
+                DebugMessage(M64MSG_ERROR, "Netplay: lost connection to server");
+                main_core_state_set(M64CORE_EMU_STATE, M64EMU_STOPPED);
+                break;
+            }
+        }
+    }
+
+    if (l_rollback.sync_pending && rollback_is_final(l_rollback.sync_frame))
+    {
+        netplay_send_sync(l_rollback.sync_data, l_rollback.sync_len);
+        l_rollback.sync_pending = 0;
+    }
+
+    l_rollback.job = l_rollback.has_target ? NETPLAY_JOB_ROLLBACK : NETPLAY_JOB_SAVE;
+}
+
+static void rollback_save(void)
+{
+    struct netplay_snapshot* snapshot = &l_rollback.snapshots[l_rollback.frame % (l_rollback.frames + 1)];
+
+    rdram_flush_pending_dma(&g_dev.rdram);
+    savestates_save_m64p_mem(&g_dev, snapshot->state);
+
+    snapshot->valid = 1;
+    snapshot->frame = l_rollback.frame;
+    for (int i = 0; i < 4; ++i)
+        snapshot->netplay_count[i] = l_cin_compats[i].netplay_count;
+    snapshot->vi_counter = l_vi_counter;
+}
+
+static void rollback_restore(void)
+{
+    uint32_t target = l_rollback.target;
+    struct netplay_snapshot* snapshot = &l_rollback.snapshots[target % (l_rollback.frames + 1)];
+
+    l_rollback.has_target = 0;
+
+    if (!rollback_has_snapshot(target))
+    {
+        DebugMessage(M64MSG_ERROR, "Netplay: no state saved for frame %u, can't roll back", target);
+        rollback_save();
+        return;
+    }
+
+    //mispredictions are frequent, so this must stay cheap: in-memory loads only
+    //invalidate the cached code of the dram pages which changed since the
+    //snapshot, and skip the plugin side effects of loading a state file
+    rdram_flush_pending_dma(&g_dev.rdram);
+    if (!savestates_load_m64p_mem(&g_dev, snapshot->state))
+    {
+        DebugMessage(M64MSG_ERROR, "Netplay: failed to restore the state of frame %u", target);
+        rollback_save();
+        return;
+    }
+#if defined(M64P_BIG_ENDIAN)
+    //the state was byteswapped in place, it may be needed again
+    savestates_save_m64p_mem(&g_dev, snapshot->state);
+#endif
+
+    //inputs used after the target will be used again
+    for (int i = 0; i < 4; ++i)
+    {
+        for (uint32_t count = snapshot->netplay_count[i]; count != l_cin_compats[i].netplay_count; ++count)
+        {
+            struct netplay_input* input = rollback_input(i, count);
+            if (input->count == count)
+                input->used = 0;
+        }
+        l_cin_compats[i].netplay_count = snapshot->netplay_count[i];
+    }
+    l_vi_counter = snapshot->vi_counter;
+
+    //outputs are muted until the frame which was about to be emulated
+    if (l_rollback.resim_end == 0 && target != l_rollback.frame)
+    {
+        l_rollback.resim_end = l_rollback.frame;
+        runahead_show_video(0);
+        runahead_play_audio(0);
+    }
+    l_rollback.resimulated += l_rollback.frame - target;
+    ++l_rollback.rollbacks;
+    l_rollback.frame = target;
+}
+
+void netplay_update(void)
+{
+    switch (l_rollback.job)
+    {
+    case NETPLAY_JOB_SAVE:
+        rollback_save();
+        break;
+
+    case NETPLAY_JOB_ROLLBACK:
+        rollback_restore();
+        break;
+
+    default:
+        return;
+    }
+
+    l_rollback.job = NETPLAY_JOB_NOTHING;
+}
+
 void netplay_read_registration(struct controller_input_compat* cin_compats)
 {
     //This function runs right before the game starts
@@ -610,6 +1419,10 @@ void netplay_read_registration(struct controller_input_compat* cin_compats)
 
 static void netplay_send_raw_input(struct pif* pif)
 {
+    //in rollback mode, inputs are sent when used
+    if (l_rollback.frames != 0)
+        return;
+
     for (int i = 0; i < 4; ++i)
     {
         if (l_netplay_control[i] != -1)
@@ -632,7 +1445,10 @@ static void netplay_get_raw_input(struct pif* pif)
 
                 if(pif->channels[i].tx_buf[0] == JCMD_CONTROLLER_READ)
                 {
-                    *(uint32_t*)pif->channels[i].rx_buf = netplay_get_input(i);
+                    if (l_rollback.frames != 0)
+                        *(uint32_t*)pif->channels[i].rx_buf = rollback_get_input(i, *(uint32_t*)pif->channels[i].rx_buf);
+                    else
+                        *(uint32_t*)pif->channels[i].rx_buf = netplay_get_input(i);
                 }
                 else if ((pif->channels[i].tx_buf[0] == JCMD_STATUS || pif->channels[i].tx_buf[0] == JCMD_RESET) && Controls[i].RawData)
                 {
@@ -55,6 +55,22 @@ void netplay_update_input(struct pif* pif);
 m64p_error netplay_send_config(char* data, int size);
 m64p_error netplay_receive_config(char* data, int size);
 
+/* Delay received packets by latency ms and drop loss percent of the packets
+ * sent and received, to test over loopback */
+void netplay_simulate_network(unsigned int latency, unsigned int loss);
+
+/* Rollback mode: remote inputs are predicted and the frames emulated with a
+ * wrong prediction are emulated again, up to frames in the past. */
+void netplay_rollback_start(unsigned int frames);
+void netplay_rollback_stop(void);
+/* Nonzero while mispredicted frames are emulated again */
+int netplay_is_resimulating(void);
+/* Called on each VI, after netplay_check_sync */
+void netplay_new_vi(void);
+/* Save or restore the machine state when due.
+ * Must only be called where savestates can be taken. */
+void netplay_update(void);
+
 #else
 
 static osal_inline m64p_error netplay_start(const char* host, int port)
@@ -131,6 +147,31 @@ static osal_inline m64p_error netplay_receive_config(char* data, int size)
     return M64ERR_INCOMPATIBLE;
 }
 
+static osal_inline void netplay_simulate_network(unsigned int latency, unsigned int loss)
+{
+}
+
+static osal_inline void netplay_rollback_start(unsigned int frames)
+{
+}
+
+static osal_inline void netplay_rollback_stop(void)
+{
+}
+
+static osal_inline int netplay_is_resimulating(void)
+{
+    return 0;
+}
+
+static osal_inline void netplay_new_vi(void)
+{
+}
+
+static osal_inline void netplay_update(void)
+{
+}
+
 #endif
 
 #endif
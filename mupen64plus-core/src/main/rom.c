@@ -61,6 +61,67 @@ static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5);
 
 static _romdatabase g_romdatabase;
 
+/* Entries parsed from mupen64plus.ini, before being indexed */
+typedef struct _romdatabase_search
+{
+    romdatabase_entry entry;
+    int has_crc;
+    size_t position;
+    struct _romdatabase_search* next_entry;
+    struct _romdatabase_search* next_md5;
+} romdatabase_search;
+
+typedef struct
+{
+    romdatabase_search* md5_lists[256];
+    romdatabase_search* list;
+} romdatabase_ini;
+
+/* Binary index of the database, cached in the user cache directory.
+ * Entries are sorted by MD5 with RefMD5s already resolved, followed by the
+ * indices of the entries with a CRC sorted by CRC, then by the strings.
+ * The index is rebuilt whenever mupen64plus.ini size or date changes.
+ */
+#define ROMDATABASE_INDEX_FILENAME "mupen64plus.ini.index"
+#define ROMDATABASE_INDEX_MAGIC "M64+RDBI"
+enum { ROMDATABASE_INDEX_VERSION = 1 };
+#define ROMDATABASE_INDEX_NO_STRING UINT32_C(0xffffffff)
+
+struct romdatabase_index_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t ini_size;
+    int64_t ini_mtime;
+    uint32_t count;
+    uint32_t crc_count;
+    uint32_t strings_size;
+    uint32_t reserved;
+};
+
+struct romdatabase_index_entry
+{
+    md5_byte_t md5[16];
+    uint32_t crc1;
+    uint32_t crc2;
+    uint32_t goodname;
+    uint32_t cheats;
+    uint32_t sidmaduration;
+    uint32_t aidmamodifier;
+    uint32_t set_flags;
+    uint8_t status;
+    uint8_t savetype;
+    uint8_t players;
+    uint8_t rumble;
+    uint8_t countperop;
+    uint8_t disableextramem;
+    uint8_t transferpak;
+    uint8_t mempak;
+    uint8_t biopak;
+    uint8_t padding[3];
+};
+
 /* Global loaded rom size. */
 int g_rom_size = 0;
 
@@ -288,7 +349,7 @@ m64p_error open_disk(void)
     }
 
     /* Try loading regular disk file */
-    if (open_rom_file_storage(fstorage, dd_disk_filename) != file_ok) {
+    if (open_dd_disk_file_storage(fstorage, dd_disk_filename) != file_ok) {
         goto free_fstorage;
     }
 
@@ -443,18 +504,28 @@ static unsigned char rom_homebrew_savetype_to_savetype(uint8_t save_type)
     return m64p_save_type;
 }
 
-static size_t romdatabase_resolve_round(void)
+static romdatabase_entry* ini_search_list_by_md5(romdatabase_ini* ini, md5_byte_t* md5)
+{
+    romdatabase_search* search = ini->md5_lists[md5[0]];
+
+    while (search != NULL && memcmp(search->entry.md5, md5, 16) != 0)
+        search = search->next_md5;
+
+    return (search != NULL) ? &search->entry : NULL;
+}
+
+static size_t romdatabase_resolve_round(romdatabase_ini* ini)
 {
     romdatabase_search *entry;
     romdatabase_entry *ref;
     size_t skipped = 0;
 
     /* Resolve RefMD5 references */
-    for (entry = g_romdatabase.list; entry; entry = entry->next_entry) {
+    for (entry = ini->list; entry; entry = entry->next_entry) {
         if (!entry->entry.refmd5)
             continue;
 
-        ref = ini_search_by_md5(entry->entry.refmd5);
+        ref = ini_search_list_by_md5(ini, entry->entry.refmd5);
         if (!ref) {
             DebugMessage(M64MSG_WARNING, "ROM Database: Error solving RefMD5s");
             continue;
@@ -560,13 +631,13 @@ static size_t romdatabase_resolve_round(void)
     return skipped;
 }
 
-static void romdatabase_resolve(void)
+static void romdatabase_resolve(romdatabase_ini* ini)
 {
     size_t last_skipped = (size_t)~0ULL;
     size_t skipped;
 
     do {
-        skipped = romdatabase_resolve_round();
+        skipped = romdatabase_resolve_round(ini);
         if (skipped == last_skipped) {
             DebugMessage(M64MSG_ERROR, "Unable to resolve rom database entries (loop)");
             break;
@@ -578,37 +649,25 @@ static void romdatabase_resolve(void)
 /********************************************************************************************/
 /* INI Rom database functions */
 
-void romdatabase_open(void)
+static int romdatabase_parse_ini(romdatabase_ini* ini, const char* pathname)
 {
     FILE *fPtr;
     char buffer[256];
     romdatabase_search* search = NULL;
     romdatabase_search** next_search;
 
-    int counter, value, lineno;
+    int value, lineno;
     unsigned char index;
-    const char *pathname = ConfigGetSharedDataFilepath("mupen64plus.ini");
-
-    if(g_romdatabase.have_database)
-        return;
 
     /* Open romdatabase. */
-    if (pathname == NULL || (fPtr = osal_file_open(pathname, "rb")) == NULL)
+    if ((fPtr = osal_file_open(pathname, "rb")) == NULL)
     {
         DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
-        return;
+        return 0;
     }
 
-    g_romdatabase.have_database = 1;
-
-    /* Clear premade indices. */
-    for(counter = 0; counter < 255; ++counter)
-        g_romdatabase.crc_lists[counter] = NULL;
-    for(counter = 0; counter < 255; ++counter)
-        g_romdatabase.md5_lists[counter] = NULL;
-    g_romdatabase.list = NULL;
-
-    next_search = &g_romdatabase.list;
+    memset(ini, 0, sizeof(*ini));
+    next_search = &ini->list;
 
     /* Parse ROM database file */
     for (lineno = 1; fgets(buffer, 255, fPtr) != NULL; lineno++)
@@ -653,11 +712,10 @@ void romdatabase_open(void)
             search->entry.set_flags = ROMDATABASE_ENTRY_NONE;
 
             search->next_entry = NULL;
-            search->next_crc = NULL;
             /* Index MD5s by first 8 bits. */
             index = search->entry.md5[0];
-            search->next_md5 = g_romdatabase.md5_lists[index];
-            g_romdatabase.md5_lists[index] = search;
+            search->next_md5 = ini->md5_lists[index];
+            ini->md5_lists[index] = search;
 
             break;
         }
@@ -680,10 +738,7 @@ void romdatabase_open(void)
                 if (sscanf(l.value, "%X %X%c", &search->entry.crc1,
                     &search->entry.crc2, &garbage_sweeper) == 2)
                 {
-                    /* Index CRCs by first 8 bits. */
-                    index = search->entry.crc1 >> 24;
-                    search->next_crc = g_romdatabase.crc_lists[index];
-                    g_romdatabase.crc_lists[index] = search;
+                    search->has_crc = 1;
                     search->entry.set_flags |= ROMDATABASE_ENTRY_CRC;
                 }
                 else
@@ -866,72 +921,420 @@ void romdatabase_open(void)
     }
 
     fclose(fPtr);
-    romdatabase_resolve();
+    return 1;
 }
 
-void romdatabase_close(void)
+static void romdatabase_free_ini(romdatabase_ini* ini)
 {
-    if (!g_romdatabase.have_database)
+    while (ini->list != NULL)
+    {
+        romdatabase_search* search = ini->list->next_entry;
+        free(ini->list->entry.goodname);
+        free(ini->list->entry.refmd5);
+        free(ini->list->entry.cheats);
+        free(ini->list);
+        ini->list = search;
+    }
+}
+
+static int compare_search_md5(const void* a, const void* b)
+{
+    const romdatabase_search* sa = *(const romdatabase_search* const*)a;
+    const romdatabase_search* sb = *(const romdatabase_search* const*)b;
+    int cmp = memcmp(sa->entry.md5, sb->entry.md5, 16);
+
+    /* duplicated MD5s: the last one in the ini wins */
+    if (cmp == 0)
+        return (sa->position < sb->position) ? 1 : -1;
+
+    return cmp;
+}
+
+static int compare_search_crc(const void* a, const void* b)
+{
+    const romdatabase_search* sa = *(const romdatabase_search* const*)a;
+    const romdatabase_search* sb = *(const romdatabase_search* const*)b;
+
+    if (sa->entry.crc1 != sb->entry.crc1)
+        return (sa->entry.crc1 < sb->entry.crc1) ? -1 : 1;
+    if (sa->entry.crc2 != sb->entry.crc2)
+        return (sa->entry.crc2 < sb->entry.crc2) ? -1 : 1;
+
+    return (sa->position < sb->position) ? -1 : 1;
+}
+
+static uint32_t put_index_string(char* strings, size_t* offset, const char* str)
+{
+    uint32_t start = (uint32_t)*offset;
+    size_t len;
+
+    if (str == NULL)
+        return ROMDATABASE_INDEX_NO_STRING;
+
+    len = strlen(str) + 1;
+    memcpy(strings + *offset, str, len);
+    *offset += len;
+
+    return start;
+}
+
+static void* romdatabase_build_index(romdatabase_ini* ini, uint64_t ini_size, int64_t ini_mtime, size_t* size)
+{
+    struct romdatabase_index_header* header;
+    struct romdatabase_index_entry* records;
+    uint32_t* crc_index;
+    char* strings;
+    romdatabase_search* search;
+    romdatabase_search** sorted;
+    size_t i, count = 0, crc_count = 0, strings_size = 0, offset = 0;
+    void* index;
+
+    for (search = ini->list; search != NULL; search = search->next_entry) {
+        search->position = count++;
+        if (search->has_crc)
+            ++crc_count;
+        if (search->entry.goodname != NULL)
+            strings_size += strlen(search->entry.goodname) + 1;
+        if (search->entry.cheats != NULL)
+            strings_size += strlen(search->entry.cheats) + 1;
+    }
+
+    if (count > UINT32_MAX || strings_size >= ROMDATABASE_INDEX_NO_STRING)
+        return NULL;
+
+    sorted = malloc((count + 1) * sizeof(*sorted));
+    *size = sizeof(*header) + count * sizeof(*records) + crc_count * sizeof(*crc_index) + strings_size;
+    index = calloc(1, *size);
+    if (sorted == NULL || index == NULL) {
+        free(sorted);
+        free(index);
+        return NULL;
+    }
+
+    header = (struct romdatabase_index_header*)index;
+    records = (struct romdatabase_index_entry*)(header + 1);
+    crc_index = (uint32_t*)(records + count);
+    strings = (char*)(crc_index + crc_count);
+
+    memcpy(header->magic, ROMDATABASE_INDEX_MAGIC, sizeof(header->magic));
+    header->version = ROMDATABASE_INDEX_VERSION;
+    header->entry_size = sizeof(*records);
+    header->ini_size = ini_size;
+    header->ini_mtime = ini_mtime;
+    header->count = (uint32_t)count;
+    header->crc_count = (uint32_t)crc_count;
+    header->strings_size = (uint32_t)strings_size;
+
+    /* entries, by MD5 */
+    i = 0;
+    for (search = ini->list; search != NULL; search = search->next_entry)
+        sorted[i++] = search;
+    qsort(sorted, count, sizeof(*sorted), compare_search_md5);
+
+    for (i = 0; i < count; ++i) {
+        const romdatabase_entry* entry = &sorted[i]->entry;
+        struct romdatabase_index_entry* record = &records[i];
+
+        memcpy(record->md5, entry->md5, 16);
+        record->crc1 = entry->crc1;
+        record->crc2 = entry->crc2;
+        record->goodname = put_index_string(strings, &offset, entry->goodname);
+        record->cheats = put_index_string(strings, &offset, entry->cheats);
+        record->sidmaduration = entry->sidmaduration;
+        record->aidmamodifier = entry->aidmamodifier;
+        record->set_flags = entry->set_flags;
+        record->status = entry->status;
+        record->savetype = entry->savetype;
+        record->players = entry->players;
+        record->rumble = entry->rumble;
+        record->countperop = entry->countperop;
+        record->disableextramem = entry->disableextramem;
+        record->transferpak = entry->transferpak;
+        record->mempak = entry->mempak;
+        record->biopak = entry->biopak;
+
+        sorted[i]->position = i;
+    }
+
+    /* entries with their own CRC, by CRC */
+    i = 0;
+    for (search = ini->list; search != NULL; search = search->next_entry) {
+        if (search->has_crc)
+            sorted[i++] = search;
+    }
+    qsort(sorted, crc_count, sizeof(*sorted), compare_search_crc);
+
+    for (i = 0; i < crc_count; ++i)
+        crc_index[i] = (uint32_t)sorted[i]->position;
+
+    free(sorted);
+    return index;
+}
+
+static const char* get_index_string(char* strings, uint32_t strings_size, uint32_t offset, int* valid)
+{
+    if (offset == ROMDATABASE_INDEX_NO_STRING)
+        return NULL;
+
+    if (offset >= strings_size) {
+        *valid = 0;
+        return NULL;
+    }
+
+    return strings + offset;
+}
+
+static int romdatabase_use_index(void* index, size_t size, int mapped, uint64_t ini_size, int64_t ini_mtime)
+{
+    const struct romdatabase_index_header* header = (const struct romdatabase_index_header*)index;
+    const struct romdatabase_index_entry* records;
+    const uint32_t* crc_index;
+    char* strings;
+    romdatabase_entry* entries;
+    size_t i;
+    int valid = 1;
+
+    if (size < sizeof(*header)
+     || memcmp(header->magic, ROMDATABASE_INDEX_MAGIC, sizeof(header->magic)) != 0
+     || header->version != ROMDATABASE_INDEX_VERSION
+     || header->entry_size != sizeof(*records)
+     || header->ini_size != ini_size
+     || header->ini_mtime != ini_mtime
+     || header->crc_count > header->count
+     || size != sizeof(*header) + (size_t)header->count * sizeof(*records)
+                + (size_t)header->crc_count * sizeof(*crc_index) + header->strings_size)
+        return 0;
+
+    records = (const struct romdatabase_index_entry*)(header + 1);
+    crc_index = (const uint32_t*)(records + header->count);
+    strings = (char*)(crc_index + header->crc_count);
+
+    if (header->strings_size > 0 && strings[header->strings_size - 1] != '\0')
+        return 0;
+
+    for (i = 0; i < header->crc_count; ++i) {
+        if (crc_index[i] >= header->count)
+            return 0;
+    }
+
+    entries = malloc((header->count + 1) * sizeof(*entries));
+    if (entries == NULL)
+        return 0;
+
+    for (i = 0; i < header->count; ++i) {
+        const struct romdatabase_index_entry* record = &records[i];
+        romdatabase_entry* entry = &entries[i];
+
+        memcpy(entry->md5, record->md5, 16);
+        entry->goodname = (char*)get_index_string(strings, header->strings_size, record->goodname, &valid);
+        entry->cheats = (char*)get_index_string(strings, header->strings_size, record->cheats, &valid);
+        entry->refmd5 = NULL;
+        entry->crc1 = record->crc1;
+        entry->crc2 = record->crc2;
+        entry->status = record->status;
+        entry->savetype = record->savetype;
+        entry->players = record->players;
+        entry->rumble = record->rumble;
+        entry->countperop = record->countperop;
+        entry->disableextramem = record->disableextramem;
+        entry->transferpak = record->transferpak;
+        entry->mempak = record->mempak;
+        entry->biopak = record->biopak;
+        entry->sidmaduration = record->sidmaduration;
+        entry->aidmamodifier = record->aidmamodifier;
+        entry->set_flags = record->set_flags;
+    }
+
+    if (!valid) {
+        free(entries);
+        return 0;
+    }
+
+    g_romdatabase.entries = entries;
+    g_romdatabase.count = header->count;
+    g_romdatabase.crc_index = crc_index;
+    g_romdatabase.crc_count = header->crc_count;
+    g_romdatabase.index = index;
+    g_romdatabase.index_size = size;
+    g_romdatabase.index_mapped = mapped;
+    g_romdatabase.have_database = 1;
+
+    return 1;
+}
+
+static void romdatabase_write_index(const char* filepath, const void* index, size_t size)
+{
+    /* other running cores may have the current index mapped, so never
+     * modify it in place: write a new file and rename it over the old one */
+    char* tmppath = formatstr("%s.tmp", filepath);
+    FILE* f;
+    int ok;
+
+    if (tmppath == NULL) {
+        return;
+    }
+
+    f = osal_file_open(tmppath, "wb");
+    if (f == NULL) {
+        DebugMessage(M64MSG_WARNING, "Couldn't create rom database index '%s'", tmppath);
+        free(tmppath);
+        return;
+    }
+
+    ok = (fwrite(index, 1, size, f) == size);
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok) {
+        DebugMessage(M64MSG_WARNING, "Couldn't write rom database index '%s'", tmppath);
+        remove(tmppath);
+    }
+    else if (osal_file_rename(tmppath, filepath) != 0) {
+        DebugMessage(M64MSG_WARNING, "Couldn't replace rom database index '%s'", filepath);
+        remove(tmppath);
+    }
+
+    free(tmppath);
+}
+
+void romdatabase_open(void)
+{
+    romdatabase_ini ini;
+    uint64_t ini_size;
+    int64_t ini_mtime;
+    void* index;
+    size_t index_size;
+    char* index_path = NULL;
+    const char *cachepath = ConfigGetUserCachePath();
+    const char *pathname = ConfigGetSharedDataFilepath("mupen64plus.ini");
+
+    if(g_romdatabase.have_database)
+        return;
+
+    if (pathname == NULL || osal_file_stat(pathname, &ini_size, &ini_mtime) != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
         return;
+    }
 
-    while (g_romdatabase.list != NULL)
+    /* use the index built from this version of the ini if there is one */
+    if (cachepath != NULL)
+    {
+        index_path = combinepath(cachepath, ROMDATABASE_INDEX_FILENAME);
+        index = (index_path != NULL) ? osal_file_map(index_path, &index_size) : NULL;
+        if (index != NULL)
         {
-        romdatabase_search* search = g_romdatabase.list->next_entry;
-        if(g_romdatabase.list->entry.goodname)
-            free(g_romdatabase.list->entry.goodname);
-        if(g_romdatabase.list->entry.refmd5)
-            free(g_romdatabase.list->entry.refmd5);
-        free(g_romdatabase.list->entry.cheats);
-        free(g_romdatabase.list);
-        g_romdatabase.list = search;
+            if (romdatabase_use_index(index, index_size, 1, ini_size, ini_mtime))
+            {
+                free(index_path);
+                return;
+            }
+            osal_file_unmap(index, index_size);
         }
+    }
 
-    g_romdatabase.have_database = 0;
+    /* otherwise parse the ini and cache its index for the next time */
+    if (!romdatabase_parse_ini(&ini, pathname))
+    {
+        free(index_path);
+        return;
+    }
+
+    romdatabase_resolve(&ini);
+    index = romdatabase_build_index(&ini, ini_size, ini_mtime, &index_size);
+    romdatabase_free_ini(&ini);
+
+    if (index == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Couldn't build rom database index");
+        free(index_path);
+        return;
+    }
+
+    if (index_path != NULL)
+        romdatabase_write_index(index_path, index, index_size);
+    free(index_path);
+
+    if (!romdatabase_use_index(index, index_size, 0, ini_size, ini_mtime))
+        free(index);
+}
+
+void romdatabase_close(void)
+{
+    if (!g_romdatabase.have_database)
+        return;
+
+    free(g_romdatabase.entries);
+
+    if (g_romdatabase.index_mapped)
+        osal_file_unmap(g_romdatabase.index, g_romdatabase.index_size);
+    else
+        free(g_romdatabase.index);
+
+    memset(&g_romdatabase, 0, sizeof(g_romdatabase));
 }
 
 static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5)
 {
-    romdatabase_search* search;
+    size_t lo = 0, hi;
 
     if(!g_romdatabase.have_database)
         return NULL;
 
-    search = g_romdatabase.md5_lists[md5[0]];
-
-    while (search != NULL && memcmp(search->entry.md5, md5, 16) != 0)
-        search = search->next_md5;
+    /* first entry not below md5 */
+    hi = g_romdatabase.count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (memcmp(g_romdatabase.entries[mid].md5, md5, 16) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
-    if(search==NULL)
+    if (lo == g_romdatabase.count || memcmp(g_romdatabase.entries[lo].md5, md5, 16) != 0)
         return NULL;
 
-    return &(search->entry);
+    return &g_romdatabase.entries[lo];
+}
+
+static int compare_crc(const romdatabase_entry* entry, unsigned int crc1, unsigned int crc2)
+{
+    if (entry->crc1 != crc1)
+        return (entry->crc1 < crc1) ? -1 : 1;
+    if (entry->crc2 != crc2)
+        return (entry->crc2 < crc2) ? -1 : 1;
+    return 0;
 }
 
 romdatabase_entry* ini_search_by_crc(unsigned int crc1, unsigned int crc2)
 {
-    romdatabase_search* search;
-    romdatabase_entry* found_entry = NULL;
+    const uint32_t* crc_index = g_romdatabase.crc_index;
+    size_t lo = 0, hi;
 
-    if(!g_romdatabase.have_database) 
+    if(!g_romdatabase.have_database)
         return NULL;
 
-    search = g_romdatabase.crc_lists[((crc1 >> 24) & 0xff)];
+    /* first entry not below crc1, crc2 */
+    hi = g_romdatabase.crc_count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (compare_crc(&g_romdatabase.entries[crc_index[mid]], crc1, crc2) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == g_romdatabase.crc_count || compare_crc(&g_romdatabase.entries[crc_index[lo]], crc1, crc2) != 0)
+        return NULL;
 
     // because CRCs can be ambiguous (there can be multiple database entries with the same CRC),
     // we will prefer MD5 hashes instead. If the given CRC matches more than one entry in the
     // database, we will return no match.
-    while (search != NULL)
-    {
-        if (search->entry.crc1 == crc1 && search->entry.crc2 == crc2)
-        {
-            if (found_entry != NULL)
-                return NULL;
-            found_entry = &search->entry;
-        }
-        search = search->next_crc;
-    }
+    if (lo + 1 < g_romdatabase.crc_count && compare_crc(&g_romdatabase.entries[crc_index[lo + 1]], crc1, crc2) == 0)
+        return NULL;
 
-    return found_entry;
+    return &g_romdatabase.entries[crc_index[lo]];
 }
 
 
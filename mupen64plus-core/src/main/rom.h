@@ -24,6 +24,7 @@
 #define __ROM_H__
 
 #include <md5.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "api/m64p_types.h"
@@ -136,20 +137,19 @@ typedef struct
 #define ROMDATABASE_ENTRY_SIDMADURATION BIT(12)
 #define ROMDATABASE_ENTRY_AIDMAMODIFIER BIT(13)
 
-typedef struct _romdatabase_search
-{
-    romdatabase_entry entry;
-    struct _romdatabase_search* next_entry;
-    struct _romdatabase_search* next_crc;
-    struct _romdatabase_search* next_md5;
-} romdatabase_search;
-
 typedef struct
 {
     int have_database;
-    romdatabase_search* crc_lists[256];
-    romdatabase_search* md5_lists[256];
-    romdatabase_search* list;
+    /* entries sorted by MD5 */
+    romdatabase_entry* entries;
+    size_t count;
+    /* indices of the entries with their own CRC, sorted by CRC */
+    const uint32_t* crc_index;
+    size_t crc_count;
+    /* binary index the entries were loaded from, holds their strings */
+    void* index;
+    size_t index_size;
+    int index_mapped;
 } _romdatabase;
 
 void romdatabase_open(void);
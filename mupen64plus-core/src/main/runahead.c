@@ -0,0 +1,207 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - runahead.c                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "runahead.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "backends/api/audio_out_backend.h"
+#include "device/device.h"
+#include "main.h"
+#include "plugin/plugin.h"
+#include "savestates.h"
+
+enum runahead_job
+{
+    RUNAHEAD_JOB_NOTHING,
+    RUNAHEAD_JOB_SAVE,
+    RUNAHEAD_JOB_RESTORE
+};
+
+static struct
+{
+    /* number of frames emulated ahead, 0 when disabled */
+    unsigned int frames;
+    /* frame being emulated ahead (1 to frames), 0 for a real frame */
+    unsigned int ahead;
+    enum runahead_job job;
+
+    void* state;
+
+    unsigned int restores;
+    unsigned int cancels;
+} l_runahead;
+
+/* outputs muted during frames which will be emulated again */
+static const struct audio_out_backend_interface* l_iaout;
+static ptr_UpdateScreen l_update_screen;
+
+static void null_set_frequency(void* aout, unsigned int frequency)
+{
+    /* the restored state may not set the frequency again */
+    l_iaout->set_frequency(aout, frequency);
+}
+
+static void null_push_samples(void* aout, const void* buffer, size_t size)
+{
+}
+
+static const struct audio_out_backend_interface l_inull_audio_out =
+{
+    null_set_frequency,
+    null_push_samples
+};
+
+static void null_update_screen(void)
+{
+}
+
+void runahead_show_video(int show)
+{
+    if (gfx.updateScreen != null_update_screen) {
+        l_update_screen = gfx.updateScreen;
+    }
+
+    gfx.updateScreen = (show) ? l_update_screen : null_update_screen;
+}
+
+void runahead_play_audio(int play)
+{
+    if (g_dev.ai.iaout != &l_inull_audio_out) {
+        l_iaout = g_dev.ai.iaout;
+    }
+
+    g_dev.ai.iaout = (play) ? l_iaout : &l_inull_audio_out;
+}
+
+void runahead_start(unsigned int frames)
+{
+    memset(&l_runahead, 0, sizeof(l_runahead));
+
+    if (frames == 0) {
+        return;
+    }
+
+    l_runahead.state = calloc(1, savestates_m64p_mem_size());
+    if (l_runahead.state == NULL) {
+        DebugMessage(M64MSG_WARNING, "Failed to allocate run-ahead state, run-ahead disabled");
+        return;
+    }
+
+    l_runahead.frames = frames;
+
+    /* real frames are never presented */
+    runahead_show_video(0);
+
+    DebugMessage(M64MSG_INFO, "Run-ahead enabled: %u frame(s)", frames);
+}
+
+void runahead_stop(void)
+{
+    if (l_runahead.frames == 0) {
+        return;
+    }
+
+    runahead_show_video(1);
+    runahead_play_audio(1);
+
+    DebugMessage(M64MSG_VERBOSE, "Run-ahead: %u restores, %u cancelled",
+        l_runahead.restores, l_runahead.cancels);
+
+    free(l_runahead.state);
+    memset(&l_runahead, 0, sizeof(l_runahead));
+}
+
+int runahead_is_ahead(void)
+{
+    return (l_runahead.ahead != 0);
+}
+
+void runahead_new_vi(void)
+{
+    if (l_runahead.frames == 0 || l_runahead.job != RUNAHEAD_JOB_NOTHING) {
+        return;
+    }
+
+    if (l_runahead.ahead == 0) {
+        l_runahead.job = RUNAHEAD_JOB_SAVE;
+    }
+    else if (l_runahead.ahead < l_runahead.frames) {
+        /* only present the last frame emulated ahead */
+        if (++l_runahead.ahead == l_runahead.frames) {
+            runahead_show_video(1);
+        }
+    }
+    else {
+        l_runahead.job = RUNAHEAD_JOB_RESTORE;
+    }
+}
+
+void runahead_update(void)
+{
+    switch (l_runahead.job)
+    {
+    case RUNAHEAD_JOB_SAVE:
+        rdram_flush_pending_dma(&g_dev.rdram);
+        savestates_save_m64p_mem(&g_dev, l_runahead.state);
+
+        l_runahead.ahead = 1;
+        runahead_play_audio(0);
+        runahead_show_video(l_runahead.frames == 1);
+        break;
+
+    case RUNAHEAD_JOB_RESTORE:
+        rdram_flush_pending_dma(&g_dev.rdram);
+        if (!savestates_load_m64p_mem(&g_dev, l_runahead.state)) {
+            DebugMessage(M64MSG_ERROR, "Failed to restore run-ahead state");
+        }
+        ++l_runahead.restores;
+
+        l_runahead.ahead = 0;
+        runahead_play_audio(1);
+        runahead_show_video(0);
+        break;
+
+    default:
+        return;
+    }
+
+    l_runahead.job = RUNAHEAD_JOB_NOTHING;
+}
+
+void runahead_cancel(void)
+{
+    if (l_runahead.frames == 0) {
+        return;
+    }
+
+    if (l_runahead.ahead != 0) {
+        ++l_runahead.cancels;
+    }
+
+    l_runahead.ahead = 0;
+    l_runahead.job = RUNAHEAD_JOB_NOTHING;
+    runahead_play_audio(1);
+    runahead_show_video(0);
+}
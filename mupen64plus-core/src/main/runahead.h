@@ -0,0 +1,60 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - runahead.h                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_RUNAHEAD_H
+#define M64P_MAIN_RUNAHEAD_H
+
+/* Run-ahead: hides part of the input latency caused by the game's own
+ * frame buffering.
+ *
+ * Once a frame has been emulated, the machine state is saved in memory and
+ * the following frames are emulated with the same inputs, without audio and
+ * without presenting video except for the last one. The state is then
+ * restored and the next frame emulated for real. Displayed frames thus
+ * reflect inputs as if they had been sampled that many frames earlier.
+ *
+ * Plugins state is not saved, so this relies on plugins being driven only by
+ * the emulated machine.
+ */
+
+void runahead_start(unsigned int frames);
+void runahead_stop(void);
+
+/* Nonzero while frames are emulated ahead of time */
+int runahead_is_ahead(void);
+
+/* Called on each VI, after the frame was presented */
+void runahead_new_vi(void);
+
+/* Save or restore the machine state when due.
+ * Must only be called where savestates can be taken. */
+void runahead_update(void);
+
+/* Forget frames emulated ahead, when the machine state is about to be
+ * replaced by other means (savestate loading, reset) */
+void runahead_cancel(void);
+
+/* Present video and play audio of the frames being emulated, or not.
+ * Also used for netplay rollbacks. */
+void runahead_show_video(int show);
+void runahead_play_audio(int play);
+
+#endif
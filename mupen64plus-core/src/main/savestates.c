@@ -40,6 +40,7 @@
 #include "api/m64p_config.h"
 #include "api/m64p_types.h"
 #include "backends/api/storage_backend.h"
+#include "backends/file_storage.h"
 #include "device/device.h"
 #include "main/list.h"
 #include "main/main.h"
@@ -49,6 +50,7 @@
 #include "plugin/plugin.h"
 #include "rom.h"
 #include "savestates.h"
+#include "snapshot.h"
 #include "util.h"
 #include "workqueue.h"
 
@@ -185,13 +187,43 @@ static void savestates_clear_job(void)
 #define PUTDATA(buff, type, value) \
     do { type x = value; PUTARRAY(&x, buff, type, 1); } while(0)
 
+/* Same as PUTARRAY for uint32_t arrays, but the copy can be deferred
+ * until snapshot_finish() is called */
+#if defined(M64P_BIG_ENDIAN)
+#define PUTSNAPSHOT(src, buff, count, deferred) \
+    do { PUTARRAY(src, buff, uint32_t, count); } while(0)
+#else
+#define PUTSNAPSHOT(src, buff, count, deferred) \
+    do { \
+        if (deferred) { snapshot_add(buff, (void*)(src), sizeof(uint32_t)*(count)); } \
+        else { memcpy(buff, src, sizeof(uint32_t)*(count)); } \
+        buff += (count)*sizeof(uint32_t); \
+    } while(0)
+#endif
+
+/* Layout of a m64p savestate once uncompressed */
+enum {
+    M64P_STATE_HEADER_SIZE = 44,
+    M64P_STATE_DATA_SIZE = 16788244,
+    M64P_STATE_QUEUE_SIZE = 1024,
+    M64P_STATE_USING_TLB_SIZE = 4,
+    M64P_STATE_EXTRA_SIZE = 4096,
+    M64P_STATE_SIZE = M64P_STATE_HEADER_SIZE + M64P_STATE_DATA_SIZE + M64P_STATE_QUEUE_SIZE
+                    + M64P_STATE_USING_TLB_SIZE + M64P_STATE_EXTRA_SIZE
+};
+
+static void savestates_parse_m64p(struct device* dev, unsigned int version,
+                                  unsigned char* curr, char* queue,
+                                  unsigned char* using_tlb_data,
+                                  unsigned char* data_0001_0200,
+                                  int in_memory);
+static void savestates_write_m64p(const struct device* dev, char* curr, int deferred);
+
 static int savestates_load_m64p(struct device* dev, char *filepath)
 {
     unsigned char header[44];
     gzFile f;
     unsigned int version;
-    int i;
-    uint32_t FCR31;
 
     size_t savestateSize;
     unsigned char *savestateData, *curr;
@@ -199,8 +231,6 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     unsigned char using_tlb_data[4];
     unsigned char data_0001_0200[4096]; // 4k for extra state from v1.2
 
-    uint32_t* cp0_regs = r4300_cp0_regs(&dev->r4300.cp0);
-
     SDL_LockMutex(savestates_lock);
 
     f = osal_gzopen(filepath, "rb");
@@ -252,7 +282,7 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     curr += 32;
 
     /* Read the rest of the savestate */
-    savestateSize = 16788244;
+    savestateSize = M64P_STATE_DATA_SIZE;
     savestateData = curr = (unsigned char *)malloc(savestateSize);
     if (savestateData == NULL)
     {
@@ -304,6 +334,46 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     gzclose(f);
     SDL_UnlockMutex(savestates_lock);
 
+    savestates_parse_m64p(dev, version, savestateData, queue, using_tlb_data, data_0001_0200, 0);
+
+    free(savestateData);
+    main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State loaded from: %s", namefrompath(filepath));
+    return 1;
+}
+
+/* Copy back only the dram pages which differ from the saved ones,
+ * so that code cached from the other pages stays valid */
+static void savestates_restore_dram(struct device* dev, const uint32_t* saved)
+{
+    enum { PAGE_WORDS = 0x1000 / sizeof(uint32_t) };
+    uint32_t page;
+
+    for (page = 0; page < RDRAM_MAX_SIZE / 0x1000; ++page) {
+        uint32_t* dram = dev->rdram.dram + page * PAGE_WORDS;
+        const uint32_t* src = saved + page * PAGE_WORDS;
+
+        if (memcmp(dram, src, 0x1000) != 0) {
+            memcpy(dram, src, 0x1000);
+            invalidate_r4300_cached_code_physical(&dev->r4300, page << 12, 0x1000, CODE_WRITE_STATE);
+        }
+    }
+}
+
+/* in_memory is set for the core's own in-memory states (run-ahead, rollback):
+ * only the cached code of the dram pages which changed gets invalidated,
+ * and the side effects only needed when loading a file are skipped. */
+static void savestates_parse_m64p(struct device* dev, unsigned int version,
+                                  unsigned char* curr, char* queue,
+                                  unsigned char* using_tlb_data,
+                                  unsigned char* data_0001_0200,
+                                  int in_memory)
+{
+    int i;
+    uint32_t FCR31;
+    struct tlb_entry old_tlb_entries[32];
+
+    uint32_t* cp0_regs = r4300_cp0_regs(&dev->r4300.cp0);
+
     // Parse savestate
     dev->rdram.regs[0][RDRAM_CONFIG_REG]       = GETDATA(curr, uint32_t);
     dev->rdram.regs[0][RDRAM_DEVICE_ID_REG]    = GETDATA(curr, uint32_t);
@@ -419,7 +489,12 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     dev->dp.dps_regs[DPS_BUFTEST_ADDR_REG] = GETDATA(curr, uint32_t);
     dev->dp.dps_regs[DPS_BUFTEST_DATA_REG] = GETDATA(curr, uint32_t);
 
-    COPYARRAY(dev->rdram.dram, curr, uint32_t, RDRAM_MAX_SIZE/4);
+    if (in_memory) {
+        savestates_restore_dram(dev, GETARRAY(curr, uint32_t, RDRAM_MAX_SIZE/4));
+    }
+    else {
+        COPYARRAY(dev->rdram.dram, curr, uint32_t, RDRAM_MAX_SIZE/4);
+    }
     COPYARRAY(dev->sp.mem, curr, uint32_t, SP_MEM_SIZE/4);
     COPYARRAY(dev->pif.ram, curr, uint8_t, PIF_RAM_SIZE);
 
@@ -444,6 +519,8 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     set_fpr_pointers(&dev->r4300.cp1, cp0_regs[CP0_STATUS_REG]);
     update_x86_rounding_mode(&dev->r4300.cp1);
 
+    memcpy(old_tlb_entries, dev->r4300.cp0.tlb.entries, sizeof(old_tlb_entries));
+
     for (i = 0; i < 32; i++)
     {
         dev->r4300.cp0.tlb.entries[i].mask = GETDATA(curr, int16_t);
@@ -471,7 +548,17 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
         dev->r4300.cp0.tlb.entries[i].phys_odd = GETDATA(curr, uint32_t);
     }
 
-    savestates_load_set_pc(&dev->r4300, GETDATA(curr, uint32_t));
+    if (in_memory) {
+        /* code cached from TLB mapped pages can only be trusted
+         * if the mappings are the same */
+        generic_jump_to(&dev->r4300, GETDATA(curr, uint32_t));
+        if (memcmp(old_tlb_entries, dev->r4300.cp0.tlb.entries, sizeof(old_tlb_entries)) != 0) {
+            invalidate_r4300_cached_code(&dev->r4300, 0, 0);
+        }
+    }
+    else {
+        savestates_load_set_pc(&dev->r4300, GETDATA(curr, uint32_t));
+    }
 
     *r4300_cp0_next_interrupt(&dev->r4300.cp0) = GETDATA(curr, uint32_t);
     curr += 4; /* here there used to be next_vi */
@@ -941,22 +1028,20 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
         }
     }
 
-    /* Zilmar-Spec plugin expect a call with control_id = -1 when RAM processing is done */
-    if (input.controllerCommand) {
-        input.controllerCommand(-1, NULL);
-    }
+    if (!in_memory) {
+        /* Zilmar-Spec plugin expect a call with control_id = -1 when RAM processing is done */
+        if (input.controllerCommand) {
+            input.controllerCommand(-1, NULL);
+        }
 
-    /* reset fb state */
-    poweron_fb(&dev->dp.fb);
+        /* reset fb state */
+        poweron_fb(&dev->dp.fb);
+    }
 
     dev->sp.rsp_task_locked = 0;
     dev->r4300.cp0.interrupt_unsafe_state = 0;
 
     *r4300_cp0_last_addr(&dev->r4300.cp0) = *r4300_pc(&dev->r4300);
-
-    free(savestateData);
-    main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State loaded from: %s", namefrompath(filepath));
-    return 1;
 }
 
 static int savestates_load_pj64(struct device* dev,
@@ -1404,6 +1489,9 @@ int savestates_load(void)
     char *filepath = NULL;
     int ret = 0;
 
+    /* don't let a deferred DMA overwrite the loaded state */
+    rdram_flush_pending_dma(&g_dev.rdram);
+
     if (fname == NULL) // For slots, autodetect the savestate type
     {
         // try M64P type first
@@ -1484,6 +1572,9 @@ static void savestates_save_m64p_work(struct work_struct *work)
     int gzres;
     struct savestate_work *save = container_of(work, struct savestate_work, work);
 
+    /* complete the copy of memories captured by savestates_save_m64p */
+    snapshot_finish();
+
     SDL_LockMutex(savestates_lock);
 
     // Write the state to a GZIP file
@@ -1516,16 +1607,7 @@ static void savestates_save_m64p_work(struct work_struct *work)
 
 static int savestates_save_m64p(const struct device* dev, char *filepath)
 {
-    unsigned char outbuf[4];
-    int i;
-
-    char queue[1024];
-
     struct savestate_work *save;
-    char *curr;
-
-    /* OK to cast away const qualifier */
-    const uint32_t* cp0_regs = r4300_cp0_regs((struct cp0*)&dev->r4300.cp0);
 
     save = malloc(sizeof(*save));
     if (!save) {
@@ -1538,11 +1620,9 @@ static int savestates_save_m64p(const struct device* dev, char *filepath)
     if(autoinc_save_slot)
         savestates_inc_slot();
 
-    save_eventqueue_infos(&dev->r4300.cp0, queue);
-
     // Allocate memory for the save state data
-    save->size = 16788288 + sizeof(queue) + 4 + 4096;
-    save->data = curr = malloc(save->size);
+    save->size = M64P_STATE_SIZE;
+    save->data = calloc(1, save->size);
     if (save->data == NULL)
     {
         free(save->filepath);
@@ -1551,9 +1631,27 @@ static int savestates_save_m64p(const struct device* dev, char *filepath)
         return 0;
     }
 
-    memset(save->data, 0, save->size);
-
     // Write the save state data to memory
+    savestates_write_m64p(dev, save->data, 1);
+
+    init_work(&save->work, savestates_save_m64p_work);
+    queue_work(&save->work);
+
+    return 1;
+}
+
+static void savestates_write_m64p(const struct device* dev, char* curr, int deferred)
+{
+    unsigned char outbuf[4];
+    int i;
+
+    char queue[1024];
+
+    /* OK to cast away const qualifier */
+    const uint32_t* cp0_regs = r4300_cp0_regs((struct cp0*)&dev->r4300.cp0);
+
+    save_eventqueue_infos(&dev->r4300.cp0, queue);
+
     PUTARRAY(savestate_magic, curr, unsigned char, 8);
 
     outbuf[0] = (savestate_latest_version >> 24) & 0xff;
@@ -1704,15 +1802,15 @@ static int savestates_save_m64p(const struct device* dev, char *filepath)
     PUTDATA(curr, uint32_t, dev->dp.dps_regs[DPS_BUFTEST_ADDR_REG]);
     PUTDATA(curr, uint32_t, dev->dp.dps_regs[DPS_BUFTEST_DATA_REG]);
 
-    PUTARRAY(dev->rdram.dram, curr, uint32_t, RDRAM_MAX_SIZE/4);
-    PUTARRAY(dev->sp.mem, curr, uint32_t, SP_MEM_SIZE/4);
+    PUTSNAPSHOT(dev->rdram.dram, curr, RDRAM_MAX_SIZE/4, deferred);
+    PUTSNAPSHOT(dev->sp.mem, curr, SP_MEM_SIZE/4, deferred);
     PUTARRAY(dev->pif.ram, curr, uint8_t, PIF_RAM_SIZE);
 
     PUTDATA(curr, int32_t, dev->cart.use_flashram);
     curr += 4+8+4+4; // Here used to be flashram state
 
-    PUTARRAY(dev->r4300.cp0.tlb.LUT_r, curr, uint32_t, 0x100000);
-    PUTARRAY(dev->r4300.cp0.tlb.LUT_w, curr, uint32_t, 0x100000);
+    PUTSNAPSHOT(dev->r4300.cp0.tlb.LUT_r, curr, 0x100000, deferred);
+    PUTSNAPSHOT(dev->r4300.cp0.tlb.LUT_w, curr, 0x100000, deferred);
 
     /* OK to cast away const qualifier */
     PUTDATA(curr, uint32_t, *r4300_llbit((struct r4300_core*)&dev->r4300));
@@ -1909,9 +2007,37 @@ static int savestates_save_m64p(const struct device* dev, char *filepath)
     /* cp0 and cp2 latch (since 1.9) */
     PUTDATA(curr, uint64_t, *r4300_cp0_latch((struct cp0*)&dev->r4300.cp0));
     PUTDATA(curr, uint64_t, *r4300_cp2_latch((struct cp2*)&dev->r4300.cp2));
+}
 
-    init_work(&save->work, savestates_save_m64p_work);
-    queue_work(&save->work);
+size_t savestates_m64p_mem_size(void)
+{
+    return M64P_STATE_SIZE;
+}
+
+void savestates_save_m64p_mem(const struct device* dev, void* data)
+{
+    savestates_write_m64p(dev, (char*)data, 0);
+}
+
+int savestates_load_m64p_mem(struct device* dev, void* data)
+{
+    unsigned char* curr = (unsigned char*)data;
+    unsigned int version;
+
+    if (strncmp((char*)curr, savestate_magic, 8) != 0)
+        return 0;
+
+    version = ((unsigned int)curr[8] << 24) | ((unsigned int)curr[9] << 16)
+            | ((unsigned int)curr[10] << 8) | (unsigned int)curr[11];
+    if (version != (unsigned int)savestate_latest_version)
+        return 0;
+
+    curr += M64P_STATE_HEADER_SIZE;
+    savestates_parse_m64p(dev, version, curr,
+        (char*)(curr + M64P_STATE_DATA_SIZE),
+        curr + M64P_STATE_DATA_SIZE + M64P_STATE_QUEUE_SIZE,
+        curr + M64P_STATE_DATA_SIZE + M64P_STATE_QUEUE_SIZE + M64P_STATE_USING_TLB_SIZE,
+        1);
 
     return 1;
 }
@@ -2164,6 +2290,9 @@ int savestates_save(void)
         get_next_event_type(&dev->r4300.cp0.q) > COMPARE_INT)
         return 0;
 
+    rdram_flush_pending_dma(&g_dev.rdram);
+    file_storage_writeback_sync();
+
     if (fname != NULL && type == savestates_type_unknown)
         type = savestates_type_m64p;
     else if (fname == NULL) // Always save slots in M64P format
@@ -2196,10 +2325,13 @@ void savestates_init(void)
         DebugMessage(M64MSG_ERROR, "Could not create savestates list lock");
         return;
     }
+
+    snapshot_init();
 }
 
 void savestates_deinit(void)
 {
+    snapshot_deinit();
     SDL_DestroyMutex(savestates_lock);
     savestates_clear_job();
 }
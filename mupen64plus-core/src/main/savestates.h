@@ -25,6 +25,10 @@
 #ifndef __SAVESTAVES_H__
 #define __SAVESTAVES_H__
 
+#include <stddef.h>
+
+struct device;
+
 typedef enum _savestates_job
 {
     savestates_job_nothing,
@@ -48,6 +52,17 @@ void savestates_deinit(void);
 int savestates_load(void);
 int savestates_save(void);
 
+/* Uncompressed m64p savestates kept in memory, for the core's own use.
+ * Unlike file savestates they are taken synchronously and silently,
+ * and only the state format of the running build is accepted.
+ * Loading them only invalidates the cached code of the dram pages which
+ * changed, and doesn't notify the input plugin nor reset the fb state.
+ * data must be zero-initialized before its first use and is
+ * byteswapped in place by savestates_load_m64p_mem on big-endian hosts. */
+size_t savestates_m64p_mem_size(void);
+void savestates_save_m64p_mem(const struct device* dev, void* data);
+int savestates_load_m64p_mem(struct device* dev, void* data);
+
 void savestates_select_slot(unsigned int s);
 unsigned int savestates_get_slot(void);
 void savestates_set_autoinc_slot(int b);
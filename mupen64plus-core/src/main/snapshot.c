@@ -0,0 +1,422 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - snapshot.c                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "snapshot.h"
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#define SNAPSHOT_COW
+#elif defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define SNAPSHOT_COW
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define snapshot_cas(p, o, n) (_InterlockedCompareExchange((p), (n), (o)) == (o))
+#define snapshot_load(p)      _InterlockedCompareExchange((p), 0, 0)
+#define snapshot_store(p, v)  _InterlockedExchange((p), (v))
+#else
+#define snapshot_cas(p, o, n) __atomic_compare_exchange_n((p), &(long){ (o) }, (n), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define snapshot_load(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define snapshot_store(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+#define SNAPSHOT_MAX_REGIONS 8
+
+/* page states */
+enum { PAGE_PROTECTED, PAGE_COPYING, PAGE_COPIED };
+
+/* Protected pages of a memory. Slots are kept once allocated so that a late
+ * fault on a page which has just been unprotected is still recognized. */
+struct snapshot_region
+{
+    uint8_t* src;
+    uint8_t* dst;
+    size_t page_count;
+    volatile long* pages;
+    int active;
+};
+
+static SDL_mutex* l_snapshot_lock;
+static int l_snapshot_enabled;
+static size_t l_page_size;
+static struct snapshot_region l_regions[SNAPSHOT_MAX_REGIONS];
+
+#ifdef SNAPSHOT_COW
+
+static int protect_pages(void* p, size_t size, int writable)
+{
+#if defined(_WIN32)
+    DWORD old_protect;
+    return VirtualProtect(p, size, writable ? PAGE_READWRITE : PAGE_READONLY, &old_protect) ? 0 : -1;
+#else
+    return mprotect(p, size, PROT_READ | (writable ? PROT_WRITE : 0));
+#endif
+}
+
+/* Copy a protected page and make it writable again.
+ * Can be called concurrently from the fault handler of any thread. */
+static void copy_page(struct snapshot_region* r, size_t i)
+{
+    size_t offset = i * l_page_size;
+
+    if (!snapshot_cas(&r->pages[i], PAGE_PROTECTED, PAGE_COPYING)) {
+        return;
+    }
+
+    memcpy(r->dst + offset, r->src + offset, l_page_size);
+    protect_pages(r->src + offset, l_page_size, 1);
+    snapshot_store(&r->pages[i], PAGE_COPIED);
+}
+
+/* Returns 1 if the write fault at address was caused by a snapshot */
+static int handle_write_fault(uintptr_t address)
+{
+    size_t i;
+
+    for (i = 0; i < SNAPSHOT_MAX_REGIONS; ++i) {
+        struct snapshot_region* r = &l_regions[i];
+        uintptr_t offset = address - (uintptr_t)r->src;
+
+        if (r->pages == NULL || address < (uintptr_t)r->src || offset >= r->page_count * l_page_size) {
+            continue;
+        }
+
+        /* if another thread is copying the page, the write faults again
+         * until the page is unprotected */
+        copy_page(r, offset / l_page_size);
+        return 1;
+    }
+
+    return 0;
+}
+
+#if defined(_WIN32)
+
+static PVOID l_exception_handler;
+
+static LONG CALLBACK snapshot_exception_handler(PEXCEPTION_POINTERS info)
+{
+    const EXCEPTION_RECORD* rec = info->ExceptionRecord;
+
+    if (rec->ExceptionCode == EXCEPTION_ACCESS_VIOLATION
+     && rec->NumberParameters >= 2
+     && rec->ExceptionInformation[0] == 1
+     && handle_write_fault((uintptr_t)rec->ExceptionInformation[1])) {
+        return EXCEPTION_CONTINUE_EXECUTION;
+    }
+
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
+static int install_fault_handler(void)
+{
+    SYSTEM_INFO si;
+
+    GetSystemInfo(&si);
+    l_page_size = si.dwPageSize;
+
+    l_exception_handler = AddVectoredExceptionHandler(1, snapshot_exception_handler);
+    return (l_exception_handler != NULL) ? 0 : -1;
+}
+
+static void remove_fault_handler(void)
+{
+    RemoveVectoredExceptionHandler(l_exception_handler);
+    l_exception_handler = NULL;
+}
+
+#else
+
+static int l_handler_installed;
+static struct sigaction l_old_sigsegv;
+static struct sigaction l_old_sigbus;
+
+static void snapshot_signal_handler(int sig, siginfo_t* info, void* context)
+{
+    const struct sigaction* old = (sig == SIGBUS) ? &l_old_sigbus : &l_old_sigsegv;
+
+    if (handle_write_fault((uintptr_t)info->si_addr)) {
+        return;
+    }
+
+    /* not ours: hand it over to the previous handler */
+    if (old->sa_flags & SA_SIGINFO) {
+        old->sa_sigaction(sig, info, context);
+    }
+    else if (old->sa_handler == SIG_DFL || old->sa_handler == SIG_IGN) {
+        /* the fault is raised again with the previous disposition on return */
+        sigaction(sig, old, NULL);
+    }
+    else {
+        old->sa_handler(sig);
+    }
+}
+
+static int install_fault_handler(void)
+{
+    struct sigaction sa;
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    if (page_size <= 0) {
+        return -1;
+    }
+    l_page_size = (size_t)page_size;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = snapshot_signal_handler;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+
+    /* some hosts report writes to read-only pages as SIGBUS */
+    if (sigaction(SIGSEGV, &sa, &l_old_sigsegv) != 0) {
+        return -1;
+    }
+    if (sigaction(SIGBUS, &sa, &l_old_sigbus) != 0) {
+        sigaction(SIGSEGV, &l_old_sigsegv, NULL);
+        return -1;
+    }
+
+    l_handler_installed = 1;
+    return 0;
+}
+
+static void remove_fault_handler(void)
+{
+    if (l_handler_installed) {
+        sigaction(SIGSEGV, &l_old_sigsegv, NULL);
+        sigaction(SIGBUS, &l_old_sigbus, NULL);
+        l_handler_installed = 0;
+    }
+}
+
+#endif
+
+static void finish_locked(void)
+{
+    size_t i, k;
+
+    for (i = 0; i < SNAPSHOT_MAX_REGIONS; ++i) {
+        struct snapshot_region* r = &l_regions[i];
+
+        if (!r->active) {
+            continue;
+        }
+
+        for (k = 0; k < r->page_count; ++k) {
+            copy_page(r, k);
+        }
+
+        /* wait for pages being copied by fault handlers */
+        for (k = 0; k < r->page_count; ++k) {
+            while (snapshot_load(&r->pages[k]) != PAGE_COPIED) {
+                SDL_Delay(0);
+            }
+        }
+
+        r->active = 0;
+    }
+}
+
+static struct snapshot_region* get_region_locked(uint8_t* src, size_t page_count)
+{
+    size_t i, k;
+    struct snapshot_region* r;
+
+    /* reuse the slot of a previous capture of the same pages */
+    for (i = 0; i < SNAPSHOT_MAX_REGIONS; ++i) {
+        r = &l_regions[i];
+
+        if (r->pages != NULL && r->src == src && r->page_count == page_count) {
+            if (r->active) {
+                finish_locked();
+            }
+            return r;
+        }
+    }
+
+    for (i = 0; i < SNAPSHOT_MAX_REGIONS; ++i) {
+        r = &l_regions[i];
+
+        if (r->pages == NULL) {
+            volatile long* pages = malloc(page_count * sizeof(*pages));
+            if (pages == NULL) {
+                return NULL;
+            }
+
+            for (k = 0; k < page_count; ++k) {
+                pages[k] = PAGE_COPIED;
+            }
+
+            r->src = src;
+            r->page_count = page_count;
+            r->pages = pages;
+            return r;
+        }
+    }
+
+    return NULL;
+}
+
+static int add_locked(uint8_t* dst, uint8_t* src, size_t size)
+{
+    size_t k;
+    struct snapshot_region* r;
+    uintptr_t begin = ((uintptr_t)src + l_page_size - 1) & ~(uintptr_t)(l_page_size - 1);
+    uintptr_t end = ((uintptr_t)src + size) & ~(uintptr_t)(l_page_size - 1);
+    size_t head = (size_t)(begin - (uintptr_t)src);
+    size_t page_count;
+
+    if (end <= begin) {
+        return 0;
+    }
+
+    page_count = (size_t)(end - begin) / l_page_size;
+
+    r = get_region_locked((uint8_t*)begin, page_count);
+    if (r == NULL) {
+        return 0;
+    }
+
+    r->dst = dst + head;
+
+    /* protect first: a late fault from a previous capture
+     * must not see the new page states before that */
+    if (protect_pages((void*)begin, page_count * l_page_size, 0) != 0) {
+        DebugMessage(M64MSG_WARNING, "Failed to write-protect snapshot pages");
+        protect_pages((void*)begin, page_count * l_page_size, 1);
+        return 0;
+    }
+
+    for (k = 0; k < page_count; ++k) {
+        snapshot_store(&r->pages[k], PAGE_PROTECTED);
+    }
+    r->active = 1;
+
+    /* partial pages at both ends are copied right away */
+    memcpy(dst, src, head);
+    memcpy(dst + (end - (uintptr_t)src), (uint8_t*)end, (size_t)((uintptr_t)src + size - end));
+
+    return 1;
+}
+
+#endif
+
+void snapshot_init(void)
+{
+    l_snapshot_lock = SDL_CreateMutex();
+    if (!l_snapshot_lock) {
+        DebugMessage(M64MSG_ERROR, "Could not create snapshot lock");
+    }
+}
+
+void snapshot_deinit(void)
+{
+    size_t i;
+
+    snapshot_enable(0);
+
+#ifdef SNAPSHOT_COW
+    if (l_page_size != 0) {
+        remove_fault_handler();
+        l_page_size = 0;
+    }
+#endif
+
+    for (i = 0; i < SNAPSHOT_MAX_REGIONS; ++i) {
+        free((void*)l_regions[i].pages);
+    }
+    memset(l_regions, 0, sizeof(l_regions));
+
+    SDL_DestroyMutex(l_snapshot_lock);
+    l_snapshot_lock = NULL;
+}
+
+void snapshot_enable(int enable)
+{
+    if (l_snapshot_lock == NULL) {
+        return;
+    }
+
+    SDL_LockMutex(l_snapshot_lock);
+
+#ifdef SNAPSHOT_COW
+    if (enable && l_page_size == 0 && install_fault_handler() != 0) {
+        DebugMessage(M64MSG_WARNING, "Could not install snapshot fault handler");
+        l_page_size = 0;
+        enable = 0;
+    }
+
+    if (!enable) {
+        finish_locked();
+    }
+#else
+    enable = 0;
+#endif
+
+    l_snapshot_enabled = enable;
+
+    SDL_UnlockMutex(l_snapshot_lock);
+}
+
+void snapshot_add(void* dst, void* src, size_t size)
+{
+#ifdef SNAPSHOT_COW
+    if (l_snapshot_enabled) {
+        int deferred;
+
+        SDL_LockMutex(l_snapshot_lock);
+        deferred = add_locked((uint8_t*)dst, (uint8_t*)src, size);
+        SDL_UnlockMutex(l_snapshot_lock);
+
+        if (deferred) {
+            return;
+        }
+    }
+#endif
+
+    memcpy(dst, src, size);
+}
+
+void snapshot_finish(void)
+{
+#ifdef SNAPSHOT_COW
+    if (l_snapshot_lock == NULL) {
+        return;
+    }
+
+    SDL_LockMutex(l_snapshot_lock);
+    finish_locked();
+    SDL_UnlockMutex(l_snapshot_lock);
+#endif
+}
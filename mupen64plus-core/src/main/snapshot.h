@@ -0,0 +1,47 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - snapshot.h                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_SNAPSHOT_H
+#define M64P_MAIN_SNAPSHOT_H
+
+#include <stddef.h>
+
+/* Copy-on-write capture of large emulated memories.
+ *
+ * snapshot_add() records that size bytes at src must end up in dst as they
+ * are at the time of the call. When enabled, the whole pages of src are
+ * write-protected instead of being copied: the first write to one of them,
+ * from any thread, copies it to dst before the write proceeds.
+ * snapshot_finish() copies the pages left untouched, usually from a
+ * background thread, and must be called before dst is used.
+ *
+ * When disabled or unsupported by the host, snapshot_add() is a plain memcpy.
+ */
+
+void snapshot_init(void);
+void snapshot_deinit(void);
+
+void snapshot_enable(int enable);
+
+void snapshot_add(void* dst, void* src, size_t size);
+void snapshot_finish(void);
+
+#endif
@@ -26,6 +26,7 @@
 #if !defined (OSAL_FILES_H)
 #define OSAL_FILES_H
 
+#include <stdint.h>
 #include <zlib.h>
 
 /* some file-related preprocessor definitions */
@@ -67,5 +68,22 @@ extern const char * osal_get_user_cachepath(void);
 extern FILE * osal_file_open (const char *filename, const char *mode);
 extern gzFile osal_gzopen(const char *filename, const char *mode);
 
+/* Map a whole file in memory. Pages are copy-on-write: they are only read
+ * from the file when first accessed and modifications are never written back.
+ * Returns NULL on failure, otherwise stores the file size in *size.
+ */
+extern void * osal_file_map(const char *filename, size_t *size);
+extern void osal_file_unmap(void *data, size_t size);
+
+/* Get the size and last modification time (in seconds) of a file.
+ * Returns zero on success, nonzero on failure.
+ */
+extern int osal_file_stat(const char *filename, uint64_t *size, int64_t *mtime);
+
+/* Rename a file, atomically replacing newname if it exists.
+ * Returns zero on success, nonzero on failure.
+ */
+extern int osal_file_rename(const char *oldname, const char *newname);
+
 #endif /* OSAL_FILES_H */
 
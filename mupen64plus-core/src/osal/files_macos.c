@@ -29,6 +29,8 @@
 #include <sysdir.h>
 #include <pwd.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -232,3 +234,47 @@ gzFile osal_gzopen(const char *filename, const char *mode)
 {
     return gzopen(filename, mode);
 }
+
+void * osal_file_map(const char *filename, size_t *size)
+{
+    struct stat st;
+    void *data;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    *size = (size_t)st.st_size;
+    return data;
+}
+
+void osal_file_unmap(void *data, size_t size)
+{
+    munmap(data, size);
+}
+
+int osal_file_stat(const char *filename, uint64_t *size, int64_t *mtime)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0)
+        return 1;
+
+    *size = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return 0;
+}
+
+int osal_file_rename(const char *oldname, const char *newname)
+{
+    return rename(oldname, newname);
+}
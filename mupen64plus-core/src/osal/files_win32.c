@@ -220,3 +220,65 @@ gzFile osal_gzopen(const char *filename, const char *mode)
     MultiByteToWideChar(CP_UTF8, 0, filename, -1, wstr_filename, PATH_MAX);
     return gzopen_w(wstr_filename, mode);
 }
+
+void * osal_file_map(const char *filename, size_t *size)
+{
+    wchar_t wstr_filename[PATH_MAX];
+    LARGE_INTEGER file_size;
+    HANDLE file, mapping;
+    void *data;
+
+    MultiByteToWideChar(CP_UTF8, 0, filename, -1, wstr_filename, PATH_MAX);
+    file = CreateFileW(wstr_filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0)
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    mapping = CreateFileMappingW(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return NULL;
+
+    /* the view keeps the mapping alive */
+    data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL)
+        return NULL;
+
+    *size = (size_t)file_size.QuadPart;
+    return data;
+}
+
+void osal_file_unmap(void *data, size_t size)
+{
+    UnmapViewOfFile(data);
+}
+
+int osal_file_stat(const char *filename, uint64_t *size, int64_t *mtime)
+{
+    wchar_t wstr_filename[PATH_MAX];
+    struct _stat64 st;
+
+    MultiByteToWideChar(CP_UTF8, 0, filename, -1, wstr_filename, PATH_MAX);
+    if (_wstat64(wstr_filename, &st) != 0)
+        return 1;
+
+    *size = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return 0;
+}
+
+int osal_file_rename(const char *oldname, const char *newname)
+{
+    wchar_t wstr_oldname[PATH_MAX];
+    wchar_t wstr_newname[PATH_MAX];
+
+    MultiByteToWideChar(CP_UTF8, 0, oldname, -1, wstr_oldname, PATH_MAX);
+    MultiByteToWideChar(CP_UTF8, 0, newname, -1, wstr_newname, PATH_MAX);
+    return MoveFileExW(wstr_oldname, wstr_newname, MOVEFILE_REPLACE_EXISTING) ? 0 : 1;
+}
@@ -71,7 +71,8 @@ static const gfx_plugin_functions dummy_gfx = {
     dummyvideo_ResizeVideoOutput,
     dummyvideo_FBRead,
     dummyvideo_FBWrite,
-    dummyvideo_FBGetFrameBufferInfo
+    dummyvideo_FBGetFrameBufferInfo,
+    NULL
 };
 
 static const audio_plugin_functions dummy_audio = {
@@ -193,6 +194,7 @@ static m64p_error plugin_connect_gfx(m64p_dynlib_handle plugin_handle)
 
         /* set function pointers for optional functions */
         gfx.resizeVideoOutput = (ptr_ResizeVideoOutput)osal_dynlib_getproc(plugin_handle, "ResizeVideoOutput");
+        gfx.fBWriteRange = (ptr_FBWriteRange)osal_dynlib_getproc(plugin_handle, "FBWriteRange");
 
         /* check the version info */
         (*gfx.getVersion)(&PluginType, &PluginVersion, &APIVersion, NULL, NULL);
@@ -0,0 +1,293 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - dma_copy_check.c                                        *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Standalone checker for device/memory/dma_copy.c.
+ *
+ * Compares every helper against the byte loops it replaces, on random
+ * addresses, lengths and masks, then times them against those loops.
+ *
+ * Build from this directory:
+ *   cc -O2 -I../src -o dma_copy_check dma_copy_check.c ../src/device/memory/dma_copy.c
+ * and again with -DM64P_BIG_ENDIAN added to check the big-endian variants.
+ *
+ * Usage: dma_copy_check [iterations] [-b]
+ *   -b also runs the benchmarks.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "device/memory/dma_copy.h"
+#include "osal/preproc.h"
+
+enum {
+    MEM_SIZE = 0x10000,
+    BENCH_SIZE = 0x100000,
+    BENCH_BYTES = 1024 * BENCH_SIZE
+};
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void)
+{
+    /* xorshift32, so that failures are reproducible everywhere */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void fill_random(uint8_t* mem, size_t size)
+{
+    size_t i;
+    for (i = 0; i < size; ++i) {
+        mem[i] = (uint8_t)rng();
+    }
+}
+
+/* Reference implementations: the byte loops the helpers replaced */
+
+static void ref_copy(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length; ++i) {
+        dst[(dst_addr + i) ^ S8] = src[(src_addr + i) ^ S8];
+    }
+}
+
+static void ref_copy_wrap(uint8_t* dst, uint32_t dst_addr, uint32_t dst_mask,
+                          const uint8_t* src, uint32_t src_addr, uint32_t src_mask,
+                          size_t length)
+{
+    size_t i;
+    for (i = 0; i < length; ++i) {
+        dst[((dst_addr + i) & dst_mask) ^ S8] = src[((src_addr + i) & src_mask) ^ S8];
+    }
+}
+
+static void ref_copy_to_bytes(uint8_t* dst, const uint8_t* src, uint32_t src_addr, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length; ++i) {
+        dst[i] = src[(src_addr + i) ^ S8];
+    }
+}
+
+static void ref_copy_from_bytes(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length; ++i) {
+        dst[(dst_addr + i) ^ S8] = src[i];
+    }
+}
+
+static void ref_zero(uint8_t* dst, uint32_t dst_addr, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length; ++i) {
+        dst[(dst_addr + i) ^ S8] = 0;
+    }
+}
+
+static void ref_copy_swap32(uint32_t* dst, const uint32_t* src, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        dst[i] = tohl(src[i]);
+    }
+}
+
+/* Checks */
+
+static uint32_t src_mem[MEM_SIZE / 4];
+static uint32_t dst_mem[MEM_SIZE / 4];
+static uint32_t ref_mem[MEM_SIZE / 4];
+
+static int failures;
+
+static void check(const char* name, unsigned int iteration, uint32_t dst_addr, uint32_t src_addr, size_t length)
+{
+    if (memcmp(dst_mem, ref_mem, MEM_SIZE) != 0) {
+        if (failures++ < 10) {
+            fprintf(stderr, "%s mismatch at iteration %u: dst 0x%x, src 0x%x, length 0x%x\n",
+                    name, iteration, (unsigned int)dst_addr, (unsigned int)src_addr, (unsigned int)length);
+        }
+    }
+}
+
+static void reset_memories(void)
+{
+    fill_random((uint8_t*)src_mem, MEM_SIZE);
+    fill_random((uint8_t*)dst_mem, MEM_SIZE);
+    memcpy(ref_mem, dst_mem, MEM_SIZE);
+}
+
+static void check_all(unsigned int iterations)
+{
+    unsigned int n;
+
+    for (n = 0; n < iterations; ++n) {
+        /* favour short transfers, which exercise heads and tails */
+        size_t length = (rng() & 1) ? rng() % 64 : rng() % (MEM_SIZE / 2);
+        uint32_t src_addr = rng() % (MEM_SIZE - (uint32_t)length);
+        uint32_t dst_addr = rng() % (MEM_SIZE - (uint32_t)length);
+        uint32_t src_mask = (UINT32_C(4) << (rng() % 14)) - 1;
+        uint32_t dst_mask = (UINT32_C(4) << (rng() % 14)) - 1;
+        uint32_t wrap_src = rng() % MEM_SIZE;
+        uint32_t wrap_dst = rng() % MEM_SIZE;
+        size_t count = rng() % (MEM_SIZE / 4);
+
+        reset_memories();
+        dma_copy((uint8_t*)dst_mem, dst_addr, (const uint8_t*)src_mem, src_addr, length);
+        ref_copy((uint8_t*)ref_mem, dst_addr, (const uint8_t*)src_mem, src_addr, length);
+        check("dma_copy", n, dst_addr, src_addr, length);
+
+        reset_memories();
+        dma_copy_wrap((uint8_t*)dst_mem, wrap_dst, dst_mask, (const uint8_t*)src_mem, wrap_src, src_mask, length);
+        ref_copy_wrap((uint8_t*)ref_mem, wrap_dst, dst_mask, (const uint8_t*)src_mem, wrap_src, src_mask, length);
+        check("dma_copy_wrap", n, wrap_dst, wrap_src, length);
+
+        reset_memories();
+        dma_copy_to_bytes((uint8_t*)dst_mem + dst_addr, (const uint8_t*)src_mem, src_addr, length);
+        ref_copy_to_bytes((uint8_t*)ref_mem + dst_addr, (const uint8_t*)src_mem, src_addr, length);
+        check("dma_copy_to_bytes", n, dst_addr, src_addr, length);
+
+        reset_memories();
+        dma_copy_from_bytes((uint8_t*)dst_mem, dst_addr, (const uint8_t*)src_mem + src_addr, length);
+        ref_copy_from_bytes((uint8_t*)ref_mem, dst_addr, (const uint8_t*)src_mem + src_addr, length);
+        check("dma_copy_from_bytes", n, dst_addr, src_addr, length);
+
+        reset_memories();
+        dma_zero((uint8_t*)dst_mem, dst_addr, length);
+        ref_zero((uint8_t*)ref_mem, dst_addr, length);
+        check("dma_zero", n, dst_addr, 0, length);
+
+        reset_memories();
+        dma_copy_swap32(dst_mem + (MEM_SIZE / 4 - count), src_mem, count);
+        ref_copy_swap32(ref_mem + (MEM_SIZE / 4 - count), src_mem, count);
+        check("dma_copy_swap32", n, 0, 0, count * 4);
+    }
+}
+
+/* Benchmarks */
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef void (*copy_func)(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length);
+
+static double bench_copy(copy_func func, uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr)
+{
+    double start = now_seconds();
+    size_t done;
+
+    for (done = 0; done < BENCH_BYTES; done += BENCH_SIZE) {
+        func(dst, dst_addr, src, src_addr, BENCH_SIZE);
+    }
+
+    return (double)BENCH_BYTES / (now_seconds() - start) * 1e-9;
+}
+
+static void bench_copy_swap32_pair(uint32_t* dst, const uint32_t* src, double* ref_rate, double* rate)
+{
+    double start;
+    size_t done;
+
+    start = now_seconds();
+    for (done = 0; done < BENCH_BYTES; done += BENCH_SIZE) {
+        ref_copy_swap32(dst, src, BENCH_SIZE / 4);
+    }
+    *ref_rate = (double)BENCH_BYTES / (now_seconds() - start) * 1e-9;
+
+    start = now_seconds();
+    for (done = 0; done < BENCH_BYTES; done += BENCH_SIZE) {
+        dma_copy_swap32(dst, src, BENCH_SIZE / 4);
+    }
+    *rate = (double)BENCH_BYTES / (now_seconds() - start) * 1e-9;
+}
+
+static void bench_all(void)
+{
+    /* room for the misaligned offsets past the copied megabyte */
+    uint8_t* src = malloc(BENCH_SIZE + 8);
+    uint8_t* dst = malloc(BENCH_SIZE + 8);
+    double ref_rate, rate;
+
+    if (src == NULL || dst == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fill_random(src, BENCH_SIZE + 8);
+    fill_random(dst, BENCH_SIZE + 8);
+
+    printf("1 MiB copies, GB/s      byte loop   helper\n");
+
+    ref_rate = bench_copy(ref_copy, dst, 0, src, 0);
+    rate = bench_copy(dma_copy, dst, 0, src, 0);
+    printf("dma_copy aligned        %9.2f %8.2f\n", ref_rate, rate);
+
+    ref_rate = bench_copy(ref_copy, dst, 0, src, 2);
+    rate = bench_copy(dma_copy, dst, 0, src, 2);
+    printf("dma_copy misaligned     %9.2f %8.2f\n", ref_rate, rate);
+
+    bench_copy_swap32_pair((uint32_t*)dst, (const uint32_t*)src, &ref_rate, &rate);
+    printf("dma_copy_swap32         %9.2f %8.2f\n", ref_rate, rate);
+
+    free(src);
+    free(dst);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int iterations = 10000;
+    int bench = 0;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-b") == 0) {
+            bench = 1;
+        }
+        else {
+            iterations = (unsigned int)strtoul(argv[i], NULL, 0);
+        }
+    }
+
+    check_all(iterations);
+    if (failures != 0) {
+        fprintf(stderr, "%d mismatches\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("%u iterations: all helpers match the byte loops\n", iterations);
+
+    if (bench) {
+        bench_all();
+    }
+
+    return EXIT_SUCCESS;
+}
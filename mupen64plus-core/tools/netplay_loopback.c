@@ -0,0 +1,293 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - netplay_loopback.c                                      *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Runs main/netplay.c against a netplay server, without an emulator.
+ *
+ * The emulated machine is replaced by a hash of every input it used, kept
+ * in a small fake RDRAM which rollbacks save and restore like the real one.
+ * Each client reads its controllers once per frame and sends the hash with
+ * the CP0 sync data, so the server detects any input the two clients did
+ * not agree on, including a misprediction that was not rolled back.
+ * Local inputs change every few frames, so with some latency added remote
+ * inputs are mispredicted regularly.
+ *
+ * Build from this directory, with SDL2 and SDL2_net:
+ *   cc -O2 -DM64P_NETPLAY -I../src -I../subprojects/xxhash $(sdl2-config --cflags) \
+ *      -o netplay_loopback netplay_loopback.c ../src/main/netplay.c \
+ *      ../src/backends/clock_monotonic.c $(sdl2-config --libs) -lSDL2_net
+ *
+ * Usage: netplay_loopback -P player [-h host] [-p port] [-f frames]
+ *                         [-r rollback] [-l latency] [-L loss] [-v]
+ *   -P player controlled by this client, 1 to 4
+ *   -f frames to emulate (default 700, the server compares the sync data of VI 600)
+ *      followed by 30 frames without simulated faults nor input changes, so
+ *      the last inputs are confirmed before the clients leave and both end
+ *      with the same hash
+ *   -r rollback frames, 0 for delay-based netplay (default 0)
+ *   -l -L latency in ms and percentage of lost packets to simulate (default 0)
+ *   -v prints verbose messages, which include the netplay statistics
+ *
+ * tools/netplay_loopback.sh starts a server and two clients with each
+ * scenario. The client exits with a nonzero status if netplay reported an
+ * error, such as a desync or a lost connection.
+ */
+
+#include <SDL.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "backends/api/joybus.h"
+#include "backends/plugins_compat/plugins_compat.h"
+#include "device/device.h"
+#include "main/main.h"
+#include "main/netplay.h"
+#include "main/runahead.h"
+#include "main/savestates.h"
+#include "main/util.h"
+#include "plugin/plugin.h"
+
+#define FAKE_DRAM_WORDS 64
+#define TAIL_FRAMES 30
+
+enum {
+    MACHINE_FRAME,
+    MACHINE_HASH
+};
+
+/* what the core provides to netplay.c */
+struct device g_dev;
+CONTROL Controls[NUM_CONTROLLER];
+
+static uint32_t l_dram[FAKE_DRAM_WORDS];
+static uint32_t l_cp0_regs[CP0_REGS_COUNT];
+static struct controller_input_compat l_cin_compats[4];
+static uint32_t l_frames = 700;
+static int l_verbose;
+static int l_tail;
+static int l_stopped;
+static unsigned int l_errors;
+
+void DebugMessage(int level, const char* message, ...)
+{
+    va_list args;
+
+    /* the other client may leave first, the server still reports desyncs */
+    if (level == M64MSG_ERROR && !l_tail)
+        ++l_errors;
+    if (level == M64MSG_VERBOSE && !l_verbose)
+        return;
+
+    va_start(args, message);
+    vfprintf(stderr, message, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+m64p_error main_core_state_set(m64p_core_param param, int val)
+{
+    if (param == M64CORE_EMU_STATE && val == M64EMU_STOPPED)
+        l_stopped = 1;
+    return M64ERR_SUCCESS;
+}
+
+file_status_t read_from_file(const char* filename, void* data, size_t size)
+{
+    return file_open_error;
+}
+
+uint32_t* r4300_cp0_regs(struct cp0* cp0)
+{
+    return l_cp0_regs;
+}
+
+size_t savestates_m64p_mem_size(void)
+{
+    return sizeof(l_dram);
+}
+
+void savestates_save_m64p_mem(const struct device* dev, void* data)
+{
+    memcpy(data, l_dram, sizeof(l_dram));
+}
+
+int savestates_load_m64p_mem(struct device* dev, void* data)
+{
+    memcpy(l_dram, data, sizeof(l_dram));
+    return 1;
+}
+
+void runahead_show_video(int show)
+{
+}
+
+void runahead_play_audio(int play)
+{
+}
+
+static uint32_t local_input(int player, uint32_t frame)
+{
+    /* stays the same for 8 frames, so predictions are right most of the time */
+    uint32_t x = (uint32_t)player * 0x9e3779b9u + (((frame < l_frames) ? frame : l_frames) / 8) * 0x85ebca6bu;
+    x ^= x >> 15;
+    x *= 0x2c1b3c6du;
+    x ^= x >> 12;
+    return x;
+}
+
+static void emulate_frame(struct pif* pif, int player)
+{
+    uint8_t tx[4], rx[4], tx_buf[4][1];
+    uint32_t rx_buf[4];
+
+    /* the game reads every controller once per frame */
+    memset(pif, 0, sizeof(*pif));
+    for (int i = 0; i < 4; ++i)
+    {
+        tx[i] = 1;
+        rx[i] = 4;
+        tx_buf[i][0] = JCMD_CONTROLLER_READ;
+        rx_buf[i] = (i == player) ? local_input(player, l_dram[MACHINE_FRAME]) : 0;
+        pif->channels[i].tx = &tx[i];
+        pif->channels[i].tx_buf = tx_buf[i];
+        pif->channels[i].rx = &rx[i];
+        pif->channels[i].rx_buf = (uint8_t*)&rx_buf[i];
+    }
+
+    netplay_update_input(pif);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        if (Controls[i].Present)
+            l_dram[MACHINE_HASH] = (l_dram[MACHINE_HASH] ^ rx_buf[i]) * 16777619u;
+    }
+    ++l_dram[MACHINE_FRAME];
+}
+
+static void vertical_interrupt(void)
+{
+    l_cp0_regs[0] = l_dram[MACHINE_FRAME];
+    l_cp0_regs[1] = l_dram[MACHINE_HASH];
+    netplay_check_sync(&g_dev.r4300.cp0);
+    netplay_new_vi();
+}
+
+int main(int argc, char** argv)
+{
+    const char* host = "127.0.0.1";
+    int port = 45000;
+    int player = -1;
+    unsigned int rollback = 0;
+    unsigned int latency = 0;
+    unsigned int loss = 0;
+    uint32_t settings[6] = { 2, 0, 0, 2300, 2, 0 };
+    struct pif pif;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+            l_verbose = 1;
+        else if (i + 1 < argc && strcmp(argv[i], "-h") == 0)
+            host = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-p") == 0)
+            port = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-P") == 0)
+            player = atoi(argv[++i]) - 1;
+        else if (i + 1 < argc && strcmp(argv[i], "-f") == 0)
+            l_frames = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-r") == 0)
+            rollback = (unsigned int)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-l") == 0)
+            latency = (unsigned int)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-L") == 0)
+            loss = (unsigned int)atoi(argv[++i]);
+        else
+            player = -1, i = argc;
+    }
+
+    if (player < 0 || player > 3)
+    {
+        fprintf(stderr, "usage: %s -P player [-h host] [-p port] [-f frames] [-r rollback] [-l latency] [-L loss] [-v]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (SDL_Init(0) < 0 || netplay_start(host, port) != M64ERR_SUCCESS)
+        return EXIT_FAILURE;
+
+    /* same sequence as a front-end and the core going through a game start */
+    Controls[player].Plugin = PLUGIN_NONE;
+    if (!netplay_register_player((uint8_t)player, PLUGIN_NONE, 0, 0x1000u + (uint32_t)player))
+    {
+        fprintf(stderr, "netplay_loopback: player %d is already registered\n", player + 1);
+        netplay_stop();
+        return EXIT_FAILURE;
+    }
+    netplay_set_controller((uint8_t)player);
+
+    netplay_sync_settings(&settings[0], &settings[1], &settings[2], (int32_t*)&settings[3], &settings[4], (int32_t*)&settings[5]);
+    netplay_read_registration(l_cin_compats);
+    netplay_simulate_network(latency, loss);
+    netplay_rollback_start(rollback);
+
+    g_dev.rdram.dram = l_dram;
+    g_dev.rdram.dram_size = sizeof(l_dram);
+
+    uint32_t start = SDL_GetTicks();
+    unsigned int emulated = 0;
+    while (!l_stopped)
+    {
+        netplay_update();
+        if (l_dram[MACHINE_FRAME] >= l_frames + TAIL_FRAMES)
+            break;
+
+        if (!l_tail && l_dram[MACHINE_FRAME] >= l_frames)
+        {
+            netplay_simulate_network(0, 0);
+            l_tail = 1;
+        }
+
+        emulate_frame(&pif, player);
+        vertical_interrupt();
+        ++emulated;
+
+        /* frames emulated again are not paced, like in the core */
+        if (!netplay_is_resimulating())
+        {
+            uint32_t due = start + l_dram[MACHINE_FRAME] * 1000 / 60;
+            uint32_t now = SDL_GetTicks();
+            if ((int32_t)(due - now) > 0)
+                SDL_Delay(due - now);
+        }
+    }
+
+    printf("netplay_loopback: player %d, %u frames (%u emulated), hash %08x, %u error(s)\n",
+        player + 1, l_dram[MACHINE_FRAME], emulated, l_dram[MACHINE_HASH], l_errors);
+
+    netplay_rollback_stop();
+    netplay_stop();
+    SDL_Quit();
+
+    return (l_errors != 0 || l_stopped) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#!/bin/sh
+# Runs two netplay_loopback clients against netplay_server in several
+# scenarios, see netplay_loopback.c and netplay_server.c to build them.
+#
+# Usage: netplay_loopback.sh [directory of the binaries] [first port]
+#
+# A scenario passes if the server saw no desync, both clients exit without
+# error and end with the same hash. Scenarios meant to force mispredictions
+# also fail if no rollback happened, and scenarios with packet loss fail if
+# no packet was dropped.
+
+BIN=${1:-.}
+PORT=${2:-45000}
+LOGS=$(mktemp -d)
+FAILED=0
+
+# scenario name, server options, client options, whether rollbacks are expected
+run() {
+    name=$1
+    server_opts=$2
+    client_opts=$3
+    expect_rollbacks=$4
+    log=$LOGS/$name
+    PORT=$((PORT + 1))
+
+    "$BIN/netplay_server" -p $PORT $server_opts > "$log.server" 2>&1 &
+    server=$!
+    sleep 1
+
+    "$BIN/netplay_loopback" -P 1 -p $PORT -v $client_opts > "$log.1" 2>&1 &
+    client1=$!
+    "$BIN/netplay_loopback" -P 2 -p $PORT -v $client_opts > "$log.2" 2>&1
+    status2=$?
+    wait $client1
+    status1=$?
+    wait $server
+    status=$?
+
+    hash1=$(sed -n 's/.*, hash \([0-9a-f]*\),.*/\1/p' "$log.1")
+    hash2=$(sed -n 's/.*, hash \([0-9a-f]*\),.*/\1/p' "$log.2")
+    rollbacks=$(cat "$log.1" "$log.2" | sed -n 's/^Netplay: \([0-9]*\) rollbacks.*/\1/p' | awk '{ n += $1 } END { print n + 0 }')
+    lost=$(cat "$log.1" "$log.2" | sed -n 's/.* \([0-9]*\) sent and \([0-9]*\) received packets lost.*/\1 \2/p' | awk '{ n += $1 + $2 } END { print n + 0 }')
+
+    result=PASS
+    if [ $status -ne 0 ] || [ $status1 -ne 0 ] || [ $status2 -ne 0 ]; then
+        result=FAIL
+    elif [ -z "$hash1" ] || [ "$hash1" != "$hash2" ]; then
+        result=FAIL
+    elif [ "$expect_rollbacks" = yes ] && [ "$rollbacks" -eq 0 ]; then
+        result=FAIL
+    elif echo "$client_opts" | grep -q -- -L && [ "$lost" -eq 0 ]; then
+        result=FAIL
+    fi
+
+    echo "$result: $name ($rollbacks rollbacks, $lost packets lost)"
+    if [ $result = FAIL ]; then
+        FAILED=1
+        cat "$log.server" "$log.1" "$log.2"
+    fi
+}
+
+run delay "" "" no
+run rollback-latency "" "-r 8 -l 50" yes
+run rollback-unsupported "-c 0" "-r 8 -l 50" no
+run delay-loss "" "-L 10" no
+run legacy-server-loss "-c 0" "-L 10" no
+run rollback-loss "" "-r 8 -l 30 -L 10" yes
+
+rm -rf "$LOGS"
+exit $FAILED
@@ -0,0 +1,679 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - netplay_server.c                                        *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Minimal stand-in for a netplay server, to run netplay over loopback.
+ *
+ * It implements the protocol described in
+ * doc/emuwiki-api-doc/Mupen64Plus-v2.0-Netplay-API.mediawiki for a single
+ * game: player registration, settings and save file exchange, input relay
+ * and desync detection. Inputs are registered at the count the client sent
+ * them for, and there is no lobby, buffer management or lag reporting.
+ *
+ * Build from this directory (POSIX only):
+ *   cc -O2 -o netplay_server netplay_server.c
+ *
+ * Usage: netplay_server [-p port] [-n players] [-b buffer] [-c caps]
+ *   -p port to listen on, TCP and UDP (default 45000)
+ *   -n number of players to wait for before the game starts (default 2)
+ *   -b local buffer target sent to the clients (default 2)
+ *   -c capability bits advertised in the registration response (default 0x6),
+ *      0 behaves like a server unaware of rollback and of input batches
+ *
+ * The server exits once every registered player has disconnected, with a
+ * nonzero status if the clients have de-synced.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define UDP_SEND_KEY_INFO 0
+#define UDP_RECEIVE_KEY_INFO 1
+#define UDP_REQUEST_KEY_INFO 2
+#define UDP_RECEIVE_KEY_INFO_GRATUITOUS 3
+#define UDP_SYNC_DATA 4
+#define UDP_SEND_KEY_INFO_BATCH 5
+
+#define TCP_SEND_SAVE 1
+#define TCP_RECEIVE_SAVE 2
+#define TCP_SEND_SETTINGS 3
+#define TCP_RECEIVE_SETTINGS 4
+#define TCP_REGISTER_PLAYER 5
+#define TCP_GET_REGISTRATION 6
+#define TCP_DISCONNECT_NOTICE 7
+
+#define NETPLAY_CAP_ROLLBACK 0x02
+#define NETPLAY_CAP_INPUT_BATCH 0x04
+
+#define SETTINGS_SIZE 24
+#define MAX_DATAGRAM 512
+#define MAX_CLIENTS 8
+#define MAX_SAVES 8
+#define MAX_SAVE_SIZE 0x100000
+#define INPUT_HISTORY 4096 /* inputs kept per player, must be a power of 2 */
+#define INPUTS_PER_PACKET 32
+#define SYNC_HISTORY 16
+#define SYNC_MAX_SIZE 141
+
+struct input
+{
+    uint32_t count;
+    uint32_t keys;
+    uint8_t plugin;
+    uint8_t valid;
+};
+
+struct player
+{
+    uint32_t reg_id; /* 0 if nobody controls this player */
+    uint8_t plugin;
+    uint8_t rawdata;
+    int disconnected;
+    struct input inputs[INPUT_HISTORY];
+};
+
+struct tcp_client
+{
+    int fd;
+    uint32_t reg_id; /* of the last player registered through this connection */
+    size_t len;
+    uint8_t buf[MAX_SAVE_SIZE + 64];
+};
+
+struct peer
+{
+    uint32_t reg_id;
+    struct sockaddr_in addr;
+};
+
+struct save
+{
+    char ext[16];
+    uint32_t size;
+    uint8_t* data;
+};
+
+struct sync
+{
+    uint32_t vi;
+    size_t len;
+    uint8_t data[SYNC_MAX_SIZE];
+};
+
+static struct player l_players[4];
+static struct tcp_client* l_clients[MAX_CLIENTS];
+static struct peer l_peers[MAX_CLIENTS];
+static size_t l_num_peers;
+static struct save l_saves[MAX_SAVES];
+static uint8_t l_settings[SETTINGS_SIZE];
+static int l_has_settings;
+static struct sync l_syncs[SYNC_HISTORY];
+static size_t l_num_syncs;
+static size_t l_next_sync;
+
+static int l_udp = -1;
+static uint8_t l_status;
+static unsigned int l_expected_players = 2;
+static uint8_t l_buffer_target = 2;
+static uint8_t l_caps = NETPLAY_CAP_ROLLBACK | NETPLAY_CAP_INPUT_BATCH;
+static int l_registered;
+
+static unsigned int l_inputs_received;
+static unsigned int l_duplicates;
+static unsigned int l_requests;
+static unsigned int l_syncs_checked;
+
+static uint32_t read32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void write32(uint32_t v, uint8_t* p)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static int send_all(int fd, const void* data, size_t size)
+{
+    const uint8_t* p = data;
+    while (size != 0)
+    {
+        ssize_t sent = send(fd, p, size, 0);
+        if (sent <= 0)
+            return 0;
+        p += sent;
+        size -= sent;
+    }
+    return 1;
+}
+
+static unsigned int num_registered(void)
+{
+    unsigned int n = 0;
+    for (int i = 0; i < 4; ++i)
+        n += (l_players[i].reg_id != 0);
+    return n;
+}
+
+static int player_of(uint32_t reg_id)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        if (l_players[i].reg_id == reg_id)
+            return i;
+    }
+    return -1;
+}
+
+/* UDP */
+
+static void remember_peer(uint32_t reg_id, const struct sockaddr_in* addr)
+{
+    for (size_t i = 0; i < l_num_peers; ++i)
+    {
+        if (l_peers[i].reg_id == reg_id)
+        {
+            l_peers[i].addr = *addr;
+            return;
+        }
+    }
+    if (l_num_peers < MAX_CLIENTS)
+    {
+        l_peers[l_num_peers].reg_id = reg_id;
+        l_peers[l_num_peers].addr = *addr;
+        ++l_num_peers;
+    }
+}
+
+static struct input* find_input(uint8_t player, uint32_t count)
+{
+    struct input* input = &l_players[player].inputs[count & (INPUT_HISTORY - 1)];
+    return (input->valid && input->count == count) ? input : NULL;
+}
+
+static size_t write_key_info(uint8_t* out, uint8_t type, uint8_t player)
+{
+    out[0] = type;
+    out[1] = player;
+    out[2] = l_status;
+    out[3] = 0; /* lag behind the lead player, not tracked */
+    out[4] = 0;
+    return 5;
+}
+
+static size_t append_input(uint8_t* out, size_t len, const struct input* input)
+{
+    write32(input->count, &out[len]);
+    write32(input->keys, &out[len + 4]);
+    out[len + 8] = input->plugin;
+    ++out[4];
+    return len + 9;
+}
+
+static int store_input(uint8_t player, uint32_t count, uint32_t keys, uint8_t plugin)
+{
+    /* the first input received for a count is the one every client uses */
+    struct input* input = &l_players[player].inputs[count & (INPUT_HISTORY - 1)];
+    ++l_inputs_received;
+    if (input->valid && input->count == count)
+    {
+        ++l_duplicates;
+        return 0;
+    }
+    input->count = count;
+    input->keys = keys;
+    input->plugin = plugin;
+    input->valid = 1;
+    return 1;
+}
+
+static void receive_inputs(const uint8_t* data, size_t len)
+{
+    uint8_t out[MAX_DATAGRAM];
+    uint8_t player = data[1];
+    size_t out_len = write_key_info(out, UDP_RECEIVE_KEY_INFO_GRATUITOUS, player);
+
+    if (player >= 4)
+        return;
+
+    if (data[0] == UDP_SEND_KEY_INFO)
+    {
+        if (len < 11)
+            return;
+        if (store_input(player, read32(&data[2]), read32(&data[6]), data[10]))
+            out_len = append_input(out, out_len, find_input(player, read32(&data[2])));
+    }
+    else
+    {
+        uint8_t n = data[2];
+        if (len < 3 + (size_t)n * 9)
+            return;
+        for (uint8_t i = 0; i < n; ++i)
+        {
+            const uint8_t* p = &data[3 + i * 9];
+            if (store_input(player, read32(&p[0]), read32(&p[4]), p[8]))
+                out_len = append_input(out, out_len, find_input(player, read32(&p[0])));
+        }
+    }
+
+    /* new inputs are pushed to everyone right away */
+    if (out[4] != 0)
+    {
+        for (size_t i = 0; i < l_num_peers; ++i)
+            sendto(l_udp, out, out_len, 0, (const struct sockaddr*)&l_peers[i].addr, sizeof(l_peers[i].addr));
+    }
+}
+
+static void request_inputs(const uint8_t* data, size_t len, const struct sockaddr_in* from)
+{
+    uint8_t out[MAX_DATAGRAM];
+    uint8_t player = data[1];
+    uint32_t count = read32(&data[6]);
+    size_t out_len = write_key_info(out, UDP_RECEIVE_KEY_INFO, player);
+    const struct input* input;
+
+    if (len < 12 || player >= 4)
+        return;
+
+    ++l_requests;
+    remember_peer(read32(&data[2]), from);
+
+    while (out[4] < INPUTS_PER_PACKET && (input = find_input(player, count + out[4])) != NULL)
+        out_len = append_input(out, out_len, input);
+
+    if (out[4] != 0)
+        sendto(l_udp, out, out_len, 0, (const struct sockaddr*)from, sizeof(*from));
+}
+
+static void check_sync(const uint8_t* data, size_t len)
+{
+    uint32_t vi = read32(&data[1]);
+
+    if (len < 5 || len > SYNC_MAX_SIZE)
+        return;
+
+    for (size_t i = 0; i < l_num_syncs; ++i)
+    {
+        struct sync* sync = &l_syncs[i];
+        if (sync->vi != vi)
+            continue;
+
+        /* a client without rollback sends no RDRAM hash, compare what both sent */
+        size_t common = (len < sync->len) ? len : sync->len;
+        ++l_syncs_checked;
+        if (memcmp(sync->data, data, common) != 0 && !(l_status & 1))
+        {
+            fprintf(stderr, "netplay_server: clients have de-synced at VI %u\n", vi);
+            l_status |= 1;
+        }
+        return;
+    }
+
+    struct sync* sync = &l_syncs[l_next_sync];
+    l_next_sync = (l_next_sync + 1) % SYNC_HISTORY;
+    if (l_num_syncs < SYNC_HISTORY)
+        ++l_num_syncs;
+    sync->vi = vi;
+    sync->len = len;
+    memcpy(sync->data, data, len);
+}
+
+static void process_udp(void)
+{
+    uint8_t data[MAX_DATAGRAM];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t len;
+
+    while ((len = recvfrom(l_udp, data, sizeof(data), MSG_DONTWAIT, (struct sockaddr*)&from, &from_len)) > 0)
+    {
+        switch (data[0])
+        {
+            case UDP_SEND_KEY_INFO_BATCH:
+                if (!(l_caps & NETPLAY_CAP_INPUT_BATCH))
+                {
+                    /* like a server which predates them */
+                    fprintf(stderr, "netplay_server: unknown UDP packet %u\n", data[0]);
+                    break;
+                }
+                receive_inputs(data, (size_t)len);
+                break;
+            case UDP_SEND_KEY_INFO:
+                receive_inputs(data, (size_t)len);
+                break;
+            case UDP_REQUEST_KEY_INFO:
+                request_inputs(data, (size_t)len, &from);
+                break;
+            case UDP_SYNC_DATA:
+                check_sync(data, (size_t)len);
+                break;
+            default:
+                fprintf(stderr, "netplay_server: unknown UDP packet %u\n", data[0]);
+                break;
+        }
+        from_len = sizeof(from);
+    }
+}
+
+/* TCP */
+
+static struct save* find_save(const char* ext)
+{
+    for (int i = 0; i < MAX_SAVES; ++i)
+    {
+        if (l_saves[i].data != NULL && strcmp(l_saves[i].ext, ext) == 0)
+            return &l_saves[i];
+    }
+    return NULL;
+}
+
+static size_t string_end(const struct tcp_client* client, size_t begin)
+{
+    /* returns the position after the terminating zero, or 0 if incomplete */
+    for (size_t i = begin; i < client->len; ++i)
+    {
+        if (client->buf[i] == '\0')
+            return i + 1;
+    }
+    return 0;
+}
+
+static void disconnect_player(uint32_t reg_id)
+{
+    int player = player_of(reg_id);
+    if (player >= 0 && !l_players[player].disconnected)
+    {
+        l_players[player].disconnected = 1;
+        l_status |= 1 << (player + 1);
+        printf("netplay_server: player %d disconnected\n", player + 1);
+    }
+}
+
+/* Handles the first request buffered for a client. Returns its size once it
+ * has been handled, 0 if it is incomplete or can't be answered yet. */
+static size_t process_request(struct tcp_client* client)
+{
+    uint8_t* buf = client->buf;
+    uint8_t out[32];
+    size_t end;
+
+    switch (buf[0])
+    {
+        case TCP_SEND_SAVE:
+        {
+            if ((end = string_end(client, 1)) == 0 || client->len < end + 4)
+                return 0;
+            uint32_t size = read32(&buf[end]);
+            if (size > MAX_SAVE_SIZE || end - 1 > sizeof(l_saves[0].ext))
+            {
+                fprintf(stderr, "netplay_server: invalid save file\n");
+                return client->len;
+            }
+            if (client->len < end + 4 + size)
+                return 0;
+            struct save* save = find_save((const char*)&buf[1]);
+            for (int i = 0; save == NULL && i < MAX_SAVES; ++i)
+            {
+                if (l_saves[i].data == NULL)
+                    save = &l_saves[i];
+            }
+            if (save != NULL)
+            {
+                free(save->data);
+                strcpy(save->ext, (const char*)&buf[1]);
+                save->size = size;
+                save->data = malloc(size ? size : 1);
+                memcpy(save->data, &buf[end + 4], size);
+            }
+            return end + 4 + size;
+        }
+
+        case TCP_RECEIVE_SAVE:
+        {
+            if ((end = string_end(client, 1)) == 0)
+                return 0;
+            /* wait for player 1 to send it */
+            struct save* save = find_save((const char*)&buf[1]);
+            if (save == NULL)
+                return 0;
+            send_all(client->fd, save->data, save->size);
+            return end;
+        }
+
+        case TCP_SEND_SETTINGS:
+            if (client->len < SETTINGS_SIZE + 1)
+                return 0;
+            memcpy(l_settings, &buf[1], SETTINGS_SIZE);
+            l_has_settings = 1;
+            return SETTINGS_SIZE + 1;
+
+        case TCP_RECEIVE_SETTINGS:
+            if (!l_has_settings)
+                return 0;
+            send_all(client->fd, l_settings, SETTINGS_SIZE);
+            return 1;
+
+        case TCP_REGISTER_PLAYER:
+        {
+            if (client->len < 8)
+                return 0;
+            uint8_t player = buf[1];
+            uint32_t reg_id = read32(&buf[4]);
+            int ok = (player < 4 && reg_id != 0 && (l_players[player].reg_id == 0 || l_players[player].reg_id == reg_id));
+            if (ok)
+            {
+                l_players[player].reg_id = reg_id;
+                l_players[player].plugin = buf[2];
+                l_players[player].rawdata = buf[3];
+                l_registered = 1;
+                client->reg_id = reg_id;
+                printf("netplay_server: player %u registered\n", player + 1);
+            }
+            out[0] = (uint8_t)ok | (ok ? l_caps : 0);
+            out[1] = l_buffer_target;
+            send_all(client->fd, out, 2);
+            return 8;
+        }
+
+        case TCP_GET_REGISTRATION:
+            /* the game starts once everyone has registered */
+            if (num_registered() < l_expected_players)
+                return 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                write32(l_players[i].reg_id, &out[i * 6]);
+                out[i * 6 + 4] = l_players[i].plugin;
+                out[i * 6 + 5] = l_players[i].rawdata;
+            }
+            send_all(client->fd, out, 24);
+            return 1;
+
+        case TCP_DISCONNECT_NOTICE:
+            if (client->len < 5)
+                return 0;
+            disconnect_player(read32(&buf[1]));
+            return 5;
+
+        default:
+            fprintf(stderr, "netplay_server: unknown TCP request %u\n", buf[0]);
+            return client->len;
+    }
+}
+
+static int process_tcp(struct tcp_client* client, int readable)
+{
+    /* returns 0 once the connection is closed */
+    if (readable)
+    {
+        ssize_t len = recv(client->fd, client->buf + client->len, sizeof(client->buf) - client->len, 0);
+        if (len <= 0)
+            return 0;
+        client->len += (size_t)len;
+    }
+
+    size_t used;
+    while (client->len != 0 && (used = process_request(client)) != 0)
+    {
+        client->len -= used;
+        memmove(client->buf, client->buf + used, client->len);
+    }
+    return 1;
+}
+
+static int open_sockets(int port, int* tcp)
+{
+    struct sockaddr_in addr;
+    int on = 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+
+    *tcp = socket(AF_INET, SOCK_STREAM, 0);
+    l_udp = socket(AF_INET, SOCK_DGRAM, 0);
+    if (*tcp < 0 || l_udp < 0)
+        return 0;
+
+    setsockopt(*tcp, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    return bind(*tcp, (struct sockaddr*)&addr, sizeof(addr)) == 0
+        && listen(*tcp, MAX_CLIENTS) == 0
+        && bind(l_udp, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+}
+
+static int all_disconnected(void)
+{
+    if (!l_registered)
+        return 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (l_players[i].reg_id != 0 && !l_players[i].disconnected)
+            return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    int port = 45000;
+    int tcp;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        long value = strtol(argv[i + 1], NULL, 0);
+        if (strcmp(argv[i], "-p") == 0)
+            port = (int)value;
+        else if (strcmp(argv[i], "-n") == 0 && value >= 1 && value <= 4)
+            l_expected_players = (unsigned int)value;
+        else if (strcmp(argv[i], "-b") == 0)
+            l_buffer_target = (uint8_t)value;
+        else if (strcmp(argv[i], "-c") == 0)
+            l_caps = (uint8_t)(value & ~1);
+        else
+        {
+            fprintf(stderr, "usage: %s [-p port] [-n players] [-b buffer] [-c caps]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!open_sockets(port, &tcp))
+    {
+        fprintf(stderr, "netplay_server: can't listen on port %d: %s\n", port, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    printf("netplay_server: listening on port %d for %u player(s)\n", port, l_expected_players);
+    fflush(stdout);
+
+    while (!all_disconnected())
+    {
+        struct pollfd fds[MAX_CLIENTS + 2];
+        nfds_t n = 0;
+
+        fds[n].fd = tcp;
+        fds[n++].events = POLLIN;
+        fds[n].fd = l_udp;
+        fds[n++].events = POLLIN;
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+        {
+            fds[n].fd = (l_clients[i] != NULL) ? l_clients[i]->fd : -1;
+            fds[n++].events = POLLIN;
+        }
+
+        /* requests which can't be answered yet are retried periodically */
+        if (poll(fds, n, 10) < 0 && errno != EINTR)
+            break;
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(tcp, NULL, NULL);
+            int i = 0;
+            while (i < MAX_CLIENTS && l_clients[i] != NULL)
+                ++i;
+            if (fd >= 0 && i < MAX_CLIENTS && (l_clients[i] = calloc(1, sizeof(*l_clients[i]))) != NULL)
+                l_clients[i]->fd = fd;
+            else if (fd >= 0)
+                close(fd);
+        }
+
+        if (fds[1].revents & POLLIN)
+            process_udp();
+
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+        {
+            if (l_clients[i] != NULL && !process_tcp(l_clients[i], (fds[i + 2].revents & (POLLIN | POLLHUP)) != 0))
+            {
+                /* same as a disconnection notice */
+                disconnect_player(l_clients[i]->reg_id);
+                close(l_clients[i]->fd);
+                free(l_clients[i]);
+                l_clients[i] = NULL;
+            }
+        }
+    }
+
+    printf("netplay_server: %u inputs received (%u duplicates), %u input requests, %u sync checks, %s\n",
+        l_inputs_received, l_duplicates, l_requests, l_syncs_checked, (l_status & 1) ? "de-synced" : "in sync");
+
+    for (int i = 0; i < MAX_CLIENTS; ++i)
+    {
+        if (l_clients[i] != NULL)
+        {
+            close(l_clients[i]->fd);
+            free(l_clients[i]);
+        }
+    }
+    for (int i = 0; i < MAX_SAVES; ++i)
+        free(l_saves[i].data);
+    close(l_udp);
+    close(tcp);
+
+    return (l_status & 1) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -21,8 +21,10 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+#include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #ifdef ENABLE_TASK_DUMP
 #include <stdio.h>
@@ -35,6 +37,9 @@
 
 #define min(a,b) (((a) < (b)) ? (a) : (b))
 
+/* ucode_type used for non-task ucodes in the ucode cache */
+#define UCODE_TYPE_NON_TASK         0xffffffff
+
 /* some rdp status flags */
 #define DP_STATUS_FREEZE            0x2
 
@@ -42,6 +47,9 @@
 
 /* helper functions prototypes */
 static unsigned int sum_bytes(const unsigned char *bytes, unsigned int size);
+static uint32_t hash_bytes(uint32_t hash, const unsigned char *bytes, unsigned int size);
+static void fill_ucode_key(struct hle_t* hle, struct ucode_info_t* key);
+static unsigned int ucode_cache_index(const struct ucode_info_t* key);
 static bool is_task(struct hle_t* hle);
 static void send_dlist_to_gfx_plugin(struct hle_t* hle);
 static ucode_func_t try_audio_task_detection(struct hle_t* hle);
@@ -108,40 +116,53 @@ void hle_init(struct hle_t* hle,
 
 void hle_execute(struct hle_t* hle)
 {
-    uint32_t uc_start = *dmem_u32(hle, TASK_UCODE);
-    uint32_t uc_dstart = *dmem_u32(hle, TASK_UCODE_DATA);
-    uint32_t uc_dsize = *dmem_u32(hle, TASK_UCODE_DATA_SIZE);
-
-    bool match = false;
-    struct cached_ucodes_t * cached_ucodes = &hle->cached_ucodes;
-    struct ucode_info_t *info = NULL;
-    if (cached_ucodes->count > 0)
-        info = &cached_ucodes->infos[cached_ucodes->count-1];
-    for (int i = 0; i < cached_ucodes->count; i++)
+    struct cached_ucodes_t* cached_ucodes = &hle->cached_ucodes;
+    struct ucode_info_t key;
+    struct ucode_info_t* info;
+
+    fill_ucode_key(hle, &key);
+    info = &cached_ucodes->infos[ucode_cache_index(&key)];
+
+    if (info->uc_pfunc != NULL
+     && info->uc_type   == key.uc_type
+     && info->uc_start  == key.uc_start
+     && info->uc_size   == key.uc_size
+     && info->uc_dstart == key.uc_dstart
+     && info->uc_dsize  == key.uc_dsize
+     && info->uc_hash   == key.uc_hash)
     {
-        if (info->uc_start == uc_start && info->uc_dstart == uc_dstart && info->uc_dsize == uc_dsize)
-        {
-            match = true;
-            break;
-        }
-        info--;
+        ++cached_ucodes->hits;
     }
-
-    if (!match)
+    else
     {
-        info = &cached_ucodes->infos[cached_ucodes->count];
-        info->uc_start = uc_start;
-        info->uc_dstart = uc_dstart;
-        info->uc_dsize = uc_dsize;
+        /* same location but different contents: ucode was overwritten */
+        if (info->uc_pfunc != NULL
+         && info->uc_start == key.uc_start
+         && info->uc_dstart == key.uc_dstart)
+            ++cached_ucodes->invalidations;
+        else
+            ++cached_ucodes->misses;
+
+        *info = key;
         info->uc_pfunc = task_detection(hle);
-        cached_ucodes->count++;
-        assert(cached_ucodes->count <= CACHED_UCODES_MAX_SIZE);
         assert(info->uc_pfunc != NULL);
     }
 
     info->uc_pfunc(hle);
 }
 
+void hle_flush_ucode_cache(struct hle_t* hle)
+{
+    struct cached_ucodes_t* cached_ucodes = &hle->cached_ucodes;
+
+    if (cached_ucodes->hits + cached_ucodes->misses + cached_ucodes->invalidations != 0) {
+        HleVerboseMessage(hle->user_defined, "ucode cache: %u hits, %u misses, %u invalidations",
+                cached_ucodes->hits, cached_ucodes->misses, cached_ucodes->invalidations);
+    }
+
+    memset(cached_ucodes, 0, sizeof(*cached_ucodes));
+}
+
 /* local functions */
 static unsigned int sum_bytes(const unsigned char *bytes, unsigned int size)
 {
@@ -154,6 +175,60 @@ static unsigned int sum_bytes(const unsigned char *bytes, unsigned int size)
     return sum;
 }
 
+/* FNV-1a, cheap enough to run on every task */
+static uint32_t hash_bytes(uint32_t hash, const unsigned char *bytes, unsigned int size)
+{
+    const unsigned char *const bytes_end = bytes + size;
+
+    while (bytes != bytes_end) {
+        hash ^= *bytes++;
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+/**
+ * Build the ucode cache key for the current task.
+ *
+ * Only a few leading bytes of ucode and ucode data are hashed.
+ * This is enough to notice when a game uploads a different ucode
+ * at a previously seen address, without paying for a full sum_bytes
+ * on every task.
+ **/
+static void fill_ucode_key(struct hle_t* hle, struct ucode_info_t* key)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    key->uc_start  = *dmem_u32(hle, TASK_UCODE);
+    key->uc_size   = *dmem_u32(hle, TASK_UCODE_SIZE);
+    key->uc_dstart = *dmem_u32(hle, TASK_UCODE_DATA);
+    key->uc_dsize  = *dmem_u32(hle, TASK_UCODE_DATA_SIZE);
+    key->uc_pfunc  = NULL;
+
+    if (is_task(hle)) {
+        key->uc_type = *dmem_u32(hle, TASK_TYPE);
+        hash = hash_bytes(hash, (void*)dram_u32(hle, key->uc_start), UCODE_CACHE_HASH_SIZE);
+        hash = hash_bytes(hash, (void*)dram_u32(hle, key->uc_dstart), UCODE_CACHE_HASH_SIZE);
+    }
+    else {
+        /* DMEM task header is meaningless, non_task_detection only looks at IMEM */
+        key->uc_type = UCODE_TYPE_NON_TASK;
+        hash = hash_bytes(hash, hle->imem, 44);
+    }
+
+    key->uc_hash = hash;
+}
+
+static unsigned int ucode_cache_index(const struct ucode_info_t* key)
+{
+    /* index on location only, so that a ucode overwritten in place
+     * replaces its stale entry instead of lingering in another slot */
+    uint32_t h = key->uc_start ^ (key->uc_dstart * 0x9e3779b1) ^ key->uc_type;
+
+    return (h * 0x9e3779b1) >> (32 - UCODE_CACHE_BITS);
+}
+
 /**
  * Try to figure if the RSP was launched using osSpTask* functions
  * and not run directly (in which case DMEM[0xfc0-0xfff] is meaningless).
@@ -50,5 +50,7 @@ void hle_init(struct hle_t* hle,
 
 void hle_execute(struct hle_t* hle);
 
+void hle_flush_ucode_cache(struct hle_t* hle);
+
 #endif
 
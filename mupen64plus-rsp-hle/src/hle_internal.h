@@ -75,6 +75,10 @@ struct hle_t
     /* mp3.c */
     uint8_t  mp3_buffer[0x1000];
 
+    /* musyx.c */
+    unsigned int musyx_threads;
+    struct musyx_workers_t* musyx_workers;
+
     struct cached_ucodes_t cached_ucodes;
 };
 
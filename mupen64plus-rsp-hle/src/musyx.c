@@ -22,8 +22,14 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define MUSYX_THREADS
+#include <pthread.h>
+#endif
+
 #include "arithmetics.h"
 #include "audio.h"
 #include "common.h"
@@ -128,6 +134,38 @@ typedef struct {
     int16_t subframe_740_last4[4];
 } musyx_t;
 
+/* a voice rendered independently of the others, ready to be mixed */
+typedef struct {
+    uint32_t voice_ptr;
+
+    /* envmixed contributions to L,R,cc0,e50 subframes (not clamped yet) */
+    int32_t v4_mix[4][SUBFRAME_SIZE];
+
+    /* last resampled sample */
+    int16_t v4_last[4];
+} musyx_voice_t;
+
+#ifdef MUSYX_THREADS
+/* small worker pool used to render voices concurrently */
+struct musyx_workers_t {
+    pthread_t threads[MUSYX_MAX_THREADS];
+    unsigned thread_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    /* current batch of voices, protected by lock */
+    struct hle_t* hle;
+    unsigned voice_count;
+    unsigned next_voice;
+    unsigned pending;
+    bool quit;
+
+    musyx_voice_t voices[MAX_VOICES];
+};
+#endif
+
 typedef void (*mix_sfx_with_main_subframes_t)(musyx_t *musyx, const int16_t *subframe,
                                               const uint16_t* gains);
 
@@ -161,9 +199,20 @@ static void adpcm_predict_frame(int16_t *dst, const uint8_t *src,
                                 const uint8_t *nibbles,
                                 unsigned int rshift);
 
-static void mix_voice_samples(struct hle_t* hle, musyx_t *musyx,
-                              uint32_t voice_ptr, const int16_t *samples,
-                              unsigned segbase, unsigned offset, uint32_t last_sample_ptr);
+static void render_voice(struct hle_t* hle, musyx_voice_t *voice);
+static void resample_voice_samples(struct hle_t* hle, musyx_voice_t *voice,
+                                   const int16_t *samples,
+                                   unsigned segbase, unsigned offset);
+static void mix_voice(struct hle_t* hle, musyx_t *musyx,
+                      const musyx_voice_t *voice, uint32_t last_sample_ptr);
+
+#ifdef MUSYX_THREADS
+static unsigned count_voices(struct hle_t* hle, uint32_t voice_ptr);
+static struct musyx_workers_t* get_workers(struct hle_t* hle);
+static void* worker_thread(void* arg);
+static void render_voices_parallel(struct hle_t* hle, struct musyx_workers_t* workers,
+                                   uint32_t voice_ptr, unsigned voice_count);
+#endif
 
 static void sfx_stage(struct hle_t* hle,
                       mix_sfx_with_main_subframes_t mix_sfx_with_main_subframes,
@@ -466,39 +515,210 @@ static uint32_t voice_stage(struct hle_t* hle, musyx_t *musyx,
     if (*dram_u16(hle, voice_ptr + VOICE_CATSRC_0 + CATSRC_SIZE1) == 0) {
         HleVerboseMessage(hle->user_defined, "Skipping Voice stage");
         output_ptr = *dram_u32(hle, voice_ptr + VOICE_INTERLEAVED_PTR);
-    } else {
-        /* otherwise process voices until a non null output_ptr is encountered */
-        for (;;) {
-            /* load voice samples (PCM16 or APDCM) */
-            int16_t samples[SAMPLE_BUFFER_SIZE];
-            unsigned segbase;
-            unsigned offset;
-
-            HleVerboseMessage(hle->user_defined, "Processing Voice #%d", i);
-
-            if (*dram_u8(hle, voice_ptr + VOICE_ADPCM_FRAMES) == 0)
-                load_samples_PCM16(hle, voice_ptr, samples, &segbase, &offset);
-            else
-                load_samples_ADPCM(hle, voice_ptr, samples, &segbase, &offset);
-
-            /* mix them with each internal subframes */
-            mix_voice_samples(hle, musyx, voice_ptr, samples, segbase, offset,
-                              last_sample_ptr + i * 8);
-
-            /* check break condition */
-            output_ptr = *dram_u32(hle, voice_ptr + VOICE_INTERLEAVED_PTR);
-            if (output_ptr != 0)
-                break;
-
-            /* next voice */
-            ++i;
-            voice_ptr += VOICE_SIZE;
+        return output_ptr;
+    }
+
+#ifdef MUSYX_THREADS
+    if (hle->musyx_threads > 0) {
+        unsigned voice_count = count_voices(hle, voice_ptr);
+        struct musyx_workers_t* workers = (voice_count > 1) ? get_workers(hle) : NULL;
+
+        if (workers != NULL) {
+            /* voices are independent until they get mixed,
+             * so render them concurrently, then mix them in order */
+            render_voices_parallel(hle, workers, voice_ptr, voice_count);
+
+            for (i = 0; i < (int)voice_count; ++i)
+                mix_voice(hle, musyx, &workers->voices[i], last_sample_ptr + i * 8);
+
+            return *dram_u32(hle, voice_ptr + (voice_count - 1) * VOICE_SIZE + VOICE_INTERLEAVED_PTR);
         }
     }
+#endif
+
+    /* otherwise process voices until a non null output_ptr is encountered */
+    for (;;) {
+        musyx_voice_t voice;
+
+        HleVerboseMessage(hle->user_defined, "Processing Voice #%d", i);
+
+        voice.voice_ptr = voice_ptr;
+        render_voice(hle, &voice);
+
+        /* mix it with each internal subframes */
+        mix_voice(hle, musyx, &voice, last_sample_ptr + i * 8);
+
+        /* check break condition */
+        output_ptr = *dram_u32(hle, voice_ptr + VOICE_INTERLEAVED_PTR);
+        if (output_ptr != 0)
+            break;
+
+        /* next voice */
+        ++i;
+        voice_ptr += VOICE_SIZE;
+    }
 
     return output_ptr;
 }
 
+/* Load voice samples (PCM16 or ADPCM) and resample them.
+ * Only reads DRAM, so several voices can be rendered concurrently */
+static void render_voice(struct hle_t* hle, musyx_voice_t *voice)
+{
+    int16_t samples[SAMPLE_BUFFER_SIZE];
+    unsigned segbase;
+    unsigned offset;
+
+    if (*dram_u8(hle, voice->voice_ptr + VOICE_ADPCM_FRAMES) == 0)
+        load_samples_PCM16(hle, voice->voice_ptr, samples, &segbase, &offset);
+    else
+        load_samples_ADPCM(hle, voice->voice_ptr, samples, &segbase, &offset);
+
+    resample_voice_samples(hle, voice, samples, segbase, offset);
+}
+
+#ifdef MUSYX_THREADS
+/* Count voices up to and including the one with a non null output_ptr.
+ * Returns 0 if there is no such voice in the SFD */
+static unsigned count_voices(struct hle_t* hle, uint32_t voice_ptr)
+{
+    unsigned i;
+
+    for (i = 0; i < MAX_VOICES; ++i) {
+        if (*dram_u32(hle, voice_ptr + i * VOICE_SIZE + VOICE_INTERLEAVED_PTR) != 0)
+            return i + 1;
+    }
+
+    return 0;
+}
+
+static struct musyx_workers_t* get_workers(struct hle_t* hle)
+{
+    struct musyx_workers_t* workers = hle->musyx_workers;
+    unsigned i;
+
+    if (workers != NULL)
+        return workers;
+
+    workers = calloc(1, sizeof(*workers));
+    if (workers == NULL)
+        return NULL;
+
+    pthread_mutex_init(&workers->lock, NULL);
+    pthread_cond_init(&workers->work_cond, NULL);
+    pthread_cond_init(&workers->done_cond, NULL);
+
+    for (i = 0; i < hle->musyx_threads && i < MUSYX_MAX_THREADS; ++i) {
+        if (pthread_create(&workers->threads[i], NULL, worker_thread, workers) != 0)
+            break;
+    }
+    workers->thread_count = i;
+
+    hle->musyx_workers = workers;
+
+    if (workers->thread_count == 0) {
+        HleWarnMessage(hle->user_defined, "Couldn't start MusyX worker threads");
+        musyx_stop_workers(hle);
+        hle->musyx_threads = 0;
+        return NULL;
+    }
+
+    HleVerboseMessage(hle->user_defined, "Started %u MusyX worker threads", workers->thread_count);
+    return workers;
+}
+
+void musyx_stop_workers(struct hle_t* hle)
+{
+    struct musyx_workers_t* workers = hle->musyx_workers;
+    unsigned i;
+
+    if (workers == NULL)
+        return;
+
+    pthread_mutex_lock(&workers->lock);
+    workers->quit = true;
+    pthread_cond_broadcast(&workers->work_cond);
+    pthread_mutex_unlock(&workers->lock);
+
+    for (i = 0; i < workers->thread_count; ++i)
+        pthread_join(workers->threads[i], NULL);
+
+    pthread_cond_destroy(&workers->done_cond);
+    pthread_cond_destroy(&workers->work_cond);
+    pthread_mutex_destroy(&workers->lock);
+
+    free(workers);
+    hle->musyx_workers = NULL;
+}
+
+/* grab next voice of current batch, must be called with lock held.
+ * Returns false if there is nothing left to render */
+static bool render_next_voice(struct musyx_workers_t* workers)
+{
+    musyx_voice_t* voice;
+
+    if (workers->next_voice >= workers->voice_count)
+        return false;
+
+    voice = &workers->voices[workers->next_voice++];
+
+    pthread_mutex_unlock(&workers->lock);
+    render_voice(workers->hle, voice);
+    pthread_mutex_lock(&workers->lock);
+
+    if (--workers->pending == 0)
+        pthread_cond_signal(&workers->done_cond);
+
+    return true;
+}
+
+static void* worker_thread(void* arg)
+{
+    struct musyx_workers_t* workers = arg;
+
+    pthread_mutex_lock(&workers->lock);
+    while (!workers->quit) {
+        if (!render_next_voice(workers))
+            pthread_cond_wait(&workers->work_cond, &workers->lock);
+    }
+    pthread_mutex_unlock(&workers->lock);
+
+    return NULL;
+}
+
+static void render_voices_parallel(struct hle_t* hle, struct musyx_workers_t* workers,
+                                   uint32_t voice_ptr, unsigned voice_count)
+{
+    unsigned i;
+
+    HleVerboseMessage(hle->user_defined, "Processing %u Voices", voice_count);
+
+    pthread_mutex_lock(&workers->lock);
+
+    for (i = 0; i < voice_count; ++i)
+        workers->voices[i].voice_ptr = voice_ptr + i * VOICE_SIZE;
+
+    workers->hle = hle;
+    workers->voice_count = voice_count;
+    workers->next_voice = 0;
+    workers->pending = voice_count;
+    pthread_cond_broadcast(&workers->work_cond);
+
+    /* calling thread helps too */
+    while (render_next_voice(workers)) {}
+
+    while (workers->pending != 0)
+        pthread_cond_wait(&workers->done_cond, &workers->lock);
+
+    workers->voice_count = 0;
+    pthread_mutex_unlock(&workers->lock);
+}
+#else
+void musyx_stop_workers(struct hle_t* UNUSED(hle))
+{
+}
+#endif
+
 static void dma_cat8(struct hle_t* hle, uint8_t *dst, uint32_t catsrc_ptr)
 {
     uint32_t ptr1  = *dram_u32(hle, catsrc_ptr + CATSRC_PTR1);
@@ -667,11 +887,12 @@ static void adpcm_predict_frame(int16_t *dst, const uint8_t *src,
     }
 }
 
-static void mix_voice_samples(struct hle_t* hle, musyx_t *musyx,
-                              uint32_t voice_ptr, const int16_t *samples,
-                              unsigned segbase, unsigned offset, uint32_t last_sample_ptr)
+static void resample_voice_samples(struct hle_t* hle, musyx_voice_t *voice,
+                                   const int16_t *samples,
+                                   unsigned segbase, unsigned offset)
 {
     int i, k;
+    const uint32_t voice_ptr = voice->voice_ptr;
 
     /* parse VOICE structure */
     const uint16_t pitch_q16   = *dram_u16(hle, voice_ptr + VOICE_PITCH_Q16);
@@ -694,17 +915,10 @@ static void mix_voice_samples(struct hle_t* hle, musyx_t *musyx,
 
     int32_t  v4_env[4];
     int32_t  v4_env_step[4];
-    int16_t *v4_dst[4];
-    int16_t  v4[4];
 
     dram_load_u32(hle, (uint32_t *)v4_env,      voice_ptr + VOICE_ENV_BEGIN, 4);
     dram_load_u32(hle, (uint32_t *)v4_env_step, voice_ptr + VOICE_ENV_STEP,  4);
 
-    v4_dst[0] = musyx->left;
-    v4_dst[1] = musyx->right;
-    v4_dst[2] = musyx->cc0;
-    v4_dst[3] = musyx->e50;
-
     HleVerboseMessage(hle->user_defined,
                       "Voice debug: segbase=%d"
                       "\tu16_4e=%04x\n"
@@ -740,21 +954,41 @@ static void mix_voice_samples(struct hle_t* hle, musyx_t *musyx,
         for (k = 0; k < 4; ++k) {
             /* envmix */
             int32_t accu = (v * (v4_env[k] >> 16)) >> 15;
-            v4[k] = clamp_s16(accu);
-            *(v4_dst[k]) = clamp_s16(accu + *(v4_dst[k]));
+            voice->v4_mix[k][i] = accu;
 
-            /* update envelopes and dst pointers */
-            ++(v4_dst[k]);
+            /* update envelopes */
             v4_env[k] += v4_env_step[k];
         }
     }
 
+    /* keep last resampled sample */
+    for (k = 0; k < 4; ++k)
+        voice->v4_last[k] = clamp_s16(voice->v4_mix[k][SUBFRAME_SIZE - 1]);
+}
+
+static void mix_voice(struct hle_t* hle, musyx_t *musyx,
+                      const musyx_voice_t *voice, uint32_t last_sample_ptr)
+{
+    int i, k;
+    int16_t *v4_dst[4];
+
+    v4_dst[0] = musyx->left;
+    v4_dst[1] = musyx->right;
+    v4_dst[2] = musyx->cc0;
+    v4_dst[3] = musyx->e50;
+
+    for (k = 0; k < 4; ++k) {
+        for (i = 0; i < SUBFRAME_SIZE; ++i)
+            v4_dst[k][i] = clamp_s16(voice->v4_mix[k][i] + v4_dst[k][i]);
+    }
+
     /* save last resampled sample */
-    dram_store_u16(hle, (uint16_t *)v4, last_sample_ptr, 4);
+    dram_store_u16(hle, (uint16_t *)voice->v4_last, last_sample_ptr, 4);
 
     HleVerboseMessage(hle->user_defined,
                       "last_sample = %04x %04x %04x %04x",
-                      v4[0], v4[1], v4[2], v4[3]);
+                      voice->v4_last[0], voice->v4_last[1],
+                      voice->v4_last[2], voice->v4_last[3]);
 }
 
 
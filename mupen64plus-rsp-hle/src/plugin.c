@@ -51,6 +51,7 @@
 #define RSP_HLE_CONFIG_FALLBACK "RspFallback"
 #define RSP_HLE_CONFIG_HLE_GFX  "DisplayListToGraphicsPlugin"
 #define RSP_HLE_CONFIG_HLE_AUD  "AudioListToAudioPlugin"
+#define RSP_HLE_CONFIG_MUSYX_THREADS "MusyXThreads"
 
 
 #define VERSION_PRINTF_SPLIT(x) (((x) >> 16) & 0xffff), (((x) >> 8) & 0xff), ((x) & 0xff)
@@ -377,6 +378,8 @@ EXPORT m64p_error CALL PluginStartup(m64p_dynlib_handle CoreLibHandle, void *Con
         "Send display lists to the graphics plugin");
     ConfigSetDefaultBool(l_ConfigRspHle, RSP_HLE_CONFIG_HLE_AUD, 0,
         "Send audio lists to the audio plugin");
+    ConfigSetDefaultInt(l_ConfigRspHle, RSP_HLE_CONFIG_MUSYX_THREADS, 0,
+        "Number of worker threads used to render MusyX voices (0 = render on the RSP thread)");
 
     l_CoreHandle = CoreLibHandle;
 
@@ -395,6 +398,7 @@ EXPORT m64p_error CALL PluginShutdown(void)
     l_CoreHandle = NULL;
 
     teardown_rsp_fallback();
+    musyx_stop_workers(&g_hle);
 
     l_PluginInit = 0;
     return M64ERR_SUCCESS;
@@ -429,6 +433,8 @@ EXPORT unsigned int CALL DoRspCycles(unsigned int Cycles)
 
 EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, unsigned int* CycleCount)
 {
+    int musyx_threads;
+
     hle_init(&g_hle,
              Rsp_Info.RDRAM,
              Rsp_Info.DMEM,
@@ -463,6 +469,8 @@ EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, unsigned int* CycleCount)
 
     g_hle.hle_gfx = ConfigGetParamBool(l_ConfigRspHle, RSP_HLE_CONFIG_HLE_GFX);
     g_hle.hle_aud = ConfigGetParamBool(l_ConfigRspHle, RSP_HLE_CONFIG_HLE_AUD);
+    musyx_threads = ConfigGetParamInt(l_ConfigRspHle, RSP_HLE_CONFIG_MUSYX_THREADS);
+    g_hle.musyx_threads = (musyx_threads > 0) ? musyx_threads : 0;
 
     /* notify fallback plugin */
     if (l_InitiateRSP) {
@@ -472,7 +480,8 @@ EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, unsigned int* CycleCount)
 
 EXPORT void CALL RomClosed(void)
 {
-    g_hle.cached_ucodes.count = 0;
+    hle_flush_ucode_cache(&g_hle);
+    musyx_stop_workers(&g_hle);
 
     /* notify fallback plugin */
     if (l_RomClosed) {
@@ -24,22 +24,38 @@
 
 #include <stdint.h>
 
-#define CACHED_UCODES_MAX_SIZE 16
+/* ucode detection cache is direct-mapped with 2^UCODE_CACHE_BITS entries */
+#define UCODE_CACHE_BITS        4
+#define UCODE_CACHE_SIZE        (1 << UCODE_CACHE_BITS)
+
+/* number of leading ucode (and ucode data) bytes hashed to detect ucode changes */
+#define UCODE_CACHE_HASH_SIZE   0x40
 
 struct hle_t;
+struct musyx_workers_t;
+
+/* upper bound for MusyX voice rendering threads */
+#define MUSYX_MAX_THREADS       16
 
 typedef void(*ucode_func_t)(struct hle_t* hle);
 
 struct ucode_info_t {
+    uint32_t     uc_type;
     uint32_t     uc_start;
+    uint32_t     uc_size;
     uint32_t     uc_dstart;
-    uint16_t     uc_dsize;
+    uint32_t     uc_dsize;
+    uint32_t     uc_hash;
     ucode_func_t uc_pfunc;
 };
 
 struct cached_ucodes_t {
-    struct ucode_info_t infos[CACHED_UCODES_MAX_SIZE];
-    int count;
+    struct ucode_info_t infos[UCODE_CACHE_SIZE];
+
+    /* statistics */
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t invalidations;
 };
 
 /* cic_x105 ucode */
@@ -151,6 +167,7 @@ void mp3_task(struct hle_t* hle, unsigned int index, uint32_t address);
 /* musyx ucodes */
 void musyx_v1_task(struct hle_t* hle);
 void musyx_v2_task(struct hle_t* hle);
+void musyx_stop_workers(struct hle_t* hle);
 
 
 /* jpeg ucodes */